@@ -26,6 +26,57 @@ let package = Package(
                 .unsafeFlags(["-std=c++11"])
             ]
         ),
+        // Recall / QPS evaluation against brute force (swift run -c release hnswlib_eval)
+        .executableTarget(
+            name: "hnswlib_eval",
+            dependencies: ["hnswlib_cpp"],
+            path: "Sources/hnswlib_eval",
+            cxxSettings: [
+                .define("NDEBUG"),
+                .unsafeFlags(["-std=c++11"])
+            ]
+        ),
+        // Local search server over a Unix domain socket (swift run -c release hnswlib_server)
+        .executableTarget(
+            name: "hnswlib_server",
+            dependencies: ["hnswlib_cpp"],
+            path: "Sources/hnswlib_server",
+            cxxSettings: [
+                .define("NDEBUG"),
+                .unsafeFlags(["-std=c++11"])
+            ]
+        ),
+        // Distance kernel throughput (swift run -c release hnswlib_bench_kernels)
+        .executableTarget(
+            name: "hnswlib_bench_kernels",
+            path: "Sources/hnswlib_bench_kernels",
+            cxxSettings: [
+                .headerSearchPath("../hnswlib.cpp"),
+                .define("NDEBUG"),
+                .unsafeFlags(["-std=c++11"])
+            ]
+        ),
+        // Mixed read/write latency and lock contention (swift run -c release hnswlib_bench_concurrency)
+        .executableTarget(
+            name: "hnswlib_bench_concurrency",
+            path: "Sources/hnswlib_bench_concurrency",
+            cxxSettings: [
+                .headerSearchPath("../hnswlib.cpp"),
+                .define("NDEBUG"),
+                .define("HNSWLIB_LOCK_STATS"),
+                .unsafeFlags(["-std=c++11"])
+            ]
+        ),
+        // Flat single-level graph against standard HNSW (swift run -c release hnswlib_bench_flat)
+        .executableTarget(
+            name: "hnswlib_bench_flat",
+            path: "Sources/hnswlib_bench_flat",
+            cxxSettings: [
+                .headerSearchPath("../hnswlib.cpp"),
+                .define("NDEBUG"),
+                .unsafeFlags(["-std=c++11"])
+            ]
+        ),
         // Swift target
         .target(
             name: "hnswlib_swift",
@@ -1,9 +1,13 @@
 #include "HNSWLibWrapper.h"
 #include "../hnswlib.cpp/hnswlib.h"
+#include "../hnswlib.cpp/perf_counters.h"
 #include <iostream>
 #include <thread>
 #include <atomic>
 #include <vector>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
 
 using namespace hnswlib;
 
@@ -55,14 +59,17 @@ inline void ParallelFor(size_t start, size_t end, size_t numThreads, Function fn
     }
 }
 
-// Helper for vector normalization (used for cosine similarity)
-inline void normalize_vector(float* data, float* norm_array, int dim) {
-    float norm = 0.0f;
-    for (int i = 0; i < dim; i++)
-        norm += data[i] * data[i];
-    norm = 1.0f / (sqrtf(norm) + 1e-30f);
-    for (int i = 0; i < dim; i++)
-        norm_array[i] = data[i] * norm;
+// Minimum number of rows a thread scans when a brute-force query is split
+// across threads; below this the thread start-up cost outweighs the scan
+static const size_t BF_MIN_ROWS_PER_CHUNK = 16384;
+
+// Normalized copy of a batch of rows in one buffer when normalize is set, otherwise the input itself
+inline const float* prepare_batch(bool normalize, const float* data, size_t rows, int dim, std::vector<float>& buffer) {
+    if (!normalize) return data;
+    buffer.resize(rows * dim);
+    for (size_t i = 0; i < rows; i++)
+        NormalizeVector(&data[i * dim], &buffer[i * dim], dim);
+    return buffer.data();
 }
 
 // HNSW Index implementation
@@ -77,6 +84,39 @@ struct HNSWIndex {
     HierarchicalNSW<float>* appr_alg;
     SpaceInterface<float>* space;
     size_t default_ef;
+
+    // Per-query work, recorded by hnswlib_index_search_knn_with_stats
+    LogLinearHistogram latency_ns_hist;
+    LogLinearHistogram hops_hist;
+    LogLinearHistogram distance_computations_hist;
+    LogLinearHistogram visited_nodes_hist;
+
+    // Hardware counters per worker slot, collected while perf_enabled. Counted batches
+    // run on perf_pool, whose threads keep their counter group open between batches
+    bool perf_enabled;
+    std::mutex perf_lock;
+    std::vector<PerfCounts> perf_totals[2];  // indexed by HNSWPerfOperation
+    std::unique_ptr<ThreadPool> perf_pool;
+
+    // Insert phase timings per worker slot, collected while build_profile_enabled
+    bool build_profile_enabled;
+    std::mutex build_profile_lock;
+    std::vector<BuildProfileCounts> build_profile_totals;
+
+    // Called by add_items every build_progress_interval points
+    HNSWBuildProgressCallback build_progress;
+    void* build_progress_user_data;
+    size_t build_progress_interval;
+
+    // Group of each grouped label as a dense index into group_ids, for grouped search.
+    // set_groups publishes a new table, so searches keep the one they started with
+    struct GroupTable {
+        std::unordered_map<labeltype, uint32_t> label_groups;
+        std::unordered_map<uint64_t, uint32_t> group_index;
+        std::vector<uint64_t> group_ids;
+    };
+    std::mutex groups_lock;
+    std::shared_ptr<const GroupTable> groups;
     
     HNSWIndex(SpaceType space_type, int dim) 
         : space_type(space_type), 
@@ -88,14 +128,20 @@ struct HNSWIndex {
           cur_l(0),
           appr_alg(nullptr),
           space(nullptr),
-          default_ef(10) {
+          default_ef(10),
+          perf_enabled(false),
+          build_profile_enabled(false),
+          build_progress(nullptr),
+          build_progress_user_data(nullptr),
+          build_progress_interval(0),
+          groups(std::make_shared<GroupTable>()) {
         
         if (space_type == SpaceTypeL2) {
             space = new L2Space(dim);
         } else if (space_type == SpaceTypeIP) {
             space = new InnerProductSpace(dim);
         } else if (space_type == SpaceTypeCosine) {
-            space = new InnerProductSpace(dim);
+            space = new CosineSpace(dim);
             normalize = true;
         }
     }
@@ -110,6 +156,127 @@ struct HNSWIndex {
     }
 };
 
+// Group of a label from the label -> group table of an HNSWIndex
+class LabelGroupFunctor : public BaseGroupFunctor {
+    const std::unordered_map<labeltype, uint32_t>& groups_;
+
+ public:
+    explicit LabelGroupFunctor(const std::unordered_map<labeltype, uint32_t>& groups) : groups_(groups) {}
+
+    size_t operator()(labeltype label) override {
+        auto it = groups_.find(label);
+        return it == groups_.end() ? NO_GROUP : it->second;
+    }
+};
+
+// Adds one query to the index's latency / work histograms
+inline void record_query_stats(HNSWIndex* index, const SearchStats& stats) {
+    index->latency_ns_hist.record(stats.wall_time_ns);
+    index->hops_hist.record(stats.upper_hops + stats.base_hops);
+    index->distance_computations_hist.record(stats.upper_distance_computations + stats.base_distance_computations);
+    index->visited_nodes_hist.record(stats.visited_nodes);
+}
+
+// Per worker slot counters for one batch, or none when perf counters are off
+inline std::vector<PerfCounts> perf_batch(HNSWIndex* index, size_t num_threads) {
+    return std::vector<PerfCounts>(index->perf_enabled ? num_threads : 0);
+}
+
+inline PerfCounts* perf_slot(std::vector<PerfCounts>& batch, size_t threadId) {
+    return batch.empty() ? nullptr : &batch[threadId];
+}
+
+// ParallelFor for batches that may be counted: while perf counters are on, the items
+// run on the index's persistent pool instead of fresh threads, so that opening the
+// per-thread counter group (one perf_event_open per event) happens once per worker
+template<class Function>
+inline void perf_parallel_for(HNSWIndex* index, size_t start, size_t end, size_t num_threads, Function fn) {
+    if (!index->perf_enabled || !index->perf_pool || num_threads <= 1) {
+        ParallelFor(start, end, num_threads, fn);
+        return;
+    }
+    // one pool item per worker slot, each taking rows until none are left
+    std::atomic<size_t> current(start);
+    index->perf_pool->run(num_threads, [&](size_t threadId) {
+        size_t id;
+        while ((id = current.fetch_add(1)) < end) {
+            try {
+                fn(id, threadId);
+            } catch (...) {
+                current = end;
+                throw;
+            }
+        }
+    });
+}
+
+// Folds the counters of a finished batch into the index totals
+inline void perf_commit(HNSWIndex* index, HNSWPerfOperation op, const std::vector<PerfCounts>& batch) {
+    if (batch.empty()) return;
+    std::unique_lock<std::mutex> lock(index->perf_lock);
+    std::vector<PerfCounts>& totals = index->perf_totals[op];
+    if (totals.size() < batch.size()) totals.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++)
+        totals[i].add(batch[i]);
+}
+
+inline void perf_to_c(const PerfCounts& counts, HNSWPerfCounters* out) {
+    out->operations = counts.operations;
+    out->cycles = counts.values[PERF_CYCLES];
+    out->instructions = counts.values[PERF_INSTRUCTIONS];
+    out->llc_misses = counts.values[PERF_LLC_MISSES];
+    out->dtlb_misses = counts.values[PERF_DTLB_MISSES];
+    out->branch_misses = counts.values[PERF_BRANCH_MISSES];
+}
+
+// Per worker slot build profiles for one add_items call, or none when profiling is off
+inline std::vector<BuildProfileCounts> build_profile_batch(HNSWIndex* index, size_t num_threads) {
+    return std::vector<BuildProfileCounts>(index->build_profile_enabled ? num_threads : 0);
+}
+
+inline BuildProfileCounts* build_profile_slot(std::vector<BuildProfileCounts>& batch, size_t threadId) {
+    return batch.empty() ? nullptr : &batch[threadId];
+}
+
+inline void build_profile_commit(HNSWIndex* index, const std::vector<BuildProfileCounts>& batch) {
+    if (batch.empty()) return;
+    std::unique_lock<std::mutex> lock(index->build_profile_lock);
+    std::vector<BuildProfileCounts>& totals = index->build_profile_totals;
+    if (totals.size() < batch.size()) totals.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); i++)
+        totals[i].add(batch[i]);
+}
+
+inline void build_profile_to_c(const BuildProfileCounts& counts, HNSWBuildProfile* out) {
+    for (int i = 0; i < BUILD_PHASE_COUNT; i++) {
+        out->count[i] = counts.count[i];
+        out->ns[i] = counts.ns[i];
+    }
+}
+
+// Reports the progress of one add_items call to the index's callback
+class BuildProgress {
+    HNSWIndex* index_;
+    size_t total_;
+    std::atomic<size_t> done_;
+    std::chrono::steady_clock::time_point start_;
+    std::mutex lock_;
+
+ public:
+    BuildProgress(HNSWIndex* index, size_t total)
+        : index_(index), total_(total), done_(0), start_(std::chrono::steady_clock::now()) {}
+
+    void step() {
+        if (!index_->build_progress) return;
+        size_t done = ++done_;
+        if (done % index_->build_progress_interval != 0 && done != total_) return;
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        std::unique_lock<std::mutex> lock(lock_);
+        index_->build_progress(done, total_, seconds > 0 ? done / seconds : 0, index_->build_progress_user_data);
+    }
+};
+
 // BruteForce Index implementation
 struct BFIndex {
     SpaceType space_type;
@@ -134,7 +301,7 @@ struct BFIndex {
         } else if (space_type == SpaceTypeIP) {
             space = new InnerProductSpace(dim);
         } else if (space_type == SpaceTypeCosine) {
-            space = new InnerProductSpace(dim);
+            space = new CosineSpace(dim);
             normalize = true;
         }
     }
@@ -149,46 +316,2131 @@ struct BFIndex {
     }
 };
 
-// HNSW Index Functions
-extern "C" {
+// Quantized BruteForce Index implementation
+struct BFQuantizedIndex {
+    SpaceType space_type;
+    QuantizationType quantization;
+    int dim;
+    bool normalize;
+    int num_threads_default;
+    labeltype cur_l;
+    size_t rerank_k;
+    BruteforceSearch<float>* alg;
+    QuantizedSpace* space;
+    // Optional float copies used to rerank the quantized candidates exactly,
+    // stored at the slot the vector has in alg so one reservation covers both
+    std::vector<float> float_vectors;
+    SpaceInterface<float>* float_space;
+    
+    BFQuantizedIndex(SpaceType space_type, QuantizationType quantization, int dim) 
+        : space_type(space_type), 
+          quantization(quantization),
+          dim(dim), 
+          normalize(space_type == SpaceTypeCosine), 
+          num_threads_default(std::thread::hardware_concurrency()),
+          cur_l(0),
+          rerank_k(0),
+          alg(nullptr),
+          space(nullptr),
+          float_space(nullptr) {
+        
+        bool inner_product = space_type != SpaceTypeL2;
+        if (quantization == QuantizationInt8) {
+            space = new Int8Space(dim, inner_product);
+        } else if (quantization == QuantizationFp16) {
+            space = new Fp16Space(dim, inner_product);
+        }
+        
+        if (inner_product) {
+            float_space = new InnerProductSpace(dim);
+        } else {
+            float_space = new L2Space(dim);
+        }
+    }
+    
+    ~BFQuantizedIndex() {
+        if (alg) {
+            delete alg;
+        }
+        if (space) {
+            delete space;
+        }
+        if (float_space) {
+            delete float_space;
+        }
+    }
+};
 
-HNSWIndex* hnswlib_index_create(SpaceType space_type, int dim) {
-    try {
-        return new HNSWIndex(space_type, dim);
+// Sharded HNSW Index implementation
+struct ShardedHNSWIndex {
+    SpaceType space_type;
+    int dim;
+    bool normalize;
+    int num_threads_default;
+    labeltype cur_l;
+    size_t default_ef;
+    ShardedIndex<float>* alg;
+    SpaceInterface<float>* space;
+    
+    ShardedHNSWIndex(SpaceType space_type, int dim) 
+        : space_type(space_type), 
+          dim(dim), 
+          normalize(false), 
+          num_threads_default(std::thread::hardware_concurrency()),
+          cur_l(0),
+          default_ef(10),
+          alg(nullptr),
+          space(nullptr) {
+        
+        if (space_type == SpaceTypeL2) {
+            space = new L2Space(dim);
+        } else if (space_type == SpaceTypeIP) {
+            space = new InnerProductSpace(dim);
+        } else if (space_type == SpaceTypeCosine) {
+            space = new CosineSpace(dim);
+            normalize = true;
+        }
+    }
+    
+    ~ShardedHNSWIndex() {
+        if (alg) {
+            delete alg;
+        }
+        if (space) {
+            delete space;
+        }
+    }
+};
+
+// Partitioned (IVF) HNSW Index implementation
+struct PartitionedHNSWIndex {
+    SpaceType space_type;
+    int dim;
+    bool normalize;
+    int num_threads_default;
+    labeltype cur_l;
+    size_t default_ef;
+    PartitionedIndex<float>* alg;
+    SpaceInterface<float>* space;
+    
+    PartitionedHNSWIndex(SpaceType space_type, int dim) 
+        : space_type(space_type), 
+          dim(dim), 
+          normalize(false), 
+          num_threads_default(std::thread::hardware_concurrency()),
+          cur_l(0),
+          default_ef(10),
+          alg(nullptr),
+          space(nullptr) {
+        
+        if (space_type == SpaceTypeL2) {
+            space = new L2Space(dim);
+        } else if (space_type == SpaceTypeIP) {
+            space = new InnerProductSpace(dim);
+        } else if (space_type == SpaceTypeCosine) {
+            space = new InnerProductSpace(dim);
+            normalize = true;
+        }
+    }
+    
+    ~PartitionedHNSWIndex() {
+        if (alg) {
+            delete alg;
+        }
+        if (space) {
+            delete space;
+        }
+    }
+    
+    // Normalized copy of rows vectors for cosine, otherwise the input itself
+    const float* prepare(const float* data, size_t rows, std::vector<float>& buffer) const {
+        return prepare_batch(normalize, data, rows, dim, buffer);
+    }
+};
+
+// Tiered (LSM-style) HNSW Index implementation
+struct TieredHNSWIndex {
+    SpaceType space_type;
+    int dim;
+    bool normalize;
+    int num_threads_default;
+    labeltype cur_l;
+    size_t default_ef;
+    TieredIndex* alg;
+    SpaceInterface<float>* space;
+    // Space of the frozen segments when they are stored quantized, else null
+    QuantizedSpace* segment_space;
+    
+    TieredHNSWIndex(SpaceType space_type, int dim) 
+        : space_type(space_type), 
+          dim(dim), 
+          normalize(false), 
+          num_threads_default(std::thread::hardware_concurrency()),
+          cur_l(0),
+          default_ef(10),
+          alg(nullptr),
+          space(nullptr),
+          segment_space(nullptr) {
+        
+        if (space_type == SpaceTypeL2) {
+            space = new L2Space(dim);
+        } else if (space_type == SpaceTypeIP) {
+            space = new InnerProductSpace(dim);
+        } else if (space_type == SpaceTypeCosine) {
+            // inserted vectors are normalized by the space into the head, queries by prepare_batch
+            space = new CosineSpace(dim);
+            normalize = true;
+        }
+    }
+    
+    ~TieredHNSWIndex() {
+        if (alg) {
+            delete alg;
+        }
+        if (space) {
+            delete space;
+        }
+        if (segment_space) {
+            delete segment_space;
+        }
+    }
+    
+    void setSegmentQuantization(bool compress_segments, QuantizationType quantization) {
+        if (segment_space) {
+            delete segment_space;
+            segment_space = nullptr;
+        }
+        if (!compress_segments) return;
+        bool inner_product = space_type != SpaceTypeL2;
+        if (quantization == QuantizationInt8) {
+            segment_space = new Int8Space(dim, inner_product);
+        } else if (quantization == QuantizationFp16) {
+            segment_space = new Fp16Space(dim, inner_product);
+        }
+    }
+};
+
+// Multi-vector (document) HNSW Index implementation
+struct MultiVectorHNSWIndex {
+    typedef MultiVectorSearchScratch<uint32_t, float> Scratch;
+
+    SpaceType space_type;
+    int dim;
+    bool normalize;
+    bool ep_added;
+    int num_threads_default;
+    labeltype cur_l;
+    size_t default_ef;
+    HierarchicalNSW<float>* appr_alg;
+    BaseMultiVectorSpace<uint32_t>* space;
+
+    // Each element stores the dense index of its document after the vector, so that a
+    // search counts documents in flat arrays; doc_ids maps the index back to the caller's id
+    std::mutex doc_lock;
+    std::vector<uint64_t> doc_ids;
+    std::unordered_map<uint64_t, uint32_t> doc_index;
+    // Internal ids of the vectors of each document, for late-interaction scoring
+    std::vector<std::vector<tableint>> doc_members;
+
+    // Search scratch kept between batches, one taken per worker slot
+    std::mutex scratch_lock;
+    std::vector<std::unique_ptr<Scratch>> free_scratch;
+    
+    MultiVectorHNSWIndex(SpaceType space_type, int dim) 
+        : space_type(space_type), 
+          dim(dim), 
+          normalize(false), 
+          ep_added(false), 
+          num_threads_default(std::thread::hardware_concurrency()),
+          cur_l(0),
+          default_ef(10),
+          appr_alg(nullptr),
+          space(nullptr) {
+        
+        if (space_type == SpaceTypeL2) {
+            space = new MultiVectorL2Space<uint32_t>(dim);
+        } else if (space_type == SpaceTypeIP) {
+            space = new MultiVectorInnerProductSpace<uint32_t>(dim);
+        } else if (space_type == SpaceTypeCosine) {
+            space = new MultiVectorInnerProductSpace<uint32_t>(dim);
+            normalize = true;
+        }
+    }
+    
+    ~MultiVectorHNSWIndex() {
+        if (appr_alg) {
+            delete appr_alg;
+        }
+        if (space) {
+            delete space;
+        }
+    }
+
+    // Caller must hold doc_lock
+    uint32_t docIndex(uint64_t doc_id) {
+        auto it = doc_index.find(doc_id);
+        if (it != doc_index.end()) return it->second;
+        if (doc_ids.size() >= std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("Too many documents");
+        uint32_t index = (uint32_t) doc_ids.size();
+        doc_ids.push_back(doc_id);
+        doc_index[doc_id] = index;
+        doc_members.emplace_back();
+        return index;
+    }
+
+    // Rebuilds doc_members from the document index stored in every element
+    void collectMembers() {
+        doc_members.assign(doc_ids.size(), std::vector<tableint>());
+        for (tableint id = 0; id < appr_alg->cur_element_count; id++) {
+            uint32_t doc = space->get_doc_id(appr_alg->getDataByInternalId(id));
+            if (doc < doc_members.size()) doc_members[doc].push_back(id);
+        }
+    }
+
+    std::unique_ptr<Scratch> acquireScratch() {
+        std::unique_lock<std::mutex> lock(scratch_lock);
+        if (free_scratch.empty()) return std::unique_ptr<Scratch>(new Scratch());
+        std::unique_ptr<Scratch> scratch = std::move(free_scratch.back());
+        free_scratch.pop_back();
+        return scratch;
+    }
+
+    void releaseScratch(std::vector<std::unique_ptr<Scratch>>& scratch) {
+        std::unique_lock<std::mutex> lock(scratch_lock);
+        for (auto& s : scratch) free_scratch.push_back(std::move(s));
+    }
+};
+
+// Sparse-vector HNSW Index implementation
+struct SparseHNSWIndex {
+    int dim;
+    bool ep_added;
+    int num_threads_default;
+    labeltype cur_l;
+    size_t default_ef;
+    HierarchicalNSW<float>* appr_alg;
+    SparseInnerProductSpace* space;
+    
+    SparseHNSWIndex(int dim) 
+        : dim(dim), 
+          ep_added(false), 
+          num_threads_default(std::thread::hardware_concurrency()),
+          cur_l(0),
+          default_ef(10),
+          appr_alg(nullptr),
+          space(new SparseInnerProductSpace(dim)) {}
+    
+    ~SparseHNSWIndex() {
+        if (appr_alg) {
+            delete appr_alg;
+        }
+        if (space) {
+            delete space;
+        }
+    }
+};
+
+// Row i of a CSR batch as a SparseVector in `block`, sorted by index and checked against the space's dimension
+inline const SparseVector* csr_row(const size_t* indptr, const uint32_t* indices, const float* values, size_t i, size_t dim, std::vector<SparseEntry>& block) {
+    if (indptr[i + 1] < indptr[i])
+        throw std::runtime_error("CSR row pointers must not decrease");
+    size_t nnz = indptr[i + 1] - indptr[i];
+    if (nnz > dim)
+        throw std::runtime_error("Sparse row has more entries than dimensions");
+    block.resize(nnz + 1);
+    SparseVector* vector = reinterpret_cast<SparseVector*>(block.data());
+    vector->nnz = (uint32_t) nnz;
+    vector->reserved = 0;
+    SparseEntry* entries = vector->entries();
+    bool sorted = true;
+    for (size_t j = 0; j < nnz; j++) {
+        entries[j].index = indices[indptr[i] + j];
+        entries[j].value = values[indptr[i] + j];
+        if (entries[j].index >= dim)
+            throw std::runtime_error("Sparse index out of range");
+        if (j > 0 && entries[j].index < entries[j - 1].index) sorted = false;
+    }
+    if (!sorted) {
+        std::sort(entries, entries + nnz, [](const SparseEntry& a, const SparseEntry& b) {
+            return a.index < b.index;
+        });
+    }
+    return vector;
+}
+
+// Flag shared between a caller and its asynchronous request
+struct HNSWCancelToken {
+    std::atomic<bool> cancelled;
+
+    HNSWCancelToken() : cancelled(false) {}
+};
+
+// Dispatcher for asynchronous searches and inserts on an HNSWIndex
+struct HNSWAsyncQueue {
+    struct Request {
+        bool is_add;
+        std::vector<float> data;  // copied queries or rows
+        std::vector<uint64_t> ids;
+        size_t count;             // queries or rows in data
+        size_t k;
+        bool replace_deleted;
+        uint64_t* labels;
+        float* distances;
+        HNSWCancelToken* token;
+        HNSWAsyncCallback callback;
+        void* user_data;
+        std::chrono::steady_clock::time_point enqueued;
+        std::atomic<size_t> searched;
+        std::atomic<bool> failed;
+
+        Request() : is_add(false), count(0), k(0), replace_deleted(false), labels(nullptr), distances(nullptr),
+                    token(nullptr), callback(nullptr), user_data(nullptr), searched(0), failed(false) {}
+
+        bool cancelled() const {
+            return token && token->cancelled.load();
+        }
+    };
+
+    HNSWIndex* index;
+    size_t max_batch;
+    std::chrono::microseconds max_wait;
+    int num_threads;
+    // Searches of a batch run here, the dispatcher thread takes part in every batch
+    std::unique_ptr<ThreadPool> pool;
+
+    std::mutex lock;
+    std::condition_variable queued;
+    std::deque<Request*> requests;
+    size_t queued_queries;
+    bool stop;
+    std::thread dispatcher;
+
+    HNSWAsyncQueue(HNSWIndex* index, size_t max_batch, uint64_t max_wait_us, int num_threads)
+        : index(index),
+          max_batch(std::max<size_t>(1, max_batch)),
+          max_wait(max_wait_us),
+          num_threads(num_threads),
+          pool(new ThreadPool(num_threads - 1)),
+          queued_queries(0),
+          stop(false) {
+        dispatcher = std::thread(&HNSWAsyncQueue::run, this);
+    }
+
+    ~HNSWAsyncQueue() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            stop = true;
+        }
+        queued.notify_all();
+        dispatcher.join();
+    }
+
+    bool submit(Request* request) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (stop) return false;
+            request->enqueued = std::chrono::steady_clock::now();
+            requests.push_back(request);
+            if (!request->is_add) queued_queries += request->count;
+        }
+        queued.notify_one();
+        return true;
+    }
+
+    static void finish(Request* request, HNSWAsyncStatus status) {
+        HNSWAsyncCallback callback = request->callback;
+        void* user_data = request->user_data;
+        delete request;
+        callback(status, user_data);
+    }
+
+    void runAdd(Request* request) {
+        if (request->cancelled()) {
+            finish(request, HNSWAsyncCancelled);
+            return;
+        }
+        bool ok = hnswlib_index_add_items(index, request->data.data(), request->count, index->dim,
+                                          request->ids.empty() ? nullptr : request->ids.data(),
+                                          num_threads, request->replace_deleted);
+        finish(request, ok ? HNSWAsyncCompleted : HNSWAsyncFailed);
+    }
+
+    // One item per query, so that cancelling a request skips those of its queries that have not started
+    void runSearches(const std::vector<Request*>& batch) {
+        std::vector<std::pair<Request*, size_t>> items;
+        for (Request* request : batch) {
+            for (size_t i = 0; i < request->count; i++) items.push_back(std::make_pair(request, i));
+            // the queries are the request's own copy, so they are normalized in place
+            if (index->normalize) {
+                for (size_t i = 0; i < request->count; i++)
+                    NormalizeVector(&request->data[i * index->dim], &request->data[i * index->dim], index->dim);
+            }
+        }
+
+        pool->run(items.size(), [&](size_t item) {
+            Request* request = items[item].first;
+            size_t i = items[item].second;
+            if (request->failed.load() || request->cancelled()) return;
+
+            try {
+                const float* query_vector = &request->data[i * index->dim];
+                SearchStats query_stats;
+                std::priority_queue<std::pair<float, labeltype>> result =
+                    index->appr_alg->searchKnnWithStats(query_vector, request->k, query_stats);
+                record_query_stats(index, query_stats);
+                if (result.size() != request->k) {
+                    throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+                }
+
+                for (int j = request->k - 1; j >= 0; j--) {
+                    request->distances[i * request->k + j] = result.top().first;
+                    request->labels[i * request->k + j] = result.top().second;
+                    result.pop();
+                }
+                request->searched++;
+            } catch (const std::exception& e) {
+                std::cerr << "Error searching: " << e.what() << std::endl;
+                request->failed = true;
+            }
+        });
+
+        for (Request* request : batch) {
+            if (request->failed.load()) {
+                finish(request, HNSWAsyncFailed);
+            } else if (request->searched.load() < request->count) {
+                finish(request, HNSWAsyncCancelled);
+            } else {
+                finish(request, HNSWAsyncCompleted);
+            }
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true) {
+            queued.wait(guard, [this] { return stop || !requests.empty(); });
+            if (stop) break;
+
+            if (requests.front()->is_add) {
+                Request* request = requests.front();
+                requests.pop_front();
+                guard.unlock();
+                runAdd(request);
+                guard.lock();
+                continue;
+            }
+
+            // give concurrent callers until max_wait after the oldest search to join its batch
+            auto deadline = requests.front()->enqueued + max_wait;
+            queued.wait_until(guard, deadline, [this] { return stop || queued_queries >= max_batch; });
+            if (stop) break;
+
+            // searches up to the next insert, at least one request and at most max_batch queries otherwise
+            std::vector<Request*> batch;
+            size_t batch_queries = 0;
+            while (!requests.empty() && !requests.front()->is_add &&
+                   (batch.empty() || batch_queries + requests.front()->count <= max_batch)) {
+                batch.push_back(requests.front());
+                batch_queries += requests.front()->count;
+                requests.pop_front();
+            }
+            queued_queries -= batch_queries;
+            guard.unlock();
+            runSearches(batch);
+            guard.lock();
+        }
+
+        // requests that never started are reported as cancelled
+        std::deque<Request*> remaining;
+        remaining.swap(requests);
+        guard.unlock();
+        for (Request* request : remaining) finish(request, HNSWAsyncCancelled);
+    }
+};
+
+// HNSW Index Functions
+extern "C" {
+
+HNSWIndex* hnswlib_index_create(SpaceType space_type, int dim) {
+    try {
+        return new HNSWIndex(space_type, dim);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_index_free(HNSWIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_index_init(HNSWIndex* index, size_t max_elements, size_t M, size_t ef_construction, size_t random_seed, bool allow_replace_deleted) {
+    if (!index || !index->space) return false;
+    
+    try {
+        if (index->appr_alg) {
+            delete index->appr_alg;
+        }
+        
+        index->cur_l = 0;
+        index->appr_alg = new HierarchicalNSW<float>(index->space, max_elements, M, ef_construction, random_seed, allow_replace_deleted);
+        index->index_inited = true;
+        index->ep_added = false;
+        index->appr_alg->ef_ = index->default_ef;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_index_add_items(HNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, int num_threads, bool replace_deleted) {
+    if (!index || !index->appr_alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Avoid using threads when the number of additions is small
+        if (rows <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        std::vector<PerfCounts> perf = perf_batch(index, num_threads);
+        std::vector<BuildProfileCounts> profile = build_profile_batch(index, num_threads);
+        BuildProgress progress(index, rows);
+        // Cosine vectors are normalized by the space straight into their slot
+        int start = 0;
+        if (!index->ep_added) {
+            size_t id = ids ? ids[0] : index->cur_l;
+            PerfScope perf_scope(perf_slot(perf, 0));
+            BuildProfileScope profile_scope(build_profile_slot(profile, 0));
+            index->appr_alg->addPoint(&data[0], id, replace_deleted);
+            progress.step();
+            start = 1;
+            index->ep_added = true;
+        }
+        
+        perf_parallel_for(index, start, rows, num_threads, [&](size_t row, size_t threadId) {
+            PerfScope perf_scope(perf_slot(perf, threadId));
+            BuildProfileScope profile_scope(build_profile_slot(profile, threadId));
+            size_t id = ids ? ids[row] : (index->cur_l + row);
+            index->appr_alg->addPoint(&data[row * dim], id, replace_deleted);
+            progress.step();
+        });
+        
+        index->cur_l += rows;
+        perf_commit(index, HNSWPerfAdd, perf);
+        build_profile_commit(index, profile);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding items: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Shared by the plain and the stats search: fills k results per query, and with
+// collect_stats also records every query in the histograms and in stats (if not null)
+inline void search_knn_batch(HNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads, bool collect_stats, HNSWSearchStats* stats) {
+    if (num_threads <= 0) {
+        num_threads = index->num_threads_default;
+    }
+    
+    // Avoid using threads when the number of searches is small
+    if (query_count <= (size_t)(num_threads * 4)) {
+        num_threads = 1;
+    }
+    
+    std::vector<float> normalized;
+    const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+    std::vector<PerfCounts> perf = perf_batch(index, num_threads);
+    perf_parallel_for(index, 0, query_count, num_threads, [&](size_t i, size_t threadId) {
+        PerfScope perf_scope(perf_slot(perf, threadId));
+        const float* query_vector = &queries[i * index->dim];
+        
+        std::priority_queue<std::pair<float, labeltype>> result;
+        if (collect_stats) {
+            SearchStats query_stats;
+            result = index->appr_alg->searchKnnWithStats(query_vector, k, query_stats);
+            record_query_stats(index, query_stats);
+            
+            if (stats) {
+                HNSWSearchStats& out = stats[i];
+                out.upper_hops = query_stats.upper_hops;
+                out.upper_distance_computations = query_stats.upper_distance_computations;
+                out.base_hops = query_stats.base_hops;
+                out.base_distance_computations = query_stats.base_distance_computations;
+                out.visited_nodes = query_stats.visited_nodes;
+                out.filter_rejects = query_stats.filter_rejects;
+                out.wall_time_ns = query_stats.wall_time_ns;
+            }
+        } else {
+            result = index->appr_alg->searchKnn(query_vector, k);
+        }
+        
+        if (result.size() != k) {
+            throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+        }
+        
+        for (int j = k - 1; j >= 0; j--) {
+            auto& result_tuple = result.top();
+            result_distances[i * k + j] = result_tuple.first;
+            result_labels[i * k + j] = result_tuple.second;
+            result.pop();
+        }
+    });
+    perf_commit(index, HNSWPerfSearch, perf);
+}
+
+bool hnswlib_index_search_knn(HNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
+    if (!index || !index->appr_alg) return false;
+    
+    try {
+        search_knn_batch(index, query, k, result_labels, result_distances, query_count, num_threads, false, nullptr);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_index_search_range(HNSWIndex* index, const float* query, float radius, size_t max_results, uint64_t* result_labels, float* result_distances, size_t* result_count) {
+    if (!index || !index->appr_alg || !result_count || max_results == 0) return false;
+    
+    try {
+        std::vector<float> normalized;
+        const float* query_data = prepare_batch(index->normalize, query, 1, index->dim, normalized);
+        
+        // The search keeps going until ef candidates were seen and the next one is outside the radius
+        size_t min_candidates = std::min(index->appr_alg->ef_, max_results);
+        EpsilonSearchStopCondition<float> stop_condition(radius, min_candidates, max_results);
+        std::vector<std::pair<float, labeltype>> result;
+        std::vector<PerfCounts> perf = perf_batch(index, 1);
+        {
+            PerfScope perf_scope(perf_slot(perf, 0));
+            result = index->appr_alg->searchStopConditionClosest(query_data, stop_condition);
+        }
+        perf_commit(index, HNSWPerfSearch, perf);
+        
+        for (size_t i = 0; i < result.size(); i++) {
+            result_distances[i] = result[i].first;
+            result_labels[i] = result[i].second;
+        }
+        *result_count = result.size();
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_index_set_groups(HNSWIndex* index, const uint64_t* labels, const uint64_t* groups, size_t count) {
+    if (!index || (count > 0 && (!labels || !groups))) return false;
+    
+    try {
+        // updates build on a copy and are serialized by holding the lock until it is published
+        std::unique_lock<std::mutex> lock(index->groups_lock);
+        std::shared_ptr<HNSWIndex::GroupTable> table = std::make_shared<HNSWIndex::GroupTable>(*index->groups);
+        for (size_t i = 0; i < count; i++) {
+            auto it = table->group_index.find(groups[i]);
+            uint32_t group = 0;
+            if (it != table->group_index.end()) {
+                group = it->second;
+            } else {
+                group = (uint32_t) table->group_ids.size();
+                table->group_ids.push_back(groups[i]);
+                table->group_index[groups[i]] = group;
+            }
+            table->label_groups[labels[i]] = group;
+        }
+        index->groups = table;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error setting groups: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_index_search_grouped(HNSWIndex* index, const float* query, size_t query_count, size_t k, size_t max_per_group, uint64_t* result_labels, float* result_distances, size_t* result_counts, int num_threads) {
+    if (!index || !index->appr_alg || !result_counts || k == 0) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Avoid using threads when the number of searches is small
+        if (query_count <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+        std::shared_ptr<const HNSWIndex::GroupTable> table;
+        {
+            std::unique_lock<std::mutex> lock(index->groups_lock);
+            table = index->groups;
+        }
+        LabelGroupFunctor group_of(table->label_groups);
+        std::vector<MultiVectorSearchScratch<size_t, float>> scratch(num_threads);
+        std::vector<PerfCounts> perf = perf_batch(index, num_threads);
+        perf_parallel_for(index, 0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            PerfScope perf_scope(perf_slot(perf, threadId));
+            GroupedSearchStopCondition<float> stop_condition(group_of, k, max_per_group, index->appr_alg->ef_, &scratch[threadId]);
+            std::vector<std::pair<float, labeltype>> result =
+                index->appr_alg->searchStopConditionClosest(&queries[i * index->dim], stop_condition);
+            
+            for (size_t j = 0; j < k; j++) {
+                result_labels[i * k + j] = j < result.size() ? result[j].second : std::numeric_limits<uint64_t>::max();
+                result_distances[i * k + j] = j < result.size() ? result[j].first : std::numeric_limits<float>::infinity();
+            }
+            result_counts[i] = result.size();
+        });
+        perf_commit(index, HNSWPerfSearch, perf);
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_index_search_knn_with_stats(HNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads, HNSWSearchStats* stats) {
+    if (!index || !index->appr_alg) return false;
+
+    try {
+        search_knn_batch(index, query, k, result_labels, result_distances, query_count, num_threads, true, stats);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_index_reset_query_histograms(HNSWIndex* index) {
+    if (!index) return;
+
+    index->latency_ns_hist.reset();
+    index->hops_hist.reset();
+    index->distance_computations_hist.reset();
+    index->visited_nodes_hist.reset();
+}
+
+size_t hnswlib_index_export_prometheus(HNSWIndex* index, char* buffer, size_t buffer_size) {
+    if (!index) return 0;
+
+    std::ostringstream out;
+    index->latency_ns_hist.writePrometheus(out, "hnswlib_query_latency_seconds",
+                                           "Wall time of HNSW queries", 1e-9, 10, 34);
+    index->hops_hist.writePrometheus(out, "hnswlib_query_hops",
+                                     "Graph nodes expanded per HNSW query", 1, 0, 20);
+    index->distance_computations_hist.writePrometheus(out, "hnswlib_query_distance_computations",
+                                                      "Distance computations per HNSW query", 1, 0, 24);
+    index->visited_nodes_hist.writePrometheus(out, "hnswlib_query_visited_nodes",
+                                              "Nodes visited on level 0 per HNSW query", 1, 0, 24);
+
+    std::string text = out.str();
+    if (buffer && buffer_size > 0) {
+        size_t n = std::min(text.size(), buffer_size - 1);
+        memcpy(buffer, text.data(), n);
+        buffer[n] = '\0';
+    }
+    return text.size();
+}
+
+bool hnswlib_perf_counters_available(void) {
+    return threadPerfCounters().available();
+}
+
+bool hnswlib_index_set_perf_counters(HNSWIndex* index, bool enable) {
+    if (!index) return false;
+    if (enable && !threadPerfCounters().available()) {
+        std::cerr << "Error enabling perf counters: perf_event_open is not available" << std::endl;
+        return false;
+    }
+    if (enable && !index->perf_pool) {
+        index->perf_pool.reset(new ThreadPool(std::max(index->num_threads_default, 1) - 1));
+    }
+    index->perf_enabled = enable;
+    return true;
+}
+
+bool hnswlib_index_get_perf_counters(HNSWIndex* index, HNSWPerfOperation op, HNSWPerfCounters* total) {
+    if (!index || !total || op < HNSWPerfSearch || op > HNSWPerfAdd) return false;
+
+    std::unique_lock<std::mutex> lock(index->perf_lock);
+    PerfCounts sum;
+    for (const auto& counts : index->perf_totals[op])
+        sum.add(counts);
+    perf_to_c(sum, total);
+    return true;
+}
+
+size_t hnswlib_index_get_perf_counters_per_thread(HNSWIndex* index, HNSWPerfOperation op, HNSWPerfCounters* out, size_t max_threads) {
+    if (!index || op < HNSWPerfSearch || op > HNSWPerfAdd) return 0;
+
+    std::unique_lock<std::mutex> lock(index->perf_lock);
+    const std::vector<PerfCounts>& totals = index->perf_totals[op];
+    for (size_t i = 0; out && i < totals.size() && i < max_threads; i++)
+        perf_to_c(totals[i], &out[i]);
+    return totals.size();
+}
+
+void hnswlib_index_reset_perf_counters(HNSWIndex* index) {
+    if (!index) return;
+
+    std::unique_lock<std::mutex> lock(index->perf_lock);
+    index->perf_totals[HNSWPerfSearch].clear();
+    index->perf_totals[HNSWPerfAdd].clear();
+}
+
+void hnswlib_index_set_build_profiling(HNSWIndex* index, bool enable) {
+    if (!index) return;
+    index->build_profile_enabled = enable;
+}
+
+bool hnswlib_index_get_build_profile(HNSWIndex* index, HNSWBuildProfile* total) {
+    if (!index || !total) return false;
+
+    std::unique_lock<std::mutex> lock(index->build_profile_lock);
+    BuildProfileCounts sum;
+    for (const BuildProfileCounts& counts : index->build_profile_totals)
+        sum.add(counts);
+    build_profile_to_c(sum, total);
+    return true;
+}
+
+size_t hnswlib_index_get_build_profile_per_thread(HNSWIndex* index, HNSWBuildProfile* out, size_t max_threads) {
+    if (!index) return 0;
+
+    std::unique_lock<std::mutex> lock(index->build_profile_lock);
+    const std::vector<BuildProfileCounts>& totals = index->build_profile_totals;
+    for (size_t i = 0; out && i < totals.size() && i < max_threads; i++)
+        build_profile_to_c(totals[i], &out[i]);
+    return totals.size();
+}
+
+void hnswlib_index_reset_build_profile(HNSWIndex* index) {
+    if (!index) return;
+
+    std::unique_lock<std::mutex> lock(index->build_profile_lock);
+    index->build_profile_totals.clear();
+}
+
+void hnswlib_index_set_build_progress(HNSWIndex* index, HNSWBuildProgressCallback callback, void* user_data, size_t interval) {
+    if (!index) return;
+
+    index->build_progress = callback;
+    index->build_progress_user_data = user_data;
+    index->build_progress_interval = interval > 0 ? interval : 1;
+}
+
+bool hnswlib_index_graph_stats(HNSWIndex* index, size_t navigability_samples, int num_threads, HNSWGraphStats* stats) {
+    if (!index || !index->appr_alg || !stats) return false;
+
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        GraphStats g = index->appr_alg->graphStats(navigability_samples, num_threads);
+
+        memset(stats, 0, sizeof(HNSWGraphStats));
+        stats->num_elements = g.num_elements;
+        stats->num_deleted = g.num_deleted;
+        stats->num_levels = g.nodes_per_level.size();
+        stats->unreachable_nodes = g.unreachable_nodes;
+        stats->total_edges = g.total_edges;
+        stats->edges_to_deleted = g.edges_to_deleted;
+        stats->navigability_samples = g.navigability_samples;
+        stats->deleted_edge_fraction = g.deleted_edge_fraction;
+        stats->avg_edge_length = g.avg_edge_length;
+        stats->navigability = g.navigability;
+
+        size_t levels = std::min<size_t>(g.nodes_per_level.size(), HNSW_GRAPH_STATS_MAX_LEVELS);
+        for (size_t l = 0; l < levels; l++) {
+            stats->nodes_per_level[l] = g.nodes_per_level[l];
+            for (size_t d = 0; d < g.out_degree_histogram[l].size(); d++)
+                stats->out_degree_histogram[l][std::min<size_t>(d, HNSW_GRAPH_STATS_DEGREE_BUCKETS - 1)] += g.out_degree_histogram[l][d];
+            for (size_t d = 0; d < g.in_degree_histogram[l].size(); d++)
+                stats->in_degree_histogram[l][std::min<size_t>(d, HNSW_GRAPH_STATS_DEGREE_BUCKETS - 1)] += g.in_degree_histogram[l][d];
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error computing graph stats: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_index_set_assume_normalized(HNSWIndex* index, bool assume_normalized) {
+    if (!index || index->space_type != SpaceTypeCosine) return false;
+    
+    static_cast<CosineSpace*>(index->space)->setAssumeNormalized(assume_normalized);
+    index->normalize = !assume_normalized;
+    return true;
+}
+
+bool hnswlib_index_set_flat(HNSWIndex* index, size_t num_routers) {
+    if (!index || !index->appr_alg) return false;
+    
+    try {
+        index->appr_alg->setFlat(num_routers > 0 ? num_routers : 32);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error setting flat mode: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_index_set_ef(HNSWIndex* index, size_t ef) {
+    if (!index) return;
+    
+    index->default_ef = ef;
+    if (index->appr_alg) {
+        index->appr_alg->ef_ = ef;
+    }
+}
+
+size_t hnswlib_index_get_current_count(HNSWIndex* index) {
+    if (!index || !index->appr_alg) return 0;
+    return index->appr_alg->cur_element_count;
+}
+
+size_t hnswlib_index_get_items(HNSWIndex* index, const uint64_t* labels, size_t count, float* out, bool* found, int num_threads) {
+    if (!index || !index->appr_alg) return 0;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Copying is cheap, so only use threads for large batches
+        if (count * index->dim < (size_t)num_threads * BF_MIN_ROWS_PER_CHUNK) {
+            num_threads = 1;
+        }
+        
+        // Resolve every label under one lock, then copy the rows in parallel. Each copy holds
+        // the label's op lock like getDataByLabel, so an update cannot tear the row; a label
+        // deleted or replaced since it was resolved counts as not found
+        HierarchicalNSW<float>* alg = index->appr_alg;
+        std::vector<tableint> ids(count);
+        alg->getInternalIds(labels, count, ids.data());
+        std::atomic<size_t> found_count(0);
+        ParallelFor(0, count, num_threads, [&](size_t i, size_t threadId) {
+            float* row = &out[i * index->dim];
+            bool copied = false;
+            if (ids[i] != (tableint)-1) {
+                std::unique_lock<HierarchicalNSW<float>::label_op_mutex_t> lock_label(alg->getLabelOpMutex(labels[i]));
+                if (alg->getExternalLabel(ids[i]) == labels[i] && !alg->isMarkedDeleted(ids[i])) {
+                    memcpy(row, alg->getDataByInternalId(ids[i]), index->dim * sizeof(float));
+                    copied = true;
+                }
+            }
+            if (!copied) {
+                memset(row, 0, index->dim * sizeof(float));
+            } else {
+                found_count++;
+            }
+            if (found) {
+                found[i] = copied;
+            }
+        });
+        return found_count;
+    } catch (const std::exception& e) {
+        std::cerr << "Error getting items: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+size_t hnswlib_index_get_max_elements(HNSWIndex* index) {
+    if (!index || !index->appr_alg) return 0;
+    return index->appr_alg->max_elements_;
+}
+
+size_t hnswlib_index_get_ef(HNSWIndex* index) {
+    if (!index || !index->appr_alg) return 0;
+    return index->appr_alg->ef_;
+}
+
+size_t hnswlib_index_get_m(HNSWIndex* index) {
+    if (!index || !index->appr_alg) return 0;
+    return index->appr_alg->M_;
+}
+
+bool hnswlib_index_save(HNSWIndex* index, const char* path) {
+    if (!index || !index->appr_alg) return false;
+    
+    try {
+        index->appr_alg->saveIndex(path);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+HNSWIndex* hnswlib_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements, bool allow_replace_deleted) {
+    try {
+        HNSWIndex* index = new HNSWIndex(space_type, dim);
+        if (!index->space) {
+            delete index;
+            return nullptr;
+        }
+        
+        index->appr_alg = new HierarchicalNSW<float>(index->space, path, false, max_elements, allow_replace_deleted);
+        index->cur_l = index->appr_alg->cur_element_count;
+        index->index_inited = true;
+        index->ep_added = true;
+        
+        return index;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+bool hnswlib_index_mark_deleted(HNSWIndex* index, uint64_t label) {
+    if (!index || !index->appr_alg) return false;
+    
+    try {
+        index->appr_alg->markDelete(label);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error marking item as deleted: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_index_unmark_deleted(HNSWIndex* index, uint64_t label) {
+    if (!index || !index->appr_alg) return;
+    
+    try {
+        index->appr_alg->unmarkDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error unmarking deletion: " << e.what() << std::endl;
+    }
+}
+
+bool hnswlib_index_resize(HNSWIndex* index, size_t new_size) {
+    if (!index || !index->appr_alg) return false;
+    
+    try {
+        index->appr_alg->resizeIndex(new_size);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error resizing index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// BruteForce Index Functions
+BFIndex* hnswlib_bf_index_create(SpaceType space_type, int dim) {
+    try {
+        return new BFIndex(space_type, dim);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating BF index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_bf_index_free(BFIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_bf_index_init(BFIndex* index, size_t max_elements) {
+    if (!index || !index->space) return false;
+    
+    try {
+        if (index->alg) {
+            delete index->alg;
+        }
+        
+        index->cur_l = 0;
+        index->alg = new BruteforceSearch<float>(index->space, max_elements);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_bf_index_add_items(BFIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids) {
+    if (!index || !index->alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        // Resolve every label to its slot under one lock, then fill the slots in parallel
+        std::vector<size_t> slots(rows);
+        index->alg->reservePoints(ids, rows, index->cur_l, slots.data());
+        
+        int num_threads = index->num_threads_default;
+        
+        // Copying is cheap, so only use threads for large batches
+        if (rows * dim < (size_t)num_threads * BF_MIN_ROWS_PER_CHUNK) {
+            num_threads = 1;
+        }
+        
+        // Cosine vectors are normalized by the space straight into their slot
+        ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
+            if (slots[row] == BruteforceSearch<float>::SKIPPED_SLOT) return;
+            index->space->storeVector(index->alg->getDataByInternalId(slots[row]), &data[row * dim]);
+        });
+        
+        index->cur_l += rows;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding items to BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_bf_index_set_assume_normalized(BFIndex* index, bool assume_normalized) {
+    if (!index || index->space_type != SpaceTypeCosine) return false;
+    
+    static_cast<CosineSpace*>(index->space)->setAssumeNormalized(assume_normalized);
+    index->normalize = !assume_normalized;
+    return true;
+}
+
+bool hnswlib_bf_index_remove(BFIndex* index, uint64_t label) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        return index->alg->removePoint(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error removing item from BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_bf_index_search_knn(BFIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        typedef BruteforceSearch<float>::TopKHeap TopKHeap;
+        
+        // With fewer queries than threads, split the data range of each query
+        // across the threads instead, so a single exact query uses every core
+        size_t element_count = index->alg->cur_element_count;
+        size_t num_chunks = std::min((size_t)num_threads, element_count / BF_MIN_ROWS_PER_CHUNK);
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+        if (query_count < (size_t)num_threads && num_chunks > 1) {
+            std::vector<TopKHeap> partial(num_chunks);
+            size_t chunk_size = (element_count + num_chunks - 1) / num_chunks;
+            
+            for (size_t i = 0; i < query_count; i++) {
+                const float* query_data = &queries[i * index->dim];
+                
+                ParallelFor(0, num_chunks, num_chunks, [&](size_t chunk, size_t threadId) {
+                    size_t begin = chunk * chunk_size;
+                    partial[chunk].clear();
+                    index->alg->scanRange(query_data, k, begin, begin + chunk_size, partial[chunk]);
+                });
+                
+                // Merge the per-chunk top-k into the first chunk's heap
+                for (size_t chunk = 1; chunk < num_chunks; chunk++) {
+                    BruteforceSearch<float>::mergeTopK(partial[0], partial[chunk], k);
+                }
+                
+                if (BruteforceSearch<float>::writeTopK(partial[0], &result_labels[i * k], &result_distances[i * k]) != k) {
+                    throw std::runtime_error("Cannot return results. Probably k is larger than the number of elements");
+                }
+            }
+            return true;
+        }
+        
+        std::vector<TopKHeap> heaps(num_threads);
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            const float* query_data = &queries[i * index->dim];
+            size_t found = index->alg->searchKnnInto(query_data, k, &result_labels[i * k], &result_distances[i * k], heaps[threadId]);
+            if (found != k) {
+                throw std::runtime_error("Cannot return results. Probably k is larger than the number of elements");
+            }
+        });
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Quantized BruteForce Index Functions
+BFQuantizedIndex* hnswlib_bfq_index_create(SpaceType space_type, QuantizationType quantization, int dim) {
+    try {
+        BFQuantizedIndex* index = new BFQuantizedIndex(space_type, quantization, dim);
+        if (!index->space) {
+            delete index;
+            return nullptr;
+        }
+        return index;
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating quantized BF index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_bfq_index_free(BFQuantizedIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_bfq_index_init(BFQuantizedIndex* index, size_t max_elements, bool keep_float_vectors) {
+    if (!index || !index->space) return false;
+    
+    try {
+        if (index->alg) {
+            delete index->alg;
+            index->alg = nullptr;
+        }
+        index->float_vectors.clear();
+        index->float_vectors.shrink_to_fit();
+        
+        index->cur_l = 0;
+        index->alg = new BruteforceSearch<float>(index->space, max_elements);
+        if (keep_float_vectors) {
+            index->float_vectors.resize(max_elements * index->dim);
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing quantized BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_bfq_index_set_rerank(BFQuantizedIndex* index, size_t rerank_k) {
+    if (!index) return;
+    index->rerank_k = rerank_k;
+}
+
+bool hnswlib_bfq_index_add_items(BFQuantizedIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids) {
+    if (!index || !index->alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        // One reservation gives each row its slot in both stores
+        std::vector<size_t> slots(rows);
+        index->alg->reservePoints(ids, rows, index->cur_l, slots.data());
+        bool keep_float = !index->float_vectors.empty();
+        
+        int num_threads = index->num_threads_default;
+        if (rows * dim < (size_t)num_threads * BF_MIN_ROWS_PER_CHUNK) {
+            num_threads = 1;
+        }
+        
+        // A kept float copy is normalized in place; otherwise rows go through per-thread scratch
+        std::vector<float> norm_array(index->normalize && !keep_float ? num_threads * index->dim : 0);
+        ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
+            if (slots[row] == BruteforceSearch<float>::SKIPPED_SLOT) return;
+            const float* vector_data = &data[row * dim];
+            if (keep_float) {
+                float* stored = &index->float_vectors[slots[row] * dim];
+                if (index->normalize) {
+                    NormalizeVector(vector_data, stored, dim);
+                } else {
+                    memcpy(stored, vector_data, dim * sizeof(float));
+                }
+                vector_data = stored;
+            } else if (index->normalize) {
+                float* normalized = &norm_array[threadId * index->dim];
+                NormalizeVector(vector_data, normalized, dim);
+                vector_data = normalized;
+            }
+            index->space->encode(vector_data, index->alg->getDataByInternalId(slots[row]));
+        });
+        
+        index->cur_l += rows;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding items to quantized BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_bfq_index_search_knn(BFQuantizedIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        typedef BruteforceSearch<float>::TopKHeap TopKHeap;
+        bool rerank = !index->float_vectors.empty() && index->rerank_k > k;
+        size_t candidates_k = rerank ? index->rerank_k : k;
+        DISTFUNC<float> float_dist = index->float_space->get_dist_func();
+        void* float_dist_param = index->float_space->get_dist_func_param();
+        
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+        
+        // Per-thread scratch: encoded query and two heaps
+        size_t code_size = index->space->get_data_size();
+        std::vector<char> code_array(num_threads * code_size);
+        std::vector<TopKHeap> heaps(num_threads);
+        std::vector<TopKHeap> rerank_heaps(rerank ? num_threads : 0);
+        
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            const float* query_data = &queries[i * index->dim];
+            char* query_code = &code_array[threadId * code_size];
+            index->space->encode(query_data, query_code);
+            
+            TopKHeap& heap = heaps[threadId];
+            heap.clear();
+            index->alg->scanRange(query_code, candidates_k, 0, index->alg->cur_element_count, heap);
+            
+            if (rerank) {
+                // Recompute exact distances for the candidates and keep the best k
+                TopKHeap& reranked = rerank_heaps[threadId];
+                reranked.clear();
+                for (size_t j = 0; j < heap.size(); j++) {
+                    auto found = index->alg->dict_external_to_internal.find(heap[j].second);
+                    if (found == index->alg->dict_external_to_internal.end()) continue;
+                    float dist = float_dist(query_data, &index->float_vectors[found->second * index->dim], float_dist_param);
+                    BruteforceSearch<float>::pushTopK(reranked, k, dist, heap[j].second);
+                }
+                heap.swap(reranked);
+            }
+            
+            if (BruteforceSearch<float>::writeTopK(heap, &result_labels[i * k], &result_distances[i * k]) != k) {
+                throw std::runtime_error("Cannot return results. Probably k is larger than the number of elements");
+            }
+        });
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching quantized BF index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Sharded HNSW Index Functions
+ShardedHNSWIndex* hnswlib_sharded_index_create(SpaceType space_type, int dim) {
+    try {
+        return new ShardedHNSWIndex(space_type, dim);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating sharded index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_sharded_index_free(ShardedHNSWIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_sharded_index_init(ShardedHNSWIndex* index, size_t num_shards, size_t max_elements_per_shard, size_t M, size_t ef_construction, size_t random_seed, bool allow_replace_deleted, HNSWShardPartitioning partitioning, size_t range_size, int num_threads) {
+    if (!index || !index->space) return false;
+    
+    try {
+        if (index->alg) {
+            delete index->alg;
+            index->alg = nullptr;
+        }
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        index->cur_l = 0;
+        index->alg = new ShardedIndex<float>(index->space, num_shards, max_elements_per_shard, M, ef_construction, random_seed,
+                                             allow_replace_deleted, (ShardPartitioning) partitioning, range_size, num_threads);
+        index->alg->setEf(index->default_ef);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing sharded index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_sharded_index_add_items(ShardedHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, int num_threads, bool replace_deleted) {
+    if (!index || !index->alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Avoid using threads when the number of additions is small
+        if (rows <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        // Each row goes to the shard of its label, so threads mostly insert into different graphs.
+        // Cosine vectors are normalized by the space straight into their slot.
+        ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
+            size_t id = ids ? ids[row] : (index->cur_l + row);
+            index->alg->addPoint(&data[row * dim], id, replace_deleted);
+        });
+        
+        index->cur_l += rows;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding items to sharded index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_sharded_index_search_knn(ShardedHNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Every query already fans out over the shard pool
+        if (query_count <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            std::priority_queue<std::pair<float, labeltype>> result = index->alg->searchKnn(&queries[i * index->dim], k);
+            if (result.size() != k) {
+                throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+            }
+            
+            for (int j = k - 1; j >= 0; j--) {
+                auto& result_tuple = result.top();
+                result_distances[i * k + j] = result_tuple.first;
+                result_labels[i * k + j] = result_tuple.second;
+                result.pop();
+            }
+        });
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching sharded index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_sharded_index_set_ef(ShardedHNSWIndex* index, size_t ef) {
+    if (!index) return;
+    
+    index->default_ef = ef;
+    if (index->alg) {
+        index->alg->setEf(ef);
+    }
+}
+
+size_t hnswlib_sharded_index_get_current_count(ShardedHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->getCurrentElementCount();
+}
+
+size_t hnswlib_sharded_index_get_max_elements(ShardedHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->getMaxElements();
+}
+
+size_t hnswlib_sharded_index_get_num_shards(ShardedHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->numShards();
+}
+
+bool hnswlib_sharded_index_save(ShardedHNSWIndex* index, const char* path) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        index->alg->saveIndex(path);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving sharded index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+ShardedHNSWIndex* hnswlib_sharded_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements_per_shard, bool allow_replace_deleted, int num_threads) {
+    ShardedHNSWIndex* index = nullptr;
+    try {
+        index = new ShardedHNSWIndex(space_type, dim);
+        if (!index->space) {
+            delete index;
+            return nullptr;
+        }
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        index->alg = new ShardedIndex<float>(index->space, path, num_threads, max_elements_per_shard, allow_replace_deleted);
+        index->alg->setEf(index->default_ef);
+        index->cur_l = index->alg->getCurrentElementCount();
+        return index;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading sharded index: " << e.what() << std::endl;
+        delete index;
+        return nullptr;
+    }
+}
+
+void hnswlib_sharded_index_mark_deleted(ShardedHNSWIndex* index, uint64_t label) {
+    if (!index || !index->alg) return;
+    
+    try {
+        index->alg->markDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error marking item as deleted: " << e.what() << std::endl;
+    }
+}
+
+void hnswlib_sharded_index_unmark_deleted(ShardedHNSWIndex* index, uint64_t label) {
+    if (!index || !index->alg) return;
+    
+    try {
+        index->alg->unmarkDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error unmarking item as deleted: " << e.what() << std::endl;
+    }
+}
+
+bool hnswlib_sharded_index_resize(ShardedHNSWIndex* index, size_t new_max_elements_per_shard) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        index->alg->resizeIndex(new_max_elements_per_shard);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error resizing sharded index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Partitioned (IVF) HNSW Index Functions
+PartitionedHNSWIndex* hnswlib_partitioned_index_create(SpaceType space_type, int dim) {
+    try {
+        return new PartitionedHNSWIndex(space_type, dim);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating partitioned index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_partitioned_index_free(PartitionedHNSWIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_partitioned_index_init(PartitionedHNSWIndex* index, size_t num_partitions, size_t max_elements_per_partition, size_t M, size_t ef_construction, size_t random_seed, bool allow_replace_deleted, int num_threads) {
+    if (!index || !index->space) return false;
+    
+    try {
+        if (index->alg) {
+            delete index->alg;
+            index->alg = nullptr;
+        }
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        index->cur_l = 0;
+        index->alg = new PartitionedIndex<float>(index->space, num_partitions, max_elements_per_partition, M, ef_construction,
+                                                 random_seed, allow_replace_deleted, num_threads);
+        index->alg->setEf(index->default_ef);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing partitioned index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_partitioned_index_train(PartitionedHNSWIndex* index, const float* data, size_t rows, size_t dim, size_t iterations) {
+    if (!index || !index->alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        std::vector<float> buffer;
+        index->alg->train(index->prepare(data, rows, buffer), rows, iterations);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error training partitioned index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_partitioned_index_set_replication(PartitionedHNSWIndex* index, size_t max_replicas, float boundary_factor) {
+    if (!index || !index->alg) return;
+    index->alg->setReplication(max_replicas, boundary_factor);
+}
+
+void hnswlib_partitioned_index_set_nprobe(PartitionedHNSWIndex* index, size_t nprobe) {
+    if (!index || !index->alg) return;
+    index->alg->setNprobe(nprobe);
+}
+
+size_t hnswlib_partitioned_index_get_nprobe(PartitionedHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->getNprobe();
+}
+
+void hnswlib_partitioned_index_set_ef(PartitionedHNSWIndex* index, size_t ef) {
+    if (!index) return;
+    
+    index->default_ef = ef;
+    if (index->alg) {
+        index->alg->setEf(ef);
+    }
+}
+
+bool hnswlib_partitioned_index_add_items(PartitionedHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, bool replace_deleted) {
+    if (!index || !index->alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        std::vector<labeltype> labels(rows);
+        for (size_t row = 0; row < rows; row++) {
+            labels[row] = ids ? ids[row] : (index->cur_l + row);
+        }
+        
+        std::vector<float> buffer;
+        index->alg->addPoints(index->prepare(data, rows, buffer), labels.data(), rows, replace_deleted);
+        index->cur_l += rows;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding items to partitioned index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_partitioned_index_search_knn(PartitionedHNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Every query already fans out over its nprobe partitions
+        if (query_count <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        std::vector<float> normalized;
+        const float* queries = index->prepare(query, query_count, normalized);
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            std::priority_queue<std::pair<float, labeltype>> result = index->alg->searchKnn(&queries[i * index->dim], k);
+            if (result.size() != k) {
+                throw std::runtime_error("Cannot return results. Probably ef, M or nprobe is too small");
+            }
+            
+            for (int j = k - 1; j >= 0; j--) {
+                auto& result_tuple = result.top();
+                result_distances[i * k + j] = result_tuple.first;
+                result_labels[i * k + j] = result_tuple.second;
+                result.pop();
+            }
+        });
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching partitioned index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+size_t hnswlib_partitioned_index_get_current_count(PartitionedHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->getCurrentElementCount();
+}
+
+size_t hnswlib_partitioned_index_get_num_partitions(PartitionedHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->numPartitions();
+}
+
+size_t hnswlib_partitioned_index_get_partition_sizes(PartitionedHNSWIndex* index, uint64_t* sizes, size_t max_partitions) {
+    if (!index || !index->alg) return 0;
+    
+    std::vector<size_t> partition_sizes = index->alg->partitionSizes();
+    for (size_t i = 0; sizes && i < partition_sizes.size() && i < max_partitions; i++) {
+        sizes[i] = partition_sizes[i];
+    }
+    return partition_sizes.size();
+}
+
+bool hnswlib_partitioned_index_save(PartitionedHNSWIndex* index, const char* path) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        index->alg->saveIndex(path);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving partitioned index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+PartitionedHNSWIndex* hnswlib_partitioned_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements_per_partition, bool allow_replace_deleted, int num_threads) {
+    PartitionedHNSWIndex* index = nullptr;
+    try {
+        index = new PartitionedHNSWIndex(space_type, dim);
+        if (!index->space) {
+            delete index;
+            return nullptr;
+        }
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        index->alg = new PartitionedIndex<float>(index->space, path, num_threads, max_elements_per_partition, allow_replace_deleted);
+        index->alg->setEf(index->default_ef);
+        // replicas are stored once per partition, but take a single label
+        index->cur_l = index->alg->getLabelCount();
+        return index;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading partitioned index: " << e.what() << std::endl;
+        delete index;
+        return nullptr;
+    }
+}
+
+void hnswlib_partitioned_index_mark_deleted(PartitionedHNSWIndex* index, uint64_t label) {
+    if (!index || !index->alg) return;
+    
+    try {
+        index->alg->markDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error marking item as deleted: " << e.what() << std::endl;
+    }
+}
+
+// Tiered (LSM-style) HNSW Index Functions
+TieredHNSWIndex* hnswlib_tiered_index_create(SpaceType space_type, int dim) {
+    try {
+        return new TieredHNSWIndex(space_type, dim);
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating tiered index: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_tiered_index_free(TieredHNSWIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_tiered_index_init(TieredHNSWIndex* index, size_t head_capacity, size_t M, size_t ef_construction, size_t random_seed, size_t merge_threshold, bool compress_segments, QuantizationType quantization, int num_threads) {
+    if (!index || !index->space) return false;
+    
+    try {
+        if (index->alg) {
+            delete index->alg;
+            index->alg = nullptr;
+        }
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        index->setSegmentQuantization(compress_segments, quantization);
+        index->cur_l = 0;
+        index->alg = new TieredIndex(index->space, head_capacity, M, ef_construction, random_seed,
+                                     index->segment_space, merge_threshold, num_threads);
+        index->alg->setEf(index->default_ef);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error initializing tiered index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_tiered_index_add_items(TieredHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, int num_threads, bool replace_deleted) {
+    if (!index || !index->alg || dim != (size_t)index->dim) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        if (rows <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        // Cosine vectors are normalized by the space straight into their head slot
+        ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
+            labeltype label = ids ? ids[row] : (index->cur_l + row);
+            index->alg->addPoint(&data[row * dim], label, replace_deleted);
+        });
+        index->cur_l += rows;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error adding items to tiered index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool hnswlib_tiered_index_search_knn(TieredHNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        if (query_count <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            std::priority_queue<std::pair<float, labeltype>> result = index->alg->searchKnn(&queries[i * index->dim], k);
+            if (result.size() != k) {
+                throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+            }
+            
+            for (int j = k - 1; j >= 0; j--) {
+                auto& result_tuple = result.top();
+                result_distances[i * k + j] = result_tuple.first;
+                result_labels[i * k + j] = result_tuple.second;
+                result.pop();
+            }
+        });
+        
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching tiered index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_tiered_index_mark_deleted(TieredHNSWIndex* index, uint64_t label) {
+    if (!index || !index->alg) return;
+    
+    try {
+        index->alg->markDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error marking item as deleted: " << e.what() << std::endl;
+    }
+}
+
+bool hnswlib_tiered_index_merge(TieredHNSWIndex* index, bool wait) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        bool started = index->alg->merge(wait);
+        if (wait) {
+            index->alg->waitForMerge();
+        }
+        return started;
+    } catch (const std::exception& e) {
+        std::cerr << "Error merging tiered index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void hnswlib_tiered_index_set_ef(TieredHNSWIndex* index, size_t ef) {
+    if (!index) return;
+    
+    index->default_ef = ef;
+    if (index->alg) {
+        index->alg->setEf(ef);
+    }
+}
+
+size_t hnswlib_tiered_index_get_current_count(TieredHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->getCurrentElementCount();
+}
+
+size_t hnswlib_tiered_index_get_head_count(TieredHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->headCount();
+}
+
+size_t hnswlib_tiered_index_get_num_segments(TieredHNSWIndex* index) {
+    if (!index || !index->alg) return 0;
+    return index->alg->numSegments();
+}
+
+size_t hnswlib_tiered_index_get_items(TieredHNSWIndex* index, const uint64_t* labels, size_t count, float* out, bool* found) {
+    if (!index || !index->alg) return 0;
+    
+    try {
+        return index->alg->getItems(labels, count, out, found);
+    } catch (const std::exception& e) {
+        std::cerr << "Error getting items from tiered index: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+bool hnswlib_tiered_index_save(TieredHNSWIndex* index, const char* path) {
+    if (!index || !index->alg) return false;
+    
+    try {
+        index->alg->saveIndex(path);
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving tiered index: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+TieredHNSWIndex* hnswlib_tiered_index_load(SpaceType space_type, int dim, const char* path, bool compress_segments, QuantizationType quantization, int num_threads) {
+    TieredHNSWIndex* index = nullptr;
+    try {
+        index = new TieredHNSWIndex(space_type, dim);
+        if (!index->space) {
+            delete index;
+            return nullptr;
+        }
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        index->setSegmentQuantization(compress_segments, quantization);
+        index->alg = new TieredIndex(index->space, path, index->segment_space, num_threads);
+        index->default_ef = index->alg->getEf();
+        index->cur_l = index->alg->getCurrentElementCount();
+        return index;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading tiered index: " << e.what() << std::endl;
+        delete index;
+        return nullptr;
+    }
+}
+
+// Asynchronous request functions
+HNSWCancelToken* hnswlib_cancel_token_create(void) {
+    try {
+        return new HNSWCancelToken();
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating cancel token: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_cancel_token_cancel(HNSWCancelToken* token) {
+    if (token) {
+        token->cancelled = true;
+    }
+}
+
+bool hnswlib_cancel_token_is_cancelled(HNSWCancelToken* token) {
+    return token && token->cancelled.load();
+}
+
+void hnswlib_cancel_token_free(HNSWCancelToken* token) {
+    if (token) {
+        delete token;
+    }
+}
+
+HNSWAsyncQueue* hnswlib_async_queue_create(HNSWIndex* index, size_t max_batch, uint64_t max_wait_us, int num_threads) {
+    if (!index || !index->appr_alg) return nullptr;
+
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        return new HNSWAsyncQueue(index, max_batch, max_wait_us, std::max(num_threads, 1));
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating async queue: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void hnswlib_async_queue_free(HNSWAsyncQueue* queue) {
+    if (queue) {
+        delete queue;
+    }
+}
+
+bool hnswlib_async_queue_submit_search(HNSWAsyncQueue* queue, const float* query, size_t query_count, size_t k, uint64_t* result_labels, float* result_distances, HNSWCancelToken* token, HNSWAsyncCallback callback, void* user_data) {
+    if (!queue || !callback || query_count == 0 || k == 0) return false;
+
+    HNSWAsyncQueue::Request* request = nullptr;
+    try {
+        request = new HNSWAsyncQueue::Request();
+        request->data.assign(query, query + query_count * queue->index->dim);
+        request->count = query_count;
+        request->k = k;
+        request->labels = result_labels;
+        request->distances = result_distances;
+        request->token = token;
+        request->callback = callback;
+        request->user_data = user_data;
+        if (queue->submit(request)) return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error submitting search: " << e.what() << std::endl;
+    }
+    delete request;
+    return false;
+}
+
+bool hnswlib_async_queue_submit_add(HNSWAsyncQueue* queue, const float* data, size_t rows, size_t dim, const uint64_t* ids, bool replace_deleted, HNSWCancelToken* token, HNSWAsyncCallback callback, void* user_data) {
+    if (!queue || !callback || rows == 0 || dim != (size_t)queue->index->dim) return false;
+
+    HNSWAsyncQueue::Request* request = nullptr;
+    try {
+        request = new HNSWAsyncQueue::Request();
+        request->is_add = true;
+        request->data.assign(data, data + rows * dim);
+        if (ids) {
+            request->ids.assign(ids, ids + rows);
+        }
+        request->count = rows;
+        request->replace_deleted = replace_deleted;
+        request->token = token;
+        request->callback = callback;
+        request->user_data = user_data;
+        if (queue->submit(request)) return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error submitting add: " << e.what() << std::endl;
+    }
+    delete request;
+    return false;
+}
+
+
+// Multi-vector HNSW Index Functions
+MultiVectorHNSWIndex* hnswlib_multivector_index_create(SpaceType space_type, int dim) {
+    try {
+        return new MultiVectorHNSWIndex(space_type, dim);
     } catch (const std::exception& e) {
-        std::cerr << "Error creating index: " << e.what() << std::endl;
+        std::cerr << "Error creating multi-vector index: " << e.what() << std::endl;
         return nullptr;
     }
 }
 
-void hnswlib_index_free(HNSWIndex* index) {
+void hnswlib_multivector_index_free(MultiVectorHNSWIndex* index) {
     if (index) {
         delete index;
     }
 }
 
-bool hnswlib_index_init(HNSWIndex* index, size_t max_elements, size_t M, size_t ef_construction, size_t random_seed, bool allow_replace_deleted) {
+bool hnswlib_multivector_index_init(MultiVectorHNSWIndex* index, size_t max_elements, size_t M, size_t ef_construction, size_t random_seed) {
     if (!index || !index->space) return false;
     
     try {
         if (index->appr_alg) {
             delete index->appr_alg;
+            index->appr_alg = nullptr;
         }
         
         index->cur_l = 0;
-        index->appr_alg = new HierarchicalNSW<float>(index->space, max_elements, M, ef_construction, random_seed, allow_replace_deleted);
-        index->index_inited = true;
+        index->doc_ids.clear();
+        index->doc_index.clear();
+        index->doc_members.clear();
+        index->appr_alg = new HierarchicalNSW<float>(index->space, max_elements, M, ef_construction, random_seed);
         index->ep_added = false;
-        index->appr_alg->ef_ = index->default_ef;
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error initializing index: " << e.what() << std::endl;
+        std::cerr << "Error initializing multi-vector index: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool hnswlib_index_add_items(HNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, int num_threads, bool replace_deleted) {
-    if (!index || !index->appr_alg || dim != (size_t)index->dim) return false;
+bool hnswlib_multivector_index_add_items(MultiVectorHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* doc_ids, const uint64_t* ids, int num_threads) {
+    if (!index || !index->appr_alg || !doc_ids || dim != (size_t)index->dim) return false;
     
     try {
         if (num_threads <= 0) {
@@ -200,49 +2452,62 @@ bool hnswlib_index_add_items(HNSWIndex* index, const float* data, size_t rows, s
             num_threads = 1;
         }
         
-        int start = 0;
-        if (!index->ep_added) {
-            size_t id = ids ? ids[0] : index->cur_l;
-            float* vector_data = const_cast<float*>(&data[0]);
-            std::vector<float> norm_array(index->dim);
-            
+        std::vector<uint32_t> docs(rows);
+        {
+            std::unique_lock<std::mutex> lock(index->doc_lock);
+            for (size_t row = 0; row < rows; row++)
+                docs[row] = index->docIndex(doc_ids[row]);
+        }
+        
+        // Every element is the (normalized) vector followed by its document index
+        size_t data_size = index->space->get_data_size();
+        std::vector<char> elements(num_threads * data_size);
+        auto add_row = [&](size_t row, size_t threadId) {
+            char* element = &elements[threadId * data_size];
             if (index->normalize) {
-                normalize_vector(vector_data, norm_array.data(), index->dim);
-                vector_data = norm_array.data();
+                NormalizeVector(&data[row * dim], (float*)element, dim);
+            } else {
+                memcpy(element, &data[row * dim], dim * sizeof(float));
             }
-            
-            index->appr_alg->addPoint(vector_data, id, replace_deleted);
+            index->space->set_doc_id(element, docs[row]);
+            size_t id = ids ? ids[row] : (index->cur_l + row);
+            index->appr_alg->addPoint(element, id);
+        };
+        
+        int start = 0;
+        if (!index->ep_added && rows > 0) {
+            add_row(0, 0);
             start = 1;
             index->ep_added = true;
         }
+        ParallelFor(start, rows, num_threads, add_row);
         
-        if (index->normalize == false) {
-            ParallelFor(start, rows, num_threads, [&](size_t row, size_t threadId) {
-                size_t id = ids ? ids[row] : (index->cur_l + row);
-                index->appr_alg->addPoint(&data[row * dim], id, replace_deleted);
-            });
-        } else {
-            std::vector<float> norm_array(num_threads * index->dim);
-            ParallelFor(start, rows, num_threads, [&](size_t row, size_t threadId) {
-                // Normalize vector
-                size_t start_idx = threadId * index->dim;
-                normalize_vector(const_cast<float*>(&data[row * dim]), &norm_array[start_idx], index->dim);
-                
-                size_t id = ids ? ids[row] : (index->cur_l + row);
-                index->appr_alg->addPoint(&norm_array[start_idx], id, replace_deleted);
-            });
+        // A replaced label keeps its internal id, so it may already be listed
+        std::vector<uint64_t> labels(rows);
+        std::vector<tableint> internal_ids(rows);
+        for (size_t row = 0; row < rows; row++)
+            labels[row] = ids ? ids[row] : (index->cur_l + row);
+        index->appr_alg->getInternalIds(labels.data(), rows, internal_ids.data());
+        {
+            std::unique_lock<std::mutex> lock(index->doc_lock);
+            for (size_t row = 0; row < rows; row++) {
+                std::vector<tableint>& members = index->doc_members[docs[row]];
+                if (internal_ids[row] != (tableint) -1 &&
+                    std::find(members.begin(), members.end(), internal_ids[row]) == members.end())
+                    members.push_back(internal_ids[row]);
+            }
         }
         
         index->cur_l += rows;
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error adding items: " << e.what() << std::endl;
+        std::cerr << "Error adding items to multi-vector index: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool hnswlib_index_search_knn(HNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
-    if (!index || !index->appr_alg) return false;
+bool hnswlib_multivector_index_search_docs(MultiVectorHNSWIndex* index, const float* query, size_t query_count, size_t k, uint64_t* result_doc_ids, float* result_distances, int num_threads) {
+    if (!index || !index->appr_alg || k == 0) return false;
     
     try {
         if (num_threads <= 0) {
@@ -254,233 +2519,480 @@ bool hnswlib_index_search_knn(HNSWIndex* index, const float* query, size_t k, ui
             num_threads = 1;
         }
         
-        if (!index->normalize) {
-            ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
-                std::priority_queue<std::pair<float, labeltype>> result = 
-                    index->appr_alg->searchKnn(&query[i * index->dim], k);
-                
-                if (result.size() != k) {
-                    throw std::runtime_error("Cannot return results. Probably ef or M is too small");
-                }
-                
-                for (int j = k - 1; j >= 0; j--) {
-                    auto& result_tuple = result.top();
-                    result_distances[i * k + j] = result_tuple.first;
-                    result_labels[i * k + j] = result_tuple.second;
-                    result.pop();
-                }
-            });
-        } else {
-            std::vector<float> norm_array(num_threads * index->dim);
-            ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
-                size_t start_idx = threadId * index->dim;
-                normalize_vector(const_cast<float*>(&query[i * index->dim]), &norm_array[start_idx], index->dim);
-                
-                std::priority_queue<std::pair<float, labeltype>> result = 
-                    index->appr_alg->searchKnn(&norm_array[start_idx], k);
-                
-                if (result.size() != k) {
-                    throw std::runtime_error("Cannot return results. Probably ef or M is too small");
-                }
-                
-                for (int j = k - 1; j >= 0; j--) {
-                    auto& result_tuple = result.top();
-                    result_distances[i * k + j] = result_tuple.first;
-                    result_labels[i * k + j] = result_tuple.second;
-                    result.pop();
-                }
-            });
-        }
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, query_count, index->dim, normalized);
+        std::vector<std::unique_ptr<MultiVectorHNSWIndex::Scratch>> scratch(num_threads);
+        for (auto& s : scratch) s = index->acquireScratch();
+        // Dense document indexes, mapped to the caller's ids under one lock after the batch
+        std::vector<uint32_t> found(query_count * k);
+        
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            MultiVectorSearchStopCondition<uint32_t, float> stop_condition(
+                *index->space, k, index->default_ef, scratch[threadId].get());
+            index->appr_alg->searchStopConditionClosest(&queries[i * index->dim], stop_condition);
+            
+            if (stop_condition.get_docs(&found[i * k], &result_distances[i * k], k) != k) {
+                throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+            }
+        });
+        index->releaseScratch(scratch);
+        
+        std::unique_lock<std::mutex> lock(index->doc_lock);
+        for (size_t j = 0; j < query_count * k; j++)
+            result_doc_ids[j] = index->doc_ids[found[j]];
         
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error searching: " << e.what() << std::endl;
+        std::cerr << "Error searching multi-vector index: " << e.what() << std::endl;
         return false;
     }
 }
 
-void hnswlib_index_set_ef(HNSWIndex* index, size_t ef) {
-    if (!index) return;
+bool hnswlib_multivector_index_search_maxsim(MultiVectorHNSWIndex* index, const float* query, size_t num_query_vectors, size_t k, size_t candidates_per_vector, uint64_t* result_doc_ids, float* result_distances, int num_threads) {
+    if (!index || !index->appr_alg || k == 0 || num_query_vectors == 0) return false;
     
-    index->default_ef = ef;
-    if (index->appr_alg) {
-        index->appr_alg->ef_ = ef;
+    try {
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        std::vector<float> normalized;
+        const float* queries = prepare_batch(index->normalize, query, num_query_vectors, index->dim, normalized);
+        candidates_per_vector = std::max(candidates_per_vector, k);
+        
+        // Candidate documents: the closest distinct documents of every query vector
+        size_t search_threads = std::min((size_t) num_threads, num_query_vectors);
+        std::vector<std::unique_ptr<MultiVectorHNSWIndex::Scratch>> scratch(search_threads);
+        for (auto& s : scratch) s = index->acquireScratch();
+        std::vector<uint32_t> candidates(num_query_vectors * candidates_per_vector);
+        std::vector<float> candidate_distances(search_threads * candidates_per_vector);
+        std::vector<size_t> found(num_query_vectors);
+        ParallelFor(0, num_query_vectors, search_threads, [&](size_t i, size_t threadId) {
+            MultiVectorSearchStopCondition<uint32_t, float> stop_condition(
+                *index->space, candidates_per_vector, index->default_ef, scratch[threadId].get());
+            index->appr_alg->searchStopConditionClosest(&queries[i * index->dim], stop_condition);
+            found[i] = stop_condition.get_docs(&candidates[i * candidates_per_vector],
+                                               &candidate_distances[threadId * candidates_per_vector], candidates_per_vector);
+        });
+        index->releaseScratch(scratch);
+        
+        std::vector<uint32_t> docs;
+        for (size_t i = 0; i < num_query_vectors; i++)
+            docs.insert(docs.end(), &candidates[i * candidates_per_vector], &candidates[i * candidates_per_vector] + found[i]);
+        std::sort(docs.begin(), docs.end());
+        docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+        if (docs.size() < k) {
+            throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+        }
+        
+        // Exact late-interaction distance over all live vectors of every candidate
+        size_t score_threads = std::min((size_t) num_threads, docs.size());
+        std::vector<LateInteractionScorer> scorers(score_threads, LateInteractionScorer(index->space_type == SpaceTypeL2, index->dim));
+        for (auto& scorer : scorers) scorer.setQuery(queries, num_query_vectors);
+        std::vector<std::vector<const float*>> vectors(score_threads);
+        std::vector<std::pair<float, uint32_t>> scored(docs.size());
+        ParallelFor(0, docs.size(), score_threads, [&](size_t i, size_t threadId) {
+            std::vector<const float*>& doc_vectors = vectors[threadId];
+            doc_vectors.clear();
+            {
+                std::unique_lock<std::mutex> lock(index->doc_lock);
+                for (tableint id : index->doc_members[docs[i]]) {
+                    const char* data = index->appr_alg->getDataByInternalId(id);
+                    // skip deleted vectors and replaced labels that moved to another document
+                    if (!index->appr_alg->isMarkedDeleted(id) && index->space->get_doc_id(data) == docs[i])
+                        doc_vectors.push_back((const float*) data);
+                }
+            }
+            scored[i] = std::make_pair(scorers[threadId].score(doc_vectors.data(), doc_vectors.size()), docs[i]);
+        });
+        
+        std::partial_sort(scored.begin(), scored.begin() + k, scored.end());
+        std::unique_lock<std::mutex> lock(index->doc_lock);
+        for (size_t j = 0; j < k; j++) {
+            result_doc_ids[j] = index->doc_ids[scored[j].second];
+            result_distances[j] = scored[j].first;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error searching multi-vector index: " << e.what() << std::endl;
+        return false;
     }
 }
 
-size_t hnswlib_index_get_current_count(HNSWIndex* index) {
-    if (!index || !index->appr_alg) return 0;
-    return index->appr_alg->cur_element_count;
+void hnswlib_multivector_index_set_ef(MultiVectorHNSWIndex* index, size_t ef) {
+    if (index) {
+        index->default_ef = ef;
+    }
 }
 
-size_t hnswlib_index_get_max_elements(HNSWIndex* index) {
-    if (!index || !index->appr_alg) return 0;
-    return index->appr_alg->max_elements_;
+void hnswlib_multivector_index_mark_deleted(MultiVectorHNSWIndex* index, uint64_t label) {
+    if (!index || !index->appr_alg) return;
+    
+    try {
+        index->appr_alg->markDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error marking element as deleted: " << e.what() << std::endl;
+    }
 }
 
-size_t hnswlib_index_get_ef(HNSWIndex* index) {
+size_t hnswlib_multivector_index_get_current_count(MultiVectorHNSWIndex* index) {
     if (!index || !index->appr_alg) return 0;
-    return index->appr_alg->ef_;
+    return index->appr_alg->cur_element_count;
 }
 
-size_t hnswlib_index_get_m(HNSWIndex* index) {
-    if (!index || !index->appr_alg) return 0;
-    return index->appr_alg->M_;
+size_t hnswlib_multivector_index_get_num_docs(MultiVectorHNSWIndex* index) {
+    if (!index) return 0;
+    std::unique_lock<std::mutex> lock(index->doc_lock);
+    return index->doc_ids.size();
 }
 
-bool hnswlib_index_save(HNSWIndex* index, const char* path) {
+bool hnswlib_multivector_index_save(MultiVectorHNSWIndex* index, const char* path) {
     if (!index || !index->appr_alg) return false;
     
     try {
         index->appr_alg->saveIndex(path);
+        
+        std::ofstream output(std::string(path) + ".docs", std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+        std::unique_lock<std::mutex> lock(index->doc_lock);
+        writeBinaryPOD(output, (uint64_t) index->doc_ids.size());
+        output.write((const char*) index->doc_ids.data(), index->doc_ids.size() * sizeof(uint64_t));
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error saving index: " << e.what() << std::endl;
+        std::cerr << "Error saving multi-vector index: " << e.what() << std::endl;
         return false;
     }
 }
 
-HNSWIndex* hnswlib_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements, bool allow_replace_deleted) {
+MultiVectorHNSWIndex* hnswlib_multivector_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements) {
+    MultiVectorHNSWIndex* index = nullptr;
     try {
-        HNSWIndex* index = new HNSWIndex(space_type, dim);
+        index = new MultiVectorHNSWIndex(space_type, dim);
         if (!index->space) {
             delete index;
             return nullptr;
         }
         
-        index->appr_alg = new HierarchicalNSW<float>(index->space, path, false, max_elements, allow_replace_deleted);
+        std::ifstream input(std::string(path) + ".docs", std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+        uint64_t num_docs = 0;
+        readBinaryPOD(input, num_docs);
+        index->doc_ids.resize(num_docs);
+        input.read((char*) index->doc_ids.data(), num_docs * sizeof(uint64_t));
+        if (!input)
+            throw std::runtime_error("Not a multi-vector document table");
+        for (size_t i = 0; i < num_docs; i++)
+            index->doc_index[index->doc_ids[i]] = (uint32_t) i;
+        
+        index->appr_alg = new HierarchicalNSW<float>(index->space, path, false, max_elements);
         index->cur_l = index->appr_alg->cur_element_count;
-        index->index_inited = true;
+        index->collectMembers();
         index->ep_added = true;
-        
         return index;
     } catch (const std::exception& e) {
-        std::cerr << "Error loading index: " << e.what() << std::endl;
+        std::cerr << "Error loading multi-vector index: " << e.what() << std::endl;
+        delete index;
         return nullptr;
     }
 }
 
-void hnswlib_index_mark_deleted(HNSWIndex* index, uint64_t label) {
-    if (!index || !index->appr_alg) return;
-    
+
+// Sparse-vector HNSW Index Functions
+SparseHNSWIndex* hnswlib_sparse_index_create(int dim) {
     try {
-        index->appr_alg->markDelete(label);
+        return new SparseHNSWIndex(dim);
     } catch (const std::exception& e) {
-        std::cerr << "Error marking item as deleted: " << e.what() << std::endl;
+        std::cerr << "Error creating sparse index: " << e.what() << std::endl;
+        return nullptr;
     }
 }
 
-void hnswlib_index_unmark_deleted(HNSWIndex* index, uint64_t label) {
-    if (!index || !index->appr_alg) return;
+void hnswlib_sparse_index_free(SparseHNSWIndex* index) {
+    if (index) {
+        delete index;
+    }
+}
+
+bool hnswlib_sparse_index_init(SparseHNSWIndex* index, size_t max_elements, size_t M, size_t ef_construction, size_t random_seed) {
+    if (!index) return false;
     
     try {
-        index->appr_alg->unmarkDelete(label);
+        if (index->appr_alg) {
+            delete index->appr_alg;
+            index->appr_alg = nullptr;
+        }
+        
+        index->cur_l = 0;
+        index->appr_alg = new HierarchicalNSW<float>(index->space, max_elements, M, ef_construction, random_seed);
+        index->appr_alg->ef_ = index->default_ef;
+        index->ep_added = false;
+        return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error unmarking deletion: " << e.what() << std::endl;
+        std::cerr << "Error initializing sparse index: " << e.what() << std::endl;
+        return false;
     }
 }
 
-bool hnswlib_index_resize(HNSWIndex* index, size_t new_size) {
-    if (!index || !index->appr_alg) return false;
+bool hnswlib_sparse_index_add_items(SparseHNSWIndex* index, const size_t* indptr, const uint32_t* indices, const float* values, size_t rows, const uint64_t* ids, int num_threads) {
+    if (!index || !index->appr_alg || !indptr) return false;
     
     try {
-        index->appr_alg->resizeIndex(new_size);
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Avoid using threads when the number of additions is small
+        if (rows <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        // The space copies every row into its arena, the slot keeps a pointer to it
+        std::vector<std::vector<SparseEntry>> blocks(num_threads);
+        auto add_row = [&](size_t row, size_t threadId) {
+            const SparseVector* vector = csr_row(indptr, indices, values, row, index->dim, blocks[threadId]);
+            size_t id = ids ? ids[row] : (index->cur_l + row);
+            index->appr_alg->addPoint(&vector, id);
+        };
+        
+        int start = 0;
+        if (!index->ep_added && rows > 0) {
+            add_row(0, 0);
+            start = 1;
+            index->ep_added = true;
+        }
+        ParallelFor(start, rows, num_threads, add_row);
+        
+        index->cur_l += rows;
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error resizing index: " << e.what() << std::endl;
+        std::cerr << "Error adding items to sparse index: " << e.what() << std::endl;
         return false;
     }
 }
 
-// BruteForce Index Functions
-BFIndex* hnswlib_bf_index_create(SpaceType space_type, int dim) {
+bool hnswlib_sparse_index_search_knn(SparseHNSWIndex* index, const size_t* indptr, const uint32_t* indices, const float* values, size_t query_count, size_t k, uint64_t* result_labels, float* result_distances, int num_threads) {
+    if (!index || !index->appr_alg || !indptr) return false;
+    
     try {
-        return new BFIndex(space_type, dim);
+        if (num_threads <= 0) {
+            num_threads = index->num_threads_default;
+        }
+        
+        // Avoid using threads when the number of searches is small
+        if (query_count <= (size_t)(num_threads * 4)) {
+            num_threads = 1;
+        }
+        
+        std::vector<std::vector<SparseEntry>> blocks(num_threads);
+        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
+            const SparseVector* vector = csr_row(indptr, indices, values, i, index->dim, blocks[threadId]);
+            std::priority_queue<std::pair<float, labeltype>> result = index->appr_alg->searchKnn(&vector, k);
+            if (result.size() != k) {
+                throw std::runtime_error("Cannot return results. Probably ef or M is too small");
+            }
+            
+            for (int j = k - 1; j >= 0; j--) {
+                auto& result_tuple = result.top();
+                result_distances[i * k + j] = result_tuple.first;
+                result_labels[i * k + j] = result_tuple.second;
+                result.pop();
+            }
+        });
+        
+        return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error creating BF index: " << e.what() << std::endl;
-        return nullptr;
+        std::cerr << "Error searching sparse index: " << e.what() << std::endl;
+        return false;
     }
 }
 
-void hnswlib_bf_index_free(BFIndex* index) {
-    if (index) {
-        delete index;
+void hnswlib_sparse_index_set_ef(SparseHNSWIndex* index, size_t ef) {
+    if (!index) return;
+    
+    index->default_ef = ef;
+    if (index->appr_alg) {
+        index->appr_alg->ef_ = ef;
     }
 }
 
-bool hnswlib_bf_index_init(BFIndex* index, size_t max_elements) {
-    if (!index || !index->space) return false;
+void hnswlib_sparse_index_mark_deleted(SparseHNSWIndex* index, uint64_t label) {
+    if (!index || !index->appr_alg) return;
     
     try {
-        if (index->alg) {
-            delete index->alg;
-        }
+        index->appr_alg->markDelete(label);
+    } catch (const std::exception& e) {
+        std::cerr << "Error marking element as deleted: " << e.what() << std::endl;
+    }
+}
+
+size_t hnswlib_sparse_index_get_current_count(SparseHNSWIndex* index) {
+    if (!index || !index->appr_alg) return 0;
+    return index->appr_alg->cur_element_count;
+}
+
+size_t hnswlib_sparse_index_get_arena_bytes(SparseHNSWIndex* index) {
+    if (!index) return 0;
+    return index->space->arenaEntries() * sizeof(SparseEntry);
+}
+
+bool hnswlib_sparse_index_save(SparseHNSWIndex* index, const char* path) {
+    if (!index || !index->appr_alg) return false;
+    
+    try {
+        index->appr_alg->saveIndex(path);
         
-        index->cur_l = 0;
-        index->alg = new BruteforceSearch<float>(index->space, max_elements);
+        // The slots hold pointers, so the entries follow in a side file in internal id order
+        std::ofstream output(std::string(path) + ".sparse", std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+        size_t count = index->appr_alg->cur_element_count;
+        writeBinaryPOD(output, (uint64_t) count);
+        for (size_t id = 0; id < count; id++) {
+            const SparseVector* vector = SparseSlot(index->appr_alg->getDataByInternalId(id))->load();
+            writeBinaryPOD(output, (uint64_t) vector->nnz);
+            output.write((const char*) vector->entries(), vector->nnz * sizeof(SparseEntry));
+        }
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error initializing BF index: " << e.what() << std::endl;
+        std::cerr << "Error saving sparse index: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool hnswlib_bf_index_add_items(BFIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids) {
-    if (!index || !index->alg || dim != (size_t)index->dim) return false;
-    
+SparseHNSWIndex* hnswlib_sparse_index_load(int dim, const char* path, size_t max_elements) {
+    SparseHNSWIndex* index = nullptr;
     try {
-        for (size_t row = 0; row < rows; row++) {
-            size_t id = ids ? ids[row] : index->cur_l + row;
-            
-            if (!index->normalize) {
-                index->alg->addPoint(&data[row * dim], id);
-            } else {
-                std::vector<float> normalized_vector(index->dim);
-                normalize_vector(const_cast<float*>(&data[row * dim]), normalized_vector.data(), index->dim);
-                index->alg->addPoint(normalized_vector.data(), id);
+        index = new SparseHNSWIndex(dim);
+        index->appr_alg = new HierarchicalNSW<float>(index->space, path, false, max_elements);
+        
+        std::ifstream input(std::string(path) + ".sparse", std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+        uint64_t count = 0;
+        readBinaryPOD(input, count);
+        if (count != index->appr_alg->cur_element_count)
+            throw std::runtime_error("Sparse entries do not match the index");
+        for (size_t id = 0; id < count; id++) {
+            uint64_t nnz = 0;
+            readBinaryPOD(input, nnz);
+            if (!input || nnz > (uint64_t) dim)
+                throw std::runtime_error("Sparse entry file is corrupt");
+            SparseVector* vector = index->space->allocate(nnz);
+            SparseEntry* entries = vector->entries();
+            input.read((char*) entries, nnz * sizeof(SparseEntry));
+            if (!input)
+                throw std::runtime_error("Sparse entry file is truncated");
+            for (size_t j = 0; j < nnz; j++) {
+                if (entries[j].index >= (uint32_t) dim || (j > 0 && entries[j].index < entries[j - 1].index))
+                    throw std::runtime_error("Sparse entry file is corrupt");
             }
+            SparseInnerProductSpace::publish(index->appr_alg->getDataByInternalId(id), vector);
         }
         
-        index->cur_l += rows;
+        index->cur_l = index->appr_alg->cur_element_count;
+        index->ep_added = true;
+        index->appr_alg->ef_ = index->default_ef;
+        return index;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading sparse index: " << e.what() << std::endl;
+        delete index;
+        return nullptr;
+    }
+}
+
+bool hnswlib_autotune(SpaceType space_type, int dim, const float* data, size_t rows, const float* queries, size_t query_count, size_t k, double target_recall, HNSWTuneObjective objective, double budget_seconds, size_t sample_size, int num_threads, HNSWTuneResult* best, HNSWTuneResult* tried, size_t max_tried, size_t* num_tried) {
+    if (!data || !queries || !best || dim <= 0 || k == 0) return false;
+    
+    try {
+        std::unique_ptr<SpaceInterface<float>> space;
+        bool normalize = false;
+        if (space_type == SpaceTypeL2) {
+            space.reset(new L2Space(dim));
+        } else if (space_type == SpaceTypeIP) {
+            space.reset(new InnerProductSpace(dim));
+        } else if (space_type == SpaceTypeCosine) {
+            space.reset(new CosineSpace(dim));
+            normalize = true;
+        } else {
+            return false;
+        }
+        
+        std::vector<float> normalized_data, normalized_queries;
+        const float* rows_data = prepare_batch(normalize, data, rows, dim, normalized_data);
+        const float* query_data = prepare_batch(normalize, queries, query_count, dim, normalized_queries);
+        
+        TuneOptions options;
+        options.k = k;
+        options.target_recall = target_recall;
+        options.objective = objective == HNSWTuneMinMemory ? TUNE_MIN_MEMORY : TUNE_MAX_QPS;
+        options.budget_seconds = budget_seconds;
+        if (sample_size > 0) options.sample_size = sample_size;
+        options.num_threads = num_threads > 0 ? num_threads : 0;
+        
+        std::vector<TuneResult> results;
+        TuneResult result = autotune<float>(space.get(), rows_data, rows, query_data, query_count, options, &results);
+        
+        auto to_c = [](const TuneResult& r, HNSWTuneResult* out) {
+            out->M = r.M;
+            out->ef_construction = r.ef_construction;
+            out->ef = r.ef;
+            out->memory_bytes = r.memory_bytes;
+            out->meets_target = r.meets_target;
+            out->recall = r.recall;
+            out->qps = r.qps;
+            out->build_seconds = r.build_seconds;
+        };
+        to_c(result, best);
+        if (tried) {
+            for (size_t i = 0; i < results.size() && i < max_tried; i++)
+                to_c(results[i], &tried[i]);
+        }
+        if (num_tried) *num_tried = results.size();
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error adding items to BF index: " << e.what() << std::endl;
+        std::cerr << "Error tuning parameters: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool hnswlib_bf_index_search_knn(BFIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads) {
-    if (!index || !index->alg) return false;
+bool hnswlib_index_calibrate_ef(HNSWIndex* index, const float* queries, size_t query_count, const size_t* ks, size_t num_k, double target_recall, size_t max_ef, size_t* ef_out, double* recall_out, int num_threads) {
+    if (!index || !index->appr_alg || !queries || !ks || !ef_out) return false;
     
     try {
         if (num_threads <= 0) {
             num_threads = index->num_threads_default;
         }
+        if (max_ef == 0) max_ef = 1024;
         
-        ParallelFor(0, query_count, num_threads, [&](size_t i, size_t threadId) {
-            std::priority_queue<std::pair<float, labeltype>> result;
-            
-            if (!index->normalize) {
-                result = index->alg->searchKnn(&query[i * index->dim], k);
-            } else {
-                std::vector<float> normalized_query(index->dim);
-                normalize_vector(const_cast<float*>(&query[i * index->dim]), normalized_query.data(), index->dim);
-                result = index->alg->searchKnn(normalized_query.data(), k);
-            }
-            
-            for (int j = k - 1; j >= 0; j--) {
-                auto& result_tuple = result.top();
-                result_distances[i * k + j] = result_tuple.first;
-                result_labels[i * k + j] = result_tuple.second;
-                result.pop();
-            }
-        });
+        std::vector<float> normalized;
+        const float* query_data = prepare_batch(index->normalize, queries, query_count, index->dim, normalized);
+        size_t query_bytes = index->dim * sizeof(float);
+        ThreadPool pool(std::max(num_threads, 1) - 1);
         
+        // exact neighbors for the largest k, every smaller k uses a prefix of them
+        size_t max_k = 0;
+        for (size_t i = 0; i < num_k; i++) {
+            if (ks[i] == 0)
+                throw std::runtime_error("Every k must be positive");
+            max_k = std::max(max_k, ks[i]);
+        }
+        std::vector<std::vector<labeltype>> truth = exactNeighbors(*index->appr_alg, query_data, query_count, query_bytes, max_k, pool);
+        
+        for (size_t i = 0; i < num_k; i++) {
+            std::vector<std::vector<labeltype>> truth_k(query_count);
+            for (size_t q = 0; q < query_count; q++)
+                truth_k[q].assign(truth[q].begin(), truth[q].begin() + std::min(ks[i], truth[q].size()));
+            double recall = 0;
+            ef_out[i] = calibrateEf(*index->appr_alg, query_data, query_bytes, ks[i], truth_k, target_recall, max_ef, pool, recall);
+            if (recall_out) recall_out[i] = recall;
+        }
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error searching BF index: " << e.what() << std::endl;
+        std::cerr << "Error calibrating ef: " << e.what() << std::endl;
         return false;
     }
 }
 
-} // extern "C" 
\ No newline at end of file
+} // extern "C"
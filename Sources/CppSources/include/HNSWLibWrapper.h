@@ -12,6 +12,113 @@ extern "C" {
 // Opaque types to represent the C++ objects
 typedef struct HNSWIndex HNSWIndex;
 typedef struct BFIndex BFIndex;
+typedef struct BFQuantizedIndex BFQuantizedIndex;
+typedef struct ShardedHNSWIndex ShardedHNSWIndex;
+typedef struct PartitionedHNSWIndex PartitionedHNSWIndex;
+typedef struct TieredHNSWIndex TieredHNSWIndex;
+typedef struct HNSWAsyncQueue HNSWAsyncQueue;
+typedef struct MultiVectorHNSWIndex MultiVectorHNSWIndex;
+typedef struct SparseHNSWIndex SparseHNSWIndex;
+typedef struct HNSWCancelToken HNSWCancelToken;
+
+// Work done by one query, see hnswlib_index_search_knn_with_stats.
+// "upper" is the greedy descent through the upper layers, "base" the ef search on level 0.
+typedef struct {
+    uint64_t upper_hops;
+    uint64_t upper_distance_computations;
+    uint64_t base_hops;
+    uint64_t base_distance_computations;
+    uint64_t visited_nodes;
+    uint64_t filter_rejects;   // candidates dropped by a filter or a delete mark
+    uint64_t wall_time_ns;
+} HNSWSearchStats;
+
+// Operations that hardware counters are collected for
+typedef enum {
+    HNSWPerfSearch = 0,
+    HNSWPerfAdd = 1
+} HNSWPerfOperation;
+
+// Hardware counter totals (perf_event_open, Linux only)
+typedef struct {
+    uint64_t operations;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t llc_misses;
+    uint64_t dtlb_misses;
+    uint64_t branch_misses;
+} HNSWPerfCounters;
+
+// Phases of an insert that build profiling times, see hnswlib_index_set_build_profiling.
+// Lock waits are counted per acquisition and their time is also part of the phase they happen in.
+typedef enum {
+    HNSWBuildInsert = 0,            // the whole insert, one count per point
+    HNSWBuildUpperDescent = 1,      // greedy descent through the levels above the new point
+    HNSWBuildSearchBaseLayer = 2,   // ef_construction search on each level of the new point
+    HNSWBuildSelectNeighbors = 3,   // neighbor selection heuristic for the new point
+    HNSWBuildPrune = 4,             // re-pruning neighbors whose link list overflowed
+    HNSWBuildWaitGlobal = 5,
+    HNSWBuildWaitLinkList = 6,
+    HNSWBuildWaitLabelLookup = 7,
+    HNSWBuildPhaseCount = 8
+} HNSWBuildPhase;
+
+typedef struct {
+    uint64_t count[HNSWBuildPhaseCount];
+    uint64_t ns[HNSWBuildPhaseCount];
+} HNSWBuildProfile;
+
+// Progress of an add_items call: points added so far, points in the call, and rate
+typedef void (*HNSWBuildProgressCallback)(uint64_t done, uint64_t total, double points_per_sec, void* user_data);
+
+// Outcome of an asynchronous request, passed to its callback
+typedef enum {
+    HNSWAsyncCompleted = 0,
+    HNSWAsyncCancelled = 1,
+    HNSWAsyncFailed = 2
+} HNSWAsyncStatus;
+
+typedef void (*HNSWAsyncCallback)(HNSWAsyncStatus status, void* user_data);
+
+#define HNSW_GRAPH_STATS_MAX_LEVELS 16
+#define HNSW_GRAPH_STATS_DEGREE_BUCKETS 129
+
+// Structural health of the graph, see hnswlib_index_graph_stats.
+// Histograms are indexed [level][degree]; degrees >= 128 share the last bucket,
+// levels beyond HNSW_GRAPH_STATS_MAX_LEVELS are left out (num_levels is still exact).
+typedef struct {
+    uint64_t num_elements;
+    uint64_t num_deleted;
+    uint64_t num_levels;
+    uint64_t unreachable_nodes;      // live nodes not reachable from the entry point on level 0
+    uint64_t total_edges;
+    uint64_t edges_to_deleted;
+    uint64_t navigability_samples;
+    double deleted_edge_fraction;
+    double avg_edge_length;          // mean level 0 edge distance, in the units of the space
+    double navigability;             // fraction of sampled nodes found as top-1 for their own vector
+    uint64_t nodes_per_level[HNSW_GRAPH_STATS_MAX_LEVELS];
+    uint64_t out_degree_histogram[HNSW_GRAPH_STATS_MAX_LEVELS][HNSW_GRAPH_STATS_DEGREE_BUCKETS];
+    uint64_t in_degree_histogram[HNSW_GRAPH_STATS_MAX_LEVELS][HNSW_GRAPH_STATS_DEGREE_BUCKETS];
+} HNSWGraphStats;
+
+// What hnswlib_autotune minimizes among the configurations meeting the target recall
+typedef enum {
+    HNSWTuneMaxQPS = 0,      // fastest single-thread search
+    HNSWTuneMinMemory = 1    // smallest graph, faster search breaking ties
+} HNSWTuneObjective;
+
+// One configuration measured by hnswlib_autotune
+typedef struct {
+    uint64_t M;
+    uint64_t ef_construction;
+    uint64_t ef;                 // smallest ef reaching the target recall
+    uint64_t memory_bytes;       // graph memory extrapolated to all rows
+    uint64_t meets_target;       // 0 if recall stays below the target up to the largest ef tried
+    double recall;               // recall@k at ef
+    double qps;                  // single-thread queries per second at ef
+    double build_seconds;        // build time of the sample graph
+} HNSWTuneResult;
 
 // Space types
 typedef enum {
@@ -20,6 +127,18 @@ typedef enum {
     SpaceTypeCosine = 2   // Cosine similarity
 } SpaceType;
 
+// Storage formats for quantized indices
+typedef enum {
+    QuantizationInt8 = 0,  // 8-bit integer codes with a per-vector scale
+    QuantizationFp16 = 1   // IEEE half precision
+} QuantizationType;
+
+// How a sharded index assigns labels to shards
+typedef enum {
+    HNSWShardByHash = 0,   // hash of the label modulo the shard count
+    HNSWShardByRange = 1   // consecutive blocks of range_size labels, the last shard takes the rest
+} HNSWShardPartitioning;
+
 // Creating and destroying indices
 HNSWIndex* hnswlib_index_create(SpaceType space_type, int dim);
 void hnswlib_index_free(HNSWIndex* index);
@@ -33,6 +152,63 @@ bool hnswlib_index_add_items(HNSWIndex* index, const float* data, size_t rows, s
 // Search
 bool hnswlib_index_search_knn(HNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads);
 
+// All points within radius of a single query, closest first, at most max_results of them.
+// Like search_knn it is approximate: it stops once ef candidates were found and the next
+// one is farther than radius. *result_count receives the number written.
+bool hnswlib_index_search_range(HNSWIndex* index, const float* query, float radius, size_t max_results, uint64_t* result_labels, float* result_distances, size_t* result_count);
+
+// Grouped search: the k closest points with at most max_per_group of them per group, e.g.
+// "top 50 but at most 3 per seller"; max_per_group = 1 gives k distinct groups. Groups come
+// from set_groups (labels without one are never capped; call it while no grouped search
+// runs). The search keeps traversing until ef (at least k) points within the caps are held.
+// result_counts[query_count] receives the number of results per query; the remaining of
+// the k slots get label UINT64_MAX and distance infinity.
+bool hnswlib_index_set_groups(HNSWIndex* index, const uint64_t* labels, const uint64_t* groups, size_t count);
+bool hnswlib_index_search_grouped(HNSWIndex* index, const float* query, size_t query_count, size_t k, size_t max_per_group, uint64_t* result_labels, float* result_distances, size_t* result_counts, int num_threads);
+
+// Search that also fills stats[query_count] (may be NULL) and records every query
+// in the index's latency / work histograms
+bool hnswlib_index_search_knn_with_stats(HNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads, HNSWSearchStats* stats);
+void hnswlib_index_reset_query_histograms(HNSWIndex* index);
+
+// Writes the query histograms in the Prometheus text format into buffer (NUL terminated,
+// truncated to buffer_size) and returns the full length, so it can be called with NULL first
+size_t hnswlib_index_export_prometheus(HNSWIndex* index, char* buffer, size_t buffer_size);
+
+// Hardware counters around every search and insert. set_perf_counters fails when
+// perf_event_open is unavailable (non-Linux, or blocked by perf_event_paranoid / seccomp).
+// Counters are kept per worker slot (the thread index within a batch); get_perf_counters
+// sums them, get_perf_counters_per_thread copies up to max_threads slots and returns the count.
+bool hnswlib_perf_counters_available(void);
+bool hnswlib_index_set_perf_counters(HNSWIndex* index, bool enable);
+bool hnswlib_index_get_perf_counters(HNSWIndex* index, HNSWPerfOperation op, HNSWPerfCounters* total);
+size_t hnswlib_index_get_perf_counters_per_thread(HNSWIndex* index, HNSWPerfOperation op, HNSWPerfCounters* out, size_t max_threads);
+void hnswlib_index_reset_perf_counters(HNSWIndex* index);
+
+// Build profiling, kept per worker slot like the perf counters
+void hnswlib_index_set_build_profiling(HNSWIndex* index, bool enable);
+bool hnswlib_index_get_build_profile(HNSWIndex* index, HNSWBuildProfile* total);
+size_t hnswlib_index_get_build_profile_per_thread(HNSWIndex* index, HNSWBuildProfile* out, size_t max_threads);
+void hnswlib_index_reset_build_profile(HNSWIndex* index);
+
+// Calls callback from the inserting threads (one call at a time) every `interval` points
+// and after the last point of each add_items call; NULL removes it
+void hnswlib_index_set_build_progress(HNSWIndex* index, HNSWBuildProgressCallback callback, void* user_data, size_t interval);
+
+// Walks the whole graph with num_threads threads (<= 0 = default) and searches for
+// navigability_samples of the stored vectors. Must not run concurrently with inserts.
+bool hnswlib_index_graph_stats(HNSWIndex* index, size_t navigability_samples, int num_threads, HNSWGraphStats* stats);
+
+// Cosine only: the caller guarantees unit length inserts and queries, so they are used
+// as is instead of being normalized. Returns false for the other spaces.
+bool hnswlib_index_set_assume_normalized(HNSWIndex* index, bool assume_normalized);
+
+// Builds a single-level graph from here on: inserts and searches start from the closest
+// of num_routers (0 = 32) routing elements instead of descending upper levels. Call after
+// init, before the first insert, or after loading an index built this way (the mode is
+// not saved). Returns false if the graph already has upper levels.
+bool hnswlib_index_set_flat(HNSWIndex* index, size_t num_routers);
+
 // Set ef parameter (search accuracy vs speed)
 void hnswlib_index_set_ef(HNSWIndex* index, size_t ef);
 
@@ -42,12 +218,19 @@ size_t hnswlib_index_get_max_elements(HNSWIndex* index);
 size_t hnswlib_index_get_ef(HNSWIndex* index);
 size_t hnswlib_index_get_m(HNSWIndex* index);
 
+// Copies the stored vectors of labels[count] into out (count * dim floats) with num_threads
+// threads (<= 0 = default). found (may be NULL) receives whether each label exists and is
+// not deleted; the rows of the others are zero filled. Cosine indices return the normalized
+// vectors. Returns the number of labels found. May run concurrently with inserts and
+// updates: each row is copied whole under the lock of its label.
+size_t hnswlib_index_get_items(HNSWIndex* index, const uint64_t* labels, size_t count, float* out, bool* found, int num_threads);
+
 // Save/load index
 bool hnswlib_index_save(HNSWIndex* index, const char* path);
 HNSWIndex* hnswlib_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements, bool allow_replace_deleted);
 
-// Mark/unmark deleted
-void hnswlib_index_mark_deleted(HNSWIndex* index, uint64_t label);
+// Mark/unmark deleted; mark_deleted returns false if no live item has the label
+bool hnswlib_index_mark_deleted(HNSWIndex* index, uint64_t label);
 void hnswlib_index_unmark_deleted(HNSWIndex* index, uint64_t label);
 
 // Resize index
@@ -59,6 +242,166 @@ void hnswlib_bf_index_free(BFIndex* index);
 bool hnswlib_bf_index_init(BFIndex* index, size_t max_elements);
 bool hnswlib_bf_index_add_items(BFIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids);
 bool hnswlib_bf_index_search_knn(BFIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads);
+bool hnswlib_bf_index_remove(BFIndex* index, uint64_t label);
+bool hnswlib_bf_index_set_assume_normalized(BFIndex* index, bool assume_normalized);
+
+// Quantized BruteForce index functions
+// keep_float_vectors stores a float copy of every vector, which set_rerank uses to
+// recompute exact distances for the best rerank_k quantized candidates
+BFQuantizedIndex* hnswlib_bfq_index_create(SpaceType space_type, QuantizationType quantization, int dim);
+void hnswlib_bfq_index_free(BFQuantizedIndex* index);
+bool hnswlib_bfq_index_init(BFQuantizedIndex* index, size_t max_elements, bool keep_float_vectors);
+void hnswlib_bfq_index_set_rerank(BFQuantizedIndex* index, size_t rerank_k);
+bool hnswlib_bfq_index_add_items(BFQuantizedIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids);
+bool hnswlib_bfq_index_search_knn(BFQuantizedIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads);
+
+// Sharded HNSW index functions
+// N independent HNSW graphs; a search runs on all shards concurrently on a pool of
+// num_threads threads (<= 0 = default) and merges the per-shard top-k.
+// save writes a small header to path and shard i to "<path>.shard<i>".
+ShardedHNSWIndex* hnswlib_sharded_index_create(SpaceType space_type, int dim);
+void hnswlib_sharded_index_free(ShardedHNSWIndex* index);
+bool hnswlib_sharded_index_init(ShardedHNSWIndex* index, size_t num_shards, size_t max_elements_per_shard, size_t M, size_t ef_construction, size_t random_seed, bool allow_replace_deleted, HNSWShardPartitioning partitioning, size_t range_size, int num_threads);
+bool hnswlib_sharded_index_add_items(ShardedHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, int num_threads, bool replace_deleted);
+bool hnswlib_sharded_index_search_knn(ShardedHNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads);
+void hnswlib_sharded_index_set_ef(ShardedHNSWIndex* index, size_t ef);
+size_t hnswlib_sharded_index_get_current_count(ShardedHNSWIndex* index);
+size_t hnswlib_sharded_index_get_max_elements(ShardedHNSWIndex* index);
+size_t hnswlib_sharded_index_get_num_shards(ShardedHNSWIndex* index);
+bool hnswlib_sharded_index_save(ShardedHNSWIndex* index, const char* path);
+ShardedHNSWIndex* hnswlib_sharded_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements_per_shard, bool allow_replace_deleted, int num_threads);
+void hnswlib_sharded_index_mark_deleted(ShardedHNSWIndex* index, uint64_t label);
+void hnswlib_sharded_index_unmark_deleted(ShardedHNSWIndex* index, uint64_t label);
+bool hnswlib_sharded_index_resize(ShardedHNSWIndex* index, size_t new_max_elements_per_shard);
+
+// Partitioned (IVF) HNSW index functions
+// train runs k-means over a sample and must come before add_items; every partition is
+// its own HNSW graph, and a query searches only the nprobe partitions with the closest
+// centroids. With max_replicas > 1 a point is also stored in partitions whose centroid
+// is within boundary_factor times its closest centroid distance. add_items builds the
+// partitions in parallel and must not run concurrently with searches.
+// save writes the centroids to path and partition i to "<path>.part<i>".
+PartitionedHNSWIndex* hnswlib_partitioned_index_create(SpaceType space_type, int dim);
+void hnswlib_partitioned_index_free(PartitionedHNSWIndex* index);
+bool hnswlib_partitioned_index_init(PartitionedHNSWIndex* index, size_t num_partitions, size_t max_elements_per_partition, size_t M, size_t ef_construction, size_t random_seed, bool allow_replace_deleted, int num_threads);
+bool hnswlib_partitioned_index_train(PartitionedHNSWIndex* index, const float* data, size_t rows, size_t dim, size_t iterations);
+void hnswlib_partitioned_index_set_replication(PartitionedHNSWIndex* index, size_t max_replicas, float boundary_factor);
+void hnswlib_partitioned_index_set_nprobe(PartitionedHNSWIndex* index, size_t nprobe);
+size_t hnswlib_partitioned_index_get_nprobe(PartitionedHNSWIndex* index);
+void hnswlib_partitioned_index_set_ef(PartitionedHNSWIndex* index, size_t ef);
+bool hnswlib_partitioned_index_add_items(PartitionedHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, bool replace_deleted);
+bool hnswlib_partitioned_index_search_knn(PartitionedHNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads);
+size_t hnswlib_partitioned_index_get_current_count(PartitionedHNSWIndex* index);  // replicas included
+size_t hnswlib_partitioned_index_get_num_partitions(PartitionedHNSWIndex* index);
+size_t hnswlib_partitioned_index_get_partition_sizes(PartitionedHNSWIndex* index, uint64_t* sizes, size_t max_partitions);
+bool hnswlib_partitioned_index_save(PartitionedHNSWIndex* index, const char* path);
+PartitionedHNSWIndex* hnswlib_partitioned_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements_per_partition, bool allow_replace_deleted, int num_threads);
+void hnswlib_partitioned_index_mark_deleted(PartitionedHNSWIndex* index, uint64_t label);
+
+// Tiered (LSM-style) HNSW index functions
+// Inserts go into a small mutable head graph. Once it holds merge_threshold points
+// (0: head_capacity) it is frozen and merged in the background into an immutable
+// segment, rebuilt without deleted points and, with compress_segments, stored with
+// the given quantization. Searches merge the results of the head and all segments;
+// inserts, deletes and searches can run concurrently. Inserts only block on a merge
+// when the head is full. merge starts a merge of the current head and returns false
+// if none was started; with wait it also waits for it to finish.
+// save writes a header to path, the head to "<path>.head" and segment i to "<path>.seg<i>";
+// load needs the same compress_segments and quantization as the saved index.
+TieredHNSWIndex* hnswlib_tiered_index_create(SpaceType space_type, int dim);
+void hnswlib_tiered_index_free(TieredHNSWIndex* index);
+bool hnswlib_tiered_index_init(TieredHNSWIndex* index, size_t head_capacity, size_t M, size_t ef_construction, size_t random_seed, size_t merge_threshold, bool compress_segments, QuantizationType quantization, int num_threads);
+bool hnswlib_tiered_index_add_items(TieredHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* ids, int num_threads, bool replace_deleted);
+bool hnswlib_tiered_index_search_knn(TieredHNSWIndex* index, const float* query, size_t k, uint64_t* result_labels, float* result_distances, size_t query_count, int num_threads);
+void hnswlib_tiered_index_mark_deleted(TieredHNSWIndex* index, uint64_t label);
+bool hnswlib_tiered_index_merge(TieredHNSWIndex* index, bool wait);
+void hnswlib_tiered_index_set_ef(TieredHNSWIndex* index, size_t ef);
+size_t hnswlib_tiered_index_get_current_count(TieredHNSWIndex* index);  // live points in all tiers
+size_t hnswlib_tiered_index_get_head_count(TieredHNSWIndex* index);
+size_t hnswlib_tiered_index_get_num_segments(TieredHNSWIndex* index);
+size_t hnswlib_tiered_index_get_items(TieredHNSWIndex* index, const uint64_t* labels, size_t count, float* out, bool* found);  // like hnswlib_index_get_items, decoded from quantized segments
+bool hnswlib_tiered_index_save(TieredHNSWIndex* index, const char* path);
+TieredHNSWIndex* hnswlib_tiered_index_load(SpaceType space_type, int dim, const char* path, bool compress_segments, QuantizationType quantization, int num_threads);  // restores the saved ef
+
+// Asynchronous requests on an HNSWIndex
+// A queue owns a dispatcher thread that runs searches on a pool of num_threads threads
+// (<= 0 = default). submit_search and submit_add copy their input and return at once;
+// callback is called exactly once, from the dispatcher thread, when the request is done.
+// result_labels / result_distances (query_count * k each) must stay valid until then.
+// Searches submitted within max_wait_us of the oldest waiting one run as one batch of at
+// most max_batch queries; inserts run alone, so they never overlap a search of the queue.
+// Cancelling the token (may be NULL) of a request skips its queries that have not started,
+// also while its batch runs, and reports HNSWAsyncCancelled unless all of them finished.
+// free waits for the running batch and cancels the requests still queued. The index must
+// not be changed outside its queue while the queue exists.
+HNSWCancelToken* hnswlib_cancel_token_create(void);
+void hnswlib_cancel_token_cancel(HNSWCancelToken* token);
+bool hnswlib_cancel_token_is_cancelled(HNSWCancelToken* token);
+void hnswlib_cancel_token_free(HNSWCancelToken* token);
+HNSWAsyncQueue* hnswlib_async_queue_create(HNSWIndex* index, size_t max_batch, uint64_t max_wait_us, int num_threads);
+void hnswlib_async_queue_free(HNSWAsyncQueue* queue);
+bool hnswlib_async_queue_submit_search(HNSWAsyncQueue* queue, const float* query, size_t query_count, size_t k, uint64_t* result_labels, float* result_distances, HNSWCancelToken* token, HNSWAsyncCallback callback, void* user_data);
+bool hnswlib_async_queue_submit_add(HNSWAsyncQueue* queue, const float* data, size_t rows, size_t dim, const uint64_t* ids, bool replace_deleted, HNSWCancelToken* token, HNSWAsyncCallback callback, void* user_data);
+
+// Multi-vector (document) HNSW index functions
+// Every vector belongs to a document (doc_ids, one per row) and search_docs returns, per
+// query, the k closest distinct documents with the distance of their closest vector.
+// ef (set_ef) is the number of documents a search collects before it stops, at least k.
+// Documents are counted in flat per-thread arrays keyed by a dense index the index
+// assigns, so doc ids themselves may be any 64-bit values. save writes the graph to
+// path and the document table to path.docs.
+// search_maxsim scores one query of num_query_vectors vectors (e.g. token embeddings) by
+// late interaction: the candidates_per_vector (at least k) closest documents of every
+// query vector are gathered, and each candidate is scored exactly as the sum over the
+// query vectors of the distance to its closest live vector. The k best documents and
+// their sums are written in ascending order; for inner product / cosine spaces the sum
+// is num_query_vectors minus the ColBERT MaxSim similarity.
+MultiVectorHNSWIndex* hnswlib_multivector_index_create(SpaceType space_type, int dim);
+void hnswlib_multivector_index_free(MultiVectorHNSWIndex* index);
+bool hnswlib_multivector_index_init(MultiVectorHNSWIndex* index, size_t max_elements, size_t M, size_t ef_construction, size_t random_seed);
+bool hnswlib_multivector_index_add_items(MultiVectorHNSWIndex* index, const float* data, size_t rows, size_t dim, const uint64_t* doc_ids, const uint64_t* ids, int num_threads);
+bool hnswlib_multivector_index_search_docs(MultiVectorHNSWIndex* index, const float* query, size_t query_count, size_t k, uint64_t* result_doc_ids, float* result_distances, int num_threads);
+bool hnswlib_multivector_index_search_maxsim(MultiVectorHNSWIndex* index, const float* query, size_t num_query_vectors, size_t k, size_t candidates_per_vector, uint64_t* result_doc_ids, float* result_distances, int num_threads);
+void hnswlib_multivector_index_set_ef(MultiVectorHNSWIndex* index, size_t ef);
+void hnswlib_multivector_index_mark_deleted(MultiVectorHNSWIndex* index, uint64_t label);
+size_t hnswlib_multivector_index_get_current_count(MultiVectorHNSWIndex* index);
+size_t hnswlib_multivector_index_get_num_docs(MultiVectorHNSWIndex* index);
+bool hnswlib_multivector_index_save(MultiVectorHNSWIndex* index, const char* path);
+MultiVectorHNSWIndex* hnswlib_multivector_index_load(SpaceType space_type, int dim, const char* path, size_t max_elements);
+
+// Sparse-vector HNSW index functions (inner product distance 1 - dot, e.g. SPLADE)
+// dim is the number of possible indices. Vectors come in CSR batches: row i has the
+// indices / values in [indptr[i], indptr[i + 1]), indptr holds rows + 1 offsets.
+// Indices need not be sorted but must be < dim and unique within a row. The entries
+// are copied into an arena of the index (get_arena_bytes); save writes the graph to
+// path and the entries to path.sparse.
+SparseHNSWIndex* hnswlib_sparse_index_create(int dim);
+void hnswlib_sparse_index_free(SparseHNSWIndex* index);
+bool hnswlib_sparse_index_init(SparseHNSWIndex* index, size_t max_elements, size_t M, size_t ef_construction, size_t random_seed);
+bool hnswlib_sparse_index_add_items(SparseHNSWIndex* index, const size_t* indptr, const uint32_t* indices, const float* values, size_t rows, const uint64_t* ids, int num_threads);
+bool hnswlib_sparse_index_search_knn(SparseHNSWIndex* index, const size_t* indptr, const uint32_t* indices, const float* values, size_t query_count, size_t k, uint64_t* result_labels, float* result_distances, int num_threads);
+void hnswlib_sparse_index_set_ef(SparseHNSWIndex* index, size_t ef);
+void hnswlib_sparse_index_mark_deleted(SparseHNSWIndex* index, uint64_t label);
+size_t hnswlib_sparse_index_get_current_count(SparseHNSWIndex* index);
+size_t hnswlib_sparse_index_get_arena_bytes(SparseHNSWIndex* index);
+bool hnswlib_sparse_index_save(SparseHNSWIndex* index, const char* path);
+SparseHNSWIndex* hnswlib_sparse_index_load(int dim, const char* path, size_t max_elements);
+
+// Parameter tuning
+// autotune picks M, ef_construction and ef for rows vectors of data so that recall@k on
+// the query_count queries reaches target_recall, at the highest QPS or lowest memory.
+// Graphs are built on sample_size (0 = 20000) evenly spaced rows for every M in
+// {8, 12, 16, 24, 32, 48} and ef_construction in {64, 128, 256, 512}, cheapest first,
+// until budget_seconds have passed; ef is searched up to 1024 against exact neighbors
+// within the sample. The best configuration goes to best, the first max_tried measured
+// ones to tried (may be NULL) and their number to num_tried (may be NULL).
+bool hnswlib_autotune(SpaceType space_type, int dim, const float* data, size_t rows, const float* queries, size_t query_count, size_t k, double target_recall, HNSWTuneObjective objective, double budget_seconds, size_t sample_size, int num_threads, HNSWTuneResult* best, HNSWTuneResult* tried, size_t max_tried, size_t* num_tried);
+
+// For each of ks[num_k] (all > 0), the smallest ef up to max_ef (0 = 1024) whose recall@k
+// on the query_count held-out queries reaches target_recall, into ef_out, and the recall at
+// it into recall_out (may be NULL). Exact neighbors come from a scan of the index. The ef
+// of the index is left unchanged; must not run concurrently with searches or inserts.
+bool hnswlib_index_calibrate_ef(HNSWIndex* index, const float* queries, size_t query_count, const size_t* ks, size_t num_k, double target_recall, size_t max_ef, size_t* ef_out, double* recall_out, int num_threads);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+
+namespace hnswlib {
+
+enum TuneObjective {
+    TUNE_MAX_QPS = 0,      // fastest single-thread search among the configurations meeting the target
+    TUNE_MIN_MEMORY = 1    // smallest graph among them, faster search breaking ties
+};
+
+// Search space and limits of autotune
+struct TuneOptions {
+    size_t k = 10;
+    double target_recall = 0.9;
+    TuneObjective objective = TUNE_MAX_QPS;
+    double budget_seconds = 60;   // no new configuration is started after this
+    size_t sample_size = 20000;   // rows of the data the candidate graphs are built on
+    size_t max_ef = 1024;
+    size_t num_threads = 0;       // 0 = all cores, for building and recall measurements
+    size_t seed = 100;
+    std::vector<size_t> M_values = {8, 12, 16, 24, 32, 48};
+    std::vector<size_t> ef_construction_values = {64, 128, 256, 512};
+};
+
+// One configuration tried by autotune, measured on the sample
+struct TuneResult {
+    size_t M = 0;
+    size_t ef_construction = 0;
+    size_t ef = 0;              // smallest ef reaching the target, max_ef if none does
+    double recall = 0;          // recall@k at that ef
+    double qps = 0;             // single-thread queries per second at that ef
+    double build_seconds = 0;   // build time of the sample graph
+    size_t memory_bytes = 0;    // graph memory extrapolated to all rows
+    bool meets_target = false;
+};
+
+/*
+* Exact k nearest labels of each query, closest first, found by scanning the live
+* elements of `index`. query_bytes is the size of one query (the space's data size).
+*/
+template<typename dist_t>
+std::vector<std::vector<labeltype>>
+exactNeighbors(const HierarchicalNSW<dist_t> &index, const void *queries, size_t query_count, size_t query_bytes,
+               size_t k, ThreadPool &pool) {
+    std::vector<std::vector<labeltype>> truth(query_count);
+    size_t count = index.cur_element_count;
+    pool.run(query_count, [&](size_t q) {
+        const void *query = (const char *) queries + q * query_bytes;
+        std::priority_queue<std::pair<dist_t, labeltype>> top;
+        for (size_t id = 0; id < count; id++) {
+            if (index.isMarkedDeleted(id)) continue;
+            dist_t d = index.fstdistfunc_(query, index.getDataByInternalId(id), index.dist_func_param_);
+            if (top.size() < k) {
+                top.emplace(d, index.getExternalLabel(id));
+            } else if (d < top.top().first) {
+                top.pop();
+                top.emplace(d, index.getExternalLabel(id));
+            }
+        }
+        truth[q].resize(top.size());
+        for (size_t i = top.size(); i > 0; i--) {
+            truth[q][i - 1] = top.top().second;
+            top.pop();
+        }
+    });
+    return truth;
+}
+
+
+// Recall@k of `index` at its current ef against exact neighbor lists
+template<typename dist_t>
+double measureRecall(const HierarchicalNSW<dist_t> &index, const void *queries, size_t query_bytes, size_t k,
+                     const std::vector<std::vector<labeltype>> &truth, ThreadPool &pool) {
+    std::vector<size_t> found(truth.size(), 0);
+    size_t expected = 0;
+    for (const auto &t : truth) expected += t.size();
+    if (expected == 0) return 1.0;
+    pool.run(truth.size(), [&](size_t q) {
+        auto result = index.searchKnn((const char *) queries + q * query_bytes, k);
+        while (!result.empty()) {
+            if (std::find(truth[q].begin(), truth[q].end(), result.top().second) != truth[q].end())
+                found[q]++;
+            result.pop();
+        }
+    });
+    size_t total = 0;
+    for (size_t f : found) total += f;
+    return (double) total / expected;
+}
+
+
+/*
+* Smallest ef in [k, max_ef] whose recall@k on the queries reaches target_recall:
+* doubles ef until the target is met, then bisects the last step. Recall grows with ef
+* up to noise, so the result is the smallest ef at the resolution of the query set.
+* Returns max_ef if even that misses the target. `recall` receives the recall at the
+* returned ef. k must be positive. Leaves the ef of the index unchanged; must not run
+* concurrently with searches on it.
+*/
+template<typename dist_t>
+size_t calibrateEf(HierarchicalNSW<dist_t> &index, const void *queries, size_t query_bytes, size_t k,
+                   const std::vector<std::vector<labeltype>> &truth, double target_recall, size_t max_ef,
+                   ThreadPool &pool, double &recall) {
+    if (k == 0)
+        throw std::runtime_error("Calibrating ef needs k > 0");
+    size_t saved_ef = index.ef_;
+    max_ef = std::max(max_ef, k);
+    auto recallAt = [&](size_t ef) {
+        index.setEf(ef);
+        return measureRecall(index, queries, query_bytes, k, truth, pool);
+    };
+
+    size_t low = 0;  // largest ef known to miss the target
+    size_t high = k;
+    double high_recall = recallAt(high);
+    while (high_recall < target_recall && high < max_ef) {
+        low = high;
+        high = std::min(high * 2, max_ef);
+        high_recall = recallAt(high);
+    }
+    if (high_recall >= target_recall) {
+        while (low + 1 < high && high > k) {
+            size_t mid = low + (high - low) / 2;
+            double mid_recall = recallAt(mid);
+            if (mid_recall >= target_recall) {
+                high = mid;
+                high_recall = mid_recall;
+            } else {
+                low = mid;
+            }
+        }
+    }
+    index.setEf(saved_ef);
+    recall = high_recall;
+    return high;
+}
+
+
+/*
+* Picks M, ef_construction and ef for `rows` vectors of `data` (rows of the space's
+* data size) so that recall@k on `queries` reaches options.target_recall at the least
+* cost. Builds a graph per (M, ef_construction) pair of the grid on an evenly strided
+* sample of the data, takes exact neighbors within the sample from BruteforceSearch and
+* calibrates ef for each graph. Pairs are tried from cheap to expensive until the time
+* budget runs out; an ef_construction is skipped once a smaller one with the same M
+* met the target at ef = k. `tried` (may be null) receives every measured configuration.
+* Returns the best one meeting the target, or the one with the highest recall if none does.
+*/
+template<typename dist_t>
+TuneResult autotune(SpaceInterface<dist_t> *space, const void *data, size_t rows, const void *queries,
+                    size_t query_count, const TuneOptions &options, std::vector<TuneResult> *tried = nullptr) {
+    if (rows == 0 || query_count == 0)
+        throw std::runtime_error("Autotune needs data and queries");
+    if (options.k == 0)
+        throw std::runtime_error("Autotune needs k > 0");
+    if (options.M_values.empty() || options.ef_construction_values.empty())
+        throw std::runtime_error("Autotune needs at least one M and one ef_construction");
+    auto start = std::chrono::steady_clock::now();
+    size_t num_threads = options.num_threads ? options.num_threads : std::thread::hardware_concurrency();
+    ThreadPool pool(std::max(num_threads, (size_t) 1) - 1);
+    size_t data_size = space->get_data_size();
+    size_t sample_size = std::min(std::max(options.sample_size, (size_t) 1), rows);
+    size_t k = std::min(options.k, sample_size);
+
+    std::vector<size_t> sample(sample_size);
+    for (size_t i = 0; i < sample_size; i++)
+        sample[i] = i * rows / sample_size;
+    auto row = [&](size_t i) { return (const char *) data + sample[i] * data_size; };
+
+    std::vector<std::vector<labeltype>> truth(query_count);
+    {
+        BruteforceSearch<dist_t> exact(space, sample_size);
+        for (size_t i = 0; i < sample_size; i++)
+            exact.addPoint(row(i), i);
+        pool.run(query_count, [&](size_t q) {
+            auto result = exact.searchKnn((const char *) queries + q * data_size, k);
+            truth[q].resize(result.size());
+            for (size_t i = result.size(); i > 0; i--) {
+                truth[q][i - 1] = result.top().second;
+                result.pop();
+            }
+        });
+    }
+
+    std::vector<size_t> M_values = options.M_values;
+    std::vector<size_t> ef_construction_values = options.ef_construction_values;
+    std::sort(M_values.begin(), M_values.end());
+    std::sort(ef_construction_values.begin(), ef_construction_values.end());
+
+    TuneResult best;
+    bool have_best = false;
+    auto better = [&](const TuneResult &a, const TuneResult &b) {
+        if (a.meets_target != b.meets_target) return a.meets_target;
+        if (!a.meets_target) return a.recall > b.recall;
+        if (options.objective == TUNE_MIN_MEMORY && a.memory_bytes != b.memory_bytes)
+            return a.memory_bytes < b.memory_bytes;
+        return a.qps > b.qps;
+    };
+
+    for (size_t M : M_values) {
+        for (size_t ef_construction : ef_construction_values) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (have_best && elapsed > options.budget_seconds)
+                break;
+
+            TuneResult result;
+            result.M = M;
+            result.ef_construction = ef_construction;
+            HierarchicalNSW<dist_t> index(space, sample_size, M, ef_construction, options.seed);
+            auto build_start = std::chrono::steady_clock::now();
+            index.addPoint(row(0), 0);
+            pool.run(sample_size - 1, [&](size_t i) { index.addPoint(row(i + 1), i + 1); });
+            result.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count();
+
+            size_t upper_bytes = 0;
+            for (size_t i = 0; i < sample_size; i++) {
+                if (index.element_levels_[i] > 0)
+                    upper_bytes += index.size_links_per_element_ * index.element_levels_[i] + 1;
+            }
+            result.memory_bytes = rows * (index.size_data_per_element_ + sizeof(void *)) +
+                                  (size_t) ((double) upper_bytes * rows / sample_size);
+
+            result.ef = calibrateEf(index, queries, data_size, k, truth, options.target_recall, options.max_ef,
+                                    pool, result.recall);
+            result.meets_target = result.recall >= options.target_recall;
+
+            // one query at a time on this thread, so QPS is per core; the fastest of
+            // at least three passes and 0.2 s of searching smooths out timer noise
+            index.setEf(result.ef);
+            double fastest = std::numeric_limits<double>::max(), searched = 0;
+            for (size_t pass = 0; pass < 3 || searched < 0.2; pass++) {
+                auto search_start = std::chrono::steady_clock::now();
+                for (size_t q = 0; q < query_count; q++)
+                    index.searchKnn((const char *) queries + q * data_size, k);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count();
+                fastest = std::min(fastest, seconds);
+                searched += seconds;
+            }
+            result.qps = query_count / std::max(fastest, 1e-9);
+
+            if (tried) tried->push_back(result);
+            if (!have_best || better(result, best)) {
+                best = result;
+                have_best = true;
+            }
+            if (result.meets_target && result.ef <= k)
+                break;  // a larger ef_construction cannot lower ef further
+        }
+    }
+    return best;
+}
+
+}  // namespace hnswlib
@@ -3,9 +3,57 @@
 #include <fstream>
 #include <mutex>
 #include <algorithm>
+#include <limits>
 #include <assert.h>
 
 namespace hnswlib {
+static const size_t BF_SCAN_BLOCK_SIZE = 64;
+
+/*
+* Writes the positions of the distances that are <= threshold into `out`
+* and returns their count.
+*/
+template<typename dist_t>
+inline size_t selectBelowThreshold(const dist_t *dists, size_t n, dist_t threshold, unsigned int *out) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        out[count] = (unsigned int) i;
+        count += dists[i] <= threshold;
+    }
+    return count;
+}
+
+#if defined(USE_AVX) || defined(USE_SSE)
+inline size_t selectBelowThreshold(const float *dists, size_t n, float threshold, unsigned int *out) {
+    size_t count = 0;
+    size_t i = 0;
+#if defined(USE_AVX)
+    __m256 limit = _mm256_set1_ps(threshold);
+    for (; i + 8 <= n; i += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(dists + i), limit, _CMP_LE_OQ));
+        for (unsigned int j = 0; mask; j++, mask >>= 1) {
+            out[count] = (unsigned int) i + j;
+            count += mask & 1;
+        }
+    }
+#else
+    __m128 limit = _mm_set1_ps(threshold);
+    for (; i + 4 <= n; i += 4) {
+        int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(dists + i), limit));
+        for (unsigned int j = 0; mask; j++, mask >>= 1) {
+            out[count] = (unsigned int) i + j;
+            count += mask & 1;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        out[count] = (unsigned int) i;
+        count += dists[i] <= threshold;
+    }
+    return count;
+}
+#endif
+
 template<typename dist_t>
 class BruteforceSearch : public AlgorithmInterface<dist_t> {
  public:
@@ -17,6 +65,7 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
     size_t data_size_;
     DISTFUNC <dist_t> fstdistfunc_;
     void *dist_func_param_;
+    SpaceInterface<dist_t> *space_;
     std::mutex index_lock;
 
     std::unordered_map<labeltype, size_t > dict_external_to_internal;
@@ -28,7 +77,8 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             cur_element_count(0),
             size_per_element_(0),
             data_size_(0),
-            dist_func_param_(nullptr) {
+            dist_func_param_(nullptr),
+            space_(s) {
     }
 
 
@@ -38,12 +88,13 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             cur_element_count(0),
             size_per_element_(0),
             data_size_(0),
-            dist_func_param_(nullptr) {
+            dist_func_param_(nullptr),
+            space_(s) {
         loadIndex(location, s);
     }
 
 
-    BruteforceSearch(SpaceInterface <dist_t> *s, size_t maxElements) {
+    BruteforceSearch(SpaceInterface <dist_t> *s, size_t maxElements) : space_(s) {
         maxelements_ = maxElements;
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
@@ -79,59 +130,199 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             }
         }
         memcpy(data_ + size_per_element_ * idx + data_size_, &label, sizeof(labeltype));
-        memcpy(data_ + size_per_element_ * idx, datapoint, data_size_);
+        space_->storeVector(data_ + size_per_element_ * idx, datapoint);
     }
 
 
-    void removePoint(labeltype cur_external) {
+    // Slot given by reservePoints to a row whose label appears again later in the batch
+    static const size_t SKIPPED_SLOT = (size_t) -1;
+
+
+    /*
+    * Resolves a whole batch of labels to storage slots under a single lock, so that
+    * the vectors can then be written into getDataByInternalId(slots[i]) concurrently.
+    * Existing labels keep their slot and are overwritten; new labels are appended.
+    * If a label repeats within the batch, only its last row gets a slot, the others
+    * get SKIPPED_SLOT, as if the rows were added one after another. The capacity is
+    * checked for the whole batch first, so a batch that does not fit changes nothing.
+    * If `labels` is null, labels first_label, first_label + 1, ... are used.
+    */
+    template<typename label_t>
+    void reservePoints(const label_t *labels, size_t count, labeltype first_label, size_t *slots) {
+        std::unique_lock<std::mutex> lock(index_lock);
+
+        // explicit labels may repeat, generated ones cannot
+        std::unordered_map<labeltype, size_t> last_row;
+        if (labels) {
+            last_row.reserve(count);
+            for (size_t i = 0; i < count; i++)
+                last_row[(labeltype) labels[i]] = i;
+        }
+        size_t num_new = 0;
+        for (size_t i = 0; i < count; i++) {
+            labeltype label = labels ? (labeltype) labels[i] : first_label + i;
+            if (labels && last_row[label] != i) continue;
+            num_new += dict_external_to_internal.find(label) == dict_external_to_internal.end();
+        }
+        if (cur_element_count + num_new > maxelements_) {
+            throw std::runtime_error("The number of elements exceeds the specified limit\n");
+        }
+
+        dict_external_to_internal.reserve(cur_element_count + num_new);
+        for (size_t i = 0; i < count; i++) {
+            labeltype label = labels ? (labeltype) labels[i] : first_label + i;
+            if (labels && last_row[label] != i) {
+                slots[i] = SKIPPED_SLOT;
+                continue;
+            }
+            auto search = dict_external_to_internal.find(label);
+            if (search != dict_external_to_internal.end()) {
+                slots[i] = search->second;
+            } else {
+                slots[i] = cur_element_count;
+                dict_external_to_internal[label] = cur_element_count;
+                memcpy(data_ + size_per_element_ * cur_element_count + data_size_, &label, sizeof(labeltype));
+                cur_element_count++;
+            }
+        }
+    }
+
+
+    inline char *getDataByInternalId(size_t internal_id) const {
+        return data_ + size_per_element_ * internal_id;
+    }
+
+
+    // Returns false if the label is not in the index
+    bool removePoint(labeltype cur_external) {
         std::unique_lock<std::mutex> lock(index_lock);
 
         auto found = dict_external_to_internal.find(cur_external);
         if (found == dict_external_to_internal.end()) {
-            return;
+            return false;
         }
 
+        size_t cur_c = found->second;
         dict_external_to_internal.erase(found);
 
-        size_t cur_c = found->second;
-        labeltype label = *((labeltype*)(data_ + size_per_element_ * (cur_element_count-1) + data_size_));
-        dict_external_to_internal[label] = cur_c;
-        memcpy(data_ + size_per_element_ * cur_c,
-                data_ + size_per_element_ * (cur_element_count-1),
-                data_size_+sizeof(labeltype));
+        size_t last = cur_element_count - 1;
+        if (cur_c != last) {
+            labeltype label = *((labeltype*)(data_ + size_per_element_ * last + data_size_));
+            dict_external_to_internal[label] = cur_c;
+            memcpy(data_ + size_per_element_ * cur_c,
+                    data_ + size_per_element_ * last,
+                    data_size_+sizeof(labeltype));
+        }
         cur_element_count--;
+        return true;
     }
 
 
+    typedef std::vector<std::pair<dist_t, labeltype>> TopKHeap;
+
+
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
         assert(k <= cur_element_count);
-        std::priority_queue<std::pair<dist_t, labeltype >> topResults;
-        if (cur_element_count == 0) return topResults;
-        for (int i = 0; i < k; i++) {
-            dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
-            labeltype label = *((labeltype*) (data_ + size_per_element_ * i + data_size_));
-            if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                topResults.emplace(dist, label);
+        return searchKnnRange(query_data, k, 0, cur_element_count, isIdAllowed);
+    }
+
+
+    /*
+    * Scans only the internal ids in [begin, end) and returns their local top-k.
+    * Disjoint ranges can be scanned concurrently and their results merged,
+    * which lets a single query use several threads.
+    */
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnRange(const void *query_data, size_t k, size_t begin, size_t end,
+                   BaseFilterFunctor* isIdAllowed = nullptr) const {
+        TopKHeap heap;
+        scanRange(query_data, k, begin, end, heap, isIdAllowed);
+        return std::priority_queue<std::pair<dist_t, labeltype >>(std::less<std::pair<dist_t, labeltype>>(), std::move(heap));
+    }
+
+
+    /*
+    * Writes the k nearest neighbors, closest first, straight into the caller arrays
+    * and returns how many were found. `heap` is scratch space that can be reused
+    * across calls to keep the search allocation free.
+    */
+    template<typename label_t>
+    size_t searchKnnInto(const void *query_data, size_t k, label_t *labels, dist_t *distances,
+                         TopKHeap &heap, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        heap.clear();
+        scanRange(query_data, k, 0, cur_element_count, heap, isIdAllowed);
+        return writeTopK(heap, labels, distances);
+    }
+
+
+    /*
+    * Scans [begin, end) in blocks: distances of a whole block are computed first,
+    * then compared against the current k-th distance with SIMD so that only the
+    * few survivors touch the heap. `heap` is a max-heap of at most k entries and
+    * may already hold results from other ranges.
+    */
+    void scanRange(const void *query_data, size_t k, size_t begin, size_t end,
+                   TopKHeap &heap, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        end = std::min(end, (size_t) cur_element_count);
+        if (begin >= end || k == 0) return;
+        heap.reserve(k + 1);
+
+        dist_t dists[BF_SCAN_BLOCK_SIZE];
+        unsigned int survivors[BF_SCAN_BLOCK_SIZE];
+        for (size_t block = begin; block < end; block += BF_SCAN_BLOCK_SIZE) {
+            size_t block_size = std::min(BF_SCAN_BLOCK_SIZE, end - block);
+            char *block_data = data_ + size_per_element_ * block;
+            for (size_t i = 0; i < block_size; i++) {
+                dists[i] = fstdistfunc_(query_data, block_data + size_per_element_ * i, dist_func_param_);
             }
-        }
-        dist_t lastdist = topResults.empty() ? std::numeric_limits<dist_t>::max() : topResults.top().first;
-        for (int i = k; i < cur_element_count; i++) {
-            dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
-            if (dist <= lastdist) {
-                labeltype label = *((labeltype *) (data_ + size_per_element_ * i + data_size_));
-                if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                    topResults.emplace(dist, label);
-                }
-                if (topResults.size() > k)
-                    topResults.pop();
 
-                if (!topResults.empty()) {
-                    lastdist = topResults.top().first;
+            dist_t threshold = heap.size() < k ? std::numeric_limits<dist_t>::max() : heap.front().first;
+            size_t num_survivors = selectBelowThreshold(dists, block_size, threshold, survivors);
+            for (size_t j = 0; j < num_survivors; j++) {
+                size_t i = survivors[j];
+                if (heap.size() >= k && dists[i] > heap.front().first) continue;
+                labeltype label = *((labeltype *) (block_data + size_per_element_ * i + data_size_));
+                if ((!isIdAllowed) || (*isIdAllowed)(label)) {
+                    pushTopK(heap, k, dists[i], label);
                 }
             }
         }
-        return topResults;
+    }
+
+
+    static void pushTopK(TopKHeap &heap, size_t k, dist_t dist, labeltype label) {
+        heap.emplace_back(dist, label);
+        std::push_heap(heap.begin(), heap.end());
+        if (heap.size() > k) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
+    }
+
+
+    /*
+    * Folds the results of `src` into `dst`, keeping the k closest.
+    */
+    static void mergeTopK(TopKHeap &dst, const TopKHeap &src, size_t k) {
+        for (size_t i = 0; i < src.size(); i++) {
+            if (dst.size() >= k && src[i].first > dst.front().first) continue;
+            pushTopK(dst, k, src[i].first, src[i].second);
+        }
+    }
+
+
+    /*
+    * Sorts the heap in place and writes it out closest first.
+    */
+    template<typename label_t>
+    static size_t writeTopK(TopKHeap &heap, label_t *labels, dist_t *distances) {
+        std::sort_heap(heap.begin(), heap.end());
+        for (size_t i = 0; i < heap.size(); i++) {
+            distances[i] = heap[i].first;
+            labels[i] = heap[i].second;
+        }
+        return heap.size();
     }
 
 
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+
+namespace hnswlib {
+
+// Parts of HierarchicalNSW::addPoint that are timed while a BuildProfileScope is active
+enum BuildPhase {
+    BUILD_INSERT,               // the whole insert, one count per point
+    BUILD_UPPER_DESCENT,        // greedy descent through the levels above the new point
+    BUILD_SEARCH_BASE_LAYER,    // ef_construction search on each level of the new point
+    BUILD_SELECT_NEIGHBORS,     // getNeighborsByHeuristic2 on the candidates of the new point
+    BUILD_PRUNE,                // re-running the heuristic on neighbors whose list overflowed
+    BUILD_WAIT_GLOBAL,          // lock waits, counted per acquisition; the time is also
+                                // part of the phase the lock was taken in
+    BUILD_WAIT_LINK_LIST,
+    BUILD_WAIT_LABEL_LOOKUP,
+    BUILD_PHASE_COUNT
+};
+
+static inline const char *buildPhaseName(int phase) {
+    static const char *names[BUILD_PHASE_COUNT] = {
+        "insert", "upper_descent", "search_base_layer", "select_neighbors", "prune",
+        "wait_global", "wait_link_list", "wait_label_lookup"
+    };
+    return names[phase];
+}
+
+struct BuildProfileCounts {
+    uint64_t count[BUILD_PHASE_COUNT];
+    uint64_t ns[BUILD_PHASE_COUNT];
+
+    BuildProfileCounts() {
+        memset(count, 0, sizeof(count));
+        memset(ns, 0, sizeof(ns));
+    }
+
+    void add(const BuildProfileCounts &other) {
+        for (int i = 0; i < BUILD_PHASE_COUNT; i++) {
+            count[i] += other.count[i];
+            ns[i] += other.ns[i];
+        }
+    }
+};
+
+/*
+* Where the calling thread's inserts are accounted, null when profiling is off.
+* Each thread has its own target, so the counters need no synchronization.
+*/
+static inline BuildProfileCounts *&currentBuildProfile() {
+    static thread_local BuildProfileCounts *target = nullptr;
+    return target;
+}
+
+// Accounts the calling thread's inserts to `target` for the lifetime of the scope
+class BuildProfileScope {
+    BuildProfileCounts *previous_;
+
+ public:
+    explicit BuildProfileScope(BuildProfileCounts *target) : previous_(currentBuildProfile()) {
+        currentBuildProfile() = target;
+    }
+
+    ~BuildProfileScope() {
+        currentBuildProfile() = previous_;
+    }
+};
+
+// Adds its own lifetime to one phase of `profile`; does nothing if `profile` is null
+class BuildPhaseTimer {
+    BuildProfileCounts *profile_;
+    int phase_;
+    std::chrono::steady_clock::time_point start_;
+
+ public:
+    BuildPhaseTimer(BuildProfileCounts *profile, int phase) : profile_(profile), phase_(phase) {
+        if (profile_) start_ = std::chrono::steady_clock::now();
+    }
+
+    ~BuildPhaseTimer() {
+        if (!profile_) return;
+        profile_->count[phase_]++;
+        profile_->ns[phase_] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    }
+};
+
+/*
+* Locks a deferred unique_lock, adding the time spent blocked to `phase`.
+* Like StatsMutex, the clock is only read when try_lock fails.
+*/
+template<class Mutex>
+static inline void lockProfiled(std::unique_lock<Mutex> &lock, BuildProfileCounts *profile, int phase) {
+    if (!profile) {
+        lock.lock();
+        return;
+    }
+    profile->count[phase]++;
+    if (lock.try_lock()) return;
+    auto start = std::chrono::steady_clock::now();
+    lock.lock();
+    profile->ns[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace hnswlib
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <stdint.h>
+
+namespace hnswlib {
+
+/*
+* HDR-style histogram of non-negative integers with about 3% relative precision.
+* Values up to 64 get a bucket each; above that every power of two is split into
+* 32 linear sub-buckets, so the whole uint64 range fits in a fixed array. Buckets
+* include their upper bound, so the values <= a power of two are whole buckets.
+* record() is lock free and can be called from any number of threads.
+*/
+class LogLinearHistogram {
+    static const int SUB_BUCKET_BITS = 5;
+    static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const size_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + 1;
+
+    std::atomic<uint64_t> counts_[NUM_BUCKETS];
+    std::atomic<uint64_t> total_count_;
+    std::atomic<uint64_t> total_sum_;
+    std::atomic<uint64_t> max_;
+
+    static int highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1) bit++;
+        return bit;
+#endif
+    }
+
+    // Log-linear cells of [0, 2^64), each starting at its lower bound
+    static size_t cellIndex(uint64_t value) {
+        if (value < 2 * SUB_BUCKETS)
+            return (size_t) value;
+        int shift = highestBit(value) - SUB_BUCKET_BITS;
+        return (size_t) ((shift + 1) * SUB_BUCKETS + (value >> shift) - SUB_BUCKETS);
+    }
+
+    static uint64_t cellLowerBound(size_t index) {
+        if (index < 2 * SUB_BUCKETS)
+            return index;
+        int shift = (int) (index / SUB_BUCKETS) - 1;
+        return (index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+    }
+
+    static uint64_t cellUpperBound(size_t index) {
+        if (index < 2 * SUB_BUCKETS)
+            return index;
+        int shift = (int) (index / SUB_BUCKETS) - 1;
+        return cellLowerBound(index) + (((uint64_t) 1 << shift) - 1);
+    }
+
+    // Bucket 0 holds 0, bucket i > 0 the values v whose v - 1 falls in cell i - 1,
+    // so a bucket ends where the next cell starts: at 64, 66, ..., and at every power of two
+    static size_t bucketIndex(uint64_t value) {
+        return value == 0 ? 0 : cellIndex(value - 1) + 1;
+    }
+
+    static uint64_t bucketUpperBound(size_t index) {
+        if (index == 0) return 0;
+        uint64_t upper = cellUpperBound(index - 1);
+        return upper == UINT64_MAX ? upper : upper + 1;
+    }
+
+ public:
+    LogLinearHistogram() {
+        reset();
+    }
+
+    void record(uint64_t value) {
+        counts_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        total_count_.fetch_add(1, std::memory_order_relaxed);
+        total_sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t prev = max_.load(std::memory_order_relaxed);
+        while (value > prev && !max_.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {}
+    }
+
+    void reset() {
+        for (size_t i = 0; i < NUM_BUCKETS; i++)
+            counts_[i] = 0;
+        total_count_ = 0;
+        total_sum_ = 0;
+        max_ = 0;
+    }
+
+    uint64_t count() const {
+        return total_count_.load();
+    }
+
+    uint64_t sum() const {
+        return total_sum_.load();
+    }
+
+    uint64_t max() const {
+        return max_.load();
+    }
+
+    // Number of recorded values that are <= limit, exact when limit is a power of two
+    uint64_t countAtMost(uint64_t limit) const {
+        size_t end = bucketIndex(limit);
+        if (bucketUpperBound(end) == limit) end++;
+        uint64_t total = 0;
+        for (size_t i = 0; i < end; i++)
+            total += counts_[i].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Smallest recorded bucket value such that at least `quantile` of all values are <= it
+    uint64_t valueAtQuantile(double quantile) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t target = (uint64_t) (quantile * total + 0.5);
+        if (target == 0) target = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; i++) {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= target) {
+                uint64_t upper = bucketUpperBound(i);
+                return upper < max() ? upper : max();
+            }
+        }
+        return max();
+    }
+
+    /*
+    * Writes `value` recorded units times unit_scale: as an integer when unit_scale is 1,
+    * otherwise with 17 significant digits, so that counters such as _sum stay exact.
+    */
+    static void writeValue(std::ostream &out, uint64_t value, double unit_scale) {
+        if (unit_scale == 1) {
+            out << value;
+            return;
+        }
+        std::streamsize precision = out.precision(17);
+        out << value * unit_scale;
+        out.precision(precision);
+    }
+
+    /*
+    * Writes the histogram in the Prometheus text format. Bucket edges are the powers
+    * of two from 2^min_exponent up to 2^max_exponent in recorded units, multiplied by `unit_scale`
+    * (e.g. 1e-9 to export nanoseconds as seconds). Each bucket counts the values <= its
+    * edge. p50/p90/p99/p999 are written as a separate `<name>_quantile` gauge.
+    */
+    void writePrometheus(std::ostream &out, const std::string &name, const std::string &help,
+                         double unit_scale, int min_exponent, int max_exponent) const {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " histogram\n";
+        for (int e = min_exponent; e <= max_exponent; e++) {
+            uint64_t edge = (uint64_t) 1 << e;
+            out << name << "_bucket{le=\"";
+            writeValue(out, edge, unit_scale);
+            out << "\"} " << countAtMost(edge) << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << count() << "\n";
+        out << name << "_sum ";
+        writeValue(out, sum(), unit_scale);
+        out << "\n";
+        out << name << "_count " << count() << "\n";
+
+        static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        static const char *quantile_labels[] = {"0.5", "0.9", "0.99", "0.999"};
+        out << "# HELP " << name << "_quantile " << help << " (quantiles)\n";
+        out << "# TYPE " << name << "_quantile gauge\n";
+        for (size_t i = 0; i < 4; i++) {
+            out << name << "_quantile{quantile=\"" << quantile_labels[i] << "\"} ";
+            writeValue(out, valueAtQuantile(quantiles[i]), unit_scale);
+            out << "\n";
+        }
+    }
+};
+
+}  // namespace hnswlib
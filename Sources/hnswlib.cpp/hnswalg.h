@@ -1,19 +1,57 @@
 #pragma once
 
 #include "visited_list_pool.h"
+#include "lock_stats.h"
+#include "build_profile.h"
 #include "hnswlib.h"
 #include <atomic>
+#include <chrono>
 #include <random>
 #include <stdlib.h>
 #include <assert.h>
 #include <unordered_set>
 #include <list>
 #include <memory>
+#include <thread>
 
 namespace hnswlib {
 typedef unsigned int tableint;
 typedef unsigned int linklistsizeint;
 
+/*
+* Work done by a single query, filled in by searchKnnWithStats.
+* "upper" covers the greedy descent through levels > 0, "base" the ef search on level 0.
+*/
+struct SearchStats {
+    size_t upper_hops = 0;
+    size_t upper_distance_computations = 0;
+    size_t base_hops = 0;
+    size_t base_distance_computations = 0;
+    size_t visited_nodes = 0;
+    size_t filter_rejects = 0;  // candidates kept out of the result by the filter or a delete mark
+    uint64_t wall_time_ns = 0;
+};
+
+/*
+* Structural health of the graph, returned by graphStats.
+* Histograms are indexed by degree; in-degrees above the level's maximum out-degree
+* are counted in the last bucket.
+*/
+struct GraphStats {
+    size_t num_elements = 0;
+    size_t num_deleted = 0;
+    std::vector<size_t> nodes_per_level;
+    std::vector<std::vector<size_t>> out_degree_histogram;  // [level][degree]
+    std::vector<std::vector<size_t>> in_degree_histogram;   // [level][degree]
+    size_t unreachable_nodes = 0;  // live nodes not reachable from the entry point on level 0
+    size_t total_edges = 0;        // all levels
+    size_t edges_to_deleted = 0;
+    double deleted_edge_fraction = 0;
+    double avg_edge_length = 0;    // mean level 0 edge distance, in the units of the space
+    size_t navigability_samples = 0;
+    double navigability = 0;       // fraction of sampled nodes a search for their own vector returns as top-1
+};
+
 template<typename dist_t>
 class HierarchicalNSW : public AlgorithmInterface<dist_t> {
  public:
@@ -36,11 +74,18 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::unique_ptr<VisitedListPool> visited_list_pool_{nullptr};
 
+    // Plain std::mutex unless compiled with HNSWLIB_LOCK_STATS (see lock_stats.h)
+    typedef LockType<LOCK_GLOBAL>::type global_mutex_t;
+    typedef LockType<LOCK_LABEL_OP>::type label_op_mutex_t;
+    typedef LockType<LOCK_LABEL_LOOKUP>::type label_lookup_mutex_t;
+    typedef LockType<LOCK_LINK_LIST>::type link_list_mutex_t;
+    typedef LockType<LOCK_DELETED_ELEMENTS>::type deleted_elements_mutex_t;
+
     // Locks operations with element by label value
-    mutable std::vector<std::mutex> label_op_locks_;
+    mutable std::vector<label_op_mutex_t> label_op_locks_;
 
-    std::mutex global;
-    std::vector<std::mutex> link_list_locks_;
+    global_mutex_t global;
+    std::vector<link_list_mutex_t> link_list_locks_;
 
     tableint enterpoint_node_{0};
 
@@ -55,8 +100,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     DISTFUNC<dist_t> fstdistfunc_;
     void *dist_func_param_{nullptr};
+    SpaceInterface<dist_t> *space_{nullptr};
 
-    mutable std::mutex label_lookup_lock;  // lock for label_lookup_
+    mutable label_lookup_mutex_t label_lookup_lock;  // lock for label_lookup_
     std::unordered_map<labeltype, tableint> label_lookup_;
 
     std::default_random_engine level_generator_;
@@ -67,9 +113,18 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     bool allow_replace_deleted_ = false;  // flag to replace deleted elements (marked as deleted) during insertions
 
-    std::mutex deleted_elements_lock;  // lock for deleted_elements
+    deleted_elements_mutex_t deleted_elements_lock;  // lock for deleted_elements
     std::unordered_set<tableint> deleted_elements;  // contains internal ids of deleted elements
 
+    // Flat mode (setFlat): all elements stay on level 0 and searches start from the
+    // closest of a few routers instead of descending the upper levels
+    std::atomic<bool> flat_{false};
+    size_t num_routers_{0};
+    std::unique_ptr<std::atomic<tableint>[]> routers_;
+    std::atomic<size_t> router_count_{0};
+    std::atomic<size_t> routers_built_at_{0};  // element count when the routers were picked
+    std::mutex routers_lock_;
+
 
     HierarchicalNSW(SpaceInterface<dist_t> *s) {
     }
@@ -102,6 +157,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
         dist_func_param_ = s->get_dist_func_param();
+        space_ = s;
         if ( M <= 10000 ) {
             M_ = M;
         } else {
@@ -175,7 +231,122 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
-    inline std::mutex& getLabelOpMutex(labeltype label) const {
+    /*
+    * Switches to a flat graph: new elements get level 0 only, so there are no upper
+    * link lists to allocate and no descent through them. Searches and inserts start
+    * from the closest of num_routers routers instead, spread over the data and re-picked
+    * whenever the element count doubles. For high-dimensional data the upper levels
+    * save little over that and cost memory and a global lock when a new top level appears.
+    * Needs a graph without upper levels: an empty one, or a loaded flat one (the mode
+    * itself is not saved).
+    */
+    void setFlat(size_t num_routers = 32) {
+        if (maxlevel_ > 0)
+            throw std::runtime_error("Flat mode needs an empty graph or one without upper levels");
+        std::unique_lock<std::mutex> lock(routers_lock_);
+        num_routers_ = std::max(num_routers, (size_t) 1);
+        routers_.reset(new std::atomic<tableint>[num_routers_]);
+        router_count_ = 0;
+        routers_built_at_ = 0;
+        flat_ = true;
+        lock.unlock();
+        pickRouters(true);
+    }
+
+
+    bool isFlat() const {
+        return flat_;
+    }
+
+
+    /*
+    * Picks the routers from an evenly strided sample of at most 1024 live elements:
+    * first the medoid of (part of) the sample, then repeatedly the sampled element
+    * farthest from all routers so far. Only uses distances, so works for any space.
+    * With wait = false the call returns at once if another thread is already picking.
+    * Searches running meanwhile may mix old and new routers, any of them is a valid start.
+    */
+    void pickRouters(bool wait) {
+        std::unique_lock<std::mutex> lock(routers_lock_, std::defer_lock);
+        if (wait)
+            lock.lock();
+        else if (!lock.try_lock())
+            return;
+
+        size_t count = cur_element_count;
+        std::vector<tableint> sample;
+        size_t stride = std::max((count + 1023) / 1024, (size_t) 1);
+        for (size_t id = 0; id < count; id += stride) {
+            // an insert holds the lock of its element until the links are written
+            std::unique_lock <link_list_mutex_t> link_lock(link_list_locks_[id]);
+            if (!isMarkedDeleted(id) && (getListCount(get_linklist0(id)) > 0 || count == 1))
+                sample.push_back(id);
+        }
+        routers_built_at_ = count;
+        if (sample.empty())
+            return;
+
+        // medoid of at most 256 sampled elements
+        size_t medoid_stride = std::max(sample.size() / 256, (size_t) 1);
+        tableint medoid = sample[0];
+        dist_t best_sum = std::numeric_limits<dist_t>::max();
+        for (size_t i = 0; i < sample.size(); i += medoid_stride) {
+            dist_t sum = 0;
+            for (size_t j = 0; j < sample.size(); j += medoid_stride)
+                sum += fstdistfunc_(getDataByInternalId(sample[i]), getDataByInternalId(sample[j]), dist_func_param_);
+            if (sum < best_sum) {
+                best_sum = sum;
+                medoid = sample[i];
+            }
+        }
+
+        std::vector<tableint> routers(1, medoid);
+        std::vector<dist_t> closest(sample.size());
+        for (size_t i = 0; i < sample.size(); i++)
+            closest[i] = fstdistfunc_(getDataByInternalId(sample[i]), getDataByInternalId(medoid), dist_func_param_);
+        while (routers.size() < num_routers_) {
+            size_t farthest = std::max_element(closest.begin(), closest.end()) - closest.begin();
+            if (!(closest[farthest] > 0))
+                break;
+            tableint router = sample[farthest];
+            routers.push_back(router);
+            for (size_t i = 0; i < sample.size(); i++) {
+                dist_t d = fstdistfunc_(getDataByInternalId(sample[i]), getDataByInternalId(router), dist_func_param_);
+                closest[i] = std::min(closest[i], d);
+            }
+        }
+
+        size_t old_count = router_count_;
+        for (size_t i = 0; i < routers.size(); i++)
+            routers_[i].store(routers[i], std::memory_order_relaxed);
+        if (routers.size() > old_count)
+            router_count_ = routers.size();
+    }
+
+
+    /*
+    * Where a search or insert for `point` starts: the entry point, or in flat mode the
+    * closest router. Sets `dist` to the distance of the returned element.
+    */
+    tableint startElement(const void *point, dist_t &dist) const {
+        tableint start = enterpoint_node_;
+        dist = fstdistfunc_(point, getDataByInternalId(start), dist_func_param_);
+        if (!flat_)
+            return start;
+        size_t count = router_count_;
+        for (size_t i = 0; i < count; i++) {
+            tableint router = routers_[i].load(std::memory_order_relaxed);
+            dist_t d = fstdistfunc_(point, getDataByInternalId(router), dist_func_param_);
+            if (d < dist) {
+                dist = d;
+                start = router;
+            }
+        }
+        return start;
+    }
+
+
+    inline label_op_mutex_t& getLabelOpMutex(labeltype label) const {
         // calculate hash
         size_t lock_id = label & (MAX_LABEL_OPERATION_LOCKS - 1);
         return label_op_locks_[lock_id];
@@ -224,6 +395,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
     searchBaseLayer(tableint ep_id, const void *data_point, int layer) {
+        BuildProfileCounts *profile = currentBuildProfile();
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
         vl_type *visited_array = vl->mass;
         vl_type visited_array_tag = vl->curV;
@@ -252,7 +424,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
             tableint curNodeNum = curr_el_pair.second;
 
-            std::unique_lock <std::mutex> lock(link_list_locks_[curNodeNum]);
+            std::unique_lock <link_list_mutex_t> lock(link_list_locks_[curNodeNum], std::defer_lock);
+            lockProfiled(lock, profile, BUILD_WAIT_LINK_LIST);
 
             int *data;  // = (int *)(linkList0_ + curNodeNum * size_links_per_element0_);
             if (layer == 0) {
@@ -313,7 +486,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         const void *data_point,
         size_t ef,
         BaseFilterFunctor* isIdAllowed = nullptr,
-        BaseSearchStopCondition<dist_t>* stop_condition = nullptr) const {
+        BaseSearchStopCondition<dist_t>* stop_condition = nullptr,
+        SearchStats* stats = nullptr) const {
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
         vl_type *visited_array = vl->mass;
         vl_type visited_array_tag = vl->curV;
@@ -338,6 +512,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         visited_array[ep_id] = visited_array_tag;
+        if (collect_metrics && stats) {
+            stats->visited_nodes++;
+        }
 
         while (!candidate_set.empty()) {
             std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
@@ -365,6 +542,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             if (collect_metrics) {
                 metric_hops++;
                 metric_distance_computations+=size;
+                if (stats) stats->base_hops++;
             }
 
 #ifdef USE_SSE
@@ -387,6 +565,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
                     char *currObj1 = (getDataByInternalId(candidate_id));
                     dist_t dist = fstdistfunc_(data_point, currObj1, dist_func_param_);
+                    if (collect_metrics && stats) {
+                        stats->visited_nodes++;
+                        stats->base_distance_computations++;
+                    }
 
                     bool flag_consider_candidate;
                     if (!bare_bone_search && stop_condition) {
@@ -409,6 +591,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                             if (!bare_bone_search && stop_condition) {
                                 stop_condition->add_point_to_result(getExternalLabel(candidate_id), currObj1, dist);
                             }
+                        } else if (collect_metrics && stats) {
+                            stats->filter_rejects++;
                         }
 
                         bool flag_remove_extra = false;
@@ -509,8 +693,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> &top_candidates,
         int level,
         bool isUpdate) {
+        BuildProfileCounts *profile = currentBuildProfile();
         size_t Mcurmax = level ? maxM_ : maxM0_;
-        getNeighborsByHeuristic2(top_candidates, M_);
+        {
+            BuildPhaseTimer timer(profile, BUILD_SELECT_NEIGHBORS);
+            getNeighborsByHeuristic2(top_candidates, M_);
+        }
         if (top_candidates.size() > M_)
             throw std::runtime_error("Should be not be more than M_ candidates returned by the heuristic");
 
@@ -526,9 +714,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         {
             // lock only during the update
             // because during the addition the lock for cur_c is already acquired
-            std::unique_lock <std::mutex> lock(link_list_locks_[cur_c], std::defer_lock);
+            std::unique_lock <link_list_mutex_t> lock(link_list_locks_[cur_c], std::defer_lock);
             if (isUpdate) {
-                lock.lock();
+                lockProfiled(lock, profile, BUILD_WAIT_LINK_LIST);
             }
             linklistsizeint *ll_cur;
             if (level == 0)
@@ -552,7 +740,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-            std::unique_lock <std::mutex> lock(link_list_locks_[selectedNeighbors[idx]]);
+            std::unique_lock <link_list_mutex_t> lock(link_list_locks_[selectedNeighbors[idx]], std::defer_lock);
+            lockProfiled(lock, profile, BUILD_WAIT_LINK_LIST);
 
             linklistsizeint *ll_other;
             if (level == 0)
@@ -587,6 +776,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                     data[sz_link_list_other] = cur_c;
                     setListCount(ll_other, sz_link_list_other + 1);
                 } else {
+                    BuildPhaseTimer timer(profile, BUILD_PRUNE);
                     // finding the "weakest" element to replace it with the new one
                     dist_t d_max = fstdistfunc_(getDataByInternalId(cur_c), getDataByInternalId(selectedNeighbors[idx]),
                                                 dist_func_param_);
@@ -638,7 +828,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         element_levels_.resize(new_max_elements);
 
-        std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
+        std::vector<link_list_mutex_t>(new_max_elements).swap(link_list_locks_);
 
         // Reallocate base layer
         char * data_level0_memory_new = (char *) realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
@@ -748,6 +938,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
         dist_func_param_ = s->get_dist_func_param();
+        space_ = s;
 
         auto pos = input.tellg();
 
@@ -782,8 +973,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
 
         size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
-        std::vector<std::mutex>(max_elements).swap(link_list_locks_);
-        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+        std::vector<link_list_mutex_t>(max_elements).swap(link_list_locks_);
+        std::vector<label_op_mutex_t>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
 
         visited_list_pool_.reset(new VisitedListPool(1, max_elements));
 
@@ -822,12 +1013,33 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    /*
+    * Resolves count labels under one lock. ids[i] receives the internal id of labels[i],
+    * or -1 when the label is unknown or deleted. Returns the number of labels found.
+    */
+    template<typename label_t>
+    size_t getInternalIds(const label_t *labels, size_t count, tableint *ids) const {
+        size_t found = 0;
+        std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock);
+        for (size_t i = 0; i < count; i++) {
+            auto search = label_lookup_.find((labeltype) labels[i]);
+            if (search == label_lookup_.end() || isMarkedDeleted(search->second)) {
+                ids[i] = (tableint) -1;
+            } else {
+                ids[i] = search->second;
+                found++;
+            }
+        }
+        return found;
+    }
+
+
     template<typename data_t>
     std::vector<data_t> getDataByLabel(labeltype label) const {
         // lock all operations with element by label
-        std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
+        std::unique_lock <label_op_mutex_t> lock_label(getLabelOpMutex(label));
         
-        std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+        std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock);
         auto search = label_lookup_.find(label);
         if (search == label_lookup_.end() || isMarkedDeleted(search->second)) {
             throw std::runtime_error("Label not found");
@@ -852,9 +1064,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     */
     void markDelete(labeltype label) {
         // lock all operations with element by label
-        std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
+        std::unique_lock <label_op_mutex_t> lock_label(getLabelOpMutex(label));
 
-        std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+        std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock);
         auto search = label_lookup_.find(label);
         if (search == label_lookup_.end()) {
             throw std::runtime_error("Label not found");
@@ -877,7 +1089,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             *ll_cur |= DELETE_MARK;
             num_deleted_ += 1;
             if (allow_replace_deleted_) {
-                std::unique_lock <std::mutex> lock_deleted_elements(deleted_elements_lock);
+                std::unique_lock <deleted_elements_mutex_t> lock_deleted_elements(deleted_elements_lock);
                 deleted_elements.insert(internalId);
             }
         } else {
@@ -894,9 +1106,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     */
     void unmarkDelete(labeltype label) {
         // lock all operations with element by label
-        std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
+        std::unique_lock <label_op_mutex_t> lock_label(getLabelOpMutex(label));
 
-        std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+        std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock);
         auto search = label_lookup_.find(label);
         if (search == label_lookup_.end()) {
             throw std::runtime_error("Label not found");
@@ -919,7 +1131,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             *ll_cur &= ~DELETE_MARK;
             num_deleted_ -= 1;
             if (allow_replace_deleted_) {
-                std::unique_lock <std::mutex> lock_deleted_elements(deleted_elements_lock);
+                std::unique_lock <deleted_elements_mutex_t> lock_deleted_elements(deleted_elements_lock);
                 deleted_elements.erase(internalId);
             }
         } else {
@@ -949,22 +1161,45 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     /*
     * Adds point. Updates the point if it is already in the index.
-    * If replacement of deleted elements is enabled: replaces previously deleted point if any, updating it with new point
+    * If replacement of deleted elements is enabled: replaces previously deleted point if any, updating it with new point.
+    * A deleted point with the same label takes precedence, so deleting and re-adding a label reuses its slot.
     */
     void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
         if ((allow_replace_deleted_ == false) && (replace_deleted == true)) {
             throw std::runtime_error("Replacement of deleted elements is disabled in constructor");
         }
+        BuildPhaseTimer insert_timer(currentBuildProfile(), BUILD_INSERT);
 
         // lock all operations with element by label
-        std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
+        std::unique_lock <label_op_mutex_t> lock_label(getLabelOpMutex(label));
         if (!replace_deleted) {
             addPoint(data_point, label, -1);
             return;
         }
-        // check if there is vacant place
+        // a label still in the graph keeps its slot: a live one is updated, a deleted one
+        // is claimed back before a concurrent replacement can hand it to another label
         tableint internal_id_replaced;
-        std::unique_lock <std::mutex> lock_deleted_elements(deleted_elements_lock);
+        bool label_exists;
+        {
+            std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock);
+            auto search = label_lookup_.find(label);
+            label_exists = search != label_lookup_.end();
+            if (label_exists) internal_id_replaced = search->second;
+        }
+        if (label_exists && !isMarkedDeleted(internal_id_replaced)) {
+            addPoint(data_point, label, -1);
+            return;
+        }
+        std::unique_lock <deleted_elements_mutex_t> lock_deleted_elements(deleted_elements_lock);
+        if (label_exists && getExternalLabel(internal_id_replaced) == label &&
+            deleted_elements.erase(internal_id_replaced)) {
+            lock_deleted_elements.unlock();
+            unmarkDeletedInternal(internal_id_replaced);
+            updatePoint(data_point, internal_id_replaced, 1.0);
+            return;
+        }
+
+        // check if there is vacant place
         bool is_vacant_place = !deleted_elements.empty();
         if (is_vacant_place) {
             internal_id_replaced = *deleted_elements.begin();
@@ -981,8 +1216,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             labeltype label_replaced = getExternalLabel(internal_id_replaced);
             setExternalLabel(internal_id_replaced, label);
 
-            std::unique_lock <std::mutex> lock_table(label_lookup_lock);
-            label_lookup_.erase(label_replaced);
+            // the replaced label may have moved to another slot meanwhile, that mapping stays
+            std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock);
+            auto replaced = label_lookup_.find(label_replaced);
+            if (replaced != label_lookup_.end() && replaced->second == internal_id_replaced)
+                label_lookup_.erase(replaced);
             label_lookup_[label] = internal_id_replaced;
             lock_table.unlock();
 
@@ -993,11 +1231,17 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     void updatePoint(const void *dataPoint, tableint internalId, float updateNeighborProbability) {
-        // update the feature vector associated with existing point with new vector
-        memcpy(getDataByInternalId(internalId), dataPoint, data_size_);
+        // update the feature vector associated with existing point with new vector,
+        // then search with the stored copy, which the space may have transformed
+        space_->storeVector(getDataByInternalId(internalId), dataPoint);
+        dataPoint = getDataByInternalId(internalId);
 
         int maxLevelCopy = maxlevel_;
         tableint entryPointCopy = enterpoint_node_;
+        if (flat_ && cur_element_count > 1) {
+            dist_t start_dist;
+            entryPointCopy = startElement(dataPoint, start_dist);
+        }
         // If point to be updated is entry point and graph just contains single element then just return.
         if (entryPointCopy == internalId && cur_element_count == 1)
             return;
@@ -1053,7 +1297,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 getNeighborsByHeuristic2(candidates, layer == 0 ? maxM0_ : maxM_);
 
                 {
-                    std::unique_lock <std::mutex> lock(link_list_locks_[neigh]);
+                    std::unique_lock <link_list_mutex_t> lock(link_list_locks_[neigh]);
                     linklistsizeint *ll_cur;
                     ll_cur = get_linklist_at_level(neigh, layer);
                     size_t candSize = candidates.size();
@@ -1085,7 +1329,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 while (changed) {
                     changed = false;
                     unsigned int *data;
-                    std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                    std::unique_lock <link_list_mutex_t> lock(link_list_locks_[currObj]);
                     data = get_linklist_at_level(currObj, level);
                     int size = getListCount(data);
                     tableint *datal = (tableint *) (data + 1);
@@ -1140,7 +1384,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     std::vector<tableint> getConnectionsWithLock(tableint internalId, int level) {
-        std::unique_lock <std::mutex> lock(link_list_locks_[internalId]);
+        std::unique_lock <link_list_mutex_t> lock(link_list_locks_[internalId]);
         unsigned int *data = get_linklist_at_level(internalId, level);
         int size = getListCount(data);
         std::vector<tableint> result(size);
@@ -1151,11 +1395,14 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     tableint addPoint(const void *data_point, labeltype label, int level) {
+        BuildProfileCounts *profile = currentBuildProfile();
         tableint cur_c = 0;
+        std::unique_lock <link_list_mutex_t> lock_el;
         {
             // Checking if the element with the same label already exists
             // if so, updating it *instead* of creating a new element.
-            std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+            std::unique_lock <label_lookup_mutex_t> lock_table(label_lookup_lock, std::defer_lock);
+            lockProfiled(lock_table, profile, BUILD_WAIT_LABEL_LOOKUP);
             auto search = label_lookup_.find(label);
             if (search != label_lookup_.end()) {
                 tableint existingInternalId = search->second;
@@ -1178,19 +1425,23 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 throw std::runtime_error("The number of elements exceeds the specified limit");
             }
 
+            // the new element is locked before the count makes it visible, so pickRouters
+            // waits for its memory and links instead of reading them half-written
             cur_c = cur_element_count;
+            lock_el = std::unique_lock <link_list_mutex_t>(link_list_locks_[cur_c], std::defer_lock);
+            lockProfiled(lock_el, profile, BUILD_WAIT_LINK_LIST);
             cur_element_count++;
             label_lookup_[label] = cur_c;
         }
 
-        std::unique_lock <std::mutex> lock_el(link_list_locks_[cur_c]);
-        int curlevel = getRandomLevel(mult_);
-        if (level > 0)
+        int curlevel = flat_ ? 0 : getRandomLevel(mult_);
+        if (level > 0 && !flat_)
             curlevel = level;
 
         element_levels_[cur_c] = curlevel;
 
-        std::unique_lock <std::mutex> templock(global);
+        std::unique_lock <global_mutex_t> templock(global, std::defer_lock);
+        lockProfiled(templock, profile, BUILD_WAIT_GLOBAL);
         int maxlevelcopy = maxlevel_;
         if (curlevel <= maxlevelcopy)
             templock.unlock();
@@ -1201,7 +1452,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         // Initialisation of the data and label
         memcpy(getExternalLabeLp(cur_c), &label, sizeof(labeltype));
-        memcpy(getDataByInternalId(cur_c), data_point, data_size_);
+        space_->storeVector(getDataByInternalId(cur_c), data_point);
+        data_point = getDataByInternalId(cur_c);
 
         if (curlevel) {
             linkLists_[cur_c] = (char *) malloc(size_links_per_element_ * curlevel + 1);
@@ -1211,14 +1463,21 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
 
         if ((signed)currObj != -1) {
+            if (flat_) {
+                BuildPhaseTimer timer(profile, BUILD_UPPER_DESCENT);
+                dist_t start_dist;
+                currObj = startElement(data_point, start_dist);
+            }
             if (curlevel < maxlevelcopy) {
+                BuildPhaseTimer timer(profile, BUILD_UPPER_DESCENT);
                 dist_t curdist = fstdistfunc_(data_point, getDataByInternalId(currObj), dist_func_param_);
                 for (int level = maxlevelcopy; level > curlevel; level--) {
                     bool changed = true;
                     while (changed) {
                         changed = false;
                         unsigned int *data;
-                        std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                        std::unique_lock <link_list_mutex_t> lock(link_list_locks_[currObj], std::defer_lock);
+                        lockProfiled(lock, profile, BUILD_WAIT_LINK_LIST);
                         data = get_linklist(currObj, level);
                         int size = getListCount(data);
 
@@ -1243,8 +1502,11 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 if (level > maxlevelcopy || level < 0)  // possible?
                     throw std::runtime_error("Level error");
 
-                std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates = searchBaseLayer(
-                        currObj, data_point, level);
+                std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+                {
+                    BuildPhaseTimer timer(profile, BUILD_SEARCH_BASE_LAYER);
+                    top_candidates = searchBaseLayer(currObj, data_point, level);
+                }
                 if (epDeleted) {
                     top_candidates.emplace(fstdistfunc_(data_point, getDataByInternalId(enterpoint_copy), dist_func_param_), enterpoint_copy);
                     if (top_candidates.size() > ef_construction_)
@@ -1263,17 +1525,46 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             enterpoint_node_ = cur_c;
             maxlevel_ = curlevel;
         }
+        if (templock.owns_lock())
+            templock.unlock();
+        if (flat_ && cur_element_count > 2 * routers_built_at_) {
+            lock_el.unlock();  // pickRouters takes the link locks of the sample
+            pickRouters(false);
+        }
         return cur_c;
     }
 
 
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        return searchKnnImpl<false>(query_data, k, isIdAllowed, nullptr);
+    }
+
+
+    /*
+    * Same as searchKnn, but also reports how much work the query took. Counting
+    * happens in a separate instantiation of the search, so searchKnn pays nothing.
+    */
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnWithStats(const void *query_data, size_t k, SearchStats &stats,
+                       BaseFilterFunctor* isIdAllowed = nullptr) const {
+        stats = SearchStats();
+        auto start = std::chrono::steady_clock::now();
+        std::priority_queue<std::pair<dist_t, labeltype >> result = searchKnnImpl<true>(query_data, k, isIdAllowed, &stats);
+        stats.wall_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+
+    template <bool collect_metrics>
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnnImpl(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed, SearchStats* stats) const {
         std::priority_queue<std::pair<dist_t, labeltype >> result;
         if (cur_element_count == 0) return result;
 
-        tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        dist_t curdist;
+        tableint currObj = startElement(query_data, curdist);
 
         for (int level = maxlevel_; level > 0; level--) {
             bool changed = true;
@@ -1285,6 +1576,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 int size = getListCount(data);
                 metric_hops++;
                 metric_distance_computations+=size;
+                if (collect_metrics) {
+                    stats->upper_hops++;
+                    stats->upper_distance_computations += size;
+                }
 
                 tableint *datal = (tableint *) (data + 1);
                 for (int i = 0; i < size; i++) {
@@ -1301,15 +1596,18 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 }
             }
         }
+        if (collect_metrics) {
+            stats->upper_distance_computations += flat_ ? router_count_ + 1 : 1;  // the entry point or routers
+        }
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         bool bare_bone_search = !num_deleted_ && !isIdAllowed;
         if (bare_bone_search) {
-            top_candidates = searchBaseLayerST<true>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            top_candidates = searchBaseLayerST<true, collect_metrics>(
+                    currObj, query_data, std::max(ef_, k), isIdAllowed, nullptr, stats);
         } else {
-            top_candidates = searchBaseLayerST<false>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+            top_candidates = searchBaseLayerST<false, collect_metrics>(
+                    currObj, query_data, std::max(ef_, k), isIdAllowed, nullptr, stats);
         }
 
         while (top_candidates.size() > k) {
@@ -1332,8 +1630,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         std::vector<std::pair<dist_t, labeltype >> result;
         if (cur_element_count == 0) return result;
 
-        tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        dist_t curdist;
+        tableint currObj = startElement(query_data, curdist);
 
         for (int level = maxlevel_; level > 0; level--) {
             bool changed = true;
@@ -1368,7 +1666,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_t sz = top_candidates.size();
         result.resize(sz);
         while (!top_candidates.empty()) {
-            result[--sz] = top_candidates.top();
+            result[--sz] = std::make_pair(top_candidates.top().first, getExternalLabel(top_candidates.top().second));
             top_candidates.pop();
         }
 
@@ -1408,5 +1706,151 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         }
         std::cout << "integrity ok, checked " << connections_checked << " connections\n";
     }
+
+
+    /*
+    * Computes GraphStats using `num_threads` threads (0 = hardware concurrency).
+    * Navigability searches for the vectors of up to `navigability_samples` live nodes,
+    * evenly spread over the internal ids, with the current ef.
+    * Must not run concurrently with addPoint; concurrent searches are fine.
+    */
+    GraphStats graphStats(size_t navigability_samples = 1000, size_t num_threads = 0) const {
+        GraphStats stats;
+        size_t n = cur_element_count;
+        stats.num_elements = n;
+        stats.num_deleted = num_deleted_;
+        if (n == 0) return stats;
+        if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        num_threads = std::min(num_threads, n);
+
+        int num_levels = maxlevel_ + 1;
+        stats.nodes_per_level.assign(num_levels, 0);
+        stats.out_degree_histogram.resize(num_levels);
+        stats.in_degree_histogram.resize(num_levels);
+
+        // per thread partial results, merged after each parallel pass
+        struct Partial {
+            size_t nodes = 0;
+            std::vector<size_t> out_hist;
+            size_t edges = 0;
+            size_t edges_to_deleted = 0;
+            double edge_length_sum = 0;
+            size_t found = 0;
+        };
+        std::vector<std::atomic<unsigned int>> in_degree(n);
+
+        for (int level = 0; level < num_levels; level++) {
+            size_t max_degree = level == 0 ? maxM0_ : maxM_;
+            for (size_t i = 0; i < n; i++) in_degree[i] = 0;
+            std::vector<Partial> partials(num_threads);
+
+            parallelRange(n, num_threads, [&](size_t begin, size_t end, size_t thread_id) {
+                Partial &p = partials[thread_id];
+                p.out_hist.assign(max_degree + 1, 0);
+                for (size_t i = begin; i < end; i++) {
+                    if (element_levels_[i] < level) continue;
+                    p.nodes++;
+                    linklistsizeint *ll = get_linklist_at_level((tableint) i, level);
+                    size_t size = getListCount(ll);
+                    tableint *data = (tableint *) (ll + 1);
+                    p.out_hist[std::min(size, max_degree)]++;
+                    p.edges += size;
+                    char *point = getDataByInternalId((tableint) i);
+                    for (size_t j = 0; j < size; j++) {
+                        in_degree[data[j]].fetch_add(1, std::memory_order_relaxed);
+                        if (isMarkedDeleted(data[j])) p.edges_to_deleted++;
+                        if (level == 0)
+                            p.edge_length_sum += fstdistfunc_(point, getDataByInternalId(data[j]), dist_func_param_);
+                    }
+                }
+            });
+
+            stats.out_degree_histogram[level].assign(max_degree + 1, 0);
+            stats.in_degree_histogram[level].assign(max_degree + 1, 0);
+            double edge_length_sum = 0;
+            size_t level_edges = 0;
+            for (Partial &p : partials) {
+                stats.nodes_per_level[level] += p.nodes;
+                for (size_t d = 0; d <= max_degree; d++)
+                    stats.out_degree_histogram[level][d] += p.out_hist[d];
+                level_edges += p.edges;
+                stats.edges_to_deleted += p.edges_to_deleted;
+                edge_length_sum += p.edge_length_sum;
+            }
+            stats.total_edges += level_edges;
+            if (level == 0 && level_edges > 0)
+                stats.avg_edge_length = edge_length_sum / level_edges;
+            for (size_t i = 0; i < n; i++) {
+                if (element_levels_[i] >= level)
+                    stats.in_degree_histogram[level][std::min<size_t>(in_degree[i], max_degree)]++;
+            }
+        }
+        if (stats.total_edges > 0)
+            stats.deleted_edge_fraction = (double) stats.edges_to_deleted / stats.total_edges;
+
+        // breadth first search over level 0, the layer every search ends on
+        std::vector<bool> reached(n, false);
+        std::vector<tableint> frontier;
+        frontier.push_back(enterpoint_node_);
+        reached[enterpoint_node_] = true;
+        size_t reached_live = 0;
+        while (!frontier.empty()) {
+            tableint cur = frontier.back();
+            frontier.pop_back();
+            if (!isMarkedDeleted(cur)) reached_live++;
+            linklistsizeint *ll = get_linklist0(cur);
+            size_t size = getListCount(ll);
+            tableint *data = (tableint *) (ll + 1);
+            for (size_t j = 0; j < size; j++) {
+                if (!reached[data[j]]) {
+                    reached[data[j]] = true;
+                    frontier.push_back(data[j]);
+                }
+            }
+        }
+        stats.unreachable_nodes = (n - num_deleted_) - reached_live;
+
+        if (navigability_samples > 0) {
+            std::vector<tableint> samples;
+            size_t step = std::max<size_t>(1, n / navigability_samples);
+            for (size_t i = 0; i < n && samples.size() < navigability_samples; i += step) {
+                if (!isMarkedDeleted((tableint) i)) samples.push_back((tableint) i);
+            }
+            size_t sample_threads = std::max<size_t>(1, std::min(num_threads, samples.size()));
+            std::vector<Partial> partials(sample_threads);
+            parallelRange(samples.size(), sample_threads, [&](size_t begin, size_t end, size_t thread_id) {
+                for (size_t i = begin; i < end; i++) {
+                    tableint id = samples[i];
+                    std::priority_queue<std::pair<dist_t, labeltype>> result = searchKnn(getDataByInternalId(id), 1);
+                    if (!result.empty() && result.top().second == getExternalLabel(id))
+                        partials[thread_id].found++;
+                }
+            });
+            size_t found = 0;
+            for (Partial &p : partials) found += p.found;
+            stats.navigability_samples = samples.size();
+            if (!samples.empty())
+                stats.navigability = (double) found / samples.size();
+        }
+        return stats;
+    }
+
+ private:
+    // Runs fn(begin, end, thread_id) on num_threads contiguous slices of [0, n)
+    template<class Function>
+    static void parallelRange(size_t n, size_t num_threads, Function fn) {
+        if (num_threads <= 1 || n <= 1) {
+            fn(0, n, 0);
+            return;
+        }
+        std::vector<std::thread> threads;
+        size_t chunk = (n + num_threads - 1) / num_threads;
+        for (size_t t = 0; t < num_threads; t++) {
+            size_t begin = std::min(n, t * chunk);
+            size_t end = std::min(n, begin + chunk);
+            threads.push_back(std::thread(fn, begin, end, t));
+        }
+        for (auto &thread : threads) thread.join();
+    }
 };
 }  // namespace hnswlib
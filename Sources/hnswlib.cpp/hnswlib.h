@@ -180,6 +180,11 @@ class SpaceInterface {
 
     virtual void *get_dist_func_param() = 0;
 
+    // Writes an inserted vector into its slot; spaces that store a transformed vector override it
+    virtual void storeVector(void *dst, const void *src) {
+        memcpy(dst, src, get_data_size());
+    }
+
     virtual ~SpaceInterface() {}
 };
 
@@ -223,6 +228,14 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(const void* query_data, size_t
 
 #include "space_l2.h"
 #include "space_ip.h"
+#include "space_quantized.h"
+#include "space_sparse.h"
+#include "histogram.h"
 #include "stop_condition.h"
+#include "late_interaction.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
+#include "sharded_index.h"
+#include "partitioned_index.h"
+#include "tiered_index.h"
+#include "autotune.h"
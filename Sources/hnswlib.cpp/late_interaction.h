@@ -0,0 +1,125 @@
+#pragma once
+
+#include <limits>
+
+namespace hnswlib {
+
+/*
+* Squared L2 distances (l2 = true) or inner products of one vector `v` with four
+* others, written to out[0..3]. Each block of `v` is loaded once for all four,
+* so scoring a document vector against many query vectors needs a quarter of the loads.
+*/
+template<bool l2>
+static void
+DistanceBatch4(const float *v, const float *const *q, size_t qty, float *out) {
+    size_t i = 0;
+    float sum[4];
+#if defined(USE_AVX)
+    __m256 sum256[4] = {_mm256_set1_ps(0), _mm256_set1_ps(0), _mm256_set1_ps(0), _mm256_set1_ps(0)};
+    for (; i + 8 <= qty; i += 8) {
+        __m256 x = _mm256_loadu_ps(v + i);
+        for (size_t j = 0; j < 4; j++) {
+            __m256 y = _mm256_loadu_ps(q[j] + i);
+            if (l2) {
+                __m256 diff = _mm256_sub_ps(x, y);
+                sum256[j] = _mm256_add_ps(sum256[j], _mm256_mul_ps(diff, diff));
+            } else {
+                sum256[j] = _mm256_add_ps(sum256[j], _mm256_mul_ps(x, y));
+            }
+        }
+    }
+    float PORTABLE_ALIGN32 TmpRes[8];
+    for (size_t j = 0; j < 4; j++) {
+        _mm256_store_ps(TmpRes, sum256[j]);
+        sum[j] = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+    }
+#elif defined(USE_SSE)
+    __m128 sum128[4] = {_mm_set1_ps(0), _mm_set1_ps(0), _mm_set1_ps(0), _mm_set1_ps(0)};
+    for (; i + 4 <= qty; i += 4) {
+        __m128 x = _mm_loadu_ps(v + i);
+        for (size_t j = 0; j < 4; j++) {
+            __m128 y = _mm_loadu_ps(q[j] + i);
+            if (l2) {
+                __m128 diff = _mm_sub_ps(x, y);
+                sum128[j] = _mm_add_ps(sum128[j], _mm_mul_ps(diff, diff));
+            } else {
+                sum128[j] = _mm_add_ps(sum128[j], _mm_mul_ps(x, y));
+            }
+        }
+    }
+    float PORTABLE_ALIGN32 TmpRes[8];
+    for (size_t j = 0; j < 4; j++) {
+        _mm_store_ps(TmpRes, sum128[j]);
+        sum[j] = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+    }
+#else
+    sum[0] = sum[1] = sum[2] = sum[3] = 0.0f;
+#endif
+    for (; i < qty; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            float t = l2 ? v[i] - q[j][i] : v[i] * q[j][i];
+            sum[j] += l2 ? t * t : t;
+        }
+    }
+    for (size_t j = 0; j < 4; j++)
+        out[j] = sum[j];
+}
+
+/*
+* Late-interaction (MaxSim) scoring of multi-vector documents. The distance of a
+* document is the sum, over the query vectors, of the distance to the closest vector
+* of the document. With inner product distances (1 - dot) this is the number of query
+* vectors minus the ColBERT sum-of-max similarity, so both rank documents the same.
+* Not thread safe, use one scorer per thread.
+*/
+class LateInteractionScorer {
+    bool l2_;
+    size_t dim_;
+    const float *queries_;
+    size_t num_queries_;
+    std::vector<const float *> query_ptrs_;  // padded to a multiple of 4 with the last query
+    std::vector<float> best_;
+
+ public:
+    LateInteractionScorer(bool l2, size_t dim)
+        : l2_(l2), dim_(dim), queries_(nullptr), num_queries_(0) {}
+
+    // `queries` holds num_queries vectors of dim floats and must outlive the scoring
+    void setQuery(const float *queries, size_t num_queries) {
+        queries_ = queries;
+        num_queries_ = num_queries;
+        query_ptrs_.resize((num_queries + 3) / 4 * 4);
+        for (size_t i = 0; i < query_ptrs_.size(); i++)
+            query_ptrs_[i] = queries + std::min(i, num_queries - 1) * dim_;
+        best_.resize(query_ptrs_.size());
+    }
+
+    // Distance of the document made of the num_vectors vectors in `vectors`
+    float score(const float *const *vectors, size_t num_vectors) {
+        if (num_vectors == 0 || num_queries_ == 0) return std::numeric_limits<float>::infinity();
+        std::fill(best_.begin(), best_.end(), std::numeric_limits<float>::max());
+
+        // every document vector is read once and meets all query vectors while in L1
+        float dist[4];
+        for (size_t v = 0; v < num_vectors; v++) {
+            for (size_t q = 0; q < query_ptrs_.size(); q += 4) {
+                if (l2_) {
+                    DistanceBatch4<true>(vectors[v], &query_ptrs_[q], dim_, dist);
+                } else {
+                    DistanceBatch4<false>(vectors[v], &query_ptrs_[q], dim_, dist);
+                }
+                for (size_t j = 0; j < 4; j++) {
+                    float d = l2_ ? dist[j] : 1.0f - dist[j];
+                    if (d < best_[q + j]) best_[q + j] = d;
+                }
+            }
+        }
+
+        float total = 0;
+        for (size_t q = 0; q < num_queries_; q++)
+            total += best_[q];
+        return total;
+    }
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace hnswlib {
+
+// The mutexes of HierarchicalNSW, grouped by role
+enum LockKind {
+    LOCK_GLOBAL,            // global, held while the entry point / max level may change
+    LOCK_LABEL_OP,          // label_op_locks_
+    LOCK_LABEL_LOOKUP,      // label_lookup_lock
+    LOCK_LINK_LIST,         // link_list_locks_
+    LOCK_DELETED_ELEMENTS,  // deleted_elements_lock
+    LOCK_KIND_COUNT
+};
+
+static inline const char *lockKindName(int kind) {
+    static const char *names[LOCK_KIND_COUNT] = {
+        "global", "label_op", "label_lookup", "link_list", "deleted_elements"
+    };
+    return names[kind];
+}
+
+struct LockStatsSnapshot {
+    uint64_t acquisitions;
+    uint64_t contended;  // acquisitions that had to wait
+    uint64_t wait_ns;    // total time spent waiting
+};
+
+#ifdef HNSWLIB_LOCK_STATS
+
+/*
+* Process wide wait counters for each LockKind. They are only collected when
+* hnswlib is compiled with HNSWLIB_LOCK_STATS, otherwise the locks are plain
+* std::mutex and cost nothing.
+*/
+class LockStats {
+    struct Counters {
+        std::atomic<uint64_t> acquisitions;
+        std::atomic<uint64_t> contended;
+        std::atomic<uint64_t> wait_ns;
+    };
+
+    static Counters *counters() {
+        static Counters c[LOCK_KIND_COUNT];
+        return c;
+    }
+
+ public:
+    static void record(int kind, bool contended, uint64_t wait_ns) {
+        Counters &c = counters()[kind];
+        c.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (contended) {
+            c.contended.fetch_add(1, std::memory_order_relaxed);
+            c.wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        }
+    }
+
+    static LockStatsSnapshot get(int kind) {
+        Counters &c = counters()[kind];
+        LockStatsSnapshot s;
+        s.acquisitions = c.acquisitions.load();
+        s.contended = c.contended.load();
+        s.wait_ns = c.wait_ns.load();
+        return s;
+    }
+
+    static void reset() {
+        for (int i = 0; i < LOCK_KIND_COUNT; i++) {
+            counters()[i].acquisitions = 0;
+            counters()[i].contended = 0;
+            counters()[i].wait_ns = 0;
+        }
+    }
+};
+
+/*
+* std::mutex that measures how long lock() blocks. The uncontended path is a
+* single try_lock, so the clock is only read when a thread actually waits.
+*/
+template<int kind>
+class StatsMutex {
+    std::mutex mutex_;
+
+ public:
+    void lock() {
+        if (mutex_.try_lock()) {
+            LockStats::record(kind, false, 0);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        mutex_.lock();
+        auto waited = std::chrono::steady_clock::now() - start;
+        LockStats::record(kind, true, std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+    }
+
+    bool try_lock() {
+        return mutex_.try_lock();
+    }
+
+    void unlock() {
+        mutex_.unlock();
+    }
+};
+
+template<int kind>
+struct LockType {
+    typedef StatsMutex<kind> type;
+};
+
+#else
+
+template<int kind>
+struct LockType {
+    typedef std::mutex type;
+};
+
+#endif
+
+}  // namespace hnswlib
@@ -0,0 +1,448 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace hnswlib {
+
+/*
+* IVF-style index: k-means partitions, each backed by its own HierarchicalNSW.
+* A query first scans the centroid table and then searches only the nprobe closest
+* partitions, so it touches a small fraction of the stored vectors. Points close to
+* a partition boundary can be stored in up to max_replicas partitions, which keeps
+* recall up at a small nprobe. Vectors are float, as in every space of this library.
+*/
+template<typename dist_t>
+class PartitionedIndex : public AlgorithmInterface<dist_t> {
+    static const uint64_t FILE_MAGIC = 0x3154504656495748ULL;  // "HWIVFPT1"
+    static const size_t ROUTE_CHUNK = 1024;  // rows per pool task when routing a batch
+
+    DISTFUNC<dist_t> fstdistfunc_;
+    void *dist_func_param_;
+    size_t dim_;
+    std::vector<float> centroids_;  // num partitions x dim_, empty until trained
+    std::vector<HierarchicalNSW<dist_t> *> partitions_;
+    size_t nprobe_;
+    size_t max_replicas_;
+    float boundary_factor_;
+    std::unique_ptr<ThreadPool> pool_;
+    // Directory of the partitions holding a live copy of each label, so that re-adds and
+    // deletes only touch those partitions; rebuilt from the partitions on load
+    std::mutex homes_lock_;
+    std::unordered_map<labeltype, std::vector<uint32_t>> homes_;
+
+    static std::string partitionLocation(const std::string &location, size_t partition) {
+        return location + ".part" + std::to_string(partition);
+    }
+
+    static size_t poolThreads(size_t num_threads) {
+        if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+        // the calling thread takes part in every run
+        return num_threads > 0 ? num_threads - 1 : 0;
+    }
+
+    const float *centroid(size_t partition) const {
+        return &centroids_[partition * dim_];
+    }
+
+    // Distances to all centroids, the closest `count` first
+    std::vector<std::pair<dist_t, size_t>> closestPartitions(const void *point, size_t count) const {
+        std::vector<std::pair<dist_t, size_t>> order(partitions_.size());
+        for (size_t p = 0; p < partitions_.size(); p++)
+            order[p] = std::make_pair(fstdistfunc_(point, centroid(p), dist_func_param_), p);
+        count = std::min(count, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end());
+        order.resize(count);
+        return order;
+    }
+
+    // The closest partition, plus up to max_replicas - 1 others within boundary_factor of it
+    std::vector<size_t> insertPartitions(const void *point) const {
+        std::vector<std::pair<dist_t, size_t>> closest = closestPartitions(point, max_replicas_);
+        std::vector<size_t> targets(1, closest[0].second);
+        dist_t limit = closest[0].first * boundary_factor_;
+        for (size_t i = 1; i < closest.size() && closest[0].first > 0 && closest[i].first <= limit; i++)
+            targets.push_back(closest[i].second);
+        return targets;
+    }
+
+    /*
+    * Records `targets` as the partitions of `label` and returns the partitions that
+    * held a live copy before but are not among them. Needs homes_lock_.
+    */
+    std::vector<uint32_t> moveHome(labeltype label, const std::vector<size_t> &targets) {
+        std::vector<uint32_t> &home = homes_[label];
+        std::vector<uint32_t> stale;
+        for (uint32_t p : home) {
+            if (std::find(targets.begin(), targets.end(), p) == targets.end())
+                stale.push_back(p);
+        }
+        home.assign(targets.begin(), targets.end());
+        return stale;
+    }
+
+    // True if the partition holds the label and it is not marked deleted
+    static bool holdsLive(HierarchicalNSW<dist_t> *partition, labeltype label) {
+        typedef typename HierarchicalNSW<dist_t>::label_lookup_mutex_t lookup_mutex_t;
+        std::unique_lock <lookup_mutex_t> lock_table(partition->label_lookup_lock);
+        auto search = partition->label_lookup_.find(label);
+        bool present = search != partition->label_lookup_.end();
+        tableint internal_id = present ? search->second : 0;
+        lock_table.unlock();
+        return present && !partition->isMarkedDeleted(internal_id);
+    }
+
+    void checkTrained() const {
+        if (centroids_.empty())
+            throw std::runtime_error("The partitioned index must be trained before use");
+    }
+
+ public:
+    PartitionedIndex(
+        SpaceInterface<dist_t> *s,
+        size_t num_partitions,
+        size_t max_elements_per_partition,
+        size_t M = 16,
+        size_t ef_construction = 200,
+        size_t random_seed = 100,
+        bool allow_replace_deleted = false,
+        size_t num_threads = 0)
+        : nprobe_(1), max_replicas_(1), boundary_factor_(1.0f) {
+        if (num_partitions == 0)
+            throw std::runtime_error("A partitioned index needs at least one partition");
+        fstdistfunc_ = s->get_dist_func();
+        dist_func_param_ = s->get_dist_func_param();
+        dim_ = s->get_data_size() / sizeof(float);
+
+        for (size_t i = 0; i < num_partitions; i++) {
+            partitions_.push_back(new HierarchicalNSW<dist_t>(s, max_elements_per_partition, M, ef_construction,
+                                                              random_seed + i, allow_replace_deleted));
+        }
+        pool_.reset(new ThreadPool(poolThreads(num_threads)));
+    }
+
+    /*
+    * Loads an index written by saveIndex, reading the partitions in parallel.
+    * max_elements_per_partition = 0 keeps the saved capacity of each partition.
+    */
+    PartitionedIndex(
+        SpaceInterface<dist_t> *s,
+        const std::string &location,
+        size_t num_threads = 0,
+        size_t max_elements_per_partition = 0,
+        bool allow_replace_deleted = false) {
+        fstdistfunc_ = s->get_dist_func();
+        dist_func_param_ = s->get_dist_func_param();
+        dim_ = s->get_data_size() / sizeof(float);
+
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        uint64_t magic = 0, num_partitions = 0, dim = 0, nprobe = 0, max_replicas = 0;
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, num_partitions);
+        readBinaryPOD(input, dim);
+        readBinaryPOD(input, nprobe);
+        readBinaryPOD(input, max_replicas);
+        readBinaryPOD(input, boundary_factor_);
+        if (!input || magic != FILE_MAGIC || num_partitions == 0)
+            throw std::runtime_error("Not a partitioned index file");
+        if (dim != dim_)
+            throw std::runtime_error("The partitioned index was saved with a different dimension");
+        nprobe_ = nprobe;
+        max_replicas_ = max_replicas;
+        centroids_.resize(num_partitions * dim_);
+        input.read((char *) centroids_.data(), centroids_.size() * sizeof(float));
+        if (!input)
+            throw std::runtime_error("Partitioned index file is truncated");
+
+        pool_.reset(new ThreadPool(poolThreads(num_threads)));
+        partitions_.assign(num_partitions, nullptr);
+        try {
+            pool_->run(num_partitions, [&](size_t i) {
+                partitions_[i] = new HierarchicalNSW<dist_t>(s, partitionLocation(location, i), false,
+                                                             max_elements_per_partition, allow_replace_deleted);
+            });
+        } catch (...) {
+            for (HierarchicalNSW<dist_t> *partition : partitions_) delete partition;
+            throw;
+        }
+        for (size_t p = 0; p < partitions_.size(); p++) {
+            HierarchicalNSW<dist_t> *partition = partitions_[p];
+            for (const auto &entry : partition->label_lookup_) {
+                if (!partition->isMarkedDeleted(entry.second))
+                    homes_[entry.first].push_back((uint32_t) p);
+            }
+        }
+    }
+
+    ~PartitionedIndex() {
+        pool_.reset();
+        for (HierarchicalNSW<dist_t> *partition : partitions_) delete partition;
+    }
+
+    /*
+    * Computes the centroids with k-means (random initial centroids, `iterations` Lloyd
+    * steps) over a training sample of n vectors. The assignment step uses the distance
+    * of the space and runs on the thread pool. Must be called before adding points.
+    */
+    void train(const float *data, size_t n, size_t iterations = 10, size_t random_seed = 100) {
+        size_t k = partitions_.size();
+        if (n < k)
+            throw std::runtime_error("Training needs at least one vector per partition");
+
+        std::mt19937 rng((unsigned int) random_seed);
+        std::vector<size_t> rows(n);
+        for (size_t i = 0; i < n; i++) rows[i] = i;
+        std::shuffle(rows.begin(), rows.end(), rng);
+        std::vector<float> centroids(k * dim_);
+        for (size_t c = 0; c < k; c++)
+            memcpy(&centroids[c * dim_], &data[rows[c] * dim_], dim_ * sizeof(float));
+
+        std::vector<size_t> assignment(n);
+        size_t chunks = (n + ROUTE_CHUNK - 1) / ROUTE_CHUNK;
+        for (size_t iteration = 0; iteration < iterations; iteration++) {
+            pool_->run(chunks, [&](size_t chunk) {
+                size_t end = std::min(n, (chunk + 1) * ROUTE_CHUNK);
+                for (size_t i = chunk * ROUTE_CHUNK; i < end; i++) {
+                    dist_t best = fstdistfunc_(&data[i * dim_], &centroids[0], dist_func_param_);
+                    size_t best_c = 0;
+                    for (size_t c = 1; c < k; c++) {
+                        dist_t d = fstdistfunc_(&data[i * dim_], &centroids[c * dim_], dist_func_param_);
+                        if (d < best) {
+                            best = d;
+                            best_c = c;
+                        }
+                    }
+                    assignment[i] = best_c;
+                }
+            });
+
+            std::vector<double> sums(k * dim_, 0.0);
+            std::vector<size_t> counts(k, 0);
+            for (size_t i = 0; i < n; i++) {
+                size_t c = assignment[i];
+                counts[c]++;
+                for (size_t j = 0; j < dim_; j++)
+                    sums[c * dim_ + j] += data[i * dim_ + j];
+            }
+            for (size_t c = 0; c < k; c++) {
+                if (counts[c] == 0) {
+                    // restart an empty partition from a random training vector
+                    size_t row = rng() % n;
+                    memcpy(&centroids[c * dim_], &data[row * dim_], dim_ * sizeof(float));
+                    continue;
+                }
+                for (size_t j = 0; j < dim_; j++)
+                    centroids[c * dim_ + j] = (float) (sums[c * dim_ + j] / counts[c]);
+            }
+        }
+        centroids_.swap(centroids);
+    }
+
+    bool isTrained() const {
+        return !centroids_.empty();
+    }
+
+    const std::vector<float> &getCentroids() const {
+        return centroids_;
+    }
+
+    size_t numPartitions() const {
+        return partitions_.size();
+    }
+
+    HierarchicalNSW<dist_t> &partition(size_t i) {
+        return *partitions_[i];
+    }
+
+    // Number of partitions a query searches
+    void setNprobe(size_t nprobe) {
+        nprobe_ = std::max<size_t>(1, std::min(nprobe, partitions_.size()));
+    }
+
+    size_t getNprobe() const {
+        return nprobe_;
+    }
+
+    /*
+    * Stores each new point in up to max_replicas partitions: the closest one and any
+    * other whose centroid distance is within boundary_factor times the closest distance
+    * (meant for L2, where distances are non-negative). 1 disables replication.
+    */
+    void setReplication(size_t max_replicas, float boundary_factor) {
+        max_replicas_ = std::max<size_t>(1, std::min(max_replicas, partitions_.size()));
+        boundary_factor_ = boundary_factor;
+    }
+
+    void setEf(size_t ef) {
+        for (HierarchicalNSW<dist_t> *partition : partitions_) partition->setEf(ef);
+    }
+
+    // Stored vectors, replicas included
+    size_t getCurrentElementCount() const {
+        size_t count = 0;
+        for (HierarchicalNSW<dist_t> *partition : partitions_) count += partition->cur_element_count;
+        return count;
+    }
+
+    // Distinct labels stored, deleted ones included, each replicated label counted once
+    size_t getLabelCount() const {
+        std::unordered_set<labeltype> labels;
+        for (HierarchicalNSW<dist_t> *partition : partitions_) {
+            typedef typename HierarchicalNSW<dist_t>::label_lookup_mutex_t lookup_mutex_t;
+            std::unique_lock <lookup_mutex_t> lock_table(partition->label_lookup_lock);
+            for (const auto &entry : partition->label_lookup_) labels.insert(entry.first);
+        }
+        return labels.size();
+    }
+
+    std::vector<size_t> partitionSizes() const {
+        std::vector<size_t> sizes;
+        for (HierarchicalNSW<dist_t> *partition : partitions_) sizes.push_back(partition->cur_element_count);
+        return sizes;
+    }
+
+    /*
+    * A label that is added again may route to other partitions than before; its copies
+    * in partitions it no longer routes to are marked deleted first, so that only the
+    * new vector is found.
+    */
+    void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
+        checkTrained();
+        std::vector<size_t> targets = insertPartitions(data_point);
+        std::vector<uint32_t> stale;
+        {
+            std::unique_lock<std::mutex> lock(homes_lock_);
+            stale = moveHome(label, targets);
+        }
+        for (uint32_t p : stale) {
+            if (holdsLive(partitions_[p], label))
+                partitions_[p]->markDelete(label);
+        }
+        for (size_t p : targets)
+            partitions_[p]->addPoint(data_point, label, replace_deleted);
+    }
+
+    /*
+    * Adds n points: routes them in parallel, then builds every partition on its own
+    * pool thread so that no two threads insert into the same graph. Partitions that
+    * would overflow are resized first. Like addPoint, a re-added label loses its copies
+    * in partitions it no longer routes to; if a label repeats within the batch, its
+    * last row wins. Must not run concurrently with searches.
+    */
+    void addPoints(const float *data, const labeltype *labels, size_t n, bool replace_deleted = false) {
+        checkTrained();
+        std::vector<std::vector<size_t>> targets(n);
+        pool_->run((n + ROUTE_CHUNK - 1) / ROUTE_CHUNK, [&](size_t chunk) {
+            size_t end = std::min(n, (chunk + 1) * ROUTE_CHUNK);
+            for (size_t i = chunk * ROUTE_CHUNK; i < end; i++)
+                targets[i] = insertPartitions(&data[i * dim_]);
+        });
+
+        std::unordered_map<labeltype, size_t> last_row;
+        last_row.reserve(n);
+        for (size_t i = 0; i < n; i++) last_row[labels[i]] = i;
+
+        std::vector<std::vector<size_t>> rows(partitions_.size());
+        std::vector<std::vector<labeltype>> stale(partitions_.size());
+        {
+            std::unique_lock<std::mutex> lock(homes_lock_);
+            for (size_t i = 0; i < n; i++) {
+                if (last_row[labels[i]] != i) continue;
+                for (size_t p : targets[i]) rows[p].push_back(i);
+                for (uint32_t p : moveHome(labels[i], targets[i])) stale[p].push_back(labels[i]);
+            }
+        }
+
+        pool_->run(partitions_.size(), [&](size_t p) {
+            HierarchicalNSW<dist_t> *partition = partitions_[p];
+            for (labeltype label : stale[p]) {
+                if (holdsLive(partition, label))
+                    partition->markDelete(label);
+            }
+            if (rows[p].empty()) return;
+            size_t needed = partition->cur_element_count + rows[p].size();
+            if (needed > partition->max_elements_)
+                partition->resizeIndex(needed);
+            for (size_t i : rows[p])
+                partition->addPoint(&data[i * dim_], labels[i], replace_deleted);
+        });
+    }
+
+    // Marks the label deleted in every partition that holds a copy of it
+    void markDelete(labeltype label) {
+        std::vector<uint32_t> home;
+        {
+            std::unique_lock<std::mutex> lock(homes_lock_);
+            auto search = homes_.find(label);
+            if (search == homes_.end())
+                throw std::runtime_error("Label not found");
+            home.swap(search->second);
+            homes_.erase(search);
+        }
+        for (uint32_t p : home) {
+            if (holdsLive(partitions_[p], label))
+                partitions_[p]->markDelete(label);
+        }
+    }
+
+    std::priority_queue<std::pair<dist_t, labeltype>>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        checkTrained();
+        std::vector<std::pair<dist_t, size_t>> probes = closestPartitions(query_data, nprobe_);
+        std::vector<std::priority_queue<std::pair<dist_t, labeltype>>> partial(probes.size());
+        pool_->run(probes.size(), [&](size_t i) {
+            partial[i] = partitions_[probes[i].second]->searchKnn(query_data, k, isIdAllowed);
+        });
+
+        // replicated points can come back from several partitions, keep each label once
+        std::vector<std::pair<dist_t, labeltype>> candidates;
+        for (auto &partition_result : partial) {
+            while (!partition_result.empty()) {
+                candidates.push_back(partition_result.top());
+                partition_result.pop();
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        std::priority_queue<std::pair<dist_t, labeltype>> result;
+        std::unordered_set<labeltype> seen;
+        for (const std::pair<dist_t, labeltype> &candidate : candidates) {
+            if (result.size() == k) break;
+            if (seen.insert(candidate.second).second)
+                result.push(candidate);
+        }
+        return result;
+    }
+
+    // Writes the centroids to `location` and each partition to `location`.part<i>, in parallel
+    void saveIndex(const std::string &location) {
+        checkTrained();
+        std::ofstream output(location, std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+        uint64_t magic = FILE_MAGIC;
+        writeBinaryPOD(output, magic);
+        writeBinaryPOD(output, (uint64_t) partitions_.size());
+        writeBinaryPOD(output, (uint64_t) dim_);
+        writeBinaryPOD(output, (uint64_t) nprobe_);
+        writeBinaryPOD(output, (uint64_t) max_replicas_);
+        writeBinaryPOD(output, boundary_factor_);
+        output.write((const char *) centroids_.data(), centroids_.size() * sizeof(float));
+        output.close();
+
+        pool_->run(partitions_.size(), [&](size_t i) {
+            partitions_[i]->saveIndex(partitionLocation(location, i));
+        });
+    }
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hnswlib {
+
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+};
+
+struct PerfCounts {
+    uint64_t operations;
+    uint64_t values[PERF_EVENT_COUNT];
+
+    PerfCounts() : operations(0) {
+        memset(values, 0, sizeof(values));
+    }
+
+    void add(const PerfCounts &other) {
+        operations += other.operations;
+        for (int i = 0; i < PERF_EVENT_COUNT; i++)
+            values[i] += other.values[i];
+    }
+};
+
+#if defined(__linux__)
+
+/*
+* Hardware counters of the calling thread, opened as one perf_event group so that
+* all events are scheduled together. User space only, which works with the default
+* perf_event_paranoid setting. Events the CPU or the VM does not expose read as 0;
+* if not even the cycle counter can be opened, available() is false.
+*/
+class PerfCounterGroup {
+    int fds_[PERF_EVENT_COUNT];
+    int slot_[PERF_EVENT_COUNT];  // position of each event in the group read, -1 if not opened
+    int num_opened_;
+
+    static int openEvent(uint32_t type, uint64_t config, int group_fd) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = group_fd == -1 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+
+ public:
+    PerfCounterGroup() : num_opened_(0) {
+        static const uint32_t types[PERF_EVENT_COUNT] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+        };
+        static const uint64_t configs[PERF_EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            fds_[i] = -1;
+            slot_[i] = -1;
+        }
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            int fd = openEvent(types[i], configs[i], i == 0 ? -1 : fds_[0]);
+            if (fd < 0) {
+                if (i == 0) return;
+                continue;
+            }
+            fds_[i] = fd;
+            slot_[i] = num_opened_++;
+        }
+        ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    ~PerfCounterGroup() {
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            if (fds_[i] >= 0) close(fds_[i]);
+        }
+    }
+
+    bool available() const {
+        return fds_[0] >= 0;
+    }
+
+    /*
+    * Current counter values. When the kernel had to multiplex the group, the values
+    * are scaled up by time_enabled / time_running.
+    */
+    PerfCounts read() const {
+        PerfCounts counts;
+        if (!available()) return counts;
+
+        uint64_t buffer[3 + PERF_EVENT_COUNT];
+        ssize_t n = ::read(fds_[0], buffer, sizeof(buffer));
+        if (n < (ssize_t) (3 * sizeof(uint64_t)) || buffer[2] == 0) return counts;
+
+        double scale = (double) buffer[1] / (double) buffer[2];
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            if (slot_[i] >= 0 && (uint64_t) slot_[i] < buffer[0])
+                counts.values[i] = (uint64_t) (buffer[3 + slot_[i]] * scale);
+        }
+        return counts;
+    }
+};
+
+#else
+
+// perf_event_open is Linux only; elsewhere the counters are never available
+class PerfCounterGroup {
+ public:
+    bool available() const {
+        return false;
+    }
+
+    PerfCounts read() const {
+        return PerfCounts();
+    }
+};
+
+#endif
+
+/*
+* The counter group of the calling thread, opened on first use and closed when
+* the thread exits.
+*/
+static inline PerfCounterGroup &threadPerfCounters() {
+    static thread_local PerfCounterGroup group;
+    return group;
+}
+
+/*
+* Adds the counter deltas of its lifetime to `target` as one operation; does nothing
+* if `target` is null.
+*/
+class PerfScope {
+    PerfCounts *target_;
+    PerfCounts start_;
+
+ public:
+    explicit PerfScope(PerfCounts *target) : target_(target) {
+        if (target_) start_ = threadPerfCounters().read();
+    }
+
+    ~PerfScope() {
+        if (!target_) return;
+        PerfCounts end = threadPerfCounters().read();
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            // scaled values of a multiplexed group are estimates and can step back
+            if (end.values[i] > start_.values[i])
+                target_->values[i] += end.values[i] - start_.values[i];
+        }
+        target_->operations++;
+    }
+};
+
+}  // namespace hnswlib
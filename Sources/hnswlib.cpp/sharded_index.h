@@ -0,0 +1,209 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <fstream>
+#include <memory>
+
+namespace hnswlib {
+
+enum ShardPartitioning {
+    SHARD_BY_HASH = 0,   // mixed label hash modulo the shard count
+    SHARD_BY_RANGE = 1   // consecutive blocks of range_size labels, the last shard takes the rest
+};
+
+/*
+* N independent HierarchicalNSW shards behind one AlgorithmInterface. Each label lives
+* in exactly one shard, so inserts into different shards share no locks and the total
+* size is not bound by the 32-bit internal ids of a single graph. A search runs on all
+* shards concurrently on the shared thread pool and merges the per-shard top-k.
+*/
+template<typename dist_t>
+class ShardedIndex : public AlgorithmInterface<dist_t> {
+    static const uint64_t FILE_MAGIC = 0x3144524148535748ULL;  // "HWSHARD1"
+
+    std::vector<HierarchicalNSW<dist_t> *> shards_;
+    ShardPartitioning partitioning_;
+    size_t range_size_;
+    std::unique_ptr<ThreadPool> pool_;
+
+    static std::string shardLocation(const std::string &location, size_t shard) {
+        return location + ".shard" + std::to_string(shard);
+    }
+
+    static size_t defaultThreads(size_t num_threads, size_t num_shards) {
+        if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+        // the calling thread takes part in every run, so one thread less is enough;
+        // hardware_concurrency() may return 0, which must not wrap around
+        num_threads = std::min(num_threads, num_shards);
+        return num_threads > 0 ? num_threads - 1 : 0;
+    }
+
+ public:
+    ShardedIndex(
+        SpaceInterface<dist_t> *s,
+        size_t num_shards,
+        size_t max_elements_per_shard,
+        size_t M = 16,
+        size_t ef_construction = 200,
+        size_t random_seed = 100,
+        bool allow_replace_deleted = false,
+        ShardPartitioning partitioning = SHARD_BY_HASH,
+        size_t range_size = 0,
+        size_t num_threads = 0)
+        : partitioning_(partitioning), range_size_(range_size) {
+        if (num_shards == 0)
+            throw std::runtime_error("A sharded index needs at least one shard");
+        if (partitioning == SHARD_BY_RANGE && range_size == 0)
+            throw std::runtime_error("Range partitioning needs a range size");
+
+        for (size_t i = 0; i < num_shards; i++) {
+            shards_.push_back(new HierarchicalNSW<dist_t>(s, max_elements_per_shard, M, ef_construction,
+                                                          random_seed + i, allow_replace_deleted));
+        }
+        pool_.reset(new ThreadPool(defaultThreads(num_threads, num_shards)));
+    }
+
+    /*
+    * Loads an index written by saveIndex, reading the shards in parallel.
+    * max_elements_per_shard = 0 keeps the saved capacity of each shard.
+    */
+    ShardedIndex(
+        SpaceInterface<dist_t> *s,
+        const std::string &location,
+        size_t num_threads = 0,
+        size_t max_elements_per_shard = 0,
+        bool allow_replace_deleted = false) {
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        uint64_t magic = 0, num_shards = 0, partitioning = 0, range_size = 0;
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, num_shards);
+        readBinaryPOD(input, partitioning);
+        readBinaryPOD(input, range_size);
+        if (!input || magic != FILE_MAGIC || num_shards == 0)
+            throw std::runtime_error("Not a sharded index file");
+        partitioning_ = (ShardPartitioning) partitioning;
+        range_size_ = range_size;
+
+        pool_.reset(new ThreadPool(defaultThreads(num_threads, num_shards)));
+        shards_.assign(num_shards, nullptr);
+        try {
+            pool_->run(num_shards, [&](size_t i) {
+                shards_[i] = new HierarchicalNSW<dist_t>(s, shardLocation(location, i), false,
+                                                         max_elements_per_shard, allow_replace_deleted);
+            });
+        } catch (...) {
+            for (HierarchicalNSW<dist_t> *shard : shards_) delete shard;
+            throw;
+        }
+    }
+
+    ~ShardedIndex() {
+        pool_.reset();
+        for (HierarchicalNSW<dist_t> *shard : shards_) delete shard;
+    }
+
+    size_t numShards() const {
+        return shards_.size();
+    }
+
+    HierarchicalNSW<dist_t> &shard(size_t i) {
+        return *shards_[i];
+    }
+
+    size_t shardOf(labeltype label) const {
+        if (partitioning_ == SHARD_BY_RANGE)
+            return std::min((size_t) (label / range_size_), shards_.size() - 1);
+        // splitmix64 finalizer, so that sequential labels spread evenly
+        uint64_t h = (uint64_t) label;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return (size_t) (h % shards_.size());
+    }
+
+    void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
+        shards_[shardOf(label)]->addPoint(data_point, label, replace_deleted);
+    }
+
+    void markDelete(labeltype label) {
+        shards_[shardOf(label)]->markDelete(label);
+    }
+
+    void unmarkDelete(labeltype label) {
+        shards_[shardOf(label)]->unmarkDelete(label);
+    }
+
+    void setEf(size_t ef) {
+        for (HierarchicalNSW<dist_t> *shard : shards_) shard->setEf(ef);
+    }
+
+    size_t getCurrentElementCount() const {
+        size_t count = 0;
+        for (HierarchicalNSW<dist_t> *shard : shards_) count += shard->cur_element_count;
+        return count;
+    }
+
+    size_t getDeletedCount() const {
+        size_t count = 0;
+        for (HierarchicalNSW<dist_t> *shard : shards_) count += shard->num_deleted_;
+        return count;
+    }
+
+    size_t getMaxElements() const {
+        size_t count = 0;
+        for (HierarchicalNSW<dist_t> *shard : shards_) count += shard->max_elements_;
+        return count;
+    }
+
+    void resizeIndex(size_t new_max_elements_per_shard) {
+        pool_->run(shards_.size(), [&](size_t i) {
+            shards_[i]->resizeIndex(new_max_elements_per_shard);
+        });
+    }
+
+    std::priority_queue<std::pair<dist_t, labeltype>>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        std::vector<std::priority_queue<std::pair<dist_t, labeltype>>> partial(shards_.size());
+        pool_->run(shards_.size(), [&](size_t i) {
+            partial[i] = shards_[i]->searchKnn(query_data, k, isIdAllowed);
+        });
+
+        // every shard result is a max-heap of at most k, keep the k smallest overall
+        std::priority_queue<std::pair<dist_t, labeltype>> result;
+        for (auto &shard_result : partial) {
+            while (!shard_result.empty()) {
+                const std::pair<dist_t, labeltype> &candidate = shard_result.top();
+                if (result.size() < k) {
+                    result.push(candidate);
+                } else if (candidate.first < result.top().first) {
+                    result.pop();
+                    result.push(candidate);
+                }
+                shard_result.pop();
+            }
+        }
+        return result;
+    }
+
+    // Writes a small header to `location` and each shard to `location`.shard<i>, in parallel
+    void saveIndex(const std::string &location) {
+        std::ofstream output(location, std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+        uint64_t magic = FILE_MAGIC;
+        writeBinaryPOD(output, magic);
+        writeBinaryPOD(output, (uint64_t) shards_.size());
+        writeBinaryPOD(output, (uint64_t) partitioning_);
+        writeBinaryPOD(output, (uint64_t) range_size_);
+        output.close();
+
+        pool_->run(shards_.size(), [&](size_t i) {
+            shards_[i]->saveIndex(shardLocation(location, i));
+        });
+    }
+};
+
+}  // namespace hnswlib
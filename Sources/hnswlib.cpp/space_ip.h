@@ -1,5 +1,6 @@
 #pragma once
 #include "hnswlib.h"
+#include <math.h>
 
 namespace hnswlib {
 
@@ -339,6 +340,59 @@ InnerProductDistanceSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v,
 }
 #endif
 
+/*
+* Writes src / |src| into dst (src and dst may alias), which turns inner product
+* into cosine similarity. Both the norm and the scaling are vectorized.
+*/
+static void
+NormalizeVector(const float *src, float *dst, size_t qty) {
+    size_t i = 0;
+    float norm = 0.0f;
+#if defined(USE_AVX)
+    __m256 sum256 = _mm256_set1_ps(0);
+    for (; i + 8 <= qty; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        sum256 = _mm256_add_ps(sum256, _mm256_mul_ps(v, v));
+    }
+    float PORTABLE_ALIGN32 TmpRes[8];
+    _mm256_store_ps(TmpRes, sum256);
+    norm = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+#elif defined(USE_SSE)
+    __m128 sum128 = _mm_set1_ps(0);
+    for (; i + 4 <= qty; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        sum128 = _mm_add_ps(sum128, _mm_mul_ps(v, v));
+    }
+    float PORTABLE_ALIGN32 TmpRes[8];
+    _mm_store_ps(TmpRes, sum128);
+    norm = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+#else
+    // four independent sums, so that compilers can vectorize the loop without reassociating
+    float sum4[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (; i + 4 <= qty; i += 4) {
+        for (size_t j = 0; j < 4; j++)
+            sum4[j] += src[i + j] * src[i + j];
+    }
+    norm = sum4[0] + sum4[1] + sum4[2] + sum4[3];
+#endif
+    for (; i < qty; i++)
+        norm += src[i] * src[i];
+    float scale = 1.0f / (sqrtf(norm) + 1e-30f);
+
+    i = 0;
+#if defined(USE_AVX)
+    __m256 scale256 = _mm256_set1_ps(scale);
+    for (; i + 8 <= qty; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), scale256));
+#elif defined(USE_SSE)
+    __m128 scale128 = _mm_set1_ps(scale);
+    for (; i + 4 <= qty; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), scale128));
+#endif
+    for (; i < qty; i++)
+        dst[i] = src[i] * scale;
+}
+
 class InnerProductSpace : public SpaceInterface<float> {
     DISTFUNC<float> fstdistfunc_;
     size_t data_size_;
@@ -397,4 +451,34 @@ class InnerProductSpace : public SpaceInterface<float> {
 ~InnerProductSpace() {}
 };
 
+
+/*
+* Cosine distance as inner product of unit vectors. Inserted vectors are normalized
+* straight into their slot by storeVector; queries must be normalized by the caller.
+* With setAssumeNormalized(true) the input is taken as unit length and stored as is,
+* which must be decided before the first insert.
+*/
+class CosineSpace : public InnerProductSpace {
+    size_t dim_;
+    bool assume_normalized_;
+
+ public:
+    explicit CosineSpace(size_t dim) : InnerProductSpace(dim), dim_(dim), assume_normalized_(false) {}
+
+    void setAssumeNormalized(bool assume_normalized) {
+        assume_normalized_ = assume_normalized;
+    }
+
+    bool assumeNormalized() const {
+        return assume_normalized_;
+    }
+
+    void storeVector(void *dst, const void *src) override {
+        if (assume_normalized_)
+            memcpy(dst, src, dim_ * sizeof(float));
+        else
+            NormalizeVector((const float *) src, (float *) dst, dim_);
+    }
+};
+
 }  // namespace hnswlib
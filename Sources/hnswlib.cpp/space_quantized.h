@@ -0,0 +1,317 @@
+#pragma once
+#include "hnswlib.h"
+#include <math.h>
+#include <algorithm>
+
+namespace hnswlib {
+
+/*
+* Spaces that store vectors in a compressed form. Points have to be encoded
+* with encode() before they are handed to an index, and queries have to be
+* encoded the same way, so distances are always computed between two codes.
+*/
+class QuantizedSpace : public SpaceInterface<float> {
+ public:
+    virtual void encode(const float *src, void *dst) = 0;
+
+    // Approximate inverse of encode, writes get_dim() floats
+    virtual void decode(const void *src, float *dst) = 0;
+
+    virtual size_t get_dim() = 0;
+};
+
+
+struct QuantizedDistParam {
+    size_t dim;
+    bool inner_product;
+};
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Int8: each vector is stored as [float scale][float squared norm][int8 codes],
+// where code * scale reconstructs the component.
+//
+/////////////////////////////////////////////////////////////////////
+
+static const size_t INT8_HEADER_SIZE = 2 * sizeof(float);
+
+static int
+Int8Dot(const int8_t *a, const int8_t *b, size_t qty) {
+    int res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += (int) a[i] * (int) b[i];
+    }
+    return res;
+}
+
+#if defined(__AVX2__)
+static int
+Int8DotSIMD(const int8_t *a, const int8_t *b, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(va, vb));
+    }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    int PORTABLE_ALIGN32 TmpRes[4];
+    _mm_store_si128((__m128i *) TmpRes, sum128);
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + Int8Dot(a + qty16, b + qty16, qty - qty16);
+}
+#elif defined(USE_SSE)
+static int
+Int8DotSIMD(const int8_t *a, const int8_t *b, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    __m128i sum = _mm_setzero_si128();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+        // sign-extend to 16 bits by placing each byte in the high half and shifting back
+        __m128i va_lo = _mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8);
+        __m128i va_hi = _mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8);
+        __m128i vb_lo = _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8);
+        __m128i vb_hi = _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(va_lo, vb_lo));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(va_hi, vb_hi));
+    }
+    int PORTABLE_ALIGN32 TmpRes[4];
+    _mm_store_si128((__m128i *) TmpRes, sum);
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + Int8Dot(a + qty16, b + qty16, qty - qty16);
+}
+#else
+static int
+Int8DotSIMD(const int8_t *a, const int8_t *b, size_t qty) {
+    return Int8Dot(a, b, qty);
+}
+#endif
+
+static float
+Int8Distance(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const QuantizedDistParam *param = (const QuantizedDistParam *) param_ptr;
+    const float *h1 = (const float *) pVect1v;
+    const float *h2 = (const float *) pVect2v;
+    const int8_t *c1 = (const int8_t *) pVect1v + INT8_HEADER_SIZE;
+    const int8_t *c2 = (const int8_t *) pVect2v + INT8_HEADER_SIZE;
+
+    float dot = h1[0] * h2[0] * (float) Int8DotSIMD(c1, c2, param->dim);
+    if (param->inner_product)
+        return 1.0f - dot;
+    float res = h1[1] + h2[1] - 2.0f * dot;
+    return res > 0.0f ? res : 0.0f;
+}
+
+class Int8Space : public QuantizedSpace {
+    size_t data_size_;
+    QuantizedDistParam param_;
+
+ public:
+    Int8Space(size_t dim, bool inner_product) {
+        param_.dim = dim;
+        param_.inner_product = inner_product;
+        data_size_ = INT8_HEADER_SIZE + dim * sizeof(int8_t);
+    }
+
+    void encode(const float *src, void *dst) {
+        size_t dim = param_.dim;
+        float max_abs = 0.0f;
+        for (size_t i = 0; i < dim; i++)
+            max_abs = std::max(max_abs, fabsf(src[i]));
+        float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+        float inv_scale = 1.0f / scale;
+
+        int8_t *codes = (int8_t *) dst + INT8_HEADER_SIZE;
+        int64_t sq_codes = 0;
+        for (size_t i = 0; i < dim; i++) {
+            int code = (int) lrintf(src[i] * inv_scale);
+            code = std::min(127, std::max(-127, code));
+            codes[i] = (int8_t) code;
+            sq_codes += code * code;
+        }
+        float header[2] = {scale, scale * scale * (float) sq_codes};
+        memcpy(dst, header, sizeof(header));
+    }
+
+    void decode(const void *src, float *dst) {
+        float scale;
+        memcpy(&scale, src, sizeof(float));
+        const int8_t *codes = (const int8_t *) src + INT8_HEADER_SIZE;
+        for (size_t i = 0; i < param_.dim; i++)
+            dst[i] = codes[i] * scale;
+    }
+
+    size_t get_dim() {
+        return param_.dim;
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return Int8Distance;
+    }
+
+    void *get_dist_func_param() {
+        return &param_;
+    }
+
+    ~Int8Space() {}
+};
+
+
+/////////////////////////////////////////////////////////////////////
+//
+// Fp16: each vector is stored as IEEE half precision components.
+//
+/////////////////////////////////////////////////////////////////////
+
+static inline float
+HalfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        // subnormal half: renormalize
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    } else {
+        bits = sign;
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint16_t
+FloatToHalf(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+    uint32_t abs_bits = bits & 0x7fffffff;
+    if (abs_bits >= 0x7f800000)  // inf or nan
+        return sign | 0x7c00 | (abs_bits > 0x7f800000 ? 0x200 : 0);
+    if (abs_bits >= 0x477ff000)  // rounds to a value above the half range
+        return sign | 0x7c00;
+    if (abs_bits < 0x38800000) {  // subnormal half or zero
+        if (abs_bits < 0x33000000)
+            return sign;
+        uint32_t mantissa = (abs_bits & 0x7fffff) | 0x800000;
+        int shift = 126 - (int) (abs_bits >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | (uint16_t) half;
+    }
+    // normal: rebias the exponent and round to nearest even
+    uint32_t half = ((abs_bits - 0x38000000) >> 13);
+    uint32_t rest = abs_bits & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | (uint16_t) half;
+}
+
+static float
+Fp16Distance(const void *pVect1v, const void *pVect2v, const void *param_ptr) {
+    const QuantizedDistParam *param = (const QuantizedDistParam *) param_ptr;
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = param->dim;
+    size_t i = 0;
+    float res = 0;
+#if defined(USE_AVX) && defined(__F16C__)
+    float PORTABLE_ALIGN32 TmpRes[8];
+    __m256 sum = _mm256_set1_ps(0);
+    for (; i + 8 <= qty; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        if (param->inner_product) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(v1, v2));
+        } else {
+            __m256 diff = _mm256_sub_ps(v1, v2);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+        }
+    }
+    _mm256_store_ps(TmpRes, sum);
+    res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+#endif
+    for (; i < qty; i++) {
+        float v1 = HalfToFloat(pVect1[i]);
+        float v2 = HalfToFloat(pVect2[i]);
+        if (param->inner_product) {
+            res += v1 * v2;
+        } else {
+            float t = v1 - v2;
+            res += t * t;
+        }
+    }
+    return param->inner_product ? 1.0f - res : res;
+}
+
+class Fp16Space : public QuantizedSpace {
+    size_t data_size_;
+    QuantizedDistParam param_;
+
+ public:
+    Fp16Space(size_t dim, bool inner_product) {
+        param_.dim = dim;
+        param_.inner_product = inner_product;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    void encode(const float *src, void *dst) {
+        uint16_t *out = (uint16_t *) dst;
+        size_t i = 0;
+#if defined(USE_AVX) && defined(__F16C__)
+        for (; i + 8 <= param_.dim; i += 8) {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128((__m128i *) (out + i), h);
+        }
+#endif
+        for (; i < param_.dim; i++)
+            out[i] = FloatToHalf(src[i]);
+    }
+
+    void decode(const void *src, float *dst) {
+        const uint16_t *in = (const uint16_t *) src;
+        size_t i = 0;
+#if defined(USE_AVX) && defined(__F16C__)
+        for (; i + 8 <= param_.dim; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (in + i))));
+#endif
+        for (; i < param_.dim; i++)
+            dst[i] = HalfToFloat(in[i]);
+    }
+
+    size_t get_dim() {
+        return param_.dim;
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return Fp16Distance;
+    }
+
+    void *get_dist_func_param() {
+        return &param_;
+    }
+
+    ~Fp16Space() {}
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace hnswlib {
+
+// One non-zero of a sparse vector
+struct SparseEntry {
+    uint32_t index;
+    float value;
+};
+
+/*
+* A sparse vector as the arena stores it: this header, then nnz entries sorted by index.
+* The header has the size of an entry, so a vector occupies nnz + 1 entries.
+*/
+struct SparseVector {
+    uint32_t nnz;
+    uint32_t reserved;
+
+    const SparseEntry *entries() const {
+        return reinterpret_cast<const SparseEntry *>(this + 1);
+    }
+
+    SparseEntry *entries() {
+        return reinterpret_cast<SparseEntry *>(this + 1);
+    }
+};
+
+/*
+* What an element slot (and a query) holds: a pointer to an immutable SparseVector.
+* Level-0 slots are only 4-byte aligned, so the slot has room for the pointer at its
+* first pointer-aligned address, where it is written and read as one atomic word.
+*/
+inline std::atomic<const SparseVector *> *
+SparseSlot(const void *slot) {
+    uintptr_t address = ((uintptr_t) slot + alignof(void *) - 1) & ~(uintptr_t) (alignof(void *) - 1);
+    return reinterpret_cast<std::atomic<const SparseVector *> *>(address);
+}
+
+/*
+* Dot product of two index-sorted sparse vectors. Lists of similar length are merged
+* without data-dependent branches; a much shorter list gallops through the longer one,
+* so a 10-term query against a 300-term document costs about 10 binary searches.
+*/
+inline float
+SparseInnerProduct(const SparseEntry *a, size_t na, const SparseEntry *b, size_t nb) {
+    if (na > nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    float sum = 0.0f;
+    size_t i = 0, j = 0;
+    if (na * 16 < nb) {
+        for (; i < na && j < nb; i++) {
+            uint32_t target = a[i].index;
+            size_t step = 1, hi = j;
+            while (hi < nb && b[hi].index < target) {
+                j = hi + 1;
+                hi += step;
+                step *= 2;
+            }
+            hi = std::min(hi, nb);
+            while (j < hi) {
+                size_t mid = j + (hi - j) / 2;
+                if (b[mid].index < target) j = mid + 1; else hi = mid;
+            }
+            if (j < nb && b[j].index == target) sum += a[i].value * b[j].value;
+        }
+        return sum;
+    }
+    while (i < na && j < nb) {
+        uint32_t ia = a[i].index, ib = b[j].index;
+        sum += ia == ib ? a[i].value * b[j].value : 0.0f;
+        i += ia <= ib;
+        j += ib <= ia;
+    }
+    return sum;
+}
+
+inline float
+SparseInnerProductDistance(const void *pVect1, const void *pVect2, const void *) {
+    const SparseVector *a = SparseSlot(pVect1)->load(std::memory_order_acquire);
+    const SparseVector *b = SparseSlot(pVect2)->load(std::memory_order_acquire);
+    return 1.0f - SparseInnerProduct(a->entries(), a->nnz, b->entries(), b->nnz);
+}
+
+/*
+* Inner product over sparse vectors (e.g. SPLADE lexical embeddings) with dim possible
+* indices. storeVector copies a vector into an append-only arena of chunks that never
+* move and then publishes its pointer in the slot, so searches racing an update read
+* either the old or the new vector whole, without locks. The entries of a replaced or
+* updated element are not reclaimed.
+*/
+class SparseInnerProductSpace : public SpaceInterface<float> {
+    static const size_t CHUNK_ENTRIES = 1 << 16;
+
+    size_t dim_;
+    std::mutex arena_lock_;
+    std::vector<std::unique_ptr<SparseEntry[]>> chunks_;
+    SparseEntry *chunk_;  // the chunk small vectors are appended to
+    size_t chunk_used_;
+    size_t chunk_capacity_;
+    size_t arena_entries_;
+
+ public:
+    explicit SparseInnerProductSpace(size_t dim)
+        : dim_(dim), chunk_(nullptr), chunk_used_(0), chunk_capacity_(0), arena_entries_(0) {}
+
+    size_t get_data_size() {
+        return sizeof(void *) + alignof(void *) - sizeof(uint32_t);
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return SparseInnerProductDistance;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    size_t dim() const {
+        return dim_;
+    }
+
+    // Room for a vector of nnz entries in the arena, valid for the lifetime of the space
+    SparseVector *allocate(size_t nnz) {
+        if (nnz > dim_)
+            throw std::runtime_error("Sparse vector has more entries than dimensions");
+        size_t size = nnz + 1;
+        SparseEntry *block;
+        {
+            std::unique_lock<std::mutex> lock(arena_lock_);
+            arena_entries_ += size;
+            if (size > CHUNK_ENTRIES / 4) {
+                // large vectors get a chunk of their own, the current one stays open
+                chunks_.emplace_back(new SparseEntry[size]);
+                block = chunks_.back().get();
+            } else {
+                if (chunk_used_ + size > chunk_capacity_) {
+                    chunks_.emplace_back(new SparseEntry[CHUNK_ENTRIES]);
+                    chunk_ = chunks_.back().get();
+                    chunk_used_ = 0;
+                    chunk_capacity_ = CHUNK_ENTRIES;
+                }
+                block = chunk_ + chunk_used_;
+                chunk_used_ += size;
+            }
+        }
+        SparseVector *vector = reinterpret_cast<SparseVector *>(block);
+        vector->nnz = (uint32_t) nnz;
+        vector->reserved = 0;
+        return vector;
+    }
+
+    // Makes `vector` the one `slot` holds; it must not change afterwards
+    static void publish(void *slot, const SparseVector *vector) {
+        SparseSlot(slot)->store(vector, std::memory_order_release);
+    }
+
+    // Entries held by the arena, headers and those of replaced elements included
+    size_t arenaEntries() {
+        std::unique_lock<std::mutex> lock(arena_lock_);
+        return arena_entries_;
+    }
+
+    void storeVector(void *dst, const void *src) override {
+        const SparseVector *vector = SparseSlot(src)->load(std::memory_order_acquire);
+        SparseVector *stored = allocate(vector->nnz);
+        std::copy(vector->entries(), vector->entries() + vector->nnz, stored->entries());
+        publish(dst, stored);
+    }
+
+    ~SparseInnerProductSpace() {}
+};
+
+}  // namespace hnswlib
@@ -115,6 +115,7 @@ class MultiVectorInnerProductSpace : public BaseMultiVectorSpace<DOCIDTYPE> {
         else if (dim > 4)
             fstdistfunc_ = InnerProductDistanceSIMD4ExtResiduals;
 #endif
+        dim_ = dim;
         vector_size_ = dim * sizeof(float);
         data_size_ = vector_size_ + sizeof(DOCIDTYPE);
     }
@@ -143,42 +144,78 @@ class MultiVectorInnerProductSpace : public BaseMultiVectorSpace<DOCIDTYPE> {
 };
 
 
+/*
+* Per-query state of MultiVectorSearchStopCondition that can be reused across queries:
+* a flat counter indexed by doc id, the docs it touched and the heap of results. Doc ids
+* should therefore be dense; the counter grows to the largest id seen, and resetting it
+* only clears the entries the last query touched.
+*/
+template<typename DOCIDTYPE, typename dist_t>
+struct MultiVectorSearchScratch {
+    std::vector<uint32_t> doc_counter;
+    std::vector<DOCIDTYPE> touched;
+    std::vector<std::pair<dist_t, DOCIDTYPE>> results;  // max-heap on the distance
+
+    void reset() {
+        for (DOCIDTYPE doc_id : touched) doc_counter[doc_id] = 0;
+        touched.clear();
+        results.clear();
+    }
+};
+
+
 template<typename DOCIDTYPE, typename dist_t>
 class MultiVectorSearchStopCondition : public BaseSearchStopCondition<dist_t> {
     size_t curr_num_docs_;
     size_t num_docs_to_search_;
     size_t ef_collection_;
-    std::unordered_map<DOCIDTYPE, size_t> doc_counter_;
-    std::priority_queue<std::pair<dist_t, DOCIDTYPE>> search_results_;
+    MultiVectorSearchScratch<DOCIDTYPE, dist_t> own_scratch_;
+    MultiVectorSearchScratch<DOCIDTYPE, dist_t> *scratch_;
     BaseMultiVectorSpace<DOCIDTYPE>& space_;
 
+    uint32_t &docCount(DOCIDTYPE doc_id) {
+        std::vector<uint32_t> &counter = scratch_->doc_counter;
+        if ((size_t) doc_id >= counter.size()) counter.resize((size_t) doc_id + 1, 0);
+        return counter[doc_id];
+    }
+
+    void popResult() {
+        std::pop_heap(scratch_->results.begin(), scratch_->results.end());
+        scratch_->results.pop_back();
+    }
+
  public:
+    // `scratch` (may be null) is reset and used for this query, so one per thread can serve many queries
     MultiVectorSearchStopCondition(
         BaseMultiVectorSpace<DOCIDTYPE>& space,
         size_t num_docs_to_search,
-        size_t ef_collection = 10)
-        : space_(space) {
+        size_t ef_collection = 10,
+        MultiVectorSearchScratch<DOCIDTYPE, dist_t> *scratch = nullptr)
+        : scratch_(scratch ? scratch : &own_scratch_), space_(space) {
             curr_num_docs_ = 0;
             num_docs_to_search_ = num_docs_to_search;
             ef_collection_ = std::max(ef_collection, num_docs_to_search);
+            scratch_->reset();
         }
 
     void add_point_to_result(labeltype label, const void *datapoint, dist_t dist) override {
         DOCIDTYPE doc_id = space_.get_doc_id(datapoint);
-        if (doc_counter_[doc_id] == 0) {
+        uint32_t &count = docCount(doc_id);
+        if (count == 0) {
             curr_num_docs_ += 1;
+            scratch_->touched.push_back(doc_id);
         }
-        search_results_.emplace(dist, doc_id);
-        doc_counter_[doc_id] += 1;
+        count += 1;
+        scratch_->results.emplace_back(dist, doc_id);
+        std::push_heap(scratch_->results.begin(), scratch_->results.end());
     }
 
     void remove_point_from_result(labeltype label, const void *datapoint, dist_t dist) override {
         DOCIDTYPE doc_id = space_.get_doc_id(datapoint);
-        doc_counter_[doc_id] -= 1;
-        if (doc_counter_[doc_id] == 0) {
+        if (--docCount(doc_id) == 0) {
             curr_num_docs_ -= 1;
         }
-        search_results_.pop();
+        popResult();
     }
 
     bool should_stop_search(dist_t candidate_dist, dist_t lowerBound) override {
@@ -199,22 +236,156 @@ class MultiVectorSearchStopCondition : public BaseSearchStopCondition<dist_t> {
     void filter_results(std::vector<std::pair<dist_t, labeltype >> &candidates) override {
         while (curr_num_docs_ > num_docs_to_search_) {
             dist_t dist_cand = candidates.back().first;
-            dist_t dist_res = search_results_.top().first;
+            dist_t dist_res = scratch_->results.front().first;
             assert(dist_cand == dist_res);
-            DOCIDTYPE doc_id = search_results_.top().second;
-            doc_counter_[doc_id] -= 1;
-            if (doc_counter_[doc_id] == 0) {
+            DOCIDTYPE doc_id = scratch_->results.front().second;
+            if (--docCount(doc_id) == 0) {
                 curr_num_docs_ -= 1;
             }
-            search_results_.pop();
+            popResult();
             candidates.pop_back();
         }
     }
 
+    /*
+    * After filter_results: writes the distinct docs of the result, closest first, with
+    * the distance of their closest vector, and returns their number. Consumes the result.
+    */
+    size_t get_docs(DOCIDTYPE *doc_ids, dist_t *distances, size_t max_docs) {
+        std::vector<std::pair<dist_t, DOCIDTYPE>> &results = scratch_->results;
+        std::sort_heap(results.begin(), results.end());
+        size_t count = 0;
+        for (size_t i = 0; i < results.size() && count < max_docs; i++) {
+            uint32_t &doc_count = docCount(results[i].second);
+            if (doc_count == 0) continue;
+            doc_count = 0;
+            doc_ids[count] = results[i].second;
+            distances[count] = results[i].first;
+            count++;
+        }
+        results.clear();
+        curr_num_docs_ = 0;
+        return count;
+    }
+
     ~MultiVectorSearchStopCondition() {}
 };
 
 
+// Maps a label to a dense group index, or NO_GROUP for labels that are not grouped
+class BaseGroupFunctor {
+ public:
+    static const size_t NO_GROUP = (size_t) -1;
+
+    virtual size_t operator()(labeltype label) = 0;
+    virtual ~BaseGroupFunctor() {}
+};
+
+
+/*
+* Collects the k closest points with at most max_per_group of them in each group, e.g.
+* "top 50 but at most 3 per seller"; max_per_group = 1 returns k distinct groups. The
+* search keeps going until ef_collection points within the caps are held, so a group
+* that dominates the neighborhood does not crowd out the others. Ungrouped points are
+* never capped. Uses the flat counters of MultiVectorSearchScratch, keyed by group.
+*/
+template<typename dist_t>
+class GroupedSearchStopCondition : public BaseSearchStopCondition<dist_t> {
+    BaseGroupFunctor &group_of_;
+    size_t k_;
+    size_t max_per_group_;
+    size_t ef_collection_;
+    size_t admissible_;  // points held that fit within the caps
+    MultiVectorSearchScratch<size_t, dist_t> own_scratch_;
+    MultiVectorSearchScratch<size_t, dist_t> *scratch_;
+
+    uint32_t &groupCount(size_t group) {
+        std::vector<uint32_t> &counter = scratch_->doc_counter;
+        if (group >= counter.size()) counter.resize(group + 1, 0);
+        return counter[group];
+    }
+
+ public:
+    GroupedSearchStopCondition(
+        BaseGroupFunctor &group_of,
+        size_t k,
+        size_t max_per_group,
+        size_t ef_collection = 10,
+        MultiVectorSearchScratch<size_t, dist_t> *scratch = nullptr)
+        : group_of_(group_of), k_(k), max_per_group_(std::max(max_per_group, (size_t) 1)),
+          ef_collection_(std::max(ef_collection, k)), admissible_(0),
+          scratch_(scratch ? scratch : &own_scratch_) {
+        scratch_->reset();
+    }
+
+    void add_point_to_result(labeltype label, const void *datapoint, dist_t dist) override {
+        size_t group = group_of_(label);
+        if (group == BaseGroupFunctor::NO_GROUP) {
+            admissible_++;
+        } else {
+            uint32_t &count = groupCount(group);
+            if (count == 0) scratch_->touched.push_back(group);
+            if (++count <= max_per_group_) admissible_++;
+        }
+        scratch_->results.emplace_back(dist, group);
+        std::push_heap(scratch_->results.begin(), scratch_->results.end());
+    }
+
+    /*
+    * The search evicts its farthest point, which with tied distances need not be the
+    * front of this heap; the entry removed is the one of the evicted label's group.
+    */
+    void remove_point_from_result(labeltype label, const void *datapoint, dist_t dist) override {
+        size_t group = group_of_(label);
+        std::vector<std::pair<dist_t, size_t>> &results = scratch_->results;
+        auto evicted = std::find(results.begin(), results.end(), std::make_pair(results.front().first, group));
+        if (evicted == results.begin() || evicted == results.end()) {
+            std::pop_heap(results.begin(), results.end());
+            results.pop_back();
+        } else {
+            *evicted = results.back();
+            results.pop_back();
+            std::make_heap(results.begin(), results.end());
+        }
+        if (group == BaseGroupFunctor::NO_GROUP || groupCount(group)-- <= max_per_group_) admissible_--;
+    }
+
+    bool should_stop_search(dist_t candidate_dist, dist_t lowerBound) override {
+        return candidate_dist > lowerBound && admissible_ >= ef_collection_;
+    }
+
+    bool should_consider_candidate(dist_t candidate_dist, dist_t lowerBound) override {
+        return admissible_ < ef_collection_ || lowerBound > candidate_dist;
+    }
+
+    // The farthest point goes if the caps still hold ef_collection points without it
+    bool should_remove_extra() override {
+        if (scratch_->results.empty()) return false;
+        size_t group = scratch_->results.front().second;
+        bool counted = group == BaseGroupFunctor::NO_GROUP || groupCount(group) <= max_per_group_;
+        return admissible_ - (counted ? 1 : 0) >= ef_collection_;
+    }
+
+    // Keeps the k closest points within the caps, closest first
+    void filter_results(std::vector<std::pair<dist_t, labeltype >> &candidates) override {
+        scratch_->reset();
+        size_t kept = 0;
+        for (size_t i = 0; i < candidates.size() && kept < k_; i++) {
+            size_t group = group_of_(candidates[i].second);
+            if (group != BaseGroupFunctor::NO_GROUP) {
+                uint32_t &count = groupCount(group);
+                if (count == 0) scratch_->touched.push_back(group);
+                if (++count > max_per_group_) continue;
+            }
+            candidates[kept++] = candidates[i];
+        }
+        candidates.resize(kept);
+    }
+
+    ~GroupedSearchStopCondition() {}
+};
+
+
 template<typename dist_t>
 class EpsilonSearchStopCondition : public BaseSearchStopCondition<dist_t> {
     float epsilon_;
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hnswlib {
+
+/*
+* Fixed set of worker threads shared by all calls. run(n, fn) executes fn(0) .. fn(n - 1)
+* on the workers and on the calling thread and returns when all of them have finished,
+* so it can be called from many threads at once and never waits for an idle worker.
+*/
+class ThreadPool {
+    struct Batch {
+        std::function<void(size_t)> fn;
+        size_t n;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+
+        // Runs items until none are left
+        void work() {
+            while (true) {
+                size_t i = next.fetch_add(1);
+                if (i >= n) return;
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (!error) error = std::current_exception();
+                }
+                if (done.fetch_add(1) + 1 == n) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers_;
+    std::deque<std::shared_ptr<Batch>> queue_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    bool stop_;
+
+    void workerLoop() {
+        while (true) {
+            std::shared_ptr<Batch> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                available_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+                if (stop_ && queue_.empty()) return;
+                batch = queue_.front();
+                queue_.pop_front();
+            }
+            batch->work();
+        }
+    }
+
+ public:
+    explicit ThreadPool(size_t num_threads) : stop_(false) {
+        for (size_t i = 0; i < num_threads; i++)
+            workers_.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        available_.notify_all();
+        for (auto &worker : workers_) worker.join();
+    }
+
+    size_t size() const {
+        return workers_.size();
+    }
+
+    template<class Function>
+    void run(size_t n, Function fn) {
+        if (n == 0) return;
+        if (n == 1 || workers_.empty()) {
+            for (size_t i = 0; i < n; i++) fn(i);
+            return;
+        }
+
+        // workers that pick the batch up late only see an exhausted counter,
+        // so the batch is shared instead of living on this stack frame
+        std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+        batch->fn = fn;
+        batch->n = n;
+        size_t helpers = std::min(n - 1, workers_.size());
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < helpers; i++) queue_.push_back(batch);
+        }
+        if (helpers == 1)
+            available_.notify_one();
+        else
+            available_.notify_all();
+
+        batch->work();
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->finished.wait(lock, [&batch] { return batch->done.load() == batch->n; });
+        if (batch->error) std::rethrow_exception(batch->error);
+    }
+};
+
+}  // namespace hnswlib
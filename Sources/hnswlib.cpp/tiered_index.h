@@ -0,0 +1,615 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace hnswlib {
+
+/*
+* LSM-style index for a continuous stream of inserts into mostly static data.
+* New points go into a small mutable head graph. When the head reaches the merge
+* threshold it is frozen and a background thread rebuilds it into an immutable
+* segment: deleted points are dropped, the graph is sized exactly, points are inserted
+* in breadth-first order of the head graph so that neighbors get nearby internal ids,
+* and, with a QuantizedSpace as segment space, vectors are stored compressed.
+* Searches run on the head, the segment being built and all segments and merge the
+* results by label. A segment is never changed again except for its delete marks,
+* which hide labels that were deleted or re-added later.
+*/
+class TieredIndex : public AlgorithmInterface<float> {
+    typedef HierarchicalNSW<float> Graph;
+    static const uint64_t FILE_MAGIC = 0x3130524549545748ULL;  // "HWTIER01"
+    static const size_t BUILD_CHUNK = 256;  // points per pool task when building a segment
+
+    SpaceInterface<float> *space_;
+    SpaceInterface<float> *segment_space_;
+    size_t dim_;
+    QuantizedSpace *quantized_;  // segment_space_ if segments are stored encoded, else null
+    size_t head_capacity_;
+    size_t merge_threshold_;
+    size_t M_;
+    size_t ef_construction_;
+    size_t random_seed_;
+    size_t ef_;
+
+    // Guards the tier pointers and the fields below; the graphs have their own locks
+    mutable std::mutex lock_;
+    std::condition_variable changed_;
+    std::shared_ptr<Graph> head_;
+    std::shared_ptr<Graph> freezing_;  // the previous head while its segment is built
+    std::vector<std::shared_ptr<Graph>> segments_;
+    std::unordered_set<labeltype> tombstones_;  // labels deleted since the last merge started
+    std::unordered_map<labeltype, size_t> readding_;  // labels whose re-add into the head is running
+    size_t head_reserved_;  // head slots taken by inserts, including running ones
+    size_t active_writers_;
+    bool rotating_;
+    bool merging_;
+    std::exception_ptr merge_error_;
+    std::thread merge_thread_;
+    std::unique_ptr<ThreadPool> pool_;
+
+    static std::string headLocation(const std::string &location) {
+        return location + ".head";
+    }
+
+    static std::string segmentLocation(const std::string &location, size_t segment) {
+        return location + ".seg" + std::to_string(segment);
+    }
+
+    static size_t poolThreads(size_t num_threads) {
+        if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+        // the calling thread takes part in every run
+        return num_threads > 0 ? num_threads - 1 : 0;
+    }
+
+    std::shared_ptr<Graph> newHead() {
+        std::shared_ptr<Graph> head = std::make_shared<Graph>(space_, head_capacity_, M_, ef_construction_,
+                                                              random_seed_ + segments_.size(), true);
+        head->setEf(ef_);
+        return head;
+    }
+
+    // Marks `label` deleted in `graph` if it holds a live copy of it
+    static bool markIfPresent(Graph &graph, labeltype label) {
+        tableint internal_id;
+        {
+            std::unique_lock<Graph::label_lookup_mutex_t> lock(graph.label_lookup_lock);
+            auto search = graph.label_lookup_.find(label);
+            if (search == graph.label_lookup_.end()) return false;
+            internal_id = search->second;
+        }
+        if (graph.isMarkedDeleted(internal_id)) return false;
+        try {
+            graph.markDelete(label);
+        } catch (const std::runtime_error &) {
+            // deleted by a concurrent call between the check and the mark
+            return false;
+        }
+        return true;
+    }
+
+    static bool containsLive(const Graph &graph, labeltype label) {
+        std::unique_lock<Graph::label_lookup_mutex_t> lock(graph.label_lookup_lock);
+        auto search = graph.label_lookup_.find(label);
+        return search != graph.label_lookup_.end() && !graph.isMarkedDeleted(search->second);
+    }
+
+    static bool containsDeleted(const Graph &graph, labeltype label) {
+        std::unique_lock<Graph::label_lookup_mutex_t> lock(graph.label_lookup_lock);
+        auto search = graph.label_lookup_.find(label);
+        return search != graph.label_lookup_.end() && graph.isMarkedDeleted(search->second);
+    }
+
+    /*
+    * Inserts and deletes run inside a WriteScope. Rotating the head waits until no
+    * scope is open, so a write never lands in a head that is already being frozen.
+    */
+    class WriteScope {
+        TieredIndex &index_;
+
+     public:
+        std::shared_ptr<Graph> head;
+
+        explicit WriteScope(TieredIndex &index) : index_(index) {
+            std::unique_lock<std::mutex> lock(index_.lock_);
+            index_.changed_.wait(lock, [this] { return !index_.rotating_; });
+            index_.active_writers_++;
+            head = index_.head_;
+        }
+
+        ~WriteScope() {
+            std::unique_lock<std::mutex> lock(index_.lock_);
+            if (--index_.active_writers_ == 0) index_.changed_.notify_all();
+        }
+    };
+
+    // Live points of `source` in breadth-first order of its level 0, unreachable ones last
+    static std::vector<tableint> buildOrder(const Graph &source) {
+        size_t n = source.cur_element_count;
+        std::vector<tableint> order;
+        std::vector<bool> seen(n, false);
+        std::vector<tableint> queue;
+        if (n > 0) {
+            queue.push_back(source.enterpoint_node_);
+            seen[source.enterpoint_node_] = true;
+        }
+        for (size_t head = 0; ; head++) {
+            if (head == queue.size()) {
+                // continue with the next point the traversal did not reach
+                size_t next = 0;
+                while (next < n && seen[next]) next++;
+                if (next == n) break;
+                queue.push_back((tableint) next);
+                seen[next] = true;
+            }
+            tableint id = queue[head];
+            if (!source.isMarkedDeleted(id)) order.push_back(id);
+            linklistsizeint *ll = source.get_linklist0(id);
+            size_t size = source.getListCount(ll);
+            tableint *links = (tableint *) (ll + 1);
+            for (size_t j = 0; j < size; j++) {
+                if (!seen[links[j]]) {
+                    seen[links[j]] = true;
+                    queue.push_back(links[j]);
+                }
+            }
+        }
+        return order;
+    }
+
+    // Builds the read-optimized segment for the live points of `source`, null if there are none
+    std::shared_ptr<Graph> buildSegment(const Graph &source, size_t random_seed) {
+        std::vector<tableint> order = buildOrder(source);
+        if (order.empty()) return std::shared_ptr<Graph>();
+
+        std::shared_ptr<Graph> segment = std::make_shared<Graph>(segment_space_, order.size(), M_,
+                                                                 ef_construction_, random_seed);
+        size_t chunks = (order.size() + BUILD_CHUNK - 1) / BUILD_CHUNK;
+        pool_->run(chunks, [&](size_t chunk) {
+            std::vector<char> code(quantized_ ? segment_space_->get_data_size() : 0);
+            size_t end = std::min(order.size(), (chunk + 1) * BUILD_CHUNK);
+            for (size_t i = chunk * BUILD_CHUNK; i < end; i++) {
+                const char *data = source.getDataByInternalId(order[i]);
+                if (quantized_) {
+                    quantized_->encode((const float *) data, code.data());
+                    data = code.data();
+                }
+                segment->addPoint(data, source.getExternalLabel(order[i]));
+            }
+        });
+        return segment;
+    }
+
+    // Body of the merge thread: turns freezing_ into a segment and publishes it
+    void mergeFrozenHead() {
+        std::shared_ptr<Graph> source;
+        size_t random_seed;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            source = freezing_;
+            random_seed = random_seed_ + segments_.size();
+        }
+        std::shared_ptr<Graph> segment;
+        std::exception_ptr error;
+        try {
+            segment = buildSegment(*source, random_seed);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::unique_lock<std::mutex> lock(lock_);
+        if (error) {
+            // the frozen head stays searchable, the next rotation retries the merge
+            merge_error_ = error;
+        } else {
+            if (segment) {
+                segment->setEf(ef_);
+                // hide labels that were deleted or re-added into the head while the segment was
+                // built, including re-adds that hid the old copy but are still inserting
+                for (auto &entry : segment->label_lookup_) {
+                    if (tombstones_.count(entry.first) || readding_.count(entry.first) ||
+                        containsLive(*head_, entry.first))
+                        segment->markDelete(entry.first);
+                }
+                segments_.push_back(segment);
+            }
+            freezing_.reset();
+        }
+        merging_ = false;
+        changed_.notify_all();
+    }
+
+    /*
+    * Freezes the head and starts merging it in the background. With `expected` set,
+    * only rotates if that graph is still the head, so that concurrent inserts that
+    * all found the head full rotate it once. If a merge is running, waits for it when
+    * `wait` is set and otherwise does nothing. After a failed merge, the merge of the
+    * same frozen head is retried instead; a waiting caller gets the error first.
+    */
+    bool rotateHead(const std::shared_ptr<Graph> &expected, bool wait) {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (merging_ && !wait) return false;
+        changed_.wait(lock, [this] { return !merging_ && !rotating_; });
+        if (merge_thread_.joinable()) merge_thread_.join();
+        if (freezing_) {
+            if (wait && merge_error_) {
+                std::exception_ptr error = merge_error_;
+                merge_error_ = nullptr;
+                std::rethrow_exception(error);
+            }
+            merging_ = true;
+            merge_thread_ = std::thread(&TieredIndex::mergeFrozenHead, this);
+            return true;
+        }
+        if (expected && head_ != expected) return true;
+        if (head_->cur_element_count == 0) return false;
+
+        rotating_ = true;
+        changed_.wait(lock, [this] { return active_writers_ == 0; });
+        freezing_ = head_;
+        head_ = newHead();
+        head_reserved_ = 0;
+        tombstones_.clear();
+        merging_ = true;
+        rotating_ = false;
+        changed_.notify_all();
+        merge_thread_ = std::thread(&TieredIndex::mergeFrozenHead, this);
+        return true;
+    }
+
+    // Takes a head slot for one insert, false if the head is full
+    bool reserveHeadSlot() {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (head_reserved_ >= head_capacity_) return false;
+        head_reserved_++;
+        return true;
+    }
+
+    struct Tiers {
+        std::vector<std::shared_ptr<Graph>> segments;
+        std::shared_ptr<Graph> freezing;
+        std::shared_ptr<Graph> head;
+
+        // The segments, then the frozen head if any, the head last
+        std::vector<std::shared_ptr<Graph>> all() const {
+            std::vector<std::shared_ptr<Graph>> graphs(segments);
+            if (freezing) graphs.push_back(freezing);
+            graphs.push_back(head);
+            return graphs;
+        }
+    };
+
+    Tiers tiers() const {
+        std::unique_lock<std::mutex> lock(lock_);
+        Tiers snapshot;
+        snapshot.segments = segments_;
+        snapshot.freezing = freezing_;
+        snapshot.head = head_;
+        return snapshot;
+    }
+
+    void init(SpaceInterface<float> *s, SpaceInterface<float> *segment_space, size_t num_threads) {
+        space_ = s;
+        segment_space_ = segment_space ? segment_space : s;
+        dim_ = s->get_data_size() / sizeof(float);
+        quantized_ = segment_space ? dynamic_cast<QuantizedSpace *>(segment_space) : nullptr;
+        head_reserved_ = 0;
+        active_writers_ = 0;
+        rotating_ = false;
+        merging_ = false;
+        pool_.reset(new ThreadPool(poolThreads(num_threads)));
+    }
+
+ public:
+    /*
+    * `segment_space` is the space of the frozen segments; null uses `s`, an Int8Space or
+    * Fp16Space of the same metric stores them compressed. The head is merged in the
+    * background once it holds merge_threshold points (0: head_capacity); inserts only
+    * wait for a merge when the head is completely full.
+    */
+    TieredIndex(
+        SpaceInterface<float> *s,
+        size_t head_capacity,
+        size_t M = 16,
+        size_t ef_construction = 200,
+        size_t random_seed = 100,
+        SpaceInterface<float> *segment_space = nullptr,
+        size_t merge_threshold = 0,
+        size_t num_threads = 0)
+        : head_capacity_(head_capacity), M_(M), ef_construction_(ef_construction),
+          random_seed_(random_seed), ef_(10) {
+        if (head_capacity == 0)
+            throw std::runtime_error("A tiered index needs a head capacity");
+        merge_threshold_ = merge_threshold == 0 ? head_capacity : std::min(merge_threshold, head_capacity);
+        init(s, segment_space, num_threads);
+        head_ = newHead();
+    }
+
+    // Loads an index written by saveIndex; the spaces have to match the saved ones
+    TieredIndex(
+        SpaceInterface<float> *s,
+        const std::string &location,
+        SpaceInterface<float> *segment_space = nullptr,
+        size_t num_threads = 0) {
+        init(s, segment_space, num_threads);
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        uint64_t magic = 0, num_segments = 0, head_capacity = 0, merge_threshold = 0;
+        uint64_t M = 0, ef_construction = 0, random_seed = 0, ef = 0;
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, num_segments);
+        readBinaryPOD(input, head_capacity);
+        readBinaryPOD(input, merge_threshold);
+        readBinaryPOD(input, M);
+        readBinaryPOD(input, ef_construction);
+        readBinaryPOD(input, random_seed);
+        readBinaryPOD(input, ef);
+        if (!input || magic != FILE_MAGIC || head_capacity == 0)
+            throw std::runtime_error("Not a tiered index file");
+        head_capacity_ = head_capacity;
+        merge_threshold_ = merge_threshold;
+        M_ = M;
+        ef_construction_ = ef_construction;
+        random_seed_ = random_seed;
+        ef_ = ef;
+
+        segments_.resize(num_segments);
+        pool_->run(num_segments + 1, [&](size_t i) {
+            if (i == num_segments) {
+                head_ = std::make_shared<Graph>(space_, headLocation(location), false, head_capacity_, true);
+            } else {
+                segments_[i] = std::make_shared<Graph>(segment_space_, segmentLocation(location, i));
+            }
+        });
+        head_->setEf(ef_);
+        for (auto &segment : segments_) segment->setEf(ef_);
+        head_reserved_ = head_->cur_element_count;
+    }
+
+    ~TieredIndex() {
+        if (merge_thread_.joinable()) merge_thread_.join();
+        pool_.reset();
+    }
+
+    /*
+    * Inserts into the head; older copies of the label in the frozen head and the segments
+    * are hidden. With replace_deleted the point may take the slot of a deleted head point.
+    */
+    void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
+        while (true) {
+            std::shared_ptr<Graph> full_head;
+            {
+                WriteScope scope(*this);
+                if (reserveHeadSlot()) {
+                    {
+                        // older copies are hidden first, so the label is never found twice; until
+                        // the insert is done, readding_ keeps a merge from publishing one again
+                        std::unique_lock<std::mutex> lock(lock_);
+                        tombstones_.erase(label);
+                        readding_[label]++;
+                        if (freezing_) markIfPresent(*freezing_, label);
+                        for (auto &segment : segments_) markIfPresent(*segment, label);
+                    }
+                    // heads allow replacement, where only the replace path may revive a
+                    // label deleted in the head; it reuses that label's own slot first
+                    bool replace = replace_deleted || containsDeleted(*scope.head, label);
+                    std::exception_ptr error;
+                    try {
+                        scope.head->addPoint(data_point, label, replace);
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    {
+                        std::unique_lock<std::mutex> lock(lock_);
+                        if (--readding_[label] == 0) readding_.erase(label);
+                        // no rotation while the scope is open, so the slot is still this head's
+                        if (error) head_reserved_--;
+                    }
+                    if (error) std::rethrow_exception(error);
+                    break;
+                }
+                full_head = scope.head;
+            }
+            rotateHead(full_head, true);
+        }
+
+        bool start_merge;
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            start_merge = head_reserved_ >= merge_threshold_ && !merging_;
+        }
+        if (start_merge) rotateHead(std::shared_ptr<Graph>(), false);
+    }
+
+    // Deletes the live copy of `label`, wherever it is
+    void markDelete(labeltype label) {
+        WriteScope scope(*this);
+        std::unique_lock<std::mutex> lock(lock_);
+        bool found = markIfPresent(*scope.head, label);
+        if (freezing_) found = markIfPresent(*freezing_, label) || found;
+        for (auto &segment : segments_) found = markIfPresent(*segment, label) || found;
+        if (!found)
+            throw std::runtime_error("Label not found");
+        tombstones_.insert(label);
+    }
+
+    /*
+    * Freezes the head and merges it into a new segment in the background. Returns
+    * false if the head is empty, or if a merge is running and `wait` is not set.
+    */
+    bool merge(bool wait = true) {
+        return rotateHead(std::shared_ptr<Graph>(), wait);
+    }
+
+    // Blocks until no merge is running; rethrows the error of a failed merge
+    void waitForMerge() {
+        std::unique_lock<std::mutex> lock(lock_);
+        changed_.wait(lock, [this] { return !merging_; });
+        if (merge_thread_.joinable()) merge_thread_.join();
+        if (merge_error_) {
+            std::exception_ptr error = merge_error_;
+            merge_error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void setEf(size_t ef) {
+        std::unique_lock<std::mutex> lock(lock_);
+        ef_ = ef;
+        head_->setEf(ef);
+        if (freezing_) freezing_->setEf(ef);
+        for (auto &segment : segments_) segment->setEf(ef);
+    }
+
+    size_t getEf() const {
+        std::unique_lock<std::mutex> lock(lock_);
+        return ef_;
+    }
+
+    size_t numSegments() const {
+        std::unique_lock<std::mutex> lock(lock_);
+        return segments_.size();
+    }
+
+    // Points in the head, live and deleted
+    size_t headCount() const {
+        std::unique_lock<std::mutex> lock(lock_);
+        return head_->cur_element_count;
+    }
+
+    // Live points in all tiers
+    size_t getCurrentElementCount() const {
+        size_t count = 0;
+        for (auto &tier : tiers().all()) count += tier->cur_element_count - tier->num_deleted_;
+        return count;
+    }
+
+    size_t getDeletedCount() const {
+        size_t count = 0;
+        for (auto &tier : tiers().all()) count += tier->num_deleted_;
+        return count;
+    }
+
+    /*
+    * Copies the vectors of count labels into out (count * dim floats), each from the newest
+    * tier it is live in and decoded when that is a quantized segment. found (may be null)
+    * tells which labels exist; the rows of the others are zero filled. Returns the number found.
+    */
+    template<typename label_t>
+    size_t getItems(const label_t *labels, size_t count, float *out, bool *found) const {
+        Tiers snapshot = tiers();
+        std::vector<std::shared_ptr<Graph>> all = snapshot.all();
+        std::vector<bool> copied(count, false);
+        std::vector<tableint> ids(count);
+        size_t found_count = 0;
+
+        for (size_t t = all.size(); t-- > 0 && found_count < count;) {
+            const Graph &graph = *all[t];
+            bool encoded = quantized_ && t < snapshot.segments.size();
+            if (graph.getInternalIds(labels, count, ids.data()) == 0) continue;
+
+            size_t chunks = (count + BUILD_CHUNK - 1) / BUILD_CHUNK;
+            pool_->run(chunks, [&](size_t chunk) {
+                for (size_t i = chunk * BUILD_CHUNK; i < std::min(count, (chunk + 1) * BUILD_CHUNK); i++) {
+                    if (copied[i] || ids[i] == (tableint) -1) continue;
+                    const char *data = graph.getDataByInternalId(ids[i]);
+                    if (encoded)
+                        quantized_->decode(data, &out[i * dim_]);
+                    else
+                        memcpy(&out[i * dim_], data, dim_ * sizeof(float));
+                }
+            });
+            for (size_t i = 0; i < count; i++) {
+                if (!copied[i] && ids[i] != (tableint) -1) {
+                    copied[i] = true;
+                    found_count++;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (!copied[i]) memset(&out[i * dim_], 0, dim_ * sizeof(float));
+            if (found) found[i] = copied[i];
+        }
+        return found_count;
+    }
+
+    std::priority_queue<std::pair<float, labeltype>>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        std::vector<char> code;
+        if (quantized_) {
+            code.resize(segment_space_->get_data_size());
+            quantized_->encode((const float *) query_data, code.data());
+        }
+
+        // the segments hold codes, the head and the frozen head the vectors themselves
+        Tiers snapshot = tiers();
+        std::vector<std::pair<const Graph *, const void *>> searches;
+        for (auto &segment : snapshot.segments)
+            searches.push_back(std::make_pair(segment.get(), quantized_ ? (const void *) code.data() : query_data));
+        if (snapshot.freezing) searches.push_back(std::make_pair(snapshot.freezing.get(), query_data));
+        searches.push_back(std::make_pair(snapshot.head.get(), query_data));
+
+        // a label is live in one tier only, except while it is being re-added
+        std::unordered_map<labeltype, float> best;
+        for (auto &search : searches) {
+            auto partial = search.first->searchKnn(search.second, k, isIdAllowed);
+            while (!partial.empty()) {
+                auto found = best.find(partial.top().second);
+                if (found == best.end() || partial.top().first < found->second)
+                    best[partial.top().second] = partial.top().first;
+                partial.pop();
+            }
+        }
+
+        std::priority_queue<std::pair<float, labeltype>> result;
+        for (auto &entry : best) {
+            if (result.size() < k) {
+                result.emplace(entry.second, entry.first);
+            } else if (entry.second < result.top().first) {
+                result.pop();
+                result.emplace(entry.second, entry.first);
+            }
+        }
+        return result;
+    }
+
+    /*
+    * Waits for a running merge and writes a small header to `location`, the head to
+    * `location`.head and every segment to `location`.seg<i>. Like saving a single
+    * graph, it must not run concurrently with inserts or deletes.
+    */
+    void saveIndex(const std::string &location) {
+        waitForMerge();
+        Tiers snapshot = tiers();
+        if (snapshot.freezing)
+            throw std::runtime_error("The failed merge has to be retried with merge() before saving");
+        std::vector<std::shared_ptr<Graph>> all = snapshot.all();
+        std::ofstream output(location, std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+        uint64_t magic = FILE_MAGIC;
+        writeBinaryPOD(output, magic);
+        writeBinaryPOD(output, (uint64_t) (all.size() - 1));
+        writeBinaryPOD(output, (uint64_t) head_capacity_);
+        writeBinaryPOD(output, (uint64_t) merge_threshold_);
+        writeBinaryPOD(output, (uint64_t) M_);
+        writeBinaryPOD(output, (uint64_t) ef_construction_);
+        writeBinaryPOD(output, (uint64_t) random_seed_);
+        writeBinaryPOD(output, (uint64_t) ef_);
+        output.close();
+
+        pool_->run(all.size(), [&](size_t i) {
+            all[i]->saveIndex(i + 1 == all.size() ? headLocation(location) : segmentLocation(location, i));
+        });
+    }
+};
+
+}  // namespace hnswlib
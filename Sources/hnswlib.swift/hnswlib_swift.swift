@@ -24,6 +24,177 @@ public enum SpaceType: Int32 {
     case cosine = 2
 }
 
+/// Storage format of a quantized index
+public enum Quantization: Int32 {
+    /// 8-bit integer codes with a per-vector scale (4x smaller than Float)
+    case int8 = 0
+    /// IEEE half precision (2x smaller than Float)
+    case fp16 = 1
+}
+
+/// Work done by a single HNSW query
+public struct SearchStats {
+    /// Nodes expanded during the greedy descent through the upper layers
+    public let upperHops: Int
+    /// Distances computed in the upper layers
+    public let upperDistanceComputations: Int
+    /// Nodes expanded on level 0
+    public let baseHops: Int
+    /// Distances computed on level 0
+    public let baseDistanceComputations: Int
+    /// Nodes visited on level 0
+    public let visitedNodes: Int
+    /// Candidates kept out of the results because they were filtered out or marked deleted
+    public let filterRejects: Int
+    /// Wall time of the query in nanoseconds
+    public let wallTimeNs: UInt64
+}
+
+/// Operations that hardware counters are collected for
+public enum PerfOperation: Int32 {
+    case search = 0
+    case add = 1
+}
+
+/// Hardware counter totals collected with perf_event_open (Linux only)
+public struct PerfCounters {
+    public let operations: UInt64
+    public let cycles: UInt64
+    public let instructions: UInt64
+    public let llcMisses: UInt64
+    public let dtlbMisses: UInt64
+    public let branchMisses: UInt64
+
+    fileprivate init(raw: ArraySlice<UInt64>) {
+        let r = Array(raw)
+        operations = r[0]
+        cycles = r[1]
+        instructions = r[2]
+        llcMisses = r[3]
+        dtlbMisses = r[4]
+        branchMisses = r[5]
+    }
+}
+
+/// How a sharded index assigns labels to shards
+public enum ShardPartitioning: Int32 {
+    /// Hash of the label modulo the shard count
+    case hash = 0
+    /// Consecutive blocks of `rangeSize` labels, the last shard takes the rest
+    case range = 1
+}
+
+/// Phases of an insert timed by build profiling.
+/// Lock waits are counted per acquisition and their time is also part of the phase they happen in.
+public enum BuildPhase: Int, CaseIterable {
+    /// The whole insert, one count per point
+    case insert = 0
+    /// Greedy descent through the levels above the new point
+    case upperDescent = 1
+    /// efConstruction search on each level of the new point
+    case searchBaseLayer = 2
+    /// Neighbor selection heuristic for the new point
+    case selectNeighbors = 3
+    /// Re-pruning neighbors whose link list overflowed
+    case prune = 4
+    case waitGlobal = 5
+    case waitLinkList = 6
+    case waitLabelLookup = 7
+}
+
+/// Time spent in each phase of the inserts, see `HNSWIndex.setBuildProfiling(enabled:)`
+public struct BuildProfile {
+    /// Number of times each phase ran
+    public let counts: [BuildPhase: UInt64]
+    /// Total time of each phase in nanoseconds, summed over threads
+    public let nanoseconds: [BuildPhase: UInt64]
+
+    fileprivate init(raw: ArraySlice<UInt64>) {
+        let r = Array(raw)
+        let phases = BuildPhase.allCases.count
+        var counts = [BuildPhase: UInt64]()
+        var nanoseconds = [BuildPhase: UInt64]()
+        for phase in BuildPhase.allCases {
+            counts[phase] = r[phase.rawValue]
+            nanoseconds[phase] = r[phases + phase.rawValue]
+        }
+        self.counts = counts
+        self.nanoseconds = nanoseconds
+    }
+}
+
+/// Progress of an `addItems` call
+public struct BuildProgress {
+    /// Points added so far
+    public let done: Int
+    /// Points in the call
+    public let total: Int
+    public let pointsPerSecond: Double
+}
+
+private final class BuildProgressHandler {
+    let handler: (BuildProgress) -> Void
+
+    init(_ handler: @escaping (BuildProgress) -> Void) {
+        self.handler = handler
+    }
+}
+
+private let buildProgressCallback: @convention(c) (UInt64, UInt64, Double, UnsafeMutableRawPointer?) -> Void = { done, total, rate, userData in
+    guard let userData = userData else { return }
+    let box = Unmanaged<BuildProgressHandler>.fromOpaque(userData).takeUnretainedValue()
+    box.handler(BuildProgress(done: Int(done), total: Int(total), pointsPerSecond: rate))
+}
+
+/// Structural health of an HNSW graph, see `HNSWIndex.graphStats`
+public struct GraphStats {
+    public let numElements: Int
+    public let numDeleted: Int
+    /// Node count of each level, level 0 first
+    public let nodesPerLevel: [Int]
+    /// Out-degree histogram of each level, indexed by degree (degrees >= 128 share the last bucket)
+    public let outDegreeHistogram: [[Int]]
+    /// In-degree histogram of each level, indexed by degree (degrees >= 128 share the last bucket)
+    public let inDegreeHistogram: [[Int]]
+    /// Live nodes that cannot be reached from the entry point on level 0
+    public let unreachableNodes: Int
+    public let totalEdges: Int
+    public let edgesToDeleted: Int
+    public let deletedEdgeFraction: Double
+    /// Mean level 0 edge distance, in the units of the space
+    public let avgEdgeLength: Double
+    /// Number of stored vectors searched for to estimate navigability
+    public let navigabilitySamples: Int
+    /// Fraction of the sampled nodes a search for their own vector returns as top-1
+    public let navigability: Double
+}
+
+/// What `HNSWIndex.autotune` optimizes among the configurations meeting the target recall
+public enum TuneObjective: Int32 {
+    /// Fastest single-thread search
+    case maxQPS = 0
+    /// Smallest graph, faster search breaking ties
+    case minMemory = 1
+}
+
+/// One configuration measured by `HNSWIndex.autotune`
+public struct TuneResult {
+    public let m: Int
+    public let efConstruction: Int
+    /// Smallest ef reaching the target recall
+    public let ef: Int
+    /// Graph memory extrapolated to all rows
+    public let memoryBytes: Int
+    /// False if recall stays below the target up to the largest ef tried
+    public let meetsTarget: Bool
+    /// Recall@k at `ef`
+    public let recall: Double
+    /// Single-thread queries per second at `ef`
+    public let qps: Double
+    /// Build time of the sample graph
+    public let buildSeconds: Double
+}
+
 /// Error types that can be thrown by HNSW operations
 public enum HNSWError: Error {
     case initializationFailed
@@ -38,7 +209,8 @@ public enum HNSWError: Error {
 
 /// Main class for the HNSW index
 public class HNSWIndex {
-    private var indexPtr: OpaquePointer?
+    fileprivate var indexPtr: OpaquePointer?
+    private var buildProgressHandler: BuildProgressHandler?
     
     /// The dimension of the vectors in the index
     public let dim: Int
@@ -91,39 +263,54 @@ public class HNSWIndex {
     ///   - numThreads: Number of threads to use for parallel insertion, -1 for auto
     ///   - replaceDeleted: Whether to replace deleted elements
     public func addItems(data: [[Float]], ids: [UInt64]? = nil, numThreads: Int = -1, replaceDeleted: Bool = false) throws {
+        let rows = data.count
+        guard rows > 0 else { return }
+        
+        let flattenedData = try flatten(data)
+        try flattenedData.withUnsafeBufferPointer { dataBuffer in
+            try withOptionalBuffer(ids) { idsBuffer in
+                try addItems(data: dataBuffer, rows: rows, ids: idsBuffer, numThreads: numThreads, replaceDeleted: replaceDeleted)
+            }
+        }
+    }
+    
+    /// Add items from a contiguous row-major buffer without copying it
+    /// - Parameters:
+    ///   - data: `rows * dim` values, row after row
+    ///   - rows: Number of vectors in `data`
+    ///   - ids: Optional buffer of `rows` item IDs, if nil, sequential IDs will be assigned
+    ///   - numThreads: Number of threads to use for parallel insertion, -1 for auto
+    ///   - replaceDeleted: Whether to replace deleted elements
+    public func addItems(data: UnsafeBufferPointer<Float>, rows: Int, ids: UnsafeBufferPointer<UInt64>? = nil,
+                         numThreads: Int = -1, replaceDeleted: Bool = false) throws {
         guard let indexPtr = indexPtr else {
             throw HNSWError.initializationFailed
         }
         
-        let rows = data.count
         guard rows > 0 else { return }
-        
-        let vecDim = data[0].count
-        guard vecDim == dim else {
+        guard data.count == rows * dim, let dataPtr = data.baseAddress else {
             throw HNSWError.invalidDimension
         }
         
-        // Flatten the 2D array
-        var flattenedData = [Float](repeating: 0, count: rows * dim)
-        for i in 0..<rows {
-            for j in 0..<dim {
-                flattenedData[i * dim + j] = data[i][j]
-            }
-        }
-        
-        var idsArray: [UInt64]?
-        if let ids = ids {
-            guard ids.count == rows else {
-                throw HNSWError.addItemsFailed
-            }
-            idsArray = ids
+        if let ids = ids, ids.count != rows {
+            throw HNSWError.addItemsFailed
         }
         
-        if !hnswlib_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsArray, Int32(numThreads), replaceDeleted) {
+        if !hnswlib_index_add_items(indexPtr, dataPtr, size_t(rows), size_t(dim), ids?.baseAddress, Int32(numThreads), replaceDeleted) {
             throw HNSWError.addItemsFailed
         }
     }
     
+    /// Add items from a contiguous row-major array without copying it
+    public func addItems(data: ContiguousArray<Float>, rows: Int, ids: ContiguousArray<UInt64>? = nil,
+                         numThreads: Int = -1, replaceDeleted: Bool = false) throws {
+        try data.withUnsafeBufferPointer { dataBuffer in
+            try withOptionalBuffer(ids) { idsBuffer in
+                try addItems(data: dataBuffer, rows: rows, ids: idsBuffer, numThreads: numThreads, replaceDeleted: replaceDeleted)
+            }
+        }
+    }
+    
     /// Search for k nearest neighbors
     /// - Parameters:
     ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
@@ -131,6 +318,128 @@ public class HNSWIndex {
     ///   - numThreads: Number of threads to use for parallel search, -1 for auto
     /// - Returns: Tuple with (labels, distances) where both are 2D arrays of shape [n, k]
     public func searchKnn(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        let flattenedQuery = try flatten(query)
+        let (resultLabels, resultDistances) = try searchKnn(query: flattenedQuery, rows: queryCount, k: k, numThreads: numThreads)
+        
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (labels, distances)
+    }
+    
+    /// Search for k nearest neighbors, writing the results into caller-provided buffers
+    /// - Parameters:
+    ///   - query: `rows * dim` query values, row after row
+    ///   - rows: Number of queries in `query`
+    ///   - k: Number of nearest neighbors to return
+    ///   - labels: Receives `rows * k` labels, the neighbors of query i at [i * k, (i + 1) * k), closest first
+    ///   - distances: Receives the `rows * k` matching distances
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    public func searchKnn(query: UnsafeBufferPointer<Float>, rows: Int, k: Int, labels: UnsafeMutableBufferPointer<UInt64>,
+                          distances: UnsafeMutableBufferPointer<Float>, numThreads: Int = -1) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard rows > 0 else { return }
+        guard query.count == rows * dim, let queryPtr = query.baseAddress else {
+            throw HNSWError.invalidDimension
+        }
+        
+        guard labels.count >= rows * k, distances.count >= rows * k,
+              let labelsPtr = labels.baseAddress, let distancesPtr = distances.baseAddress else {
+            throw HNSWError.searchFailed
+        }
+        
+        if !hnswlib_index_search_knn(indexPtr, queryPtr, size_t(k), labelsPtr, distancesPtr, size_t(rows), Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+    }
+    
+    /// Search for k nearest neighbors of a contiguous row-major query array
+    /// - Returns: Flat (labels, distances) of `rows * k` entries, the neighbors of query i at [i * k, (i + 1) * k)
+    public func searchKnn(query: ContiguousArray<Float>, rows: Int, k: Int, numThreads: Int = -1) throws
+        -> (labels: ContiguousArray<UInt64>, distances: ContiguousArray<Float>) {
+        let count = rows * k
+        var distances = ContiguousArray<Float>()
+        let labels = try ContiguousArray<UInt64>(unsafeUninitializedCapacity: count) { labelsBuffer, labelsCount in
+            distances = try ContiguousArray<Float>(unsafeUninitializedCapacity: count) { distancesBuffer, distancesCount in
+                try query.withUnsafeBufferPointer { queryBuffer in
+                    try searchKnn(query: queryBuffer, rows: rows, k: k, labels: labelsBuffer, distances: distancesBuffer, numThreads: numThreads)
+                }
+                distancesCount = count
+            }
+            labelsCount = count
+        }
+        return (labels, distances)
+    }
+    
+    // Row-major copy of `rows`, one bulk append per row
+    private func flatten(_ rows: [[Float]]) throws -> ContiguousArray<Float> {
+        var flattened = ContiguousArray<Float>()
+        flattened.reserveCapacity(rows.count * dim)
+        for row in rows {
+            guard row.count == dim else {
+                throw HNSWError.invalidDimension
+            }
+            flattened.append(contentsOf: row)
+        }
+        return flattened
+    }
+    
+    /// Search for all points within `radius` of a single query, closest first
+    /// - Parameters:
+    ///   - query: The query vector
+    ///   - radius: Largest distance to return, in the units of the space (squared for L2)
+    ///   - maxResults: Upper bound on the number of results
+    /// - Returns: Tuple with (labels, distances) of the points found
+    public func searchRange(query: [Float], radius: Float, maxResults: Int) throws -> (labels: [UInt64], distances: [Float]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard query.count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        var resultLabels = [UInt64](repeating: 0, count: maxResults)
+        var resultDistances = [Float](repeating: 0, count: maxResults)
+        var count: size_t = 0
+        if !hnswlib_index_search_range(indexPtr, query, radius, size_t(maxResults), &resultLabels, &resultDistances, &count) {
+            throw HNSWError.searchFailed
+        }
+        
+        return (Array(resultLabels[0..<Int(count)]), Array(resultDistances[0..<Int(count)]))
+    }
+    
+    /// Assign labels to groups for `searchGrouped`; a label keeps the last group set for it.
+    /// Must not be called while a grouped search runs.
+    public func setGroups(labels: [UInt64], groups: [UInt64]) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard labels.count == groups.count, hnswlib_index_set_groups(indexPtr, labels, groups, size_t(labels.count)) else {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for the k nearest neighbors with at most `maxPerGroup` of them in any one group,
+    /// e.g. "top 50 but at most 3 per seller"; `maxPerGroup` 1 returns k distinct groups.
+    /// The graph is traversed until enough points within the caps are found, rather than
+    /// searching with a large k and filtering. Labels without a group are never capped.
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of results per query
+    ///   - maxPerGroup: Most results taken from one group
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances) per query, closest first; fewer than k when
+    ///   the caps leave fewer points
+    public func searchGrouped(query: [[Float]], k: Int, maxPerGroup: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
         guard let indexPtr = indexPtr else {
             throw HNSWError.initializationFailed
         }
@@ -140,39 +449,265 @@ public class HNSWIndex {
             return ([], [])
         }
         
-        let vecDim = query[0].count
-        guard vecDim == dim else {
+        guard query[0].count == dim else {
             throw HNSWError.invalidDimension
         }
         
-        // Flatten the 2D array
-        var flattenedQuery = [Float](repeating: 0, count: queryCount * dim)
-        for i in 0..<queryCount {
-            for j in 0..<dim {
-                flattenedQuery[i * dim + j] = query[i][j]
-            }
+        let flattenedQuery = query.flatMap { $0 }
+        var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        var resultCounts = [size_t](repeating: 0, count: queryCount)
+        
+        if !hnswlib_index_search_grouped(indexPtr, flattenedQuery, size_t(queryCount), size_t(k), size_t(maxPerGroup),
+                                         &resultLabels, &resultDistances, &resultCounts, Int32(numThreads)) {
+            throw HNSWError.searchFailed
         }
         
-        // Allocate arrays for results
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<($0 * k + Int(resultCounts[$0]))]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<($0 * k + Int(resultCounts[$0]))]) }
+        return (labels, distances)
+    }
+    
+    /// Search for k nearest neighbors and report the work each query took.
+    /// Every query is also recorded in the index's latency / work histograms, see `prometheusMetrics()`.
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of nearest neighbors to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances, stats), labels and distances of shape [n, k] and one stats entry per query
+    public func searchKnnWithStats(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]], stats: [SearchStats]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [], [])
+        }
+        
+        guard query[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
         var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
         var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        // HNSWSearchStats is seven uint64_t fields
+        let statsFields = 7
+        var rawStats = [UInt64](repeating: 0, count: queryCount * statsFields)
         
-        if !hnswlib_index_search_knn(indexPtr, flattenedQuery, size_t(k), &resultLabels, &resultDistances, size_t(queryCount), Int32(numThreads)) {
+        if !hnswlib_index_search_knn_with_stats(indexPtr, flattenedQuery, size_t(k), &resultLabels, &resultDistances, size_t(queryCount), Int32(numThreads), &rawStats) {
             throw HNSWError.searchFailed
         }
         
-        // Reshape results
-        var labels = [[UInt64]](repeating: [UInt64](repeating: 0, count: k), count: queryCount)
-        var distances = [[Float]](repeating: [Float](repeating: 0, count: k), count: queryCount)
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        let stats = (0..<queryCount).map { i -> SearchStats in
+            let s = rawStats[(i * statsFields)..<((i + 1) * statsFields)].map { $0 }
+            return SearchStats(upperHops: Int(s[0]), upperDistanceComputations: Int(s[1]), baseHops: Int(s[2]),
+                               baseDistanceComputations: Int(s[3]), visitedNodes: Int(s[4]), filterRejects: Int(s[5]),
+                               wallTimeNs: s[6])
+        }
+        return (labels, distances, stats)
+    }
+    
+    /// Clear the histograms filled by `searchKnnWithStats`
+    public func resetQueryHistograms() {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_index_reset_query_histograms(indexPtr)
+    }
+    
+    /// Latency and work histograms of the queries run through `searchKnnWithStats`, in the Prometheus text format
+    public func prometheusMetrics() -> String {
+        guard let indexPtr = indexPtr else { return "" }
+        let length = hnswlib_index_export_prometheus(indexPtr, nil, 0)
+        var buffer = [CChar](repeating: 0, count: length + 1)
+        _ = hnswlib_index_export_prometheus(indexPtr, &buffer, buffer.count)
+        return String(cString: buffer)
+    }
+    
+    /// Whether hardware counters can be read on this machine
+    public static var perfCountersAvailable: Bool {
+        return hnswlib_perf_counters_available()
+    }
+    
+    /// Collect hardware counters around every search and insert
+    /// - Parameter enabled: Whether to collect
+    /// - Returns: false if counters are requested but not available
+    @discardableResult
+    public func setPerfCounters(enabled: Bool) -> Bool {
+        guard let indexPtr = indexPtr else { return false }
+        return hnswlib_index_set_perf_counters(indexPtr, enabled)
+    }
+    
+    /// Counter totals of an operation over all threads
+    public func perfCounters(operation: PerfOperation) -> PerfCounters {
+        var raw = [UInt64](repeating: 0, count: 6)
+        if let indexPtr = indexPtr {
+            _ = hnswlib_index_get_perf_counters(indexPtr, operation.rawValue, &raw)
+        }
+        return PerfCounters(raw: raw[0..<6])
+    }
+    
+    /// Counter totals of an operation, one entry per worker thread slot
+    public func perfCountersPerThread(operation: PerfOperation) -> [PerfCounters] {
+        guard let indexPtr = indexPtr else { return [] }
+        let count = hnswlib_index_get_perf_counters_per_thread(indexPtr, operation.rawValue, nil, 0)
+        var raw = [UInt64](repeating: 0, count: count * 6)
+        _ = hnswlib_index_get_perf_counters_per_thread(indexPtr, operation.rawValue, &raw, count)
+        return (0..<count).map { PerfCounters(raw: raw[($0 * 6)..<(($0 + 1) * 6)]) }
+    }
+    
+    /// Clear the collected hardware counters
+    public func resetPerfCounters() {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_index_reset_perf_counters(indexPtr)
+    }
+    
+    /// Time the phases of every insert (descent, base layer search, neighbor selection, pruning, lock waits)
+    public func setBuildProfiling(enabled: Bool) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_index_set_build_profiling(indexPtr, enabled)
+    }
+    
+    /// Phase timings of all inserts since the last reset, summed over threads
+    public func buildProfile() -> BuildProfile {
+        let fields = 2 * BuildPhase.allCases.count
+        var raw = [UInt64](repeating: 0, count: fields)
+        if let indexPtr = indexPtr {
+            _ = hnswlib_index_get_build_profile(indexPtr, &raw)
+        }
+        return BuildProfile(raw: raw[0..<fields])
+    }
+    
+    /// Phase timings, one entry per worker thread slot
+    public func buildProfilePerThread() -> [BuildProfile] {
+        guard let indexPtr = indexPtr else { return [] }
+        let fields = 2 * BuildPhase.allCases.count
+        let count = hnswlib_index_get_build_profile_per_thread(indexPtr, nil, 0)
+        var raw = [UInt64](repeating: 0, count: count * fields)
+        _ = hnswlib_index_get_build_profile_per_thread(indexPtr, &raw, count)
+        return (0..<count).map { BuildProfile(raw: raw[($0 * fields)..<(($0 + 1) * fields)]) }
+    }
+    
+    /// Clear the collected phase timings
+    public func resetBuildProfile() {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_index_reset_build_profile(indexPtr)
+    }
+    
+    /// Report the progress of `addItems` calls
+    /// - Parameters:
+    ///   - interval: Number of points between reports; the last point of each call is always reported
+    ///   - handler: Called from the inserting threads, one call at a time; nil stops reporting
+    public func setBuildProgress(interval: Int = 10000, handler: ((BuildProgress) -> Void)?) {
+        guard let indexPtr = indexPtr else { return }
+        guard let handler = handler else {
+            hnswlib_index_set_build_progress(indexPtr, nil, nil, 0)
+            buildProgressHandler = nil
+            return
+        }
+        let box = BuildProgressHandler(handler)
+        hnswlib_index_set_build_progress(indexPtr, buildProgressCallback, Unmanaged.passUnretained(box).toOpaque(), size_t(interval))
+        buildProgressHandler = box
+    }
+    
+    /// Walk the graph and report its structure. Must not run concurrently with inserts.
+    /// - Parameters:
+    ///   - navigabilitySamples: Number of stored vectors to search for with the current ef
+    ///   - numThreads: Number of threads to use, -1 for auto
+    public func graphStats(navigabilitySamples: Int = 1000, numThreads: Int = -1) throws -> GraphStats {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
         
-        for i in 0..<queryCount {
-            for j in 0..<k {
-                labels[i][j] = resultLabels[i * k + j]
-                distances[i][j] = resultDistances[i * k + j]
-            }
+        // HNSWGraphStats is ten 8-byte scalars followed by the level counts and two histograms
+        let maxLevels = 16
+        let buckets = 129
+        var raw = [UInt64](repeating: 0, count: 10 + maxLevels + 2 * maxLevels * buckets)
+        if !hnswlib_index_graph_stats(indexPtr, size_t(navigabilitySamples), Int32(numThreads), &raw) {
+            throw HNSWError.searchFailed
         }
         
-        return (labels, distances)
+        let levels = min(Int(raw[2]), maxLevels)
+        let histogram = { (offset: Int) -> [[Int]] in
+            (0..<levels).map { l in raw[(offset + l * buckets)..<(offset + (l + 1) * buckets)].map { Int($0) } }
+        }
+        return GraphStats(numElements: Int(raw[0]), numDeleted: Int(raw[1]),
+                          nodesPerLevel: raw[10..<(10 + levels)].map { Int($0) },
+                          outDegreeHistogram: histogram(10 + maxLevels),
+                          inDegreeHistogram: histogram(10 + maxLevels + maxLevels * buckets),
+                          unreachableNodes: Int(raw[3]), totalEdges: Int(raw[4]), edgesToDeleted: Int(raw[5]),
+                          deletedEdgeFraction: Double(bitPattern: raw[7]), avgEdgeLength: Double(bitPattern: raw[8]),
+                          navigabilitySamples: Int(raw[6]), navigability: Double(bitPattern: raw[9]))
+    }
+    
+    /// Pick M, ef_construction and ef for `data` so that recall@k on `queries` reaches
+    /// `targetRecall` at the highest QPS or lowest memory. Graphs are built on `sampleSize`
+    /// evenly spaced rows for a grid of M (8...48) and ef_construction (64...512) values,
+    /// cheapest first, until `budgetSeconds` have passed, and ef is calibrated for each
+    /// against exact neighbors within the sample.
+    /// - Returns: The best configuration (the highest recall one if none meets the target)
+    ///   and every configuration measured
+    public static func autotune(spaceType: SpaceType, data: [[Float]], queries: [[Float]], k: Int = 10,
+                                targetRecall: Double = 0.9, objective: TuneObjective = .maxQPS,
+                                budgetSeconds: Double = 60, sampleSize: Int = 20000,
+                                numThreads: Int = -1) throws -> (best: TuneResult, tried: [TuneResult]) {
+        guard let dim = data.first?.count, !queries.isEmpty else {
+            throw HNSWError.invalidDimension
+        }
+        guard queries[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        // HNSWTuneResult is five uint64_t fields followed by three doubles
+        let fields = 8
+        let maxTried = 64
+        var rawBest = [UInt64](repeating: 0, count: fields)
+        var rawTried = [UInt64](repeating: 0, count: maxTried * fields)
+        var numTried: size_t = 0
+        if !hnswlib_autotune(spaceType.rawValue, Int32(dim), data.flatMap { $0 }, size_t(data.count),
+                             queries.flatMap { $0 }, size_t(queries.count), size_t(k), targetRecall,
+                             objective.rawValue, budgetSeconds, size_t(sampleSize), Int32(numThreads),
+                             &rawBest, &rawTried, size_t(maxTried), &numTried) {
+            throw HNSWError.searchFailed
+        }
+        
+        let result = { (r: ArraySlice<UInt64>) -> TuneResult in
+            let s = Array(r)
+            return TuneResult(m: Int(s[0]), efConstruction: Int(s[1]), ef: Int(s[2]), memoryBytes: Int(s[3]),
+                              meetsTarget: s[4] != 0, recall: Double(bitPattern: s[5]),
+                              qps: Double(bitPattern: s[6]), buildSeconds: Double(bitPattern: s[7]))
+        }
+        let tried = (0..<min(Int(numTried), maxTried)).map { result(rawTried[($0 * fields)..<(($0 + 1) * fields)]) }
+        return (result(rawBest[0..<fields]), tried)
+    }
+    
+    /// For each k in `ks` (all positive), the smallest ef (up to `maxEf`) whose recall@k on the held-out
+    /// `queries` reaches `targetRecall`, with the recall at that ef. Exact neighbors come
+    /// from a scan of the index. The ef of the index is left unchanged; do not search or
+    /// insert while calibrating.
+    public func calibrateEf(queries: [[Float]], ks: [Int], targetRecall: Double, maxEf: Int = 1024,
+                            numThreads: Int = -1) throws -> [(k: Int, ef: Int, recall: Double)] {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        guard !queries.isEmpty, !ks.isEmpty else {
+            return []
+        }
+        guard queries[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let kValues = ks.map { size_t($0) }
+        var efs = [size_t](repeating: 0, count: ks.count)
+        var recalls = [Double](repeating: 0, count: ks.count)
+        if !hnswlib_index_calibrate_ef(indexPtr, queries.flatMap { $0 }, size_t(queries.count), kValues,
+                                       size_t(ks.count), targetRecall, size_t(maxEf), &efs, &recalls,
+                                       Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        return (0..<ks.count).map { (k: ks[$0], ef: Int(efs[$0]), recall: recalls[$0]) }
     }
     
     /// Set the ef parameter (search time accuracy vs. speed tradeoff)
@@ -182,6 +717,24 @@ public class HNSWIndex {
         hnswlib_index_set_ef(indexPtr, size_t(ef))
     }
     
+    /// Cosine only: promise that inserted and query vectors already have unit length,
+    /// so they are used as is instead of being normalized
+    public func setAssumeNormalized(_ assumeNormalized: Bool) throws {
+        guard let indexPtr = indexPtr, hnswlib_index_set_assume_normalized(indexPtr, assumeNormalized) else {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Build a single-level graph: inserts and searches start from the closest of
+    /// `numRouters` routing elements instead of descending upper levels, which for
+    /// high-dimensional embeddings saves their memory at about the same recall.
+    /// Call before adding items, or after loading an index built this way (the mode is not saved).
+    public func setFlat(numRouters: Int = 32) throws {
+        guard let indexPtr = indexPtr, hnswlib_index_set_flat(indexPtr, size_t(numRouters)) else {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
     /// Get current count of elements in the index
     public var currentCount: Int {
         guard let indexPtr = indexPtr else { return 0 }
@@ -242,11 +795,40 @@ public class HNSWIndex {
         }
     }
     
+    /// Stored vectors of the given labels, nil for labels that are unknown or deleted.
+    /// Cosine indices return the normalized vectors.
+    public func getItems(labels: [UInt64], numThreads: Int = -1) -> [[Float]?] {
+        guard !labels.isEmpty else { return [] }
+        var data = [Float](repeating: 0, count: labels.count * dim)
+        var found = [Bool](repeating: false, count: labels.count)
+        labels.withUnsafeBufferPointer { labelsBuffer in
+            data.withUnsafeMutableBufferPointer { dataBuffer in
+                found.withUnsafeMutableBufferPointer { foundBuffer in
+                    _ = getItems(labels: labelsBuffer, into: dataBuffer, found: foundBuffer, numThreads: numThreads)
+                }
+            }
+        }
+        return (0..<labels.count).map { found[$0] ? Array(data[($0 * dim)..<(($0 + 1) * dim)]) : nil }
+    }
+    
+    /// Copy the stored vectors of the given labels into a caller buffer of `labels.count * dim` values;
+    /// the rows of unknown or deleted labels are zero filled
+    /// - Returns: The number of labels found
+    @discardableResult
+    public func getItems(labels: UnsafeBufferPointer<UInt64>, into out: UnsafeMutableBufferPointer<Float>,
+                         found: UnsafeMutableBufferPointer<Bool>? = nil, numThreads: Int = -1) -> Int {
+        guard let indexPtr = indexPtr, let labelsPtr = labels.baseAddress, let outPtr = out.baseAddress,
+              out.count >= labels.count * dim, (found?.count ?? labels.count) >= labels.count else { return 0 }
+        return Int(hnswlib_index_get_items(indexPtr, labelsPtr, size_t(labels.count), outPtr, found?.baseAddress, Int32(numThreads)))
+    }
+    
     /// Mark an item as deleted
     /// - Parameter label: ID of the item to mark as deleted
-    public func markDeleted(label: UInt64) {
-        guard let indexPtr = indexPtr else { return }
-        hnswlib_index_mark_deleted(indexPtr, label)
+    /// - Returns: False if no live item has this label
+    @discardableResult
+    public func markDeleted(label: UInt64) -> Bool {
+        guard let indexPtr = indexPtr else { return false }
+        return hnswlib_index_mark_deleted(indexPtr, label)
     }
     
     /// Unmark a previously deleted item
@@ -386,11 +968,31 @@ public class BFIndex {
             idsArray = ids
         }
         
-        if !hnswlib_bf_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsArray) {
+        let added = withOptionalBuffer(idsArray) { idsBuffer in
+            hnswlib_bf_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsBuffer?.baseAddress)
+        }
+        if !added {
             throw HNSWError.addItemsFailed
         }
     }
     
+    /// Cosine only: promise that inserted and query vectors already have unit length,
+    /// so they are used as is instead of being normalized
+    public func setAssumeNormalized(_ assumeNormalized: Bool) throws {
+        guard let indexPtr = indexPtr, hnswlib_bf_index_set_assume_normalized(indexPtr, assumeNormalized) else {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Remove an item from the index
+    /// - Parameter label: ID of the item to remove
+    /// - Returns: False if no item has this label
+    @discardableResult
+    public func removeItem(label: UInt64) -> Bool {
+        guard let indexPtr = indexPtr else { return false }
+        return hnswlib_bf_index_remove(indexPtr, label)
+    }
+    
     /// Search for k nearest neighbors
     /// - Parameters:
     ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
@@ -443,6 +1045,1269 @@ public class BFIndex {
     }
 }
 
+/// BruteForce index storing int8 or fp16 vectors, for faster memory-bound exact-ish scans
+public class BFQuantizedIndex {
+    private var indexPtr: OpaquePointer?
+    
+    /// The dimension of the vectors in the index
+    public let dim: Int
+    
+    /// The space type (L2, inner product, cosine)
+    public let spaceType: SpaceType
+    
+    /// The storage format of the vectors
+    public let quantization: Quantization
+    
+    /// Creates a new quantized BruteForce index
+    /// - Parameters:
+    ///   - spaceType: The distance metric to use
+    ///   - quantization: The storage format of the vectors
+    ///   - dim: The dimension of vectors to index
+    public init(spaceType: SpaceType, quantization: Quantization, dim: Int) throws {
+        self.spaceType = spaceType
+        self.quantization = quantization
+        self.dim = dim
+        
+        guard let indexPtr = hnswlib_bfq_index_create(spaceType.rawValue, quantization.rawValue, Int32(dim)) else {
+            throw HNSWError.initializationFailed
+        }
+        
+        self.indexPtr = indexPtr
+    }
+    
+    deinit {
+        if let indexPtr = indexPtr {
+            hnswlib_bfq_index_free(indexPtr)
+        }
+    }
+    
+    /// Initialize the index with parameters
+    /// - Parameters:
+    ///   - maxElements: Maximum number of elements the index can hold
+    ///   - keepFloatVectors: Whether to also keep float copies of the vectors for reranking
+    public func initIndex(maxElements: Int, keepFloatVectors: Bool = false) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_bfq_index_init(indexPtr, size_t(maxElements), keepFloatVectors) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Set how many quantized candidates are reranked with exact distances
+    /// - Parameter rerankK: Number of candidates to rerank, 0 to disable (requires keepFloatVectors)
+    public func setRerank(rerankK: Int) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_bfq_index_set_rerank(indexPtr, size_t(rerankK))
+    }
+    
+    /// Add items to the index
+    /// - Parameters:
+    ///   - data: The vectors to add, should be a 2D array of dimension [n, dim]
+    ///   - ids: Optional array of item IDs, if nil, sequential IDs will be assigned
+    public func addItems(data: [[Float]], ids: [UInt64]? = nil) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let rows = data.count
+        guard rows > 0 else { return }
+        
+        guard data[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        
+        if let ids = ids, ids.count != rows {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let added = withOptionalBuffer(ids) { idsBuffer in
+            hnswlib_bfq_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsBuffer?.baseAddress)
+        }
+        if !added {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for k nearest neighbors
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of nearest neighbors to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances) where both are 2D arrays of shape [n, k]
+    public func searchKnn(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        guard query[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        
+        if !hnswlib_bfq_index_search_knn(indexPtr, flattenedQuery, size_t(k), &resultLabels, &resultDistances, size_t(queryCount), Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (labels, distances)
+    }
+}
+
+/// N independent HNSW graphs behind one index. Inserts into different shards do not contend,
+/// and a search runs on all shards concurrently and merges their top-k.
+public class ShardedHNSWIndex {
+    private var indexPtr: OpaquePointer?
+    
+    /// The dimension of the vectors in the index
+    public let dim: Int
+    
+    /// The space type (L2, inner product, cosine)
+    public let spaceType: SpaceType
+    
+    /// Creates a new sharded index
+    /// - Parameters:
+    ///   - spaceType: The distance metric to use
+    ///   - dim: The dimension of vectors to index
+    public init(spaceType: SpaceType, dim: Int) throws {
+        self.spaceType = spaceType
+        self.dim = dim
+        
+        guard let indexPtr = hnswlib_sharded_index_create(spaceType.rawValue, Int32(dim)) else {
+            throw HNSWError.initializationFailed
+        }
+        
+        self.indexPtr = indexPtr
+    }
+    
+    deinit {
+        if let indexPtr = indexPtr {
+            hnswlib_sharded_index_free(indexPtr)
+        }
+    }
+    
+    /// Initialize the shards
+    /// - Parameters:
+    ///   - numShards: Number of independent HNSW graphs
+    ///   - maxElementsPerShard: Capacity of each shard
+    ///   - m: Number of bidirectional links created for each element during construction
+    ///   - efConstruction: Size of the dynamic list for the nearest neighbors during construction
+    ///   - randomSeed: Seed for the random number generator, shard i uses randomSeed + i
+    ///   - allowReplaceDeleted: Whether to allow replacing deleted elements
+    ///   - partitioning: How labels are assigned to shards
+    ///   - rangeSize: Labels per shard for range partitioning
+    ///   - numThreads: Size of the thread pool that searches the shards, -1 for auto
+    public func initIndex(numShards: Int, maxElementsPerShard: Int, m: Int = 16, efConstruction: Int = 200, randomSeed: UInt = 100,
+                          allowReplaceDeleted: Bool = false, partitioning: ShardPartitioning = .hash, rangeSize: Int = 0, numThreads: Int = -1) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_sharded_index_init(indexPtr, size_t(numShards), size_t(maxElementsPerShard), size_t(m), size_t(efConstruction), size_t(randomSeed),
+                                       allowReplaceDeleted, partitioning.rawValue, size_t(rangeSize), Int32(numThreads)) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Add items to the index, each to the shard of its label
+    /// - Parameters:
+    ///   - data: The vectors to add, should be a 2D array of dimension [n, dim]
+    ///   - ids: Optional array of item IDs, if nil, sequential IDs will be assigned
+    ///   - numThreads: Number of threads to use for parallel insertion, -1 for auto
+    ///   - replaceDeleted: Whether to replace deleted elements
+    public func addItems(data: [[Float]], ids: [UInt64]? = nil, numThreads: Int = -1, replaceDeleted: Bool = false) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let rows = data.count
+        guard rows > 0 else { return }
+        
+        guard data[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        if let ids = ids, ids.count != rows {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        let added = withOptionalBuffer(ids) { idsBuffer in
+            hnswlib_sharded_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsBuffer?.baseAddress, Int32(numThreads), replaceDeleted)
+        }
+        if !added {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for k nearest neighbors over all shards
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of nearest neighbors to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances) where both are 2D arrays of shape [n, k]
+    public func searchKnn(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        guard query[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        
+        if !hnswlib_sharded_index_search_knn(indexPtr, flattenedQuery, size_t(k), &resultLabels, &resultDistances, size_t(queryCount), Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (labels, distances)
+    }
+    
+    /// Set the ef parameter of every shard
+    public func setEf(ef: Int) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_sharded_index_set_ef(indexPtr, size_t(ef))
+    }
+    
+    /// Number of elements over all shards
+    public var currentCount: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_sharded_index_get_current_count(indexPtr))
+    }
+    
+    /// Total capacity over all shards
+    public var maxElements: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_sharded_index_get_max_elements(indexPtr))
+    }
+    
+    public var numShards: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_sharded_index_get_num_shards(indexPtr))
+    }
+    
+    /// Mark an item as deleted
+    public func markDeleted(label: UInt64) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_sharded_index_mark_deleted(indexPtr, label)
+    }
+    
+    /// Unmark a previously deleted item
+    public func unmarkDeleted(label: UInt64) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_sharded_index_unmark_deleted(indexPtr, label)
+    }
+    
+    /// Resize every shard to a new capacity
+    public func resizeIndex(newSizePerShard: Int) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_sharded_index_resize(indexPtr, size_t(newSizePerShard)) {
+            throw HNSWError.resizeFailed
+        }
+    }
+    
+    /// Save the index; shard i is written in parallel to "<path>.shard<i>"
+    public func saveIndex(path: String) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !path.isEmpty, hnswlib_sharded_index_save(indexPtr, path) else {
+            throw HNSWError.saveFailed
+        }
+    }
+    
+    /// Load an index written by `saveIndex`, reading the shards in parallel
+    /// - Parameters:
+    ///   - spaceType: Space type of the index
+    ///   - dim: Dimensionality of the index
+    ///   - path: Path the index was saved to
+    ///   - maxElementsPerShard: Capacity of each shard (0 to use the values from the files)
+    ///   - allowReplaceDeleted: Whether deleted elements can be replaced
+    ///   - numThreads: Size of the thread pool, -1 for auto
+    public static func loadIndex(spaceType: SpaceType, dim: Int, path: String, maxElementsPerShard: Int = 0,
+                                 allowReplaceDeleted: Bool = false, numThreads: Int = -1) throws -> ShardedHNSWIndex {
+        guard !path.isEmpty,
+              let indexPtr = hnswlib_sharded_index_load(spaceType.rawValue, Int32(dim), path, size_t(maxElementsPerShard), allowReplaceDeleted, Int32(numThreads)) else {
+            throw HNSWError.loadFailed
+        }
+        
+        let index = try ShardedHNSWIndex(spaceType: spaceType, dim: dim)
+        hnswlib_sharded_index_free(index.indexPtr!)
+        index.indexPtr = indexPtr
+        return index
+    }
+}
+
+/// IVF-style index: k-means partitions, each its own HNSW graph. A query searches only
+/// the `nprobe` partitions with the closest centroids.
+public class PartitionedHNSWIndex {
+    private var indexPtr: OpaquePointer?
+    
+    /// The dimension of the vectors in the index
+    public let dim: Int
+    
+    /// The space type (L2, inner product, cosine)
+    public let spaceType: SpaceType
+    
+    /// Creates a new partitioned index
+    /// - Parameters:
+    ///   - spaceType: The distance metric to use
+    ///   - dim: The dimension of vectors to index
+    public init(spaceType: SpaceType, dim: Int) throws {
+        self.spaceType = spaceType
+        self.dim = dim
+        
+        guard let indexPtr = hnswlib_partitioned_index_create(spaceType.rawValue, Int32(dim)) else {
+            throw HNSWError.initializationFailed
+        }
+        
+        self.indexPtr = indexPtr
+    }
+    
+    deinit {
+        if let indexPtr = indexPtr {
+            hnswlib_partitioned_index_free(indexPtr)
+        }
+    }
+    
+    /// Create the (empty) partitions
+    /// - Parameters:
+    ///   - numPartitions: Number of k-means partitions
+    ///   - maxElementsPerPartition: Initial capacity of each partition, `addItems` grows partitions as needed
+    ///   - m: Number of bidirectional links created for each element during construction
+    ///   - efConstruction: Size of the dynamic list for the nearest neighbors during construction
+    ///   - randomSeed: Seed for the random number generator, partition i uses randomSeed + i
+    ///   - allowReplaceDeleted: Whether to allow replacing deleted elements
+    ///   - numThreads: Size of the thread pool used to train, build and search, -1 for auto
+    public func initIndex(numPartitions: Int, maxElementsPerPartition: Int, m: Int = 16, efConstruction: Int = 200, randomSeed: UInt = 100,
+                          allowReplaceDeleted: Bool = false, numThreads: Int = -1) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_partitioned_index_init(indexPtr, size_t(numPartitions), size_t(maxElementsPerPartition), size_t(m), size_t(efConstruction),
+                                           size_t(randomSeed), allowReplaceDeleted, Int32(numThreads)) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Compute the partition centroids with k-means; required before `addItems`
+    /// - Parameters:
+    ///   - data: Training sample, at least one vector per partition
+    ///   - iterations: Number of k-means iterations
+    public func train(data: [[Float]], iterations: Int = 10) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !data.isEmpty, data[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        if !hnswlib_partitioned_index_train(indexPtr, flattenedData, size_t(data.count), size_t(dim), size_t(iterations)) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Store points near a boundary in up to `maxReplicas` partitions: the closest one and any other
+    /// whose centroid distance is within `boundaryFactor` times the closest distance
+    public func setReplication(maxReplicas: Int, boundaryFactor: Float) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_partitioned_index_set_replication(indexPtr, size_t(maxReplicas), boundaryFactor)
+    }
+    
+    /// Number of partitions each query searches
+    public var nprobe: Int {
+        get {
+            guard let indexPtr = indexPtr else { return 0 }
+            return Int(hnswlib_partitioned_index_get_nprobe(indexPtr))
+        }
+        set {
+            guard let indexPtr = indexPtr else { return }
+            hnswlib_partitioned_index_set_nprobe(indexPtr, size_t(newValue))
+        }
+    }
+    
+    /// Set the ef parameter of every partition
+    public func setEf(ef: Int) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_partitioned_index_set_ef(indexPtr, size_t(ef))
+    }
+    
+    /// Add items, building all partitions in parallel. Must not run concurrently with searches.
+    /// - Parameters:
+    ///   - data: The vectors to add, should be a 2D array of dimension [n, dim]
+    ///   - ids: Optional array of item IDs, if nil, sequential IDs will be assigned
+    ///   - replaceDeleted: Whether to replace deleted elements
+    public func addItems(data: [[Float]], ids: [UInt64]? = nil, replaceDeleted: Bool = false) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let rows = data.count
+        guard rows > 0 else { return }
+        
+        guard data[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        if let ids = ids, ids.count != rows {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        let added = withOptionalBuffer(ids) { idsBuffer in
+            hnswlib_partitioned_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsBuffer?.baseAddress, replaceDeleted)
+        }
+        if !added {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for k nearest neighbors in the `nprobe` closest partitions
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of nearest neighbors to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances) where both are 2D arrays of shape [n, k]
+    public func searchKnn(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        guard query[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        
+        if !hnswlib_partitioned_index_search_knn(indexPtr, flattenedQuery, size_t(k), &resultLabels, &resultDistances, size_t(queryCount), Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (labels, distances)
+    }
+    
+    /// Number of stored vectors, replicas included
+    public var currentCount: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_partitioned_index_get_current_count(indexPtr))
+    }
+    
+    public var numPartitions: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_partitioned_index_get_num_partitions(indexPtr))
+    }
+    
+    /// Number of stored vectors in each partition
+    public var partitionSizes: [Int] {
+        guard let indexPtr = indexPtr else { return [] }
+        let count = hnswlib_partitioned_index_get_partition_sizes(indexPtr, nil, 0)
+        var sizes = [UInt64](repeating: 0, count: count)
+        _ = hnswlib_partitioned_index_get_partition_sizes(indexPtr, &sizes, count)
+        return sizes.map { Int($0) }
+    }
+    
+    /// Mark an item as deleted in every partition that holds it
+    public func markDeleted(label: UInt64) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_partitioned_index_mark_deleted(indexPtr, label)
+    }
+    
+    /// Save the index; partition i is written in parallel to "<path>.part<i>"
+    public func saveIndex(path: String) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !path.isEmpty, hnswlib_partitioned_index_save(indexPtr, path) else {
+            throw HNSWError.saveFailed
+        }
+    }
+    
+    /// Load an index written by `saveIndex`, reading the partitions in parallel
+    /// - Parameters:
+    ///   - spaceType: Space type of the index
+    ///   - dim: Dimensionality of the index
+    ///   - path: Path the index was saved to
+    ///   - maxElementsPerPartition: Capacity of each partition (0 to use the values from the files)
+    ///   - allowReplaceDeleted: Whether deleted elements can be replaced
+    ///   - numThreads: Size of the thread pool, -1 for auto
+    public static func loadIndex(spaceType: SpaceType, dim: Int, path: String, maxElementsPerPartition: Int = 0,
+                                 allowReplaceDeleted: Bool = false, numThreads: Int = -1) throws -> PartitionedHNSWIndex {
+        guard !path.isEmpty,
+              let indexPtr = hnswlib_partitioned_index_load(spaceType.rawValue, Int32(dim), path, size_t(maxElementsPerPartition), allowReplaceDeleted, Int32(numThreads)) else {
+            throw HNSWError.loadFailed
+        }
+        
+        let index = try PartitionedHNSWIndex(spaceType: spaceType, dim: dim)
+        hnswlib_partitioned_index_free(index.indexPtr!)
+        index.indexPtr = indexPtr
+        return index
+    }
+}
+
+/// LSM-style index for continuous ingest into mostly static data: inserts go into a small
+/// mutable head graph that is merged in the background into immutable, optionally quantized
+/// segments. Inserts, deletes and searches can be called from several threads at once.
+public class TieredHNSWIndex {
+    private var indexPtr: OpaquePointer?
+    
+    /// The dimension of the vectors in the index
+    public let dim: Int
+    
+    /// The space type (L2, inner product, cosine)
+    public let spaceType: SpaceType
+    
+    /// Creates a new tiered index
+    /// - Parameters:
+    ///   - spaceType: The distance metric to use
+    ///   - dim: The dimension of vectors to index
+    public init(spaceType: SpaceType, dim: Int) throws {
+        self.spaceType = spaceType
+        self.dim = dim
+        
+        guard let indexPtr = hnswlib_tiered_index_create(spaceType.rawValue, Int32(dim)) else {
+            throw HNSWError.initializationFailed
+        }
+        
+        self.indexPtr = indexPtr
+    }
+    
+    deinit {
+        if let indexPtr = indexPtr {
+            hnswlib_tiered_index_free(indexPtr)
+        }
+    }
+    
+    /// Create the (empty) head
+    /// - Parameters:
+    ///   - headCapacity: Maximum number of points in the mutable head
+    ///   - m: Number of bidirectional links created for each element during construction
+    ///   - efConstruction: Size of the dynamic list for the nearest neighbors during construction
+    ///   - randomSeed: Seed for the random number generator
+    ///   - mergeThreshold: Head size that starts a background merge, 0 for `headCapacity`
+    ///   - segmentQuantization: Storage format of the frozen segments, nil to keep them as Float
+    ///   - numThreads: Size of the thread pool used to build segments, -1 for auto
+    public func initIndex(headCapacity: Int, m: Int = 16, efConstruction: Int = 200, randomSeed: UInt = 100, mergeThreshold: Int = 0,
+                          segmentQuantization: Quantization? = nil, numThreads: Int = -1) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_tiered_index_init(indexPtr, size_t(headCapacity), size_t(m), size_t(efConstruction), size_t(randomSeed),
+                                      size_t(mergeThreshold), segmentQuantization != nil, (segmentQuantization ?? .int8).rawValue, Int32(numThreads)) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Set the ef parameter of the head and all segments
+    public func setEf(ef: Int) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_tiered_index_set_ef(indexPtr, size_t(ef))
+    }
+    
+    /// Add items to the head; an existing label is replaced
+    /// - Parameters:
+    ///   - data: The vectors to add, should be a 2D array of dimension [n, dim]
+    ///   - ids: Optional array of item IDs, if nil, sequential IDs will be assigned
+    ///   - numThreads: Number of threads to use for parallel insertion, -1 for auto
+    ///   - replaceDeleted: Whether new items may take the slots of deleted items in the head
+    public func addItems(data: [[Float]], ids: [UInt64]? = nil, numThreads: Int = -1, replaceDeleted: Bool = false) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let rows = data.count
+        guard rows > 0 else { return }
+        
+        guard data[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        if let ids = ids, ids.count != rows {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        let added = withOptionalBuffer(ids) { idsBuffer in
+            hnswlib_tiered_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), idsBuffer?.baseAddress, Int32(numThreads), replaceDeleted)
+        }
+        if !added {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for k nearest neighbors in the head and all segments
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of nearest neighbors to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances) where both are 2D arrays of shape [n, k]
+    public func searchKnn(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        guard query[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        
+        if !hnswlib_tiered_index_search_knn(indexPtr, flattenedQuery, size_t(k), &resultLabels, &resultDistances, size_t(queryCount), Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (labels, distances)
+    }
+    
+    /// Vectors of the given labels from the newest tier holding them, decoded from the
+    /// segment quantization; nil for labels that are unknown or deleted
+    public func getItems(labels: [UInt64]) -> [[Float]?] {
+        guard let indexPtr = indexPtr, !labels.isEmpty else { return [] }
+        var data = [Float](repeating: 0, count: labels.count * dim)
+        var found = [Bool](repeating: false, count: labels.count)
+        _ = hnswlib_tiered_index_get_items(indexPtr, labels, size_t(labels.count), &data, &found)
+        return (0..<labels.count).map { found[$0] ? Array(data[($0 * dim)..<(($0 + 1) * dim)]) : nil }
+    }
+    
+    /// Mark an item as deleted in whichever tier holds it
+    public func markDeleted(label: UInt64) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_tiered_index_mark_deleted(indexPtr, label)
+    }
+    
+    /// Freeze the head and merge it into a new segment
+    /// - Parameter wait: Wait for a running merge first and for the new one to finish
+    /// - Returns: false if the head was empty, or a merge was running and `wait` was not set
+    @discardableResult
+    public func merge(wait: Bool = true) -> Bool {
+        guard let indexPtr = indexPtr else { return false }
+        return hnswlib_tiered_index_merge(indexPtr, wait)
+    }
+    
+    /// Number of live points in all tiers
+    public var currentCount: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_tiered_index_get_current_count(indexPtr))
+    }
+    
+    /// Number of points in the mutable head
+    public var headCount: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_tiered_index_get_head_count(indexPtr))
+    }
+    
+    public var numSegments: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_tiered_index_get_num_segments(indexPtr))
+    }
+    
+    /// Save the index after any running merge; the head goes to "<path>.head", segment i to "<path>.seg<i>"
+    public func saveIndex(path: String) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !path.isEmpty, hnswlib_tiered_index_save(indexPtr, path) else {
+            throw HNSWError.saveFailed
+        }
+    }
+    
+    /// Load an index written by `saveIndex`
+    /// - Parameters:
+    ///   - spaceType: Space type of the index
+    ///   - dim: Dimensionality of the index
+    ///   - path: Path the index was saved to
+    ///   - segmentQuantization: Storage format the segments were saved with
+    ///   - numThreads: Size of the thread pool, -1 for auto
+    public static func loadIndex(spaceType: SpaceType, dim: Int, path: String, segmentQuantization: Quantization? = nil,
+                                 numThreads: Int = -1) throws -> TieredHNSWIndex {
+        guard !path.isEmpty,
+              let indexPtr = hnswlib_tiered_index_load(spaceType.rawValue, Int32(dim), path, segmentQuantization != nil,
+                                                       (segmentQuantization ?? .int8).rawValue, Int32(numThreads)) else {
+            throw HNSWError.loadFailed
+        }
+        
+        let index = try TieredHNSWIndex(spaceType: spaceType, dim: dim)
+        hnswlib_tiered_index_free(index.indexPtr!)
+        index.indexPtr = indexPtr
+        return index
+    }
+}
+
+/// HNSW index over documents made of several vectors. Each vector is added with the id of
+/// its document and `searchDocs` returns the closest distinct documents, each at the
+/// distance of its closest vector.
+public class MultiVectorHNSWIndex {
+    private var indexPtr: OpaquePointer?
+    
+    /// The dimension of the vectors in the index
+    public let dim: Int
+    
+    /// The space type (L2, inner product, cosine)
+    public let spaceType: SpaceType
+    
+    /// Creates a new multi-vector index
+    /// - Parameters:
+    ///   - spaceType: The distance metric to use
+    ///   - dim: The dimension of vectors to index
+    public init(spaceType: SpaceType, dim: Int) throws {
+        self.spaceType = spaceType
+        self.dim = dim
+        
+        guard let indexPtr = hnswlib_multivector_index_create(spaceType.rawValue, Int32(dim)) else {
+            throw HNSWError.initializationFailed
+        }
+        
+        self.indexPtr = indexPtr
+    }
+    
+    deinit {
+        if let indexPtr = indexPtr {
+            hnswlib_multivector_index_free(indexPtr)
+        }
+    }
+    
+    /// Initialize the index with the given parameters
+    /// - Parameters:
+    ///   - maxElements: Maximum number of vectors (not documents) the index can hold
+    ///   - m: Number of bidirectional links created for each element during construction
+    ///   - efConstruction: Size of the dynamic list for the nearest neighbors during construction
+    ///   - randomSeed: Seed for the random number generator
+    public func initIndex(maxElements: Int, m: Int = 16, efConstruction: Int = 200, randomSeed: UInt = 100) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_multivector_index_init(indexPtr, size_t(maxElements), size_t(m), size_t(efConstruction), size_t(randomSeed)) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Set the number of documents a search collects before it stops, raised to k per search
+    public func setEf(ef: Int) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_multivector_index_set_ef(indexPtr, size_t(ef))
+    }
+    
+    /// Add vectors to the index
+    /// - Parameters:
+    ///   - data: The vectors to add, should be a 2D array of dimension [n, dim]
+    ///   - docIds: The document of each vector
+    ///   - ids: Optional array of vector IDs, if nil, sequential IDs will be assigned
+    ///   - numThreads: Number of threads to use for parallel insertion, -1 for auto
+    public func addItems(data: [[Float]], docIds: [UInt64], ids: [UInt64]? = nil, numThreads: Int = -1) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let rows = data.count
+        guard rows > 0 else { return }
+        
+        guard data[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        if docIds.count != rows || (ids != nil && ids!.count != rows) {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        let added = withOptionalBuffer(ids) { idsBuffer in
+            hnswlib_multivector_index_add_items(indexPtr, flattenedData, size_t(rows), size_t(dim), docIds, idsBuffer?.baseAddress, Int32(numThreads))
+        }
+        if !added {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for the k closest documents
+    /// - Parameters:
+    ///   - query: The query vectors, should be a 2D array of dimension [n, dim]
+    ///   - k: Number of distinct documents to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (docIds, distances) where both are 2D arrays of shape [n, k]
+    public func searchDocs(query: [[Float]], k: Int, numThreads: Int = -1) throws -> (docIds: [[UInt64]], distances: [[Float]]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = query.count
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        guard query[0].count == dim else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        var resultDocIds = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        
+        if !hnswlib_multivector_index_search_docs(indexPtr, flattenedQuery, size_t(queryCount), size_t(k), &resultDocIds, &resultDistances, Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        let docIds = (0..<queryCount).map { Array(resultDocIds[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (docIds, distances)
+    }
+    
+    /// Late-interaction (ColBERT-style MaxSim) search for one query made of several vectors
+    /// - Parameters:
+    ///   - query: The query vectors (e.g. token embeddings), a 2D array of dimension [n, dim]
+    ///   - k: Number of documents to return
+    ///   - candidatesPerVector: Closest documents gathered per query vector before scoring, at least k
+    ///   - numThreads: Number of threads to use for the searches and the scoring, -1 for auto
+    /// - Returns: The k best documents with their distance, the sum over the query vectors of the
+    ///   distance to the closest document vector (n - MaxSim similarity for inner product and cosine)
+    public func searchMaxSim(query: [[Float]], k: Int, candidatesPerVector: Int = 32, numThreads: Int = -1) throws -> (docIds: [UInt64], distances: [Float]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !query.isEmpty else {
+            return ([], [])
+        }
+        
+        guard query.allSatisfy({ $0.count == dim }) else {
+            throw HNSWError.invalidDimension
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        var resultDocIds = [UInt64](repeating: 0, count: k)
+        var resultDistances = [Float](repeating: 0, count: k)
+        
+        if !hnswlib_multivector_index_search_maxsim(indexPtr, flattenedQuery, size_t(query.count), size_t(k), size_t(candidatesPerVector),
+                                                    &resultDocIds, &resultDistances, Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        return (resultDocIds, resultDistances)
+    }
+    
+    /// Mark a vector as deleted
+    public func markDeleted(label: UInt64) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_multivector_index_mark_deleted(indexPtr, label)
+    }
+    
+    /// Number of vectors in the index
+    public var currentCount: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_multivector_index_get_current_count(indexPtr))
+    }
+    
+    /// Number of distinct documents added
+    public var numDocs: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_multivector_index_get_num_docs(indexPtr))
+    }
+    
+    /// Save the graph to `path` and the document table to "<path>.docs"
+    public func saveIndex(path: String) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !path.isEmpty, hnswlib_multivector_index_save(indexPtr, path) else {
+            throw HNSWError.saveFailed
+        }
+    }
+    
+    /// Load an index written by `saveIndex`
+    /// - Parameters:
+    ///   - spaceType: Space type of the index
+    ///   - dim: Dimensionality of the index
+    ///   - path: Path the index was saved to
+    ///   - maxElements: Maximum number of vectors, 0 to keep the saved capacity
+    public static func loadIndex(spaceType: SpaceType, dim: Int, path: String, maxElements: Int = 0) throws -> MultiVectorHNSWIndex {
+        guard !path.isEmpty,
+              let indexPtr = hnswlib_multivector_index_load(spaceType.rawValue, Int32(dim), path, size_t(maxElements)) else {
+            throw HNSWError.loadFailed
+        }
+        
+        let index = try MultiVectorHNSWIndex(spaceType: spaceType, dim: dim)
+        hnswlib_multivector_index_free(index.indexPtr!)
+        index.indexPtr = indexPtr
+        return index
+    }
+}
+
+/// HNSW index over sparse vectors (e.g. SPLADE lexical embeddings) with inner product
+/// distance `1 - dot`. Vectors are passed as CSR batches: row i has the entries
+/// `indptr[i]..<indptr[i + 1]` of `indices` and `values`.
+public class SparseHNSWIndex {
+    private var indexPtr: OpaquePointer?
+    
+    /// Number of possible indices, e.g. the vocabulary size
+    public let dim: Int
+    
+    /// Creates a new sparse index
+    /// - Parameter dim: Number of possible indices; every index must be below it
+    public init(dim: Int) throws {
+        self.dim = dim
+        
+        guard let indexPtr = hnswlib_sparse_index_create(Int32(dim)) else {
+            throw HNSWError.initializationFailed
+        }
+        
+        self.indexPtr = indexPtr
+    }
+    
+    deinit {
+        if let indexPtr = indexPtr {
+            hnswlib_sparse_index_free(indexPtr)
+        }
+    }
+    
+    /// Initialize the index with the given parameters
+    /// - Parameters:
+    ///   - maxElements: Maximum number of elements the index can hold
+    ///   - m: Number of bidirectional links created for each element during construction
+    ///   - efConstruction: Size of the dynamic list for the nearest neighbors during construction
+    ///   - randomSeed: Seed for the random number generator
+    public func initIndex(maxElements: Int, m: Int = 16, efConstruction: Int = 200, randomSeed: UInt = 100) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        if !hnswlib_sparse_index_init(indexPtr, size_t(maxElements), size_t(m), size_t(efConstruction), size_t(randomSeed)) {
+            throw HNSWError.initializationFailed
+        }
+    }
+    
+    /// Set the ef parameter
+    public func setEf(ef: Int) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_sparse_index_set_ef(indexPtr, size_t(ef))
+    }
+    
+    /// Add a CSR batch of sparse vectors; indices within a row must be unique but need not be sorted
+    /// - Parameters:
+    ///   - indptr: Row offsets into `indices` / `values`, one more than the number of rows
+    ///   - indices: Indices of the non-zeros
+    ///   - values: Values of the non-zeros
+    ///   - ids: Optional array of item IDs, if nil, sequential IDs will be assigned
+    ///   - numThreads: Number of threads to use for parallel insertion, -1 for auto
+    public func addItems(indptr: [Int], indices: [UInt32], values: [Float], ids: [UInt64]? = nil, numThreads: Int = -1) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let rows = indptr.count - 1
+        guard rows > 0 else { return }
+        
+        if indices.count != values.count || indptr[rows] > indices.count || (ids != nil && ids!.count != rows) {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let added = withOptionalBuffer(ids) { idsBuffer in
+            hnswlib_sparse_index_add_items(indexPtr, indptr, indices, values, size_t(rows), idsBuffer?.baseAddress, Int32(numThreads))
+        }
+        if !added {
+            throw HNSWError.addItemsFailed
+        }
+    }
+    
+    /// Search for the k nearest neighbors of a CSR batch of sparse queries
+    /// - Parameters:
+    ///   - indptr: Row offsets into `indices` / `values`, one more than the number of queries
+    ///   - indices: Indices of the non-zeros
+    ///   - values: Values of the non-zeros
+    ///   - k: Number of nearest neighbors to return
+    ///   - numThreads: Number of threads to use for parallel search, -1 for auto
+    /// - Returns: Tuple with (labels, distances) where both are 2D arrays of shape [n, k]
+    public func searchKnn(indptr: [Int], indices: [UInt32], values: [Float], k: Int, numThreads: Int = -1) throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        let queryCount = indptr.count - 1
+        guard queryCount > 0 else {
+            return ([], [])
+        }
+        
+        if indices.count != values.count || indptr[queryCount] > indices.count {
+            throw HNSWError.searchFailed
+        }
+        
+        var resultLabels = [UInt64](repeating: 0, count: queryCount * k)
+        var resultDistances = [Float](repeating: 0, count: queryCount * k)
+        
+        if !hnswlib_sparse_index_search_knn(indexPtr, indptr, indices, values, size_t(queryCount), size_t(k), &resultLabels, &resultDistances, Int32(numThreads)) {
+            throw HNSWError.searchFailed
+        }
+        
+        let labels = (0..<queryCount).map { Array(resultLabels[($0 * k)..<(($0 + 1) * k)]) }
+        let distances = (0..<queryCount).map { Array(resultDistances[($0 * k)..<(($0 + 1) * k)]) }
+        return (labels, distances)
+    }
+    
+    /// Mark an item as deleted
+    public func markDeleted(label: UInt64) {
+        guard let indexPtr = indexPtr else { return }
+        hnswlib_sparse_index_mark_deleted(indexPtr, label)
+    }
+    
+    /// Number of elements in the index
+    public var currentCount: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_sparse_index_get_current_count(indexPtr))
+    }
+    
+    /// Bytes held by the arena of non-zeros, including those of replaced elements
+    public var arenaBytes: Int {
+        guard let indexPtr = indexPtr else { return 0 }
+        return Int(hnswlib_sparse_index_get_arena_bytes(indexPtr))
+    }
+    
+    /// Save the graph to `path` and the non-zeros to "<path>.sparse"
+    public func saveIndex(path: String) throws {
+        guard let indexPtr = indexPtr else {
+            throw HNSWError.initializationFailed
+        }
+        
+        guard !path.isEmpty, hnswlib_sparse_index_save(indexPtr, path) else {
+            throw HNSWError.saveFailed
+        }
+    }
+    
+    /// Load an index written by `saveIndex`
+    /// - Parameters:
+    ///   - dim: Number of possible indices
+    ///   - path: Path the index was saved to
+    ///   - maxElements: Maximum number of elements, 0 to keep the saved capacity
+    public static func loadIndex(dim: Int, path: String, maxElements: Int = 0) throws -> SparseHNSWIndex {
+        guard !path.isEmpty, let indexPtr = hnswlib_sparse_index_load(Int32(dim), path, size_t(maxElements)) else {
+            throw HNSWError.loadFailed
+        }
+        
+        let index = try SparseHNSWIndex(dim: dim)
+        hnswlib_sparse_index_free(index.indexPtr!)
+        index.indexPtr = indexPtr
+        return index
+    }
+}
+
+/// `Sendable` handle for calling an `HNSWIndex` from Swift concurrency. Requests are queued to a
+/// C++ dispatcher thread, so awaiting them never blocks a cooperative thread. Searches from
+/// concurrent callers that arrive within `maxWaitMicroseconds` of each other run as one batch on
+/// a pool of `numThreads` threads; inserts run between batches. Cancelling the calling task
+/// cancels its request, including the queries of an already running batch that have not started.
+/// The wrapped index must not be changed directly while the handle exists.
+public final class AsyncHNSWIndex: @unchecked Sendable {
+    private let index: HNSWIndex
+    private let queuePtr: OpaquePointer
+    
+    /// The dimension of the vectors in the index
+    public var dim: Int { index.dim }
+    
+    /// Creates a handle for an initialized index
+    /// - Parameters:
+    ///   - index: The index to serve; the handle keeps it alive
+    ///   - maxBatch: Maximum number of queries searched as one batch
+    ///   - maxWaitMicroseconds: How long a search waits for others to join its batch
+    ///   - numThreads: Number of threads searching a batch, -1 for auto
+    public init(index: HNSWIndex, maxBatch: Int = 64, maxWaitMicroseconds: Int = 100, numThreads: Int = -1) throws {
+        guard let indexPtr = index.indexPtr,
+              let queuePtr = hnswlib_async_queue_create(indexPtr, size_t(maxBatch), UInt64(maxWaitMicroseconds), Int32(numThreads)) else {
+            throw HNSWError.initializationFailed
+        }
+        self.index = index
+        self.queuePtr = queuePtr
+    }
+    
+    deinit {
+        hnswlib_async_queue_free(queuePtr)
+    }
+    
+    /// Search for the k nearest neighbors of one vector
+    /// - Throws: `CancellationError` if the task was cancelled before the search finished
+    public func searchKnn(query: [Float], k: Int) async throws -> (labels: [UInt64], distances: [Float]) {
+        let results = try await searchKnn(query: [query], k: k)
+        return (results.labels[0], results.distances[0])
+    }
+    
+    /// Search for the k nearest neighbors of each query vector
+    /// - Throws: `CancellationError` if the task was cancelled before all queries were searched
+    public func searchKnn(query: [[Float]], k: Int) async throws -> (labels: [[UInt64]], distances: [[Float]]) {
+        let queryCount = query.count
+        guard queryCount > 0 else { return ([], []) }
+        guard query.allSatisfy({ $0.count == dim }) else {
+            throw HNSWError.invalidDimension
+        }
+        
+        // Written by the dispatcher thread, so they must outlive the await
+        let labels = UnsafeMutablePointer<UInt64>.allocate(capacity: queryCount * k)
+        let distances = UnsafeMutablePointer<Float>.allocate(capacity: queryCount * k)
+        defer {
+            labels.deallocate()
+            distances.deallocate()
+        }
+        
+        let flattenedQuery = query.flatMap { $0 }
+        try await perform(failure: .searchFailed) { token, userData in
+            hnswlib_async_queue_submit_search(queuePtr, flattenedQuery, size_t(queryCount), size_t(k), labels, distances,
+                                              token, asyncRequestCallback, userData)
+        }
+        
+        let resultLabels = (0..<queryCount).map { Array(UnsafeBufferPointer(start: labels + $0 * k, count: k)) }
+        let resultDistances = (0..<queryCount).map { Array(UnsafeBufferPointer(start: distances + $0 * k, count: k)) }
+        return (resultLabels, resultDistances)
+    }
+    
+    /// Add items to the index; searches queued before the call see the index without them
+    /// - Throws: `CancellationError` if the task was cancelled before the insert started
+    public func addItems(data: [[Float]], ids: [UInt64]? = nil, replaceDeleted: Bool = false) async throws {
+        let rows = data.count
+        guard rows > 0 else { return }
+        guard data.allSatisfy({ $0.count == dim }) else {
+            throw HNSWError.invalidDimension
+        }
+        if let ids = ids, ids.count != rows {
+            throw HNSWError.addItemsFailed
+        }
+        
+        let flattenedData = data.flatMap { $0 }
+        try await perform(failure: .addItemsFailed) { token, userData in
+            withOptionalBuffer(ids) { idsBuffer in
+                hnswlib_async_queue_submit_add(queuePtr, flattenedData, size_t(rows), size_t(dim), idsBuffer?.baseAddress,
+                                               replaceDeleted, token, asyncRequestCallback, userData)
+            }
+        }
+    }
+    
+    // Submits one request and suspends until its callback, cancelling it along with the task
+    private func perform(failure: HNSWError, _ submit: (OpaquePointer, UnsafeMutableRawPointer) -> Bool) async throws {
+        guard let token = CancelToken() else {
+            throw HNSWError.outOfMemory
+        }
+        
+        let status = await withTaskCancellationHandler {
+            await withCheckedContinuation { (continuation: CheckedContinuation<Int32, Never>) in
+                let userData = Unmanaged.passRetained(AsyncRequest(continuation)).toOpaque()
+                if !submit(token.pointer, userData) {
+                    Unmanaged<AsyncRequest>.fromOpaque(userData).release()
+                    continuation.resume(returning: AsyncStatus.failed)
+                }
+            }
+        } onCancel: {
+            token.cancel()
+        }
+        
+        switch status {
+        case AsyncStatus.completed:
+            return
+        case AsyncStatus.cancelled:
+            throw CancellationError()
+        default:
+            throw failure
+        }
+    }
+}
+
+// Values of HNSWAsyncStatus
+private enum AsyncStatus {
+    static let completed: Int32 = 0
+    static let cancelled: Int32 = 1
+    static let failed: Int32 = 2
+}
+
+// Owned by the request and by the task's cancellation handler, so it is freed after both are done
+private final class CancelToken: @unchecked Sendable {
+    let pointer: OpaquePointer
+    
+    init?() {
+        guard let pointer = hnswlib_cancel_token_create() else { return nil }
+        self.pointer = pointer
+    }
+    
+    deinit {
+        hnswlib_cancel_token_free(pointer)
+    }
+    
+    func cancel() {
+        hnswlib_cancel_token_cancel(pointer)
+    }
+}
+
+private final class AsyncRequest {
+    let continuation: CheckedContinuation<Int32, Never>
+    
+    init(_ continuation: CheckedContinuation<Int32, Never>) {
+        self.continuation = continuation
+    }
+}
+
+private let asyncRequestCallback: @convention(c) (Int32, UnsafeMutableRawPointer?) -> Void = { status, userData in
+    guard let userData = userData else { return }
+    Unmanaged<AsyncRequest>.fromOpaque(userData).takeRetainedValue().continuation.resume(returning: status)
+}
+
+// Calls body with the elements of `array`, or with nil if there is no array
+private func withOptionalBuffer<T, R>(_ array: [T]?, _ body: (UnsafeBufferPointer<T>?) throws -> R) rethrows -> R {
+    guard let array = array else {
+        return try body(nil)
+    }
+    return try array.withUnsafeBufferPointer { try body($0) }
+}
+
+private func withOptionalBuffer<T, R>(_ array: ContiguousArray<T>?, _ body: (UnsafeBufferPointer<T>?) throws -> R) rethrows -> R {
+    guard let array = array else {
+        return try body(nil)
+    }
+    return try array.withUnsafeBufferPointer { try body($0) }
+}
+
 // MARK: - Private C Interface
 
 // These are the C wrapper functions from HNSWLibWrapper.cpp
@@ -458,10 +2323,67 @@ private func hnswlib_index_free(_ index: OpaquePointer)
 private func hnswlib_index_init(_ index: OpaquePointer, _ max_elements: size_t, _ M: size_t, _ ef_construction: size_t, _ random_seed: size_t, _ allow_replace_deleted: Bool) -> Bool
 
 @_silgen_name("hnswlib_index_add_items")
-private func hnswlib_index_add_items(_ index: OpaquePointer, _ data: [Float], _ rows: size_t, _ dim: size_t, _ ids: [UInt64]? = nil, _ num_threads: Int32, _ replace_deleted: Bool) -> Bool
+private func hnswlib_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?, _ num_threads: Int32, _ replace_deleted: Bool) -> Bool
 
 @_silgen_name("hnswlib_index_search_knn")
-private func hnswlib_index_search_knn(_ index: OpaquePointer, _ query: [Float], _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+private func hnswlib_index_search_knn(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+
+@_silgen_name("hnswlib_index_search_range")
+private func hnswlib_index_search_range(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ radius: Float, _ max_results: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ result_count: UnsafeMutablePointer<size_t>) -> Bool
+
+@_silgen_name("hnswlib_index_set_groups")
+private func hnswlib_index_set_groups(_ index: OpaquePointer, _ labels: UnsafePointer<UInt64>, _ groups: UnsafePointer<UInt64>, _ count: size_t) -> Bool
+
+@_silgen_name("hnswlib_index_search_grouped")
+private func hnswlib_index_search_grouped(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ queryCount: size_t, _ k: size_t, _ maxPerGroup: size_t, _ resultLabels: UnsafeMutablePointer<UInt64>, _ resultDistances: UnsafeMutablePointer<Float>, _ resultCounts: UnsafeMutablePointer<size_t>, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_index_search_knn_with_stats")
+private func hnswlib_index_search_knn_with_stats(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32, _ stats: UnsafeMutablePointer<UInt64>?) -> Bool
+
+@_silgen_name("hnswlib_index_reset_query_histograms")
+private func hnswlib_index_reset_query_histograms(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_index_export_prometheus")
+private func hnswlib_index_export_prometheus(_ index: OpaquePointer, _ buffer: UnsafeMutablePointer<CChar>?, _ buffer_size: size_t) -> size_t
+
+@_silgen_name("hnswlib_perf_counters_available")
+private func hnswlib_perf_counters_available() -> Bool
+
+@_silgen_name("hnswlib_index_set_perf_counters")
+private func hnswlib_index_set_perf_counters(_ index: OpaquePointer, _ enable: Bool) -> Bool
+
+@_silgen_name("hnswlib_index_get_perf_counters")
+private func hnswlib_index_get_perf_counters(_ index: OpaquePointer, _ op: Int32, _ total: UnsafeMutablePointer<UInt64>) -> Bool
+
+@_silgen_name("hnswlib_index_get_perf_counters_per_thread")
+private func hnswlib_index_get_perf_counters_per_thread(_ index: OpaquePointer, _ op: Int32, _ out: UnsafeMutablePointer<UInt64>?, _ max_threads: size_t) -> size_t
+
+@_silgen_name("hnswlib_index_reset_perf_counters")
+private func hnswlib_index_reset_perf_counters(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_index_set_build_profiling")
+private func hnswlib_index_set_build_profiling(_ index: OpaquePointer, _ enable: Bool)
+
+@_silgen_name("hnswlib_index_get_build_profile")
+private func hnswlib_index_get_build_profile(_ index: OpaquePointer, _ total: UnsafeMutablePointer<UInt64>) -> Bool
+
+@_silgen_name("hnswlib_index_get_build_profile_per_thread")
+private func hnswlib_index_get_build_profile_per_thread(_ index: OpaquePointer, _ out: UnsafeMutablePointer<UInt64>?, _ maxThreads: size_t) -> size_t
+
+@_silgen_name("hnswlib_index_reset_build_profile")
+private func hnswlib_index_reset_build_profile(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_index_set_build_progress")
+private func hnswlib_index_set_build_progress(_ index: OpaquePointer, _ callback: (@convention(c) (UInt64, UInt64, Double, UnsafeMutableRawPointer?) -> Void)?, _ userData: UnsafeMutableRawPointer?, _ interval: size_t)
+
+@_silgen_name("hnswlib_index_graph_stats")
+private func hnswlib_index_graph_stats(_ index: OpaquePointer, _ navigabilitySamples: size_t, _ numThreads: Int32, _ stats: UnsafeMutablePointer<UInt64>) -> Bool
+
+@_silgen_name("hnswlib_index_set_assume_normalized")
+private func hnswlib_index_set_assume_normalized(_ index: OpaquePointer, _ assumeNormalized: Bool) -> Bool
+
+@_silgen_name("hnswlib_index_set_flat")
+private func hnswlib_index_set_flat(_ index: OpaquePointer, _ numRouters: size_t) -> Bool
 
 @_silgen_name("hnswlib_index_set_ef")
 private func hnswlib_index_set_ef(_ index: OpaquePointer, _ ef: size_t)
@@ -484,8 +2406,11 @@ private func hnswlib_index_save(_ index: OpaquePointer, _ path: UnsafePointer<In
 @_silgen_name("hnswlib_index_load")
 private func hnswlib_index_load(_ space_type: Int32, _ dim: Int32, _ path: UnsafePointer<Int8>, _ max_elements: size_t, _ allow_replace_deleted: Bool) -> OpaquePointer?
 
+@_silgen_name("hnswlib_index_get_items")
+private func hnswlib_index_get_items(_ index: OpaquePointer, _ labels: UnsafePointer<UInt64>, _ count: size_t, _ out: UnsafeMutablePointer<Float>, _ found: UnsafeMutablePointer<Bool>?, _ numThreads: Int32) -> size_t
+
 @_silgen_name("hnswlib_index_mark_deleted")
-private func hnswlib_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64)
+private func hnswlib_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64) -> Bool
 
 @_silgen_name("hnswlib_index_unmark_deleted")
 private func hnswlib_index_unmark_deleted(_ index: OpaquePointer, _ label: UInt64)
@@ -503,7 +2428,259 @@ private func hnswlib_bf_index_free(_ index: OpaquePointer)
 private func hnswlib_bf_index_init(_ index: OpaquePointer, _ max_elements: size_t) -> Bool
 
 @_silgen_name("hnswlib_bf_index_add_items")
-private func hnswlib_bf_index_add_items(_ index: OpaquePointer, _ data: [Float], _ rows: size_t, _ dim: size_t, _ ids: [UInt64]? = nil) -> Bool
+private func hnswlib_bf_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?) -> Bool
 
 @_silgen_name("hnswlib_bf_index_search_knn") 
-private func hnswlib_bf_index_search_knn(_ index: OpaquePointer, _ query: [Float], _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+private func hnswlib_bf_index_search_knn(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+
+@_silgen_name("hnswlib_bf_index_set_assume_normalized")
+private func hnswlib_bf_index_set_assume_normalized(_ index: OpaquePointer, _ assumeNormalized: Bool) -> Bool
+
+@_silgen_name("hnswlib_bf_index_remove")
+private func hnswlib_bf_index_remove(_ index: OpaquePointer, _ label: UInt64) -> Bool
+
+@_silgen_name("hnswlib_bfq_index_create")
+private func hnswlib_bfq_index_create(_ space_type: Int32, _ quantization: Int32, _ dim: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_bfq_index_free")
+private func hnswlib_bfq_index_free(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_bfq_index_init")
+private func hnswlib_bfq_index_init(_ index: OpaquePointer, _ max_elements: size_t, _ keep_float_vectors: Bool) -> Bool
+
+@_silgen_name("hnswlib_bfq_index_set_rerank")
+private func hnswlib_bfq_index_set_rerank(_ index: OpaquePointer, _ rerank_k: size_t)
+
+@_silgen_name("hnswlib_bfq_index_add_items")
+private func hnswlib_bfq_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?) -> Bool
+
+@_silgen_name("hnswlib_bfq_index_search_knn")
+private func hnswlib_bfq_index_search_knn(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+
+@_silgen_name("hnswlib_sharded_index_create")
+private func hnswlib_sharded_index_create(_ spaceType: Int32, _ dim: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_sharded_index_free")
+private func hnswlib_sharded_index_free(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_sharded_index_init")
+private func hnswlib_sharded_index_init(_ index: OpaquePointer, _ numShards: size_t, _ maxElementsPerShard: size_t, _ M: size_t, _ efConstruction: size_t, _ randomSeed: size_t, _ allowReplaceDeleted: Bool, _ partitioning: Int32, _ rangeSize: size_t, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_sharded_index_add_items")
+private func hnswlib_sharded_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?, _ numThreads: Int32, _ replaceDeleted: Bool) -> Bool
+
+@_silgen_name("hnswlib_sharded_index_search_knn")
+private func hnswlib_sharded_index_search_knn(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+
+@_silgen_name("hnswlib_sharded_index_set_ef")
+private func hnswlib_sharded_index_set_ef(_ index: OpaquePointer, _ ef: size_t)
+
+@_silgen_name("hnswlib_sharded_index_get_current_count")
+private func hnswlib_sharded_index_get_current_count(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_sharded_index_get_max_elements")
+private func hnswlib_sharded_index_get_max_elements(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_sharded_index_get_num_shards")
+private func hnswlib_sharded_index_get_num_shards(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_sharded_index_save")
+private func hnswlib_sharded_index_save(_ index: OpaquePointer, _ path: UnsafePointer<Int8>) -> Bool
+
+@_silgen_name("hnswlib_sharded_index_load")
+private func hnswlib_sharded_index_load(_ spaceType: Int32, _ dim: Int32, _ path: UnsafePointer<Int8>, _ maxElementsPerShard: size_t, _ allowReplaceDeleted: Bool, _ numThreads: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_sharded_index_mark_deleted")
+private func hnswlib_sharded_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64)
+
+@_silgen_name("hnswlib_sharded_index_unmark_deleted")
+private func hnswlib_sharded_index_unmark_deleted(_ index: OpaquePointer, _ label: UInt64)
+
+@_silgen_name("hnswlib_sharded_index_resize")
+private func hnswlib_sharded_index_resize(_ index: OpaquePointer, _ newMaxElementsPerShard: size_t) -> Bool
+
+@_silgen_name("hnswlib_partitioned_index_create")
+private func hnswlib_partitioned_index_create(_ spaceType: Int32, _ dim: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_partitioned_index_free")
+private func hnswlib_partitioned_index_free(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_partitioned_index_init")
+private func hnswlib_partitioned_index_init(_ index: OpaquePointer, _ numPartitions: size_t, _ maxElementsPerPartition: size_t, _ M: size_t, _ efConstruction: size_t, _ randomSeed: size_t, _ allowReplaceDeleted: Bool, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_partitioned_index_train")
+private func hnswlib_partitioned_index_train(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ iterations: size_t) -> Bool
+
+@_silgen_name("hnswlib_partitioned_index_set_replication")
+private func hnswlib_partitioned_index_set_replication(_ index: OpaquePointer, _ maxReplicas: size_t, _ boundaryFactor: Float)
+
+@_silgen_name("hnswlib_partitioned_index_set_nprobe")
+private func hnswlib_partitioned_index_set_nprobe(_ index: OpaquePointer, _ nprobe: size_t)
+
+@_silgen_name("hnswlib_partitioned_index_get_nprobe")
+private func hnswlib_partitioned_index_get_nprobe(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_partitioned_index_set_ef")
+private func hnswlib_partitioned_index_set_ef(_ index: OpaquePointer, _ ef: size_t)
+
+@_silgen_name("hnswlib_partitioned_index_add_items")
+private func hnswlib_partitioned_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?, _ replaceDeleted: Bool) -> Bool
+
+@_silgen_name("hnswlib_partitioned_index_search_knn")
+private func hnswlib_partitioned_index_search_knn(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+
+@_silgen_name("hnswlib_partitioned_index_get_current_count")
+private func hnswlib_partitioned_index_get_current_count(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_partitioned_index_get_num_partitions")
+private func hnswlib_partitioned_index_get_num_partitions(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_partitioned_index_get_partition_sizes")
+private func hnswlib_partitioned_index_get_partition_sizes(_ index: OpaquePointer, _ sizes: UnsafeMutablePointer<UInt64>?, _ maxPartitions: size_t) -> size_t
+
+@_silgen_name("hnswlib_partitioned_index_save")
+private func hnswlib_partitioned_index_save(_ index: OpaquePointer, _ path: UnsafePointer<Int8>) -> Bool
+
+@_silgen_name("hnswlib_partitioned_index_load")
+private func hnswlib_partitioned_index_load(_ spaceType: Int32, _ dim: Int32, _ path: UnsafePointer<Int8>, _ maxElementsPerPartition: size_t, _ allowReplaceDeleted: Bool, _ numThreads: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_partitioned_index_mark_deleted")
+private func hnswlib_partitioned_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64)
+
+@_silgen_name("hnswlib_tiered_index_create")
+private func hnswlib_tiered_index_create(_ spaceType: Int32, _ dim: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_tiered_index_free")
+private func hnswlib_tiered_index_free(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_tiered_index_init")
+private func hnswlib_tiered_index_init(_ index: OpaquePointer, _ headCapacity: size_t, _ M: size_t, _ efConstruction: size_t, _ randomSeed: size_t, _ mergeThreshold: size_t, _ compressSegments: Bool, _ quantization: Int32, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_tiered_index_add_items")
+private func hnswlib_tiered_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?, _ numThreads: Int32, _ replaceDeleted: Bool) -> Bool
+
+@_silgen_name("hnswlib_tiered_index_search_knn")
+private func hnswlib_tiered_index_search_knn(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ k: size_t, _ result_labels: UnsafeMutablePointer<UInt64>, _ result_distances: UnsafeMutablePointer<Float>, _ query_count: size_t, _ num_threads: Int32) -> Bool
+
+@_silgen_name("hnswlib_tiered_index_mark_deleted")
+private func hnswlib_tiered_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64)
+
+@_silgen_name("hnswlib_tiered_index_merge")
+private func hnswlib_tiered_index_merge(_ index: OpaquePointer, _ wait: Bool) -> Bool
+
+@_silgen_name("hnswlib_tiered_index_set_ef")
+private func hnswlib_tiered_index_set_ef(_ index: OpaquePointer, _ ef: size_t)
+
+@_silgen_name("hnswlib_tiered_index_get_current_count")
+private func hnswlib_tiered_index_get_current_count(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_tiered_index_get_head_count")
+private func hnswlib_tiered_index_get_head_count(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_tiered_index_get_num_segments")
+private func hnswlib_tiered_index_get_num_segments(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_tiered_index_get_items")
+private func hnswlib_tiered_index_get_items(_ index: OpaquePointer, _ labels: UnsafePointer<UInt64>, _ count: size_t, _ out: UnsafeMutablePointer<Float>, _ found: UnsafeMutablePointer<Bool>?) -> size_t
+
+@_silgen_name("hnswlib_tiered_index_save")
+private func hnswlib_tiered_index_save(_ index: OpaquePointer, _ path: UnsafePointer<Int8>) -> Bool
+
+@_silgen_name("hnswlib_tiered_index_load")
+private func hnswlib_tiered_index_load(_ spaceType: Int32, _ dim: Int32, _ path: UnsafePointer<Int8>, _ compressSegments: Bool, _ quantization: Int32, _ numThreads: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_cancel_token_create")
+private func hnswlib_cancel_token_create() -> OpaquePointer?
+
+@_silgen_name("hnswlib_cancel_token_cancel")
+private func hnswlib_cancel_token_cancel(_ token: OpaquePointer)
+
+@_silgen_name("hnswlib_cancel_token_free")
+private func hnswlib_cancel_token_free(_ token: OpaquePointer)
+
+@_silgen_name("hnswlib_async_queue_create")
+private func hnswlib_async_queue_create(_ index: OpaquePointer, _ maxBatch: size_t, _ maxWaitMicroseconds: UInt64, _ numThreads: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_async_queue_free")
+private func hnswlib_async_queue_free(_ queue: OpaquePointer)
+
+@_silgen_name("hnswlib_async_queue_submit_search")
+private func hnswlib_async_queue_submit_search(_ queue: OpaquePointer, _ query: UnsafePointer<Float>, _ queryCount: size_t, _ k: size_t, _ resultLabels: UnsafeMutablePointer<UInt64>, _ resultDistances: UnsafeMutablePointer<Float>, _ token: OpaquePointer?, _ callback: @convention(c) (Int32, UnsafeMutableRawPointer?) -> Void, _ userData: UnsafeMutableRawPointer?) -> Bool
+
+@_silgen_name("hnswlib_async_queue_submit_add")
+private func hnswlib_async_queue_submit_add(_ queue: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ ids: UnsafePointer<UInt64>?, _ replaceDeleted: Bool, _ token: OpaquePointer?, _ callback: @convention(c) (Int32, UnsafeMutableRawPointer?) -> Void, _ userData: UnsafeMutableRawPointer?) -> Bool
+
+@_silgen_name("hnswlib_multivector_index_create")
+private func hnswlib_multivector_index_create(_ spaceType: Int32, _ dim: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_multivector_index_free")
+private func hnswlib_multivector_index_free(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_multivector_index_init")
+private func hnswlib_multivector_index_init(_ index: OpaquePointer, _ maxElements: size_t, _ M: size_t, _ efConstruction: size_t, _ randomSeed: size_t) -> Bool
+
+@_silgen_name("hnswlib_multivector_index_add_items")
+private func hnswlib_multivector_index_add_items(_ index: OpaquePointer, _ data: UnsafePointer<Float>, _ rows: size_t, _ dim: size_t, _ docIds: UnsafePointer<UInt64>, _ ids: UnsafePointer<UInt64>?, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_multivector_index_search_docs")
+private func hnswlib_multivector_index_search_docs(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ queryCount: size_t, _ k: size_t, _ resultDocIds: UnsafeMutablePointer<UInt64>, _ resultDistances: UnsafeMutablePointer<Float>, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_multivector_index_search_maxsim")
+private func hnswlib_multivector_index_search_maxsim(_ index: OpaquePointer, _ query: UnsafePointer<Float>, _ numQueryVectors: size_t, _ k: size_t, _ candidatesPerVector: size_t, _ resultDocIds: UnsafeMutablePointer<UInt64>, _ resultDistances: UnsafeMutablePointer<Float>, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_multivector_index_set_ef")
+private func hnswlib_multivector_index_set_ef(_ index: OpaquePointer, _ ef: size_t)
+
+@_silgen_name("hnswlib_multivector_index_mark_deleted")
+private func hnswlib_multivector_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64)
+
+@_silgen_name("hnswlib_multivector_index_get_current_count")
+private func hnswlib_multivector_index_get_current_count(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_multivector_index_get_num_docs")
+private func hnswlib_multivector_index_get_num_docs(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_multivector_index_save")
+private func hnswlib_multivector_index_save(_ index: OpaquePointer, _ path: UnsafePointer<Int8>) -> Bool
+
+@_silgen_name("hnswlib_multivector_index_load")
+private func hnswlib_multivector_index_load(_ spaceType: Int32, _ dim: Int32, _ path: UnsafePointer<Int8>, _ maxElements: size_t) -> OpaquePointer?
+
+@_silgen_name("hnswlib_sparse_index_create")
+private func hnswlib_sparse_index_create(_ dim: Int32) -> OpaquePointer?
+
+@_silgen_name("hnswlib_sparse_index_free")
+private func hnswlib_sparse_index_free(_ index: OpaquePointer)
+
+@_silgen_name("hnswlib_sparse_index_init")
+private func hnswlib_sparse_index_init(_ index: OpaquePointer, _ maxElements: size_t, _ M: size_t, _ efConstruction: size_t, _ randomSeed: size_t) -> Bool
+
+@_silgen_name("hnswlib_sparse_index_add_items")
+private func hnswlib_sparse_index_add_items(_ index: OpaquePointer, _ indptr: UnsafePointer<size_t>, _ indices: UnsafePointer<UInt32>, _ values: UnsafePointer<Float>, _ rows: size_t, _ ids: UnsafePointer<UInt64>?, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_sparse_index_search_knn")
+private func hnswlib_sparse_index_search_knn(_ index: OpaquePointer, _ indptr: UnsafePointer<size_t>, _ indices: UnsafePointer<UInt32>, _ values: UnsafePointer<Float>, _ queryCount: size_t, _ k: size_t, _ resultLabels: UnsafeMutablePointer<UInt64>, _ resultDistances: UnsafeMutablePointer<Float>, _ numThreads: Int32) -> Bool
+
+@_silgen_name("hnswlib_sparse_index_set_ef")
+private func hnswlib_sparse_index_set_ef(_ index: OpaquePointer, _ ef: size_t)
+
+@_silgen_name("hnswlib_sparse_index_mark_deleted")
+private func hnswlib_sparse_index_mark_deleted(_ index: OpaquePointer, _ label: UInt64)
+
+@_silgen_name("hnswlib_sparse_index_get_current_count")
+private func hnswlib_sparse_index_get_current_count(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_sparse_index_get_arena_bytes")
+private func hnswlib_sparse_index_get_arena_bytes(_ index: OpaquePointer) -> size_t
+
+@_silgen_name("hnswlib_sparse_index_save")
+private func hnswlib_sparse_index_save(_ index: OpaquePointer, _ path: UnsafePointer<Int8>) -> Bool
+
+@_silgen_name("hnswlib_sparse_index_load")
+private func hnswlib_sparse_index_load(_ dim: Int32, _ path: UnsafePointer<Int8>, _ maxElements: size_t) -> OpaquePointer?
+
+@_silgen_name("hnswlib_autotune")
+private func hnswlib_autotune(_ spaceType: Int32, _ dim: Int32, _ data: UnsafePointer<Float>, _ rows: size_t, _ queries: UnsafePointer<Float>, _ queryCount: size_t, _ k: size_t, _ targetRecall: Double, _ objective: Int32, _ budgetSeconds: Double, _ sampleSize: size_t, _ numThreads: Int32, _ best: UnsafeMutablePointer<UInt64>, _ tried: UnsafeMutablePointer<UInt64>?, _ maxTried: size_t, _ numTried: UnsafeMutablePointer<size_t>?) -> Bool
+
+@_silgen_name("hnswlib_index_calibrate_ef")
+private func hnswlib_index_calibrate_ef(_ index: OpaquePointer, _ queries: UnsafePointer<Float>, _ queryCount: size_t, _ ks: UnsafePointer<size_t>, _ numK: size_t, _ targetRecall: Double, _ maxEf: size_t, _ efOut: UnsafeMutablePointer<size_t>, _ recallOut: UnsafeMutablePointer<Double>?, _ numThreads: Int32) -> Bool
@@ -0,0 +1,321 @@
+// hnswlib_bench_concurrency - search latency under concurrent inserts, deletes and updates
+//
+// Prefills one HierarchicalNSW, then runs a fixed number of operations from several
+// threads, each picking insert / delete / update / search at random according to the
+// configured mix. Reports throughput and p50/p99/p99.9 latency per operation, plus the
+// time spent waiting on each of the index mutexes (this target is compiled with
+// HNSWLIB_LOCK_STATS, see lock_stats.h).
+//
+//   insert  addPoint of a new label, reusing slots of deleted elements
+//   delete  markDelete of a live label
+//   update  addPoint of a live label with a new vector (goes through updatePoint)
+//   search  searchKnn of a random query
+//
+// Usage:
+//   swift run -c release hnswlib_bench_concurrency [options]
+//
+// Options:
+//   --mix LIST             op weights (default search=90,insert=5,delete=3,update=2)
+//   --initial N            vectors inserted before the measured run (default 20000)
+//   --ops N                measured operations in total (default 100000)
+//   --dim D                vector dimension (default 64)
+//   --threads N            worker threads (default: all cores, at least 2)
+//   --k K                  neighbors per search (default 10)
+//   --ef EF                search ef (default 64)
+//   --M M                  HNSW M (default 16)
+//   --ef-construction EF   HNSW ef_construction (default 100)
+//   --seed S               random seed (default 100)
+//   --format csv|json      output format (default csv)
+
+#include "hnswlib.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum OpKind { OP_SEARCH, OP_INSERT, OP_DELETE, OP_UPDATE, OP_KIND_COUNT };
+const char* op_names[OP_KIND_COUNT] = {"search", "insert", "delete", "update"};
+
+// Per label state, so that deletes and updates only ever target live labels
+enum LabelState : uint8_t { LABEL_ABSENT, LABEL_LIVE, LABEL_BUSY, LABEL_DELETED };
+
+struct Options {
+    double mix[OP_KIND_COUNT] = {90, 5, 3, 2};
+    size_t initial = 20000;
+    size_t ops = 100000;
+    size_t dim = 64;
+    size_t threads = 0;
+    size_t k = 10;
+    size_t ef = 64;
+    size_t M = 16;
+    size_t ef_construction = 100;
+    size_t seed = 100;
+    bool json = false;
+};
+
+struct ThreadResult {
+    std::vector<double> latencies_us[OP_KIND_COUNT];
+    size_t skipped = 0;  // deletes / updates that found no live label
+    size_t failed = 0;   // operations that threw
+};
+
+double percentile(const std::vector<double>& sorted_values, double p) {
+    if (sorted_values.empty()) return 0;
+    size_t idx = (size_t)(p * (sorted_values.size() - 1) + 0.5);
+    return sorted_values[std::min(idx, sorted_values.size() - 1)];
+}
+
+void randomVector(std::mt19937& rng, size_t dim, float* out) {
+    std::uniform_real_distribution<float> real(0.0f, 1.0f);
+    for (size_t i = 0; i < dim; i++)
+        out[i] = real(rng);
+}
+
+void parseMix(const std::string& value, double* mix) {
+    for (int i = 0; i < OP_KIND_COUNT; i++) mix[i] = 0;
+    size_t start = 0;
+    while (start < value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+        std::string item = value.substr(start, end - start);
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            throw std::runtime_error("Expected op=weight in --mix, got " + item);
+        std::string name = item.substr(0, eq);
+        int kind = -1;
+        for (int i = 0; i < OP_KIND_COUNT; i++) {
+            if (name == op_names[i]) kind = i;
+        }
+        if (kind < 0)
+            throw std::runtime_error("Unknown op in --mix: " + name);
+        mix[kind] = std::stod(item.substr(eq + 1));
+        start = end + 1;
+    }
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << "usage: hnswlib_bench_concurrency [--mix search=90,insert=5,delete=3,update=2]\n"
+                         "           [--initial N] [--ops N] [--dim D] [--threads N] [--k K] [--ef EF]\n"
+                         "           [--M M] [--ef-construction EF] [--seed S] [--format csv|json]\n";
+            exit(0);
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--mix") parseMix(value, opt.mix);
+        else if (arg == "--initial") opt.initial = std::stoul(value);
+        else if (arg == "--ops") opt.ops = std::stoul(value);
+        else if (arg == "--dim") opt.dim = std::stoul(value);
+        else if (arg == "--threads") opt.threads = std::stoul(value);
+        else if (arg == "--k") opt.k = std::stoul(value);
+        else if (arg == "--ef") opt.ef = std::stoul(value);
+        else if (arg == "--M") opt.M = std::stoul(value);
+        else if (arg == "--ef-construction") opt.ef_construction = std::stoul(value);
+        else if (arg == "--seed") opt.seed = std::stoul(value);
+        else if (arg == "--format") opt.json = value == "json";
+        else throw std::runtime_error("Unknown option " + arg);
+    }
+    if (opt.threads == 0)
+        opt.threads = std::max(2u, std::thread::hardware_concurrency());
+    return opt;
+}
+
+/*
+* Claims a random label in state `from` by moving it to LABEL_BUSY.
+* Gives up after a few attempts so a mostly deleted index does not spin.
+*/
+bool claimLabel(std::vector<std::atomic<uint8_t>>& states, size_t num_labels, std::mt19937& rng,
+                uint8_t from, hnswlib::labeltype& label) {
+    if (num_labels == 0) return false;
+    std::uniform_int_distribution<size_t> pick(0, num_labels - 1);
+    for (int attempt = 0; attempt < 16; attempt++) {
+        size_t candidate = pick(rng);
+        uint8_t expected = from;
+        if (states[candidate].compare_exchange_strong(expected, LABEL_BUSY)) {
+            label = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    try {
+        opt = parseArgs(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    double total_weight = 0;
+    for (int i = 0; i < OP_KIND_COUNT; i++) total_weight += opt.mix[i];
+    if (total_weight <= 0) {
+        std::cerr << "Error: --mix needs at least one positive weight" << std::endl;
+        return 1;
+    }
+
+    // every insert uses a fresh label, so initial + ops labels always suffice
+    size_t num_labels_max = opt.initial + opt.ops;
+    hnswlib::L2Space space(opt.dim);
+    hnswlib::HierarchicalNSW<float> index(&space, num_labels_max, opt.M, opt.ef_construction, opt.seed, true);
+    index.setEf(opt.ef);
+
+    std::vector<std::atomic<uint8_t>> states(num_labels_max);
+    for (auto& s : states) s = LABEL_ABSENT;
+
+    std::cerr << "prefilling " << opt.initial << " vectors of dim " << opt.dim
+              << " with " << opt.threads << " threads" << std::endl;
+    {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < opt.threads; t++) {
+            workers.emplace_back([&, t]() {
+                std::mt19937 rng(opt.seed + t);
+                std::vector<float> v(opt.dim);
+                size_t label;
+                while ((label = next++) < opt.initial) {
+                    randomVector(rng, opt.dim, v.data());
+                    index.addPoint(v.data(), label);
+                    states[label] = LABEL_LIVE;
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+    }
+
+    std::atomic<size_t> next_label(opt.initial);
+    std::atomic<size_t> ops_left(opt.ops);
+    std::vector<ThreadResult> results(opt.threads);
+#ifdef HNSWLIB_LOCK_STATS
+    hnswlib::LockStats::reset();
+#endif
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < opt.threads; t++) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 rng(opt.seed * 7919 + t);
+            std::discrete_distribution<int> pick_op(opt.mix, opt.mix + OP_KIND_COUNT);
+            std::vector<float> v(opt.dim);
+            ThreadResult& result = results[t];
+
+            while (true) {
+                size_t left = ops_left.load();
+                if (left == 0 || !ops_left.compare_exchange_weak(left, left - 1)) {
+                    if (left == 0) break;
+                    continue;
+                }
+                int op = pick_op(rng);
+                hnswlib::labeltype label = 0;
+                if (op == OP_DELETE || op == OP_UPDATE) {
+                    if (!claimLabel(states, next_label.load(), rng, LABEL_LIVE, label)) {
+                        result.skipped++;
+                        continue;
+                    }
+                }
+                if (op == OP_INSERT) label = next_label++;
+                randomVector(rng, opt.dim, v.data());
+
+                auto op_start = std::chrono::steady_clock::now();
+                try {
+                    switch (op) {
+                        case OP_SEARCH:
+                            index.searchKnn(v.data(), opt.k);
+                            break;
+                        case OP_INSERT:
+                            index.addPoint(v.data(), label, true);
+                            break;
+                        case OP_DELETE:
+                            index.markDelete(label);
+                            break;
+                        case OP_UPDATE:
+                            index.addPoint(v.data(), label, false);
+                            break;
+                    }
+                } catch (const std::exception& e) {
+                    result.failed++;
+                }
+                auto op_end = std::chrono::steady_clock::now();
+                result.latencies_us[op].push_back(std::chrono::duration<double, std::micro>(op_end - op_start).count());
+
+                if (op == OP_INSERT || op == OP_UPDATE) states[label] = LABEL_LIVE;
+                else if (op == OP_DELETE) states[label] = LABEL_DELETED;
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t skipped = 0, failed = 0;
+    std::vector<double> merged[OP_KIND_COUNT];
+    for (const auto& r : results) {
+        skipped += r.skipped;
+        failed += r.failed;
+        for (int op = 0; op < OP_KIND_COUNT; op++)
+            merged[op].insert(merged[op].end(), r.latencies_us[op].begin(), r.latencies_us[op].end());
+    }
+    size_t completed = 0;
+    for (int op = 0; op < OP_KIND_COUNT; op++) {
+        std::sort(merged[op].begin(), merged[op].end());
+        completed += merged[op].size();
+    }
+    std::cerr << completed << " ops in " << seconds << " s with " << opt.threads << " threads, "
+              << skipped << " skipped, " << failed << " failed, "
+              << index.getCurrentElementCount() - index.getDeletedCount() << " live elements" << std::endl;
+
+    if (opt.json) {
+        printf("{\"threads\": %zu, \"seconds\": %.3f, \"throughput\": %.1f, \"skipped\": %zu, \"failed\": %zu,\n",
+               opt.threads, seconds, completed / seconds, skipped, failed);
+        printf(" \"ops\": [\n");
+        for (int op = 0; op < OP_KIND_COUNT; op++) {
+            const auto& l = merged[op];
+            printf("  {\"op\": \"%s\", \"count\": %zu, \"throughput\": %.1f, \"p50_us\": %.2f, \"p99_us\": %.2f, "
+                   "\"p999_us\": %.2f, \"max_us\": %.2f}%s\n",
+                   op_names[op], l.size(), l.size() / seconds, percentile(l, 0.5), percentile(l, 0.99),
+                   percentile(l, 0.999), l.empty() ? 0.0 : l.back(), op + 1 < OP_KIND_COUNT ? "," : "");
+        }
+        printf(" ],\n \"locks\": [\n");
+#ifdef HNSWLIB_LOCK_STATS
+        for (int kind = 0; kind < hnswlib::LOCK_KIND_COUNT; kind++) {
+            hnswlib::LockStatsSnapshot s = hnswlib::LockStats::get(kind);
+            printf("  {\"lock\": \"%s\", \"acquisitions\": %llu, \"contended\": %llu, \"wait_ms\": %.3f}%s\n",
+                   hnswlib::lockKindName(kind), (unsigned long long) s.acquisitions,
+                   (unsigned long long) s.contended, s.wait_ns / 1e6,
+                   kind + 1 < hnswlib::LOCK_KIND_COUNT ? "," : "");
+        }
+#endif
+        printf(" ]}\n");
+    } else {
+        printf("op,count,throughput,p50_us,p99_us,p999_us,max_us\n");
+        for (int op = 0; op < OP_KIND_COUNT; op++) {
+            const auto& l = merged[op];
+            printf("%s,%zu,%.1f,%.2f,%.2f,%.2f,%.2f\n", op_names[op], l.size(), l.size() / seconds,
+                   percentile(l, 0.5), percentile(l, 0.99), percentile(l, 0.999), l.empty() ? 0.0 : l.back());
+        }
+#ifdef HNSWLIB_LOCK_STATS
+        printf("\nlock,acquisitions,contended,wait_ms\n");
+        for (int kind = 0; kind < hnswlib::LOCK_KIND_COUNT; kind++) {
+            hnswlib::LockStatsSnapshot s = hnswlib::LockStats::get(kind);
+            printf("%s,%llu,%llu,%.3f\n", hnswlib::lockKindName(kind), (unsigned long long) s.acquisitions,
+                   (unsigned long long) s.contended, s.wait_ns / 1e6);
+        }
+#endif
+    }
+    return 0;
+}
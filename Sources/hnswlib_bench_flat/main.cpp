@@ -0,0 +1,272 @@
+// hnswlib_bench_flat - standard HNSW against the flat single-level graph (setFlat)
+//
+// Builds both graphs over the same synthetic high-dimensional data (Gaussian clusters,
+// 768-d by default, like sentence embeddings), then sweeps the search ef. Reports per
+// graph the build time, the memory of level 0 and of the upper levels, and per ef the
+// single-query QPS, recall@k against brute force and distance computations per query.
+//
+// Usage:
+//   swift run -c release hnswlib_bench_flat [options]
+//
+// Options:
+//   --n N                  indexed vectors (default 50000)
+//   --queries N            queries, drawn like the data (default 500)
+//   --dim D                vector dimension (default 768)
+//   --clusters C           Gaussian clusters in the data (default 64)
+//   --k K                  neighbors per search (default 10)
+//   --efs LIST             comma separated search ef values (default 10,20,40,80,160)
+//   --M M                  HNSW M (default 16)
+//   --ef-construction EF   HNSW ef_construction (default 100)
+//   --routers R            routers of the flat graph (default 32)
+//   --threads N            build and ground truth threads (default: all cores)
+//   --seed S               random seed (default 100)
+//   --format csv|json      output format (default csv)
+
+#include "hnswlib.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    size_t n = 50000;
+    size_t queries = 500;
+    size_t dim = 768;
+    size_t clusters = 64;
+    size_t k = 10;
+    std::vector<size_t> efs = {10, 20, 40, 80, 160};
+    size_t M = 16;
+    size_t ef_construction = 100;
+    size_t routers = 32;
+    size_t threads = 0;
+    size_t seed = 100;
+    bool json = false;
+};
+
+struct Sweep {
+    size_t ef;
+    double qps;
+    double recall;
+    double distance_computations;
+};
+
+struct GraphResult {
+    const char* name;
+    double build_seconds;
+    size_t level0_bytes;
+    size_t upper_bytes;
+    int max_level;
+    std::vector<Sweep> sweeps;
+};
+
+std::vector<size_t> parseList(const std::string& value) {
+    std::vector<size_t> list;
+    size_t start = 0;
+    while (start < value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+        list.push_back(std::stoul(value.substr(start, end - start)));
+        start = end + 1;
+    }
+    return list;
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << "usage: hnswlib_bench_flat [--n N] [--queries N] [--dim D] [--clusters C] [--k K]\n"
+                         "           [--efs 10,20,40] [--M M] [--ef-construction EF] [--routers R]\n"
+                         "           [--threads N] [--seed S] [--format csv|json]\n";
+            exit(0);
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--n") opt.n = std::stoul(value);
+        else if (arg == "--queries") opt.queries = std::stoul(value);
+        else if (arg == "--dim") opt.dim = std::stoul(value);
+        else if (arg == "--clusters") opt.clusters = std::stoul(value);
+        else if (arg == "--k") opt.k = std::stoul(value);
+        else if (arg == "--efs") opt.efs = parseList(value);
+        else if (arg == "--M") opt.M = std::stoul(value);
+        else if (arg == "--ef-construction") opt.ef_construction = std::stoul(value);
+        else if (arg == "--routers") opt.routers = std::stoul(value);
+        else if (arg == "--threads") opt.threads = std::stoul(value);
+        else if (arg == "--seed") opt.seed = std::stoul(value);
+        else if (arg == "--format") opt.json = value == "json";
+        else throw std::runtime_error("Unknown option " + arg);
+    }
+    if (opt.n == 0 || opt.queries == 0 || opt.dim == 0 || opt.clusters == 0 || opt.k == 0 || opt.efs.empty())
+        throw std::runtime_error("--n, --queries, --dim, --clusters, --k and --efs must be positive");
+    if (opt.threads == 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+    return opt;
+}
+
+template<typename Fn>
+void parallelFor(size_t count, size_t threads, Fn fn) {
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            size_t i;
+            while ((i = next++) < count) fn(i);
+        });
+    }
+    for (auto& w : workers) w.join();
+}
+
+// rows vectors around `clusters` random centers, the first rows being the data
+std::vector<float> makeData(const Options& opt, size_t rows) {
+    std::mt19937 rng(opt.seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> centers(opt.clusters * opt.dim);
+    for (auto& c : centers) c = normal(rng);
+    std::uniform_int_distribution<size_t> pick(0, opt.clusters - 1);
+    std::vector<float> data(rows * opt.dim);
+    for (size_t i = 0; i < rows; i++) {
+        const float* center = &centers[pick(rng) * opt.dim];
+        for (size_t j = 0; j < opt.dim; j++)
+            data[i * opt.dim + j] = center[j] + 0.5f * normal(rng);
+    }
+    return data;
+}
+
+GraphResult run(const char* name, bool flat, const Options& opt, hnswlib::L2Space& space,
+                const std::vector<float>& data, const std::vector<float>& queries,
+                const std::vector<std::vector<hnswlib::labeltype>>& truth) {
+    GraphResult result;
+    result.name = name;
+
+    hnswlib::HierarchicalNSW<float> index(&space, opt.n, opt.M, opt.ef_construction, opt.seed);
+    if (flat) index.setFlat(opt.routers);
+    std::cerr << "building " << name << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    index.addPoint(data.data(), 0);
+    parallelFor(opt.n - 1, opt.threads, [&](size_t i) {
+        index.addPoint(&data[(i + 1) * opt.dim], i + 1);
+    });
+    result.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // level 0 holds vector, label and links in one block, upper levels are one malloc per element
+    result.level0_bytes = opt.n * index.size_data_per_element_;
+    result.upper_bytes = opt.n * sizeof(void*);
+    for (size_t i = 0; i < opt.n; i++) {
+        if (index.element_levels_[i] > 0)
+            result.upper_bytes += index.size_links_per_element_ * index.element_levels_[i] + 1;
+    }
+    result.max_level = index.maxlevel_;
+
+    // queries run one at a time on one thread, so QPS is per core
+    for (size_t ef : opt.efs) {
+        index.setEf(ef);
+        size_t found = 0;
+        auto search_start = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < opt.queries; q++) {
+            auto neighbors = index.searchKnn(&queries[q * opt.dim], opt.k);
+            while (!neighbors.empty()) {
+                const auto& expected = truth[q];
+                if (std::find(expected.begin(), expected.end(), neighbors.top().second) != expected.end())
+                    found++;
+                neighbors.pop();
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count();
+
+        // a second, untimed pass counts the work, including the descent or router choice
+        size_t distance_computations = 0;
+        for (size_t q = 0; q < opt.queries; q++) {
+            hnswlib::SearchStats stats;
+            index.searchKnnWithStats(&queries[q * opt.dim], opt.k, stats);
+            distance_computations += stats.upper_distance_computations + stats.base_distance_computations;
+        }
+        Sweep sweep;
+        sweep.ef = ef;
+        sweep.qps = opt.queries / seconds;
+        sweep.recall = (double) found / (opt.queries * opt.k);
+        sweep.distance_computations = (double) distance_computations / opt.queries;
+        result.sweeps.push_back(sweep);
+    }
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    try {
+        opt = parseArgs(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    opt.k = std::min(opt.k, opt.n);
+
+    std::vector<float> all = makeData(opt, opt.n + opt.queries);
+    std::vector<float> data(all.begin(), all.begin() + opt.n * opt.dim);
+    std::vector<float> queries(all.begin() + opt.n * opt.dim, all.end());
+    hnswlib::L2Space space(opt.dim);
+
+    std::cerr << "brute force ground truth for " << opt.queries << " queries over " << opt.n
+              << " vectors of dim " << opt.dim << std::endl;
+    std::vector<std::vector<hnswlib::labeltype>> truth(opt.queries);
+    {
+        hnswlib::BruteforceSearch<float> exact(&space, opt.n);
+        for (size_t i = 0; i < opt.n; i++)
+            exact.addPoint(&data[i * opt.dim], i);
+        parallelFor(opt.queries, opt.threads, [&](size_t q) {
+            auto neighbors = exact.searchKnn(&queries[q * opt.dim], opt.k);
+            while (!neighbors.empty()) {
+                truth[q].push_back(neighbors.top().second);
+                neighbors.pop();
+            }
+        });
+    }
+
+    std::vector<GraphResult> results;
+    try {
+        results.push_back(run("hnsw", false, opt, space, data, queries, truth));
+        results.push_back(run("flat", true, opt, space, data, queries, truth));
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (opt.json) {
+        printf("{\"n\": %zu, \"dim\": %zu, \"k\": %zu, \"M\": %zu, \"ef_construction\": %zu, \"graphs\": [\n",
+               opt.n, opt.dim, opt.k, opt.M, opt.ef_construction);
+        for (size_t g = 0; g < results.size(); g++) {
+            const GraphResult& r = results[g];
+            printf("  {\"graph\": \"%s\", \"build_s\": %.3f, \"level0_bytes\": %zu, \"upper_bytes\": %zu, "
+                   "\"max_level\": %d, \"sweeps\": [\n",
+                   r.name, r.build_seconds, r.level0_bytes, r.upper_bytes, r.max_level);
+            for (size_t s = 0; s < r.sweeps.size(); s++) {
+                const Sweep& w = r.sweeps[s];
+                printf("    {\"ef\": %zu, \"qps\": %.1f, \"recall\": %.4f, \"distance_computations\": %.1f}%s\n",
+                       w.ef, w.qps, w.recall, w.distance_computations, s + 1 < r.sweeps.size() ? "," : "");
+            }
+            printf("  ]}%s\n", g + 1 < results.size() ? "," : "");
+        }
+        printf("]}\n");
+    } else {
+        printf("graph,build_s,level0_bytes,upper_bytes,max_level,ef,qps,recall,distance_computations\n");
+        for (const GraphResult& r : results) {
+            for (const Sweep& w : r.sweeps) {
+                printf("%s,%.3f,%zu,%zu,%d,%zu,%.1f,%.4f,%.1f\n", r.name, r.build_seconds, r.level0_bytes,
+                       r.upper_bytes, r.max_level, w.ef, w.qps, w.recall, w.distance_computations);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,390 @@
+// hnswlib_bench_kernels - throughput of every distance kernel in space_l2.h / space_ip.h
+//
+// Each kernel that is compiled in and supported by the CPU is timed over a range
+// of dimensions, with aligned and unaligned inputs and three working sets:
+//   hot     the same two vectors over and over (L1 resident)
+//   stream  one query against a large pool read sequentially (brute-force scan)
+//   random  one query against a large pool in random order (graph traversal)
+// The `selected` column marks the kernel L2Space / InnerProductSpace / L2SpaceI
+// pick for that dimension on this machine.
+//
+// Usage:
+//   swift run -c release hnswlib_bench_kernels [options]
+//
+// Options:
+//   --dims LIST        comma separated dimensions (default 4,7,8,16,25,32,64,100,128,
+//                      256,384,512,768,1000,1024,1536,2048,4096)
+//   --kernels LIST     only run kernels whose name contains one of the given substrings
+//   --pool-mb N        size of the out-of-cache pool in MB (default 256)
+//   --min-time S       minimum measured time per case in seconds (default 0.05)
+//   --ghz F            core clock used for bytes/cycle; measured from the TSC if omitted
+//   --format csv|json  output format (default csv)
+
+#include "hnswlib.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC
+#endif
+
+namespace {
+
+using hnswlib::DISTFUNC;
+
+enum Requirement {
+    ANY_DIM,
+    DIM_MULTIPLE_OF_4,
+    DIM_MULTIPLE_OF_16,
+    DIM_ABOVE_4,
+    DIM_ABOVE_16
+};
+
+struct Kernel {
+    const char* name;
+    DISTFUNC<float> float_fn;
+    DISTFUNC<int> int_fn;
+    Requirement requirement;
+    size_t flops_per_dim;   // sub + mul + add for L2, mul + add for IP
+    bool available;
+};
+
+struct Options {
+    std::vector<size_t> dims = {4, 7, 8, 16, 25, 32, 64, 100, 128, 256, 384, 512, 768,
+                                1000, 1024, 1536, 2048, 4096};
+    std::vector<std::string> filters;
+    size_t pool_mb = 256;
+    double min_time = 0.05;
+    double ghz = 0;
+    bool json = false;
+};
+
+struct Result {
+    const char* kernel;
+    size_t dim;
+    bool aligned;
+    const char* working_set;
+    bool selected;
+    double ns_per_call;
+    double gflops;
+    double gbytes_per_s;
+    double bytes_per_cycle;
+};
+
+volatile double g_sink;
+
+bool avxCapable() {
+#if defined(USE_AVX)
+    return AVXCapable();
+#else
+    return false;
+#endif
+}
+
+bool avx512Capable() {
+#if defined(USE_AVX512)
+    return AVX512Capable();
+#else
+    return false;
+#endif
+}
+
+std::vector<Kernel> allKernels() {
+    std::vector<Kernel> k;
+    bool avx = avxCapable();
+    bool avx512 = avx512Capable();
+    (void) avx;
+    (void) avx512;
+
+    k.push_back({"L2Sqr", hnswlib::L2Sqr, nullptr, ANY_DIM, 3, true});
+#if defined(USE_AVX512)
+    k.push_back({"L2SqrSIMD16ExtAVX512", hnswlib::L2SqrSIMD16ExtAVX512, nullptr, DIM_MULTIPLE_OF_16, 3, avx512});
+#endif
+#if defined(USE_AVX)
+    k.push_back({"L2SqrSIMD16ExtAVX", hnswlib::L2SqrSIMD16ExtAVX, nullptr, DIM_MULTIPLE_OF_16, 3, avx});
+#endif
+#if defined(USE_SSE)
+    k.push_back({"L2SqrSIMD16ExtSSE", hnswlib::L2SqrSIMD16ExtSSE, nullptr, DIM_MULTIPLE_OF_16, 3, true});
+    k.push_back({"L2SqrSIMD4Ext", hnswlib::L2SqrSIMD4Ext, nullptr, DIM_MULTIPLE_OF_4, 3, true});
+    k.push_back({"L2SqrSIMD16ExtResiduals", hnswlib::L2SqrSIMD16ExtResiduals, nullptr, DIM_ABOVE_16, 3, true});
+    k.push_back({"L2SqrSIMD4ExtResiduals", hnswlib::L2SqrSIMD4ExtResiduals, nullptr, DIM_ABOVE_4, 3, true});
+#endif
+    k.push_back({"L2SqrI", nullptr, hnswlib::L2SqrI, ANY_DIM, 3, true});
+    k.push_back({"L2SqrI4x", nullptr, hnswlib::L2SqrI4x, DIM_MULTIPLE_OF_4, 3, true});
+
+    k.push_back({"InnerProductDistance", hnswlib::InnerProductDistance, nullptr, ANY_DIM, 2, true});
+#if defined(USE_AVX512)
+    k.push_back({"InnerProductDistanceSIMD16ExtAVX512", hnswlib::InnerProductDistanceSIMD16ExtAVX512, nullptr,
+                 DIM_MULTIPLE_OF_16, 2, avx512});
+#endif
+#if defined(USE_AVX)
+    k.push_back({"InnerProductDistanceSIMD16ExtAVX", hnswlib::InnerProductDistanceSIMD16ExtAVX, nullptr,
+                 DIM_MULTIPLE_OF_16, 2, avx});
+    k.push_back({"InnerProductDistanceSIMD4ExtAVX", hnswlib::InnerProductDistanceSIMD4ExtAVX, nullptr,
+                 DIM_MULTIPLE_OF_4, 2, avx});
+#endif
+#if defined(USE_SSE)
+    k.push_back({"InnerProductDistanceSIMD16ExtSSE", hnswlib::InnerProductDistanceSIMD16ExtSSE, nullptr,
+                 DIM_MULTIPLE_OF_16, 2, true});
+    k.push_back({"InnerProductDistanceSIMD4ExtSSE", hnswlib::InnerProductDistanceSIMD4ExtSSE, nullptr,
+                 DIM_MULTIPLE_OF_4, 2, true});
+    k.push_back({"InnerProductDistanceSIMD16ExtResiduals", hnswlib::InnerProductDistanceSIMD16ExtResiduals, nullptr,
+                 DIM_ABOVE_16, 2, true});
+    k.push_back({"InnerProductDistanceSIMD4ExtResiduals", hnswlib::InnerProductDistanceSIMD4ExtResiduals, nullptr,
+                 DIM_ABOVE_4, 2, true});
+#endif
+    return k;
+}
+
+bool supportsDim(const Kernel& kernel, size_t dim) {
+    switch (kernel.requirement) {
+        case DIM_MULTIPLE_OF_4: return dim % 4 == 0;
+        case DIM_MULTIPLE_OF_16: return dim % 16 == 0;
+        case DIM_ABOVE_4: return dim > 4;
+        case DIM_ABOVE_16: return dim > 16;
+        default: return true;
+    }
+}
+
+// The kernel the spaces dispatch to for `dim`. Constructing a space also sets the
+// SIMD16Ext / SIMD4Ext function pointers that the residual kernels call into.
+bool isSelected(const Kernel& kernel, size_t dim) {
+    if (kernel.int_fn) {
+        hnswlib::L2SpaceI space(dim);
+        return space.get_dist_func() == kernel.int_fn;
+    }
+    hnswlib::L2Space l2(dim);
+    hnswlib::InnerProductSpace ip(dim);
+    return l2.get_dist_func() == kernel.float_fn || ip.get_dist_func() == kernel.float_fn;
+}
+
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double measureGhz() {
+#if defined(BENCH_HAS_TSC)
+    double t0 = nowSeconds();
+    unsigned long long c0 = __rdtsc();
+    while (nowSeconds() - t0 < 0.2) {}
+    double t1 = nowSeconds();
+    unsigned long long c1 = __rdtsc();
+    return (c1 - c0) / (t1 - t0) / 1e9;
+#else
+    return 0;
+#endif
+}
+
+/*
+* One buffer of random floats backs every case. A view lays vectors out in it at a
+* 64-byte stride; the unaligned view shifts every vector by 4 bytes so that none
+* of them start on a 16-byte boundary. Byte kernels read the same memory as bytes.
+*/
+struct Pool {
+    std::vector<float> storage;
+
+    explicit Pool(size_t bytes) {
+        storage.resize(bytes / sizeof(float) + 64);
+        std::mt19937 rng(100);
+        std::uniform_real_distribution<float> real(-1.0f, 1.0f);
+        for (auto& v : storage)
+            v = real(rng);
+    }
+
+    std::vector<const char*> view(size_t bytes_per_vector, size_t working_set_bytes, bool aligned) const {
+        size_t stride = (bytes_per_vector + 4 + 63) / 64 * 64;
+        size_t available = storage.size() * sizeof(float) - 128;
+        size_t count = std::max<size_t>(2, std::min(working_set_bytes, available) / stride);
+        uintptr_t p = ((uintptr_t) storage.data() + 63) & ~(uintptr_t) 63;
+        const char* base = (const char*) p + (aligned ? 0 : 4);
+
+        std::vector<const char*> vectors(count);
+        for (size_t i = 0; i < count; i++)
+            vectors[i] = base + i * stride;
+        return vectors;
+    }
+};
+
+template<typename dist_t>
+double runOnce(DISTFUNC<dist_t> fn, size_t dim, const char* query, const std::vector<const char*>& targets,
+               size_t iterations) {
+    double acc = 0;
+    size_t n = targets.size();
+    double start = nowSeconds();
+    for (size_t it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < n; i++)
+            acc += fn(query, targets[i], &dim);
+    }
+    double elapsed = nowSeconds() - start;
+    g_sink = acc;
+    return elapsed;
+}
+
+template<typename dist_t>
+double timeKernel(DISTFUNC<dist_t> fn, size_t dim, const char* query, const std::vector<const char*>& targets,
+                  double min_time) {
+    // grow the iteration count until a run is long enough, then keep the best of 3
+    size_t iterations = 1;
+    double elapsed = runOnce(fn, dim, query, targets, iterations);
+    while (elapsed < min_time / 4) {
+        iterations *= 2;
+        elapsed = runOnce(fn, dim, query, targets, iterations);
+    }
+    double best = elapsed;
+    for (int rep = 0; rep < 3; rep++)
+        best = std::min(best, runOnce(fn, dim, query, targets, iterations));
+    return best / (iterations * targets.size());
+}
+
+std::vector<std::string> split(const std::string& s) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos) end = s.size();
+        if (end > start) parts.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << "usage: hnswlib_bench_kernels [--dims LIST] [--kernels LIST] [--pool-mb N]\n"
+                         "                             [--min-time S] [--ghz F] [--format csv|json]\n";
+            exit(0);
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--dims") {
+            opt.dims.clear();
+            for (const auto& d : split(value)) opt.dims.push_back(std::stoul(d));
+        } else if (arg == "--kernels") opt.filters = split(value);
+        else if (arg == "--pool-mb") opt.pool_mb = std::stoul(value);
+        else if (arg == "--min-time") opt.min_time = std::stod(value);
+        else if (arg == "--ghz") opt.ghz = std::stod(value);
+        else if (arg == "--format") opt.json = value == "json";
+        else throw std::runtime_error("Unknown option " + arg);
+    }
+    return opt;
+}
+
+bool matchesFilter(const Kernel& kernel, const Options& opt) {
+    if (opt.filters.empty()) return true;
+    for (const auto& f : opt.filters) {
+        if (std::string(kernel.name).find(f) != std::string::npos) return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    try {
+        opt = parseArgs(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    double ghz = opt.ghz > 0 ? opt.ghz : measureGhz();
+    std::vector<Kernel> kernels = allKernels();
+
+    std::cerr << "compiled with:"
+#if defined(USE_SSE)
+              << " SSE"
+#endif
+#if defined(USE_AVX)
+              << " AVX"
+#endif
+#if defined(USE_AVX512)
+              << " AVX512"
+#endif
+              << "; cpu supports:" << (avxCapable() ? " AVX" : "") << (avx512Capable() ? " AVX512" : "")
+              << "; clock " << ghz << " GHz" << std::endl;
+    for (const auto& kernel : kernels) {
+        if (!kernel.available)
+            std::cerr << "skipping " << kernel.name << ": not supported by this cpu" << std::endl;
+    }
+
+    const char* working_sets[] = {"hot", "stream", "random"};
+    std::vector<Result> results;
+    std::mt19937 rng(100);
+
+    Pool pool((opt.pool_mb << 20) + (1 << 20));
+
+    for (size_t dim : opt.dims) {
+        for (int aligned = 1; aligned >= 0; aligned--) {
+            for (const auto& kernel : kernels) {
+                if (!kernel.available || !supportsDim(kernel, dim) || !matchesFilter(kernel, opt))
+                    continue;
+                bool selected = isSelected(kernel, dim);
+                size_t elem_size = kernel.int_fn ? 1 : sizeof(float);
+
+                for (const char* ws : working_sets) {
+                    bool hot = strcmp(ws, "hot") == 0;
+                    std::vector<const char*> targets = pool.view(dim * elem_size, hot ? 0 : opt.pool_mb << 20, aligned);
+                    const char* query = targets.back();
+                    targets.pop_back();
+                    if (strcmp(ws, "random") == 0)
+                        std::shuffle(targets.begin(), targets.end(), rng);
+
+                    double seconds = kernel.int_fn
+                            ? timeKernel(kernel.int_fn, dim, query, targets, opt.min_time)
+                            : timeKernel(kernel.float_fn, dim, query, targets, opt.min_time);
+
+                    // both operands are counted, even though the query stays cached
+                    double bytes = 2.0 * dim * elem_size;
+                    Result r;
+                    r.kernel = kernel.name;
+                    r.dim = dim;
+                    r.aligned = aligned;
+                    r.working_set = ws;
+                    r.selected = selected;
+                    r.ns_per_call = seconds * 1e9;
+                    r.gflops = kernel.flops_per_dim * dim / seconds / 1e9;
+                    r.gbytes_per_s = bytes / seconds / 1e9;
+                    r.bytes_per_cycle = ghz > 0 ? bytes / (seconds * ghz * 1e9) : 0;
+                    results.push_back(r);
+
+                    if (!opt.json) {
+                        printf("%s%s,%zu,%s,%s,%d,%.2f,%.3f,%.3f,%.3f\n",
+                               results.size() == 1 ? "kernel,dim,aligned,working_set,selected,ns_per_call,"
+                                                     "gflops,gbytes_per_s,bytes_per_cycle\n" : "",
+                               r.kernel, r.dim, r.aligned ? "yes" : "no", r.working_set, r.selected ? 1 : 0,
+                               r.ns_per_call, r.gflops, r.gbytes_per_s, r.bytes_per_cycle);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    if (opt.json) {
+        printf("{\"clock_ghz\": %.3f, \"results\": [\n", ghz);
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            printf("  {\"kernel\": \"%s\", \"dim\": %zu, \"aligned\": %s, \"working_set\": \"%s\", "
+                   "\"selected\": %s, \"ns_per_call\": %.2f, \"gflops\": %.3f, \"gbytes_per_s\": %.3f, "
+                   "\"bytes_per_cycle\": %.3f}%s\n",
+                   r.kernel, r.dim, r.aligned ? "true" : "false", r.working_set, r.selected ? "true" : "false",
+                   r.ns_per_call, r.gflops, r.gbytes_per_s, r.bytes_per_cycle,
+                   i + 1 < results.size() ? "," : "");
+        }
+        printf("]}\n");
+    }
+    return 0;
+}
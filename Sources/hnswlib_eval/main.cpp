@@ -0,0 +1,403 @@
+// hnswlib_eval - recall / QPS evaluation of HNSW against exact brute-force search
+//
+// Builds an HNSW index and a BruteForce index over the same data through the C
+// wrapper, computes ground truth with the batched exact search, then sweeps ef and
+// reports recall@k, throughput and latency percentiles for each value.
+//
+// Usage:
+//   swift run -c release hnswlib_eval [options]
+//
+// Options:
+//   --data PATH            base vectors (.fvecs, .bvecs or .npy); synthetic data if omitted
+//   --queries PATH         query vectors; if omitted the last --nq base rows are held out
+//   --synthetic N          number of synthetic base vectors (default 10000)
+//   --dim D                dimension of synthetic vectors (default 64)
+//   --nq N                 number of queries (default 200)
+//   --space l2|ip|cosine   distance (default l2)
+//   --k K                  neighbors per query (default 10)
+//   --M M                  HNSW M (default 16)
+//   --ef-construction EF   HNSW ef_construction (default 200)
+//   --ef LIST              comma separated ef values to sweep (default 10,20,40,80,160,320)
+//   --threads N            threads for build and batched search (default: all cores)
+//   --seed S               random seed (default 100)
+//   --format csv|json      output format (default csv)
+//   --min-recall R         exit with status 2 if the largest ef does not reach recall R
+
+#include "HNSWLibWrapper.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct Dataset {
+    size_t rows = 0;
+    size_t dim = 0;
+    std::vector<float> data;
+};
+
+struct Options {
+    std::string data_path;
+    std::string queries_path;
+    size_t synthetic = 10000;
+    size_t dim = 64;
+    size_t nq = 200;
+    SpaceType space = SpaceTypeL2;
+    size_t k = 10;
+    size_t M = 16;
+    size_t ef_construction = 200;
+    std::vector<size_t> ef_values = {10, 20, 40, 80, 160, 320};
+    int threads = 0;
+    size_t seed = 100;
+    bool json = false;
+    double min_recall = 0;
+};
+
+struct EvalRow {
+    size_t ef;
+    double recall;
+    double qps;
+    double mean_us;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double p999_us;
+};
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// .fvecs / .bvecs: every row is an int32 dimension followed by the components
+Dataset loadVecs(const std::string& path, bool bytes) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open())
+        throw std::runtime_error("Cannot open " + path);
+
+    Dataset ds;
+    int32_t dim;
+    std::vector<uint8_t> row_bytes;
+    while (input.read((char*)&dim, sizeof(dim))) {
+        if (dim <= 0 || (ds.dim && (size_t)dim != ds.dim))
+            throw std::runtime_error("Inconsistent dimension in " + path);
+        ds.dim = dim;
+        size_t offset = ds.data.size();
+        ds.data.resize(offset + dim);
+        if (bytes) {
+            row_bytes.resize(dim);
+            input.read((char*)row_bytes.data(), dim);
+            for (int32_t i = 0; i < dim; i++)
+                ds.data[offset + i] = row_bytes[i];
+        } else {
+            input.read((char*)&ds.data[offset], dim * sizeof(float));
+        }
+        if (!input)
+            throw std::runtime_error("Truncated row in " + path);
+        ds.rows++;
+    }
+    return ds;
+}
+
+// .npy: a 2-D C-order array of f4, f8, u1 or i1
+Dataset loadNpy(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open())
+        throw std::runtime_error("Cannot open " + path);
+
+    char magic[6];
+    uint8_t version[2];
+    input.read(magic, 6);
+    input.read((char*)version, 2);
+    if (!input || memcmp(magic, "\x93NUMPY", 6) != 0)
+        throw std::runtime_error("Not a .npy file: " + path);
+
+    uint32_t header_len = 0;
+    if (version[0] == 1) {
+        uint16_t len16;
+        input.read((char*)&len16, 2);
+        header_len = len16;
+    } else {
+        input.read((char*)&header_len, 4);
+    }
+    std::string header(header_len, ' ');
+    input.read(&header[0], header_len);
+
+    if (header.find("'fortran_order': False") == std::string::npos)
+        throw std::runtime_error("Fortran-ordered .npy is not supported");
+
+    size_t descr_pos = header.find("'descr':");
+    size_t quote = header.find('\'', descr_pos + 8);
+    std::string descr = header.substr(quote + 1, header.find('\'', quote + 1) - quote - 1);
+
+    size_t shape_pos = header.find('(', header.find("'shape':"));
+    size_t rows = 0, dim = 0;
+    if (sscanf(header.c_str() + shape_pos, "(%zu, %zu)", &rows, &dim) != 2)
+        throw std::runtime_error("Only 2-D .npy arrays are supported");
+
+    Dataset ds;
+    ds.rows = rows;
+    ds.dim = dim;
+    ds.data.resize(rows * dim);
+    size_t count = rows * dim;
+    if (descr == "<f4") {
+        input.read((char*)ds.data.data(), count * sizeof(float));
+    } else if (descr == "<f8") {
+        std::vector<double> buffer(count);
+        input.read((char*)buffer.data(), count * sizeof(double));
+        std::copy(buffer.begin(), buffer.end(), ds.data.begin());
+    } else if (descr == "|u1") {
+        std::vector<uint8_t> buffer(count);
+        input.read((char*)buffer.data(), count);
+        std::copy(buffer.begin(), buffer.end(), ds.data.begin());
+    } else if (descr == "|i1") {
+        std::vector<int8_t> buffer(count);
+        input.read((char*)buffer.data(), count);
+        std::copy(buffer.begin(), buffer.end(), ds.data.begin());
+    } else {
+        throw std::runtime_error("Unsupported .npy dtype " + descr);
+    }
+    if (!input)
+        throw std::runtime_error("Truncated data in " + path);
+    return ds;
+}
+
+Dataset loadDataset(const std::string& path) {
+    if (endsWith(path, ".fvecs"))
+        return loadVecs(path, false);
+    if (endsWith(path, ".bvecs"))
+        return loadVecs(path, true);
+    if (endsWith(path, ".npy"))
+        return loadNpy(path);
+    throw std::runtime_error("Unknown dataset format: " + path);
+}
+
+// Clustered gaussian data, which is closer to real embeddings than uniform noise
+Dataset syntheticDataset(size_t rows, size_t dim, size_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    size_t num_clusters = std::max<size_t>(1, rows / 1000);
+    std::vector<float> centers(num_clusters * dim);
+    for (auto& c : centers)
+        c = normal(rng) * 4.0f;
+
+    Dataset ds;
+    ds.rows = rows;
+    ds.dim = dim;
+    ds.data.resize(rows * dim);
+    std::uniform_int_distribution<size_t> pick(0, num_clusters - 1);
+    for (size_t i = 0; i < rows; i++) {
+        const float* center = &centers[pick(rng) * dim];
+        for (size_t j = 0; j < dim; j++)
+            ds.data[i * dim + j] = center[j] + normal(rng);
+    }
+    return ds;
+}
+
+double percentile(std::vector<double>& sorted_values, double p) {
+    if (sorted_values.empty()) return 0;
+    size_t idx = (size_t)(p * (sorted_values.size() - 1) + 0.5);
+    return sorted_values[std::min(idx, sorted_values.size() - 1)];
+}
+
+std::vector<size_t> parseList(const std::string& s) {
+    std::vector<size_t> values;
+    size_t start = 0;
+    while (start < s.size()) {
+        size_t end = s.find(',', start);
+        if (end == std::string::npos) end = s.size();
+        values.push_back(std::stoul(s.substr(start, end - start)));
+        start = end + 1;
+    }
+    return values;
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << "See the comment at the top of Sources/hnswlib_eval/main.cpp for options\n";
+            exit(0);
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--data") opt.data_path = value;
+        else if (arg == "--queries") opt.queries_path = value;
+        else if (arg == "--synthetic") opt.synthetic = std::stoul(value);
+        else if (arg == "--dim") opt.dim = std::stoul(value);
+        else if (arg == "--nq") opt.nq = std::stoul(value);
+        else if (arg == "--k") opt.k = std::stoul(value);
+        else if (arg == "--M") opt.M = std::stoul(value);
+        else if (arg == "--ef-construction") opt.ef_construction = std::stoul(value);
+        else if (arg == "--ef") opt.ef_values = parseList(value);
+        else if (arg == "--threads") opt.threads = std::stoi(value);
+        else if (arg == "--seed") opt.seed = std::stoul(value);
+        else if (arg == "--format") opt.json = value == "json";
+        else if (arg == "--min-recall") opt.min_recall = std::stod(value);
+        else if (arg == "--space") {
+            if (value == "l2") opt.space = SpaceTypeL2;
+            else if (value == "ip") opt.space = SpaceTypeIP;
+            else if (value == "cosine") opt.space = SpaceTypeCosine;
+            else throw std::runtime_error("Unknown space " + value);
+        } else {
+            throw std::runtime_error("Unknown option " + arg);
+        }
+    }
+    if (opt.threads <= 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+    return opt;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int run(int argc, char** argv) {
+    Options opt = parseOptions(argc, argv);
+
+    Dataset base = opt.data_path.empty()
+        ? syntheticDataset(opt.synthetic + (opt.queries_path.empty() ? opt.nq : 0), opt.dim, opt.seed)
+        : loadDataset(opt.data_path);
+    Dataset queries;
+    if (!opt.queries_path.empty()) {
+        queries = loadDataset(opt.queries_path);
+        if (queries.dim != base.dim)
+            throw std::runtime_error("Query and base dimensions differ");
+        queries.rows = std::min(queries.rows, opt.nq);
+        queries.data.resize(queries.rows * queries.dim);
+    } else {
+        // Hold out the last rows of the base set as queries
+        if (base.rows <= opt.nq)
+            throw std::runtime_error("Not enough rows to hold out queries");
+        queries.dim = base.dim;
+        queries.rows = opt.nq;
+        queries.data.assign(base.data.end() - opt.nq * base.dim, base.data.end());
+        base.rows -= opt.nq;
+        base.data.resize(base.rows * base.dim);
+    }
+    size_t dim = base.dim;
+    size_t k = opt.k;
+    size_t nq = queries.rows;
+    if (k > base.rows)
+        throw std::runtime_error("k is larger than the number of base vectors");
+
+    std::cerr << "base " << base.rows << "x" << dim << ", queries " << nq << ", k " << k
+              << ", threads " << opt.threads << std::endl;
+
+    // Ground truth through the batched exact search
+    BFIndex* bf = hnswlib_bf_index_create(opt.space, (int)dim);
+    if (!bf || !hnswlib_bf_index_init(bf, base.rows) ||
+        !hnswlib_bf_index_add_items(bf, base.data.data(), base.rows, dim, nullptr))
+        throw std::runtime_error("Failed to build the BruteForce index");
+    std::vector<uint64_t> gt_labels(nq * k);
+    std::vector<float> gt_distances(nq * k);
+    auto start = std::chrono::steady_clock::now();
+    if (!hnswlib_bf_index_search_knn(bf, queries.data.data(), k, gt_labels.data(), gt_distances.data(), nq, opt.threads))
+        throw std::runtime_error("Ground truth search failed");
+    double gt_seconds = secondsSince(start);
+    hnswlib_bf_index_free(bf);
+
+    // HNSW build
+    HNSWIndex* index = hnswlib_index_create(opt.space, (int)dim);
+    if (!index || !hnswlib_index_init(index, base.rows, opt.M, opt.ef_construction, opt.seed, false))
+        throw std::runtime_error("Failed to create the HNSW index");
+    start = std::chrono::steady_clock::now();
+    if (!hnswlib_index_add_items(index, base.data.data(), base.rows, dim, nullptr, opt.threads, false))
+        throw std::runtime_error("Failed to build the HNSW index");
+    double build_seconds = secondsSince(start);
+
+    std::vector<EvalRow> rows;
+    std::vector<uint64_t> labels(nq * k);
+    std::vector<float> distances(nq * k);
+    std::vector<double> latencies(nq);
+    for (size_t ef : opt.ef_values) {
+        hnswlib_index_set_ef(index, ef);
+
+        // Throughput: one batched call across all threads
+        start = std::chrono::steady_clock::now();
+        if (!hnswlib_index_search_knn(index, queries.data.data(), k, labels.data(), distances.data(), nq, opt.threads))
+            throw std::runtime_error("HNSW search failed");
+        double batch_seconds = secondsSince(start);
+
+        // Latency: one query at a time on a single thread
+        for (size_t i = 0; i < nq; i++) {
+            auto query_start = std::chrono::steady_clock::now();
+            hnswlib_index_search_knn(index, &queries.data[i * dim], k, &labels[i * k], &distances[i * k], 1, 1);
+            latencies[i] = secondsSince(query_start) * 1e6;
+        }
+
+        size_t hits = 0;
+        for (size_t i = 0; i < nq; i++) {
+            std::unordered_set<uint64_t> truth(gt_labels.begin() + i * k, gt_labels.begin() + (i + 1) * k);
+            for (size_t j = 0; j < k; j++)
+                hits += truth.count(labels[i * k + j]);
+        }
+
+        double total_us = 0;
+        for (double l : latencies) total_us += l;
+        std::sort(latencies.begin(), latencies.end());
+
+        EvalRow row;
+        row.ef = ef;
+        row.recall = (double)hits / (double)(nq * k);
+        row.qps = nq / batch_seconds;
+        row.mean_us = total_us / nq;
+        row.p50_us = percentile(latencies, 0.50);
+        row.p90_us = percentile(latencies, 0.90);
+        row.p99_us = percentile(latencies, 0.99);
+        row.p999_us = percentile(latencies, 0.999);
+        rows.push_back(row);
+    }
+    hnswlib_index_free(index);
+
+    if (opt.json) {
+        printf("{\n  \"rows\": %zu, \"dim\": %zu, \"queries\": %zu, \"k\": %zu, \"M\": %zu, \"ef_construction\": %zu,\n",
+               base.rows, dim, nq, k, opt.M, opt.ef_construction);
+        printf("  \"threads\": %d, \"build_seconds\": %.3f, \"ground_truth_seconds\": %.3f,\n",
+               opt.threads, build_seconds, gt_seconds);
+        printf("  \"results\": [\n");
+        for (size_t i = 0; i < rows.size(); i++) {
+            const EvalRow& r = rows[i];
+            printf("    {\"ef\": %zu, \"recall\": %.5f, \"qps\": %.1f, \"mean_us\": %.1f, \"p50_us\": %.1f, "
+                   "\"p90_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f}%s\n",
+                   r.ef, r.recall, r.qps, r.mean_us, r.p50_us, r.p90_us, r.p99_us, r.p999_us,
+                   i + 1 < rows.size() ? "," : "");
+        }
+        printf("  ]\n}\n");
+    } else {
+        printf("ef,recall@%zu,qps,mean_us,p50_us,p90_us,p99_us,p999_us,build_seconds\n", k);
+        for (const EvalRow& r : rows) {
+            printf("%zu,%.5f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.3f\n",
+                   r.ef, r.recall, r.qps, r.mean_us, r.p50_us, r.p90_us, r.p99_us, r.p999_us, build_seconds);
+        }
+    }
+
+    if (!rows.empty() && rows.back().recall < opt.min_recall) {
+        std::cerr << "recall " << rows.back().recall << " at ef " << rows.back().ef
+                  << " is below the required " << opt.min_recall << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
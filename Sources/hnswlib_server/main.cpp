@@ -0,0 +1,589 @@
+// hnswlib_server - serves one HNSW index over a Unix domain socket
+//
+// Loads (or creates) an index through the C wrapper and answers kNN, range, insert,
+// delete and stats requests from any number of local clients. Single kNN queries that
+// arrive concurrently are collected into micro-batches and answered with one batched
+// hnswlib_index_search_knn call, so many small clients still use every thread.
+//
+// Usage:
+//   swift run -c release hnswlib_server --socket /tmp/hnsw.sock --dim 128 [options]
+//
+// Options:
+//   --socket PATH          socket to listen on (required); an existing file is replaced
+//   --index PATH           index to load; an empty index is created if omitted
+//   --dim D                vector dimension (required)
+//   --space l2|ip|cosine   distance (default l2)
+//   --max-elements N       capacity of a new index, or of the loaded one if larger (default 100000)
+//   --M M                  HNSW M of a new index (default 16)
+//   --ef-construction EF   HNSW ef_construction of a new index (default 200)
+//   --ef EF                search ef (default 64)
+//   --threads N            threads of a batched search (default: all cores)
+//   --max-batch N          largest micro-batch of kNN queries (default 64)
+//   --max-wait-us US       longest a kNN query waits for its batch to fill (default 200)
+//   --save PATH            save the index here on SIGINT / SIGTERM
+//
+// Protocol: every message is a 5 byte header, a uint8 opcode (requests) or status
+// (responses) and a uint32 payload length, followed by the payload. All integers and
+// floats are little endian. Requests:
+//   1 KNN      uint32 k, float[dim] query
+//   2 RANGE    float radius, uint32 max_results, float[dim] query
+//   3 INSERT   uint64 label, float[dim] vector
+//   4 DELETE   uint64 label
+//   5 STATS    empty
+// A response has status 0 on success and 1 on failure, with the error text as payload.
+// KNN and RANGE return uint32 count followed by count x (uint64 label, float distance),
+// closest first; INSERT and DELETE return an empty payload; STATS returns the server
+// counters and the index histograms in the Prometheus text format. KNN fails if k exceeds
+// the number of elements, RANGE returns at most that many, DELETE fails for an unknown label.
+
+#include "HNSWLibWrapper.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+enum Opcode : uint8_t {
+    OP_KNN = 1,
+    OP_RANGE = 2,
+    OP_INSERT = 3,
+    OP_DELETE = 4,
+    OP_STATS = 5
+};
+
+const uint8_t STATUS_OK = 0;
+const uint8_t STATUS_ERROR = 1;
+const uint32_t MAX_PAYLOAD = 64 << 20;
+
+struct Options {
+    std::string socket_path;
+    std::string index_path;
+    std::string save_path;
+    size_t dim = 0;
+    SpaceType space = SpaceTypeL2;
+    size_t max_elements = 100000;
+    size_t M = 16;
+    size_t ef_construction = 200;
+    size_t ef = 64;
+    int threads = 0;
+    size_t max_batch = 64;
+    size_t max_wait_us = 200;
+};
+
+struct ServerStats {
+    std::atomic<uint64_t> requests[OP_STATS + 1];
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> connections;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> batched_queries;
+    std::atomic<uint64_t> batch_wait_ns;  // summed over queries: enqueue to batch start
+
+    ServerStats() : errors(0), connections(0), batches(0), batched_queries(0), batch_wait_ns(0) {
+        for (auto& r : requests) r = 0;
+    }
+};
+
+// One kNN query waiting for its micro-batch
+struct PendingQuery {
+    const float* vector;
+    size_t k;
+    std::chrono::steady_clock::time_point enqueued;
+    std::vector<uint64_t> labels;
+    std::vector<float> distances;
+    bool done = false;
+    bool ok = false;
+};
+
+/*
+ * Collects kNN queries from the connection threads. A batch is searched once it holds
+ * max_batch queries or its oldest query has waited max_wait_us. All queries of a batch
+ * are searched with the largest k among them and cut back afterwards.
+ */
+class QueryBatcher {
+    HNSWIndex* index_;
+    size_t dim_;
+    size_t max_batch_;
+    std::chrono::microseconds max_wait_;
+    int threads_;
+    ServerStats& stats_;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable finished_;
+    std::deque<PendingQuery*> queue_;
+    bool stop_ = false;
+    std::thread worker_;
+
+    void searchBatch(std::vector<PendingQuery*>& batch) {
+        size_t k = 0;
+        for (PendingQuery* q : batch) k = std::max(k, q->k);
+        k = std::min(k, hnswlib_index_get_current_count(index_));
+
+        std::vector<float> queries(batch.size() * dim_);
+        for (size_t i = 0; i < batch.size(); i++)
+            memcpy(&queries[i * dim_], batch[i]->vector, dim_ * sizeof(float));
+        std::vector<uint64_t> labels(batch.size() * k);
+        std::vector<float> distances(batch.size() * k);
+
+        bool ok = k > 0 && hnswlib_index_search_knn_with_stats(index_, queries.data(), k, labels.data(), distances.data(),
+                                                               batch.size(), threads_, nullptr);
+        for (size_t i = 0; i < batch.size(); i++) {
+            PendingQuery* q = batch[i];
+            size_t n = std::min(q->k, k);
+            if (ok) {
+                q->labels.assign(labels.begin() + i * k, labels.begin() + i * k + n);
+                q->distances.assign(distances.begin() + i * k, distances.begin() + i * k + n);
+                q->ok = true;
+            } else if (n > 0) {
+                // one query of the batch failed (e.g. too many deleted points), retry each alone
+                q->labels.resize(n);
+                q->distances.resize(n);
+                q->ok = hnswlib_index_search_knn_with_stats(index_, q->vector, n, q->labels.data(), q->distances.data(),
+                                                            1, 1, nullptr);
+            }
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            queued_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_ && queue_.empty()) return;
+
+            auto deadline = queue_.front()->enqueued + max_wait_;
+            queued_.wait_until(lock, deadline, [this] { return stop_ || queue_.size() >= max_batch_; });
+
+            std::vector<PendingQuery*> batch;
+            while (!queue_.empty() && batch.size() < max_batch_) {
+                batch.push_back(queue_.front());
+                queue_.pop_front();
+            }
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            for (PendingQuery* q : batch) {
+                stats_.batch_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(start - q->enqueued).count();
+            }
+            stats_.batches++;
+            stats_.batched_queries += batch.size();
+            searchBatch(batch);
+
+            lock.lock();
+            for (PendingQuery* q : batch) q->done = true;
+            finished_.notify_all();
+        }
+    }
+
+ public:
+    QueryBatcher(HNSWIndex* index, size_t dim, const Options& opt, ServerStats& stats)
+        : index_(index), dim_(dim), max_batch_(std::max<size_t>(1, opt.max_batch)),
+          max_wait_(opt.max_wait_us), threads_(opt.threads), stats_(stats) {
+        worker_ = std::thread(&QueryBatcher::run, this);
+    }
+
+    ~QueryBatcher() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        queued_.notify_all();
+        worker_.join();
+    }
+
+    // Blocks the calling connection thread until the batch containing `query` is done
+    void search(PendingQuery& query) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        query.enqueued = std::chrono::steady_clock::now();
+        queue_.push_back(&query);
+        if (queue_.size() == 1 || queue_.size() >= max_batch_) queued_.notify_one();
+        finished_.wait(lock, [&query] { return query.done; });
+    }
+};
+
+class Server {
+    HNSWIndex* index_;
+    Options opt_;
+    ServerStats stats_;
+    QueryBatcher batcher_;
+    std::mutex clients_mutex_;
+    std::condition_variable clients_done_;
+    size_t active_clients_ = 0;
+    std::unordered_set<int> client_fds_;  // connections still open, guarded by clients_mutex_
+
+    static bool readFully(int fd, void* buffer, size_t size) {
+        char* p = (char*)buffer;
+        while (size > 0) {
+            ssize_t n = ::read(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static bool writeFully(int fd, const void* buffer, size_t size) {
+        const char* p = (const char*)buffer;
+        while (size > 0) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static bool sendMessage(int fd, uint8_t status, const std::string& payload) {
+        char header[5];
+        uint32_t length = (uint32_t)payload.size();
+        header[0] = (char)status;
+        memcpy(header + 1, &length, sizeof(length));
+        return writeFully(fd, header, sizeof(header)) && writeFully(fd, payload.data(), payload.size());
+    }
+
+    template<class T>
+    static void append(std::string& out, const T& value) {
+        out.append((const char*)&value, sizeof(value));
+    }
+
+    static std::string neighbors(const uint64_t* labels, const float* distances, size_t count) {
+        std::string out;
+        append(out, (uint32_t)count);
+        for (size_t i = 0; i < count; i++) {
+            append(out, labels[i]);
+            append(out, distances[i]);
+        }
+        return out;
+    }
+
+    void expectSize(const std::string& payload, size_t size) const {
+        if (payload.size() != size)
+            throw std::runtime_error("Payload size " + std::to_string(payload.size()) + ", expected " + std::to_string(size));
+    }
+
+    // The vector at `offset` of the payload, copied out since payload offsets are not float aligned
+    std::vector<float> vectorAt(const std::string& payload, size_t offset) const {
+        std::vector<float> vector(opt_.dim);
+        memcpy(vector.data(), payload.data() + offset, opt_.dim * sizeof(float));
+        return vector;
+    }
+
+    std::string handle(uint8_t op, const std::string& payload) {
+        size_t vector_bytes = opt_.dim * sizeof(float);
+        switch (op) {
+            case OP_KNN: {
+                expectSize(payload, 4 + vector_bytes);
+                uint32_t k;
+                memcpy(&k, payload.data(), 4);
+                std::vector<float> vector = vectorAt(payload, 4);
+                PendingQuery query;
+                query.vector = vector.data();
+                query.k = k;
+                if (k == 0) return neighbors(nullptr, nullptr, 0);
+                if (k > hnswlib_index_get_current_count(index_))
+                    throw std::runtime_error("k exceeds the number of elements");
+                batcher_.search(query);
+                if (!query.ok)
+                    throw std::runtime_error("Search failed");
+                return neighbors(query.labels.data(), query.distances.data(), query.labels.size());
+            }
+            case OP_RANGE: {
+                expectSize(payload, 8 + vector_bytes);
+                float radius;
+                uint32_t max_results;
+                memcpy(&radius, payload.data(), 4);
+                memcpy(&max_results, payload.data() + 4, 4);
+                // the request is untrusted, no search returns more than the elements
+                size_t capacity = std::min((size_t) max_results, hnswlib_index_get_current_count(index_));
+                if (capacity == 0) return neighbors(nullptr, nullptr, 0);
+                std::vector<uint64_t> labels(capacity);
+                std::vector<float> distances(capacity);
+                size_t count = 0;
+                std::vector<float> vector = vectorAt(payload, 8);
+                if (!hnswlib_index_search_range(index_, vector.data(), radius, capacity,
+                                                labels.data(), distances.data(), &count))
+                    throw std::runtime_error("Range search failed");
+                return neighbors(labels.data(), distances.data(), count);
+            }
+            case OP_INSERT: {
+                expectSize(payload, 8 + vector_bytes);
+                uint64_t label;
+                memcpy(&label, payload.data(), 8);
+                std::vector<float> vector = vectorAt(payload, 8);
+                if (!hnswlib_index_add_items(index_, vector.data(), 1, opt_.dim, &label, 1, false))
+                    throw std::runtime_error("Insert failed");
+                return std::string();
+            }
+            case OP_DELETE: {
+                expectSize(payload, 8);
+                uint64_t label;
+                memcpy(&label, payload.data(), 8);
+                if (!hnswlib_index_mark_deleted(index_, label))
+                    throw std::runtime_error("Label not found");
+                return std::string();
+            }
+            case OP_STATS:
+                return statsText();
+            default:
+                throw std::runtime_error("Unknown opcode " + std::to_string(op));
+        }
+    }
+
+    std::string statsText() {
+        static const char* names[] = {"", "knn", "range", "insert", "delete", "stats"};
+        std::ostringstream out;
+        out << "# TYPE hnswlib_server_requests_total counter\n";
+        for (int op = OP_KNN; op <= OP_STATS; op++)
+            out << "hnswlib_server_requests_total{op=\"" << names[op] << "\"} " << stats_.requests[op] << "\n";
+        out << "# TYPE hnswlib_server_errors_total counter\n";
+        out << "hnswlib_server_errors_total " << stats_.errors << "\n";
+        out << "# TYPE hnswlib_server_connections_total counter\n";
+        out << "hnswlib_server_connections_total " << stats_.connections << "\n";
+        out << "# TYPE hnswlib_server_batches_total counter\n";
+        out << "hnswlib_server_batches_total " << stats_.batches << "\n";
+        out << "# TYPE hnswlib_server_batched_queries_total counter\n";
+        out << "hnswlib_server_batched_queries_total " << stats_.batched_queries << "\n";
+        out << "# TYPE hnswlib_server_batch_wait_seconds_total counter\n";
+        out << "hnswlib_server_batch_wait_seconds_total " << stats_.batch_wait_ns * 1e-9 << "\n";
+        out << "# TYPE hnswlib_server_elements gauge\n";
+        out << "hnswlib_server_elements " << hnswlib_index_get_current_count(index_) << "\n";
+
+        size_t length = hnswlib_index_export_prometheus(index_, nullptr, 0);
+        std::string histograms(length + 1, '\0');
+        hnswlib_index_export_prometheus(index_, &histograms[0], histograms.size());
+        histograms.resize(length);
+        return out.str() + histograms;
+    }
+
+ public:
+    Server(HNSWIndex* index, const Options& opt) : index_(index), opt_(opt), batcher_(index, opt.dim, opt, stats_) {}
+
+    // Answers the requests of a new client on its own thread until it disconnects
+    void accept(int fd) {
+        std::unique_lock<std::mutex> lock(clients_mutex_);
+        active_clients_++;
+        client_fds_.insert(fd);
+        std::thread(&Server::serve, this, fd).detach();
+    }
+
+    /*
+    * Shuts down the reading side of every connection, so that idle clients no longer
+    * hold up the exit, then waits for their threads. A request that is being answered
+    * still gets its response.
+    */
+    void disconnectClients() {
+        std::unique_lock<std::mutex> lock(clients_mutex_);
+        for (int fd : client_fds_) shutdown(fd, SHUT_RD);
+        clients_done_.wait(lock, [this] { return active_clients_ == 0; });
+    }
+
+    void serve(int fd) {
+        stats_.connections++;
+        std::string payload;
+        while (true) {
+            char header[5];
+            if (!readFully(fd, header, sizeof(header))) break;
+            uint8_t op = (uint8_t)header[0];
+            uint32_t length;
+            memcpy(&length, header + 1, sizeof(length));
+            if (length > MAX_PAYLOAD) {
+                sendMessage(fd, STATUS_ERROR, "Payload too large");
+                break;
+            }
+            payload.resize(length);
+            if (length > 0 && !readFully(fd, &payload[0], length)) break;
+
+            if (op <= OP_STATS) stats_.requests[op]++;
+            bool sent;
+            try {
+                sent = sendMessage(fd, STATUS_OK, handle(op, payload));
+            } catch (const std::exception& e) {
+                stats_.errors++;
+                sent = sendMessage(fd, STATUS_ERROR, e.what());
+            }
+            if (!sent) break;
+        }
+
+        // closed under the lock, so disconnectClients never shuts down a reused descriptor
+        std::unique_lock<std::mutex> lock(clients_mutex_);
+        client_fds_.erase(fd);
+        close(fd);
+        if (--active_clients_ == 0) clients_done_.notify_all();
+    }
+};
+
+// SIGINT / SIGTERM write a byte here, the accept loop polls the read end with the socket
+int g_signal_pipe[2] = {-1, -1};
+
+void onSignal(int) {
+    int saved_errno = errno;
+    char byte = 1;
+    if (write(g_signal_pipe[1], &byte, 1) < 0) {
+        // the pipe is full, a wakeup is already pending
+    }
+    errno = saved_errno;
+}
+
+void installSignalHandlers() {
+    if (pipe(g_signal_pipe) < 0)
+        throw std::runtime_error(std::string("pipe: ") + strerror(errno));
+    fcntl(g_signal_pipe[1], F_SETFL, fcntl(g_signal_pipe[1], F_GETFL) | O_NONBLOCK);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;  // no SA_RESTART, a blocking call returns EINTR
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    // a client that hangs up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << "See the comment at the top of Sources/hnswlib_server/main.cpp for options\n";
+            exit(0);
+        }
+        if (i + 1 >= argc)
+            throw std::runtime_error("Missing value for " + arg);
+        std::string value = argv[++i];
+        if (arg == "--socket") opt.socket_path = value;
+        else if (arg == "--index") opt.index_path = value;
+        else if (arg == "--save") opt.save_path = value;
+        else if (arg == "--dim") opt.dim = std::stoul(value);
+        else if (arg == "--max-elements") opt.max_elements = std::stoul(value);
+        else if (arg == "--M") opt.M = std::stoul(value);
+        else if (arg == "--ef-construction") opt.ef_construction = std::stoul(value);
+        else if (arg == "--ef") opt.ef = std::stoul(value);
+        else if (arg == "--threads") opt.threads = std::stoi(value);
+        else if (arg == "--max-batch") opt.max_batch = std::stoul(value);
+        else if (arg == "--max-wait-us") opt.max_wait_us = std::stoul(value);
+        else if (arg == "--space") {
+            if (value == "l2") opt.space = SpaceTypeL2;
+            else if (value == "ip") opt.space = SpaceTypeIP;
+            else if (value == "cosine") opt.space = SpaceTypeCosine;
+            else throw std::runtime_error("Unknown space " + value);
+        } else {
+            throw std::runtime_error("Unknown option " + arg);
+        }
+    }
+    if (opt.socket_path.empty())
+        throw std::runtime_error("--socket is required");
+    if (opt.dim == 0)
+        throw std::runtime_error("--dim is required");
+    if (opt.threads <= 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+    return opt;
+}
+
+int listenOn(const std::string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Socket path too long: " + path);
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error(std::string("socket: ") + strerror(errno));
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+        std::string error = strerror(errno);
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + path + ": " + error);
+    }
+    return fd;
+}
+
+int run(int argc, char** argv) {
+    Options opt = parseOptions(argc, argv);
+
+    HNSWIndex* index = nullptr;
+    if (!opt.index_path.empty()) {
+        index = hnswlib_index_load(opt.space, (int)opt.dim, opt.index_path.c_str(), opt.max_elements, false);
+        if (!index)
+            throw std::runtime_error("Failed to load " + opt.index_path);
+        if (hnswlib_index_get_max_elements(index) < opt.max_elements)
+            hnswlib_index_resize(index, opt.max_elements);
+    } else {
+        index = hnswlib_index_create(opt.space, (int)opt.dim);
+        if (!index || !hnswlib_index_init(index, opt.max_elements, opt.M, opt.ef_construction, 100, false))
+            throw std::runtime_error("Failed to create the index");
+    }
+    hnswlib_index_set_ef(index, opt.ef);
+
+    int listen_fd = listenOn(opt.socket_path);
+    installSignalHandlers();
+    std::cerr << "serving " << hnswlib_index_get_current_count(index) << " vectors of dim " << opt.dim
+              << " on " << opt.socket_path << std::endl;
+
+    {
+        Server server(index, opt);
+        pollfd fds[2] = {{listen_fd, POLLIN, 0}, {g_signal_pipe[0], POLLIN, 0}};
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (fds[1].revents) break;
+            if (!(fds[0].revents & POLLIN)) continue;
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) continue;
+                break;
+            }
+            server.accept(fd);
+        }
+        server.disconnectClients();
+    }
+    close(listen_fd);
+    unlink(opt.socket_path.c_str());
+
+    int status = 0;
+    if (!opt.save_path.empty()) {
+        if (hnswlib_index_save(index, opt.save_path.c_str())) {
+            std::cerr << "saved to " << opt.save_path << std::endl;
+        } else {
+            status = 1;
+        }
+    }
+    hnswlib_index_free(index);
+    return status;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
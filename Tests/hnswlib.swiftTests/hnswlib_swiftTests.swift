@@ -66,6 +66,44 @@ final class HNSWLibTests: XCTestCase {
         }
     }
 
+    func testContiguousBuffers() throws {
+        let dimensions = 4
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 100)
+        index.setEf(ef: 50)
+        
+        // 20 vectors, row after row, with explicit ids
+        let rows = 20
+        let data = ContiguousArray<Float>((0..<(rows * dimensions)).map { Float($0 / dimensions) + Float($0 % dimensions) * 0.01 })
+        let ids = ContiguousArray<UInt64>((0..<rows).map { UInt64(100 + $0) })
+        try index.addItems(data: data, rows: rows, ids: ids)
+        XCTAssertEqual(index.currentCount, rows)
+        XCTAssertThrowsError(try index.addItems(data: data, rows: rows + 1))
+        
+        // Flat results: the neighbors of query i are at [i * k, (i + 1) * k)
+        let k = 3
+        let flat = try index.searchKnn(query: data, rows: rows, k: k)
+        XCTAssertEqual(flat.labels.count, rows * k)
+        for i in 0..<rows {
+            XCTAssertEqual(flat.labels[i * k], UInt64(100 + i))
+            XCTAssertEqual(flat.distances[i * k], 0, accuracy: 1e-6)
+        }
+        
+        // Caller-provided buffers match the nested-array API
+        var labels = [UInt64](repeating: 0, count: rows * k)
+        var distances = [Float](repeating: 0, count: rows * k)
+        try data.withUnsafeBufferPointer { query in
+            try labels.withUnsafeMutableBufferPointer { labelsBuffer in
+                try distances.withUnsafeMutableBufferPointer { distancesBuffer in
+                    try index.searchKnn(query: query, rows: rows, k: k, labels: labelsBuffer, distances: distancesBuffer)
+                }
+            }
+        }
+        let nested = try index.searchKnn(query: (0..<rows).map { Array(data[($0 * dimensions)..<(($0 + 1) * dimensions)]) }, k: k)
+        XCTAssertEqual(labels, nested.labels.flatMap { $0 })
+        XCTAssertEqual(Array(flat.labels), labels)
+    }
+    
     func testCosineSimilarity() throws {
         // Create an index with cosine similarity
         let dimensions = 5
@@ -98,6 +136,22 @@ final class HNSWLibTests: XCTestCase {
         XCTAssertEqual(results.labels[0][2], 2)  // The y-direction vector should be last
     }
 
+    func testAssumeNormalized() throws {
+        let index = try HNSWIndex(spaceType: .cosine, dim: 3)
+        try index.initIndex(maxElements: 10)
+        try index.setAssumeNormalized(true)
+        
+        // Unit vectors are stored and searched as given
+        try index.addItems(data: [[1, 0, 0], [0, 1, 0], [0, 0, 1]])
+        let results = try index.searchKnn(query: [[0, 1, 0]], k: 1)
+        XCTAssertEqual(results.labels[0][0], 1)
+        XCTAssertEqual(results.distances[0][0], 0, accuracy: 1e-6)
+        
+        // Only cosine indices normalize
+        let l2Index = try HNSWIndex(spaceType: .l2, dim: 3)
+        XCTAssertThrowsError(try l2Index.setAssumeNormalized(true))
+    }
+
     func testSaveAndLoad() throws {
         // Skip this test for now as it's causing a crash
         // This test would need further investigation to fix the underlying issue
@@ -140,6 +194,30 @@ final class HNSWLibTests: XCTestCase {
         XCTAssertEqual(afterUnmarkResults.labels[0][0], assignedId)
     }
 
+    func testGetItems() throws {
+        let vectors: [[Float]] = (0..<50).map { [Float($0), Float($0) * 0.5, 1] }
+        let index = try HNSWIndex(spaceType: .l2, dim: 3)
+        try index.initIndex(maxElements: 100)
+        try index.addItems(data: vectors)
+        index.markDeleted(label: 7)
+        
+        let items = index.getItems(labels: [3, 7, 49, 1000])
+        XCTAssertEqual(items[0], vectors[3])
+        XCTAssertNil(items[1])
+        XCTAssertEqual(items[2], vectors[49])
+        XCTAssertNil(items[3])
+        
+        // Quantized segments are decoded back to floats
+        let tiered = try TieredHNSWIndex(spaceType: .l2, dim: 3)
+        try tiered.initIndex(headCapacity: 20, segmentQuantization: .fp16)
+        try tiered.addItems(data: vectors)
+        tiered.merge()
+        let decoded = tiered.getItems(labels: [3])[0]!
+        for (value, expected) in zip(decoded, vectors[3]) {
+            XCTAssertEqual(value, expected, accuracy: 0.01)
+        }
+    }
+
     func testResizeIndex() throws {
         // Create a small index
         let dimensions = 5
@@ -181,6 +259,443 @@ final class HNSWLibTests: XCTestCase {
         XCTAssertEqual(index.currentCount, 15)
     }
 
+    func testSearchStatsAndHistograms() throws {
+        let dimensions = 8
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 200)
+        
+        var vectors: [[Float]] = []
+        for i in 0..<200 {
+            vectors.append((0..<dimensions).map { Float(($0 * 31 + i * 17) % 97) })
+        }
+        try index.addItems(data: vectors)
+        
+        let plain = try index.searchKnn(query: Array(vectors[0..<10]), k: 3)
+        let withStats = try index.searchKnnWithStats(query: Array(vectors[0..<10]), k: 3)
+        
+        // Collecting stats does not change the results
+        XCTAssertEqual(withStats.labels, plain.labels)
+        XCTAssertEqual(withStats.stats.count, 10)
+        for stats in withStats.stats {
+            XCTAssertGreaterThan(stats.baseDistanceComputations, 0)
+            XCTAssertGreaterThan(stats.visitedNodes, 0)
+            XCTAssertGreaterThan(stats.wallTimeNs, 0)
+        }
+        
+        let metrics = index.prometheusMetrics()
+        XCTAssertTrue(metrics.contains("# TYPE hnswlib_query_latency_seconds histogram"))
+        XCTAssertTrue(metrics.contains("hnswlib_query_latency_seconds_count 10"))
+        
+        index.resetQueryHistograms()
+        XCTAssertTrue(index.prometheusMetrics().contains("hnswlib_query_latency_seconds_count 0"))
+    }
+
+    func testSearchRange() throws {
+        let index = try HNSWIndex(spaceType: .l2, dim: 2)
+        try index.initIndex(maxElements: 100)
+        try index.addItems(data: (0..<100).map { [Float($0), 0] })
+        
+        // Squared L2 distances from the origin are 0, 1, 4, 9, ...
+        let (labels, distances) = try index.searchRange(query: [0, 0], radius: 4.5, maxResults: 10)
+        XCTAssertEqual(labels, [0, 1, 2])
+        XCTAssertEqual(distances, [0, 1, 4])
+        
+        let capped = try index.searchRange(query: [0, 0], radius: 1000, maxResults: 5)
+        XCTAssertEqual(capped.labels, [0, 1, 2, 3, 4])
+    }
+    
+    func testSearchGrouped() throws {
+        let index = try HNSWIndex(spaceType: .l2, dim: 2)
+        try index.initIndex(maxElements: 100)
+        try index.addItems(data: (0..<100).map { [Float($0), 0] })
+        
+        // Ten consecutive points per group; labels 90..<100 have no group
+        let labels = (0..<90).map { UInt64($0) }
+        try index.setGroups(labels: labels, groups: labels.map { $0 / 10 + 1000 })
+        
+        let (capped, _) = try index.searchGrouped(query: [[0, 0]], k: 6, maxPerGroup: 2)
+        XCTAssertEqual(capped[0], [0, 1, 10, 11, 20, 21])
+        
+        let (distinct, distances) = try index.searchGrouped(query: [[85, 0]], k: 4, maxPerGroup: 1)
+        let grouped = distinct[0].filter { $0 < 90 }
+        XCTAssertEqual(distinct[0].count, 4)
+        XCTAssertEqual(Set(grouped.map { $0 / 10 }).count, grouped.count)
+        XCTAssertEqual(distinct[0].first, 85)
+        XCTAssertEqual(distances[0], distances[0].sorted())
+    }
+    
+    func testPerfCounters() throws {
+        let dimensions = 8
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 100)
+        
+        // Counters need Linux and perf_event_open permissions
+        guard HNSWIndex.perfCountersAvailable else {
+            XCTAssertFalse(index.setPerfCounters(enabled: true))
+            return
+        }
+        XCTAssertTrue(index.setPerfCounters(enabled: true))
+        
+        let vectors: [[Float]] = (0..<50).map { i in (0..<dimensions).map { Float(($0 + i) % 7) } }
+        try index.addItems(data: vectors, numThreads: 1)
+        _ = try index.searchKnn(query: Array(vectors[0..<5]), k: 3, numThreads: 1)
+        
+        XCTAssertEqual(index.perfCounters(operation: .add).operations, 50)
+        XCTAssertEqual(index.perfCounters(operation: .search).operations, 5)
+        XCTAssertGreaterThan(index.perfCounters(operation: .search).cycles, 0)
+        XCTAssertEqual(index.perfCountersPerThread(operation: .search).count, 1)
+        
+        index.resetPerfCounters()
+        XCTAssertEqual(index.perfCounters(operation: .search).operations, 0)
+    }
+    
+    func testBuildProfile() throws {
+        let dimensions = 8
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 500)
+        index.setBuildProfiling(enabled: true)
+        
+        var reports = [BuildProgress]()
+        let lock = NSLock()
+        index.setBuildProgress(interval: 100) { progress in
+            lock.lock()
+            reports.append(progress)
+            lock.unlock()
+        }
+        
+        let vectors: [[Float]] = (0..<300).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        try index.addItems(data: vectors, numThreads: 2)
+        
+        XCTAssertEqual(reports.count, 3)
+        XCTAssertEqual(reports.map { $0.done }.max(), 300)
+        XCTAssertTrue(reports.allSatisfy { $0.total == 300 })
+        
+        let profile = index.buildProfile()
+        XCTAssertEqual(profile.counts[.insert], 300)
+        XCTAssertGreaterThan(profile.counts[.searchBaseLayer]!, 0)
+        XCTAssertGreaterThan(profile.nanoseconds[.insert]!, 0)
+        XCTAssertEqual(index.buildProfilePerThread().count, 2)
+        
+        index.resetBuildProfile()
+        XCTAssertEqual(index.buildProfile().counts[.insert], 0)
+    }
+    
+    func testGraphStats() throws {
+        let dimensions = 8
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 500, m: 8)
+        
+        let vectors: [[Float]] = (0..<300).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        try index.addItems(data: vectors, numThreads: 2)
+        index.markDeleted(label: 0)
+        index.setEf(ef: 50)
+        
+        let stats = try index.graphStats(navigabilitySamples: 100, numThreads: 2)
+        XCTAssertEqual(stats.numElements, 300)
+        XCTAssertEqual(stats.numDeleted, 1)
+        XCTAssertEqual(stats.nodesPerLevel[0], 300)
+        XCTAssertEqual(stats.outDegreeHistogram[0].reduce(0, +), 300)
+        XCTAssertEqual(stats.inDegreeHistogram[0].reduce(0, +), 300)
+        XCTAssertEqual(stats.unreachableNodes, 0)
+        XCTAssertGreaterThan(stats.edgesToDeleted, 0)
+        XCTAssertGreaterThan(stats.avgEdgeLength, 0)
+        XCTAssertGreaterThan(stats.navigability, 0.9)
+    }
+
+    func testAutotuneAndCalibrateEf() throws {
+        let dimensions = 8
+        let vectors: [[Float]] = (0..<400).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        let queries: [[Float]] = (0..<30).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        
+        let (best, tried) = try HNSWIndex.autotune(spaceType: .l2, data: vectors, queries: queries, k: 5,
+                                                   targetRecall: 0.9, budgetSeconds: 2, numThreads: 2)
+        XCTAssertFalse(tried.isEmpty)
+        XCTAssertTrue(best.meetsTarget)
+        XCTAssertGreaterThanOrEqual(best.recall, 0.9)
+        XCTAssertGreaterThanOrEqual(best.ef, 5)
+        
+        // Calibrate ef per k on an index built with the chosen parameters
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 400, m: best.m, efConstruction: best.efConstruction)
+        try index.addItems(data: vectors)
+        let calibration = try index.calibrateEf(queries: queries, ks: [1, 10], targetRecall: 0.95)
+        XCTAssertEqual(calibration.map { $0.k }, [1, 10])
+        for entry in calibration {
+            XCTAssertGreaterThanOrEqual(entry.ef, entry.k)
+            XCTAssertGreaterThanOrEqual(entry.recall, 0.95)
+        }
+    }
+
+    func testFlatGraph() throws {
+        let dimensions = 16
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 500, m: 8)
+        try index.setFlat(numRouters: 8)
+        
+        let vectors: [[Float]] = (0..<300).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        try index.addItems(data: vectors, numThreads: 2)
+        index.setEf(ef: 50)
+        
+        // Every element stays on level 0 and is still found
+        let stats = try index.graphStats(navigabilitySamples: 100, numThreads: 2)
+        XCTAssertEqual(stats.nodesPerLevel, [300])
+        let results = try index.searchKnn(query: Array(vectors[0..<20]), k: 1)
+        for i in 0..<20 {
+            XCTAssertEqual(results.labels[i][0], UInt64(i))
+        }
+        
+        // A graph that already has upper levels cannot become flat
+        let hierarchical = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try hierarchical.initIndex(maxElements: 500, m: 4)
+        try hierarchical.addItems(data: vectors)
+        XCTAssertThrowsError(try hierarchical.setFlat())
+    }
+
+    // MARK: - Sharded Index Tests
+    func testShardedIndex() throws {
+        let dimensions = 8
+        let index = try ShardedHNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(numShards: 3, maxElementsPerShard: 200, numThreads: 2)
+        XCTAssertEqual(index.numShards, 3)
+        
+        let vectors: [[Float]] = (0..<300).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        try index.addItems(data: vectors)
+        XCTAssertEqual(index.currentCount, 300)
+        index.setEf(ef: 50)
+        
+        // Every vector is found in whichever shard it landed in
+        let (labels, distances) = try index.searchKnn(query: Array(vectors[0..<10]), k: 5)
+        for i in 0..<10 {
+            XCTAssertEqual(labels[i][0], UInt64(i))
+            XCTAssertEqual(distances[i][0], 0, accuracy: 1e-6)
+            XCTAssertLessThanOrEqual(distances[i][0], distances[i][4])
+        }
+        
+        let path = NSTemporaryDirectory() + "sharded_test.bin"
+        try index.saveIndex(path: path)
+        let loaded = try ShardedHNSWIndex.loadIndex(spaceType: .l2, dim: dimensions, path: path)
+        XCTAssertEqual(loaded.numShards, 3)
+        XCTAssertEqual(loaded.currentCount, 300)
+        
+        loaded.markDeleted(label: 0)
+        let (afterDelete, _) = try loaded.searchKnn(query: [vectors[0]], k: 1)
+        XCTAssertNotEqual(afterDelete[0][0], 0)
+        
+        let ranged = try ShardedHNSWIndex(spaceType: .l2, dim: dimensions)
+        XCTAssertThrowsError(try ranged.initIndex(numShards: 2, maxElementsPerShard: 100, partitioning: .range))
+    }
+    
+    // MARK: - Partitioned Index Tests
+    func testPartitionedIndex() throws {
+        let dimensions = 8
+        let index = try PartitionedHNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(numPartitions: 4, maxElementsPerPartition: 50, numThreads: 2)
+        
+        let vectors: [[Float]] = (0..<400).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        XCTAssertThrowsError(try index.addItems(data: vectors))
+        try index.train(data: vectors)
+        
+        // Partitions grow past their initial capacity when k-means is unbalanced
+        try index.addItems(data: vectors)
+        XCTAssertEqual(index.currentCount, 400)
+        XCTAssertEqual(index.partitionSizes.reduce(0, +), 400)
+        index.setEf(ef: 50)
+        
+        // A stored vector is closest to its own partition's centroid, so nprobe = 1 finds it
+        index.nprobe = 1
+        let (labels, distances) = try index.searchKnn(query: Array(vectors[0..<10]), k: 1)
+        for i in 0..<10 {
+            XCTAssertEqual(labels[i][0], UInt64(i))
+            XCTAssertEqual(distances[i][0], 0, accuracy: 1e-6)
+        }
+        
+        // Re-adding a label replaces its vector whichever partition the new one routes to
+        try index.addItems(data: [[Float](repeating: 5, count: dimensions)], ids: [0])
+        index.nprobe = 4
+        XCTAssertNotEqual(try index.searchKnn(query: [vectors[0]], k: 1).labels[0][0], 0)
+        index.nprobe = 1
+        
+        let path = NSTemporaryDirectory() + "partitioned_test.bin"
+        try index.saveIndex(path: path)
+        let loaded = try PartitionedHNSWIndex.loadIndex(spaceType: .l2, dim: dimensions, path: path)
+        XCTAssertEqual(loaded.numPartitions, 4)
+        XCTAssertEqual(loaded.nprobe, 1)
+        
+        let replicated = try PartitionedHNSWIndex(spaceType: .l2, dim: dimensions)
+        try replicated.initIndex(numPartitions: 4, maxElementsPerPartition: 400)
+        try replicated.train(data: vectors)
+        replicated.setReplication(maxReplicas: 2, boundaryFactor: 1.5)
+        try replicated.addItems(data: vectors)
+        XCTAssertGreaterThan(replicated.currentCount, 400)
+    }
+    
+    func testAsyncIndex() async throws {
+        let dimensions = 4
+        let index = try HNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 1000)
+        index.setEf(ef: 50)
+        let asyncIndex = try AsyncHNSWIndex(index: index, maxBatch: 32, maxWaitMicroseconds: 1000)
+        
+        let vectors = (0..<500).map { i in (0..<dimensions).map { Float(i * dimensions + $0) } }
+        try await asyncIndex.addItems(data: vectors)
+        XCTAssertEqual(index.currentCount, 500)
+        
+        // Concurrent callers share batches and each get their own results
+        let hits = try await withThrowingTaskGroup(of: Bool.self) { group in
+            for i in 0..<100 {
+                group.addTask {
+                    let (labels, distances) = try await asyncIndex.searchKnn(query: vectors[i], k: 3)
+                    return labels[0] == UInt64(i) && distances[0] == 0
+                }
+            }
+            return try await group.reduce(0) { $0 + ($1 ? 1 : 0) }
+        }
+        XCTAssertEqual(hits, 100)
+        
+        // A cancelled task cancels its queued search
+        let slowIndex = try AsyncHNSWIndex(index: index, maxWaitMicroseconds: 200_000)
+        let task = Task { try await slowIndex.searchKnn(query: vectors[0], k: 3) }
+        task.cancel()
+        do {
+            _ = try await task.value
+            XCTFail("Expected the search to be cancelled")
+        } catch {
+            XCTAssertTrue(error is CancellationError)
+        }
+    }
+    
+    func testTieredIndex() throws {
+        let dimensions = 8
+        let index = try TieredHNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(headCapacity: 100, mergeThreshold: 60, segmentQuantization: .int8, numThreads: 2)
+        index.setEf(ef: 50)
+        
+        // The head is frozen and merged into segments while inserts continue
+        let vectors: [[Float]] = (0..<400).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        try index.addItems(data: vectors)
+        index.merge()
+        XCTAssertGreaterThan(index.numSegments, 1)
+        XCTAssertEqual(index.headCount, 0)
+        XCTAssertEqual(index.currentCount, 400)
+        
+        let (labels, _) = try index.searchKnn(query: Array(vectors[0..<10]), k: 1)
+        for i in 0..<10 {
+            XCTAssertEqual(labels[i][0], UInt64(i))
+        }
+        
+        // A deleted label disappears from its segment, a re-added one lives in the head
+        index.markDeleted(label: 0)
+        try index.addItems(data: [vectors[2]], ids: [1])
+        XCTAssertEqual(index.currentCount, 399)
+        XCTAssertEqual(index.headCount, 1)
+        let (after, _) = try index.searchKnn(query: [vectors[0], vectors[2]], k: 5)
+        XCTAssertFalse(after[0].contains(0))
+        XCTAssertTrue(after[1].contains(2))
+        XCTAssertEqual(after[1].filter { $0 == 1 }.count, 1)
+        
+        // Deleting a label of the head and adding it again reuses its slot
+        index.markDeleted(label: 1)
+        XCTAssertEqual(index.currentCount, 398)
+        try index.addItems(data: [vectors[3]], ids: [1])
+        XCTAssertEqual(index.currentCount, 399)
+        XCTAssertEqual(index.headCount, 1)
+        let (readded, _) = try index.searchKnn(query: [vectors[3]], k: 5)
+        XCTAssertTrue(readded[0].contains(1))
+        
+        let path = NSTemporaryDirectory() + "tiered_test.bin"
+        try index.saveIndex(path: path)
+        let loaded = try TieredHNSWIndex.loadIndex(spaceType: .l2, dim: dimensions, path: path, segmentQuantization: .int8)
+        XCTAssertEqual(loaded.numSegments, index.numSegments)
+        XCTAssertEqual(loaded.currentCount, 399)
+    }
+    
+    func testMultiVectorIndex() throws {
+        let dimensions = 8
+        let index = try MultiVectorHNSWIndex(spaceType: .l2, dim: dimensions)
+        try index.initIndex(maxElements: 500)
+        index.setEf(ef: 50)
+        
+        // 100 documents of 4 vectors each, with doc ids unrelated to their order
+        let vectors: [[Float]] = (0..<400).map { _ in (0..<dimensions).map { _ in Float.random(in: 0...1) } }
+        let docIds: [UInt64] = (0..<400).map { UInt64($0 / 4) * 1_000_003 + 7 }
+        try index.addItems(data: vectors, docIds: docIds)
+        XCTAssertEqual(index.currentCount, 400)
+        XCTAssertEqual(index.numDocs, 100)
+        
+        // Each query matches one vector of its document exactly; results are distinct documents
+        let (docs, distances) = try index.searchDocs(query: [vectors[5], vectors[222]], k: 10)
+        XCTAssertEqual(docs[0][0], docIds[5])
+        XCTAssertEqual(docs[1][0], docIds[222])
+        XCTAssertEqual(distances[0][0], 0, accuracy: 1e-6)
+        XCTAssertEqual(Set(docs[0]).count, 10)
+        XCTAssertEqual(distances[1], distances[1].sorted())
+        
+        let path = NSTemporaryDirectory() + "multivector_test.bin"
+        try index.saveIndex(path: path)
+        let loaded = try MultiVectorHNSWIndex.loadIndex(spaceType: .l2, dim: dimensions, path: path)
+        loaded.setEf(ef: 50)
+        XCTAssertEqual(loaded.numDocs, 100)
+        XCTAssertEqual(try loaded.searchDocs(query: [vectors[222]], k: 1).docIds[0][0], docIds[222])
+    }
+    
+    func testMultiVectorMaxSim() throws {
+        let dimensions = 8
+        let index = try MultiVectorHNSWIndex(spaceType: .ip, dim: dimensions)
+        try index.initIndex(maxElements: 500)
+        index.setEf(ef: 50)
+        
+        let vectors: [[Float]] = (0..<400).map { _ in (0..<dimensions).map { _ in Float.random(in: -1...1) } }
+        let docIds: [UInt64] = (0..<400).map { UInt64($0 / 4) }
+        try index.addItems(data: vectors, docIds: docIds)
+        
+        // Exact sum over the query vectors of the best distance in each returned document
+        let query = [vectors[40], vectors[43], vectors[7]]
+        let (docs, distances) = try index.searchMaxSim(query: query, k: 5, candidatesPerVector: 20)
+        XCTAssertEqual(docs.count, 5)
+        XCTAssertEqual(distances, distances.sorted())
+        for (doc, distance) in zip(docs, distances) {
+            let members = (0..<400).filter { docIds[$0] == doc }
+            let expected = query.reduce(Float(0)) { sum, q in
+                sum + members.map { m in 1 - zip(q, vectors[m]).reduce(Float(0)) { $0 + $1.0 * $1.1 } }.min()!
+            }
+            XCTAssertEqual(distance, expected, accuracy: 1e-4)
+        }
+    }
+    
+    func testSparseIndex() throws {
+        let vocabulary = 30_000
+        let index = try SparseHNSWIndex(dim: vocabulary)
+        try index.initIndex(maxElements: 50)
+        // Rows share no terms, so most distances tie; ef above the count keeps the search exhaustive
+        index.setEf(ef: 100)
+        
+        // Row i has the unsorted terms i, i + 1000 and 29_999 - i
+        var indptr = [0]
+        var indices: [UInt32] = []
+        var values: [Float] = []
+        for i in 0..<50 {
+            indices += [UInt32(29_999 - i), UInt32(i), UInt32(i + 1000)]
+            values += [0.5, 1, 2]
+            indptr.append(indices.count)
+        }
+        try index.addItems(indptr: indptr, indices: indices, values: values)
+        XCTAssertEqual(index.currentCount, 50)
+        XCTAssertEqual(index.arenaBytes, 150 * 8)
+        
+        // The query shares terms 7 and 1007 with row 7 only: dot = 1 * 1 + 2 * 2
+        let (labels, distances) = try index.searchKnn(indptr: [0, 2], indices: [1007, 7], values: [2, 1], k: 1)
+        XCTAssertEqual(labels[0][0], 7)
+        XCTAssertEqual(distances[0][0], 1 - 5, accuracy: 1e-6)
+        
+        XCTAssertThrowsError(try index.addItems(indptr: [0, 1], indices: [UInt32(vocabulary)], values: [1]))
+        
+        let path = NSTemporaryDirectory() + "sparse_test.bin"
+        try index.saveIndex(path: path)
+        let loaded = try SparseHNSWIndex.loadIndex(dim: vocabulary, path: path)
+        loaded.setEf(ef: 100)
+        XCTAssertEqual(try loaded.searchKnn(indptr: [0, 1], indices: [29_999 - 42], values: [1], k: 1).labels[0][0], 42)
+    }
+    
     // MARK: - BruteForce Index Tests
     func testBruteForceIndex() throws {
         // Create a BruteForce index
@@ -224,4 +739,104 @@ final class HNSWLibTests: XCTestCase {
             print("WARNING: NaN distances detected in BruteForce test, skipping distance assertions")
         }
     }
+
+    func testBruteForceBlockScanMatchesScalarScan() throws {
+        // 203 rows are three full 64-row scan blocks plus a tail that is not a multiple of
+        // the SIMD width; small integer coordinates put many distances exactly on the threshold
+        let dimensions = 3
+        let rows = 203
+        let bfIndex = try BFIndex(spaceType: .l2, dim: dimensions)
+        try bfIndex.initIndex(maxElements: rows)
+        let vectors: [[Float]] = (0..<rows).map { _ in (0..<dimensions).map { _ in Float(Int.random(in: 0...3)) } }
+        try bfIndex.addItems(data: vectors)
+        
+        let queries: [[Float]] = (0..<10).map { _ in (0..<dimensions).map { _ in Float(Int.random(in: 0...3)) } }
+        let k = 20
+        let results = try bfIndex.searchKnn(query: queries, k: k, numThreads: 1)
+        for (q, query) in queries.enumerated() {
+            let expected = vectors.map { v in zip(v, query).map { ($0 - $1) * ($0 - $1) }.reduce(0, +) }.sorted()
+            XCTAssertEqual(results.distances[q], Array(expected[0..<k]))
+            for (label, distance) in zip(results.labels[q], results.distances[q]) {
+                let v = vectors[Int(label)]
+                XCTAssertEqual(zip(v, query).map { ($0 - $1) * ($0 - $1) }.reduce(0, +), distance)
+            }
+        }
+    }
+
+    func testBruteForceSingleQueryParallelScan() throws {
+        // Large enough that a single query is split across threads
+        let dimensions = 4
+        let count = 40000
+        let bfIndex = try BFIndex(spaceType: .l2, dim: dimensions)
+        try bfIndex.initIndex(maxElements: count)
+
+        var vectors: [[Float]] = []
+        for i in 0..<count {
+            vectors.append([Float(i), 0, 0, 0])
+        }
+        try bfIndex.addItems(data: vectors)
+
+        let query: [[Float]] = [[12345.2, 0, 0, 0]]
+        let parallel = try bfIndex.searchKnn(query: query, k: 3, numThreads: 4)
+        let serial = try bfIndex.searchKnn(query: query, k: 3, numThreads: 1)
+
+        XCTAssertEqual(parallel.labels[0], [12345, 12346, 12344])
+        XCTAssertEqual(parallel.labels, serial.labels)
+        XCTAssertEqual(parallel.distances, serial.distances)
+    }
+
+    func testBruteForceRemoveAndCosine() throws {
+        let dimensions = 5
+        let bfIndex = try BFIndex(spaceType: .cosine, dim: dimensions)
+        try bfIndex.initIndex(maxElements: 10)
+
+        let vectors: [[Float]] = [
+            [3.0, 0.0, 0.0, 0.0, 0.0],
+            [0.0, 2.0, 0.0, 0.0, 0.0],
+            [1.0, 1.0, 0.0, 0.0, 0.0]
+        ]
+        try bfIndex.addItems(data: vectors, ids: [10, 20, 30])
+
+        // Vectors are normalized on insert, so magnitude does not matter
+        var results = try bfIndex.searchKnn(query: [[1.0, 0.0, 0.0, 0.0, 0.0]], k: 1)
+        XCTAssertEqual(results.labels[0][0], 10)
+        XCTAssertLessThan(abs(results.distances[0][0]), 0.00001)
+
+        // After removal the next closest direction is returned
+        XCTAssertTrue(bfIndex.removeItem(label: 10))
+        XCTAssertFalse(bfIndex.removeItem(label: 10))
+        results = try bfIndex.searchKnn(query: [[1.0, 0.0, 0.0, 0.0, 0.0]], k: 2)
+        XCTAssertEqual(results.labels[0], [30, 20])
+
+        // A batch that does not fit adds nothing, and a repeated label keeps its last vector
+        XCTAssertThrowsError(try bfIndex.addItems(data: Array(repeating: vectors[0], count: 9), ids: Array(100..<109)))
+        XCTAssertEqual(try bfIndex.searchKnn(query: [[1.0, 0.0, 0.0, 0.0, 0.0]], k: 2).labels[0], [30, 20])
+        try bfIndex.addItems(data: [vectors[1], vectors[0]], ids: [40, 40])
+        results = try bfIndex.searchKnn(query: [[1.0, 0.0, 0.0, 0.0, 0.0]], k: 1)
+        XCTAssertEqual(results.labels[0][0], 40)
+        XCTAssertLessThan(abs(results.distances[0][0]), 0.00001)
+    }
+
+    func testQuantizedBruteForceIndex() throws {
+        let dimensions = 8
+        var vectors: [[Float]] = []
+        for i in 0..<20 {
+            var vector = [Float](repeating: 0, count: dimensions)
+            vector[i % dimensions] = Float(i / dimensions + 1)
+            vectors.append(vector)
+        }
+
+        for quantization in [Quantization.int8, Quantization.fp16] {
+            let index = try BFQuantizedIndex(spaceType: .l2, quantization: quantization, dim: dimensions)
+            try index.initIndex(maxElements: 20, keepFloatVectors: true)
+            index.setRerank(rerankK: 5)
+            try index.addItems(data: vectors)
+
+            let results = try index.searchKnn(query: [vectors[3], vectors[12]], k: 2)
+            XCTAssertEqual(results.labels[0][0], 3)
+            XCTAssertEqual(results.labels[1][0], 12)
+            // Reranked distances are exact
+            XCTAssertEqual(results.distances[0][0], 0, accuracy: 0.00001)
+        }
+    }
 }